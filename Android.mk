@@ -9,7 +9,8 @@ include $(CLEAR_VARS)
 LOCAL_MODULE_TAGS := optional
 
 LOCAL_SRC_FILES := \
-        $(call all-java-files-under, src)
+        $(call all-java-files-under, src) \
+        $(call all-Iaidl-files-under, src)
 
 LOCAL_SRC_FILES += \
         $(call all-java-files-under, nci)
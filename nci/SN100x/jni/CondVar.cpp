@@ -134,3 +134,20 @@ void CondVar::notifyOne() {
                                res);
   }
 }
+
+/*******************************************************************************
+**
+** Function:        notifyAll
+**
+** Description:     Unblock all waiting threads.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void CondVar::notifyAll() {
+  int const res = pthread_cond_broadcast(&mCondition);
+  if (res) {
+    LOG(ERROR) << StringPrintf("CondVar::notifyAll: fail broadcast; error=0x%X",
+                               res);
+  }
+}
@@ -35,6 +35,7 @@
 #include <base/logging.h>
 #include <nativehelper/ScopedLocalRef.h>
 #include "JavaClassConstants.h"
+#include "JniEventDispatcher.h"
 #include "NfcJniUtil.h"
 #include "nfc_config.h"
 
@@ -72,34 +73,32 @@ void HciEventManager::notifyTransactionListenersOfAid(std::vector<uint8_t> aid,
     return;
   }
 
-  JNIEnv* e = NULL;
-  ScopedAttach attach(mNativeData->vm, &e);
-  CHECK(e);
-
-  ScopedLocalRef<jobject> aidJavaArray(e, e->NewByteArray(aid.size()));
-  CHECK(aidJavaArray.get());
-  e->SetByteArrayRegion((jbyteArray)aidJavaArray.get(), 0, aid.size(),
-                        (jbyte*)&aid[0]);
-  CHECK(!e->ExceptionCheck());
-
-  ScopedLocalRef<jobject> srcJavaString(e, e->NewStringUTF(evtSrc.c_str()));
-  CHECK(srcJavaString.get());
-
-  if (data.size() > 0) {
-    ScopedLocalRef<jobject> dataJavaArray(e, e->NewByteArray(data.size()));
-    CHECK(dataJavaArray.get());
-    e->SetByteArrayRegion((jbyteArray)dataJavaArray.get(), 0, data.size(),
-                          (jbyte*)&data[0]);
+  JniEventDispatcher::getInstance().post([this, aid, data, evtSrc](JNIEnv* e) {
+    ScopedLocalRef<jobject> aidJavaArray(e, e->NewByteArray(aid.size()));
+    CHECK(aidJavaArray.get());
+    e->SetByteArrayRegion((jbyteArray)aidJavaArray.get(), 0, aid.size(),
+                          (jbyte*)&aid[0]);
     CHECK(!e->ExceptionCheck());
-    e->CallVoidMethod(mNativeData->manager,
-                      android::gCachedNfcManagerNotifyTransactionListeners,
-                      aidJavaArray.get(), dataJavaArray.get(),
-                      srcJavaString.get());
-  } else {
-    e->CallVoidMethod(mNativeData->manager,
-                      android::gCachedNfcManagerNotifyTransactionListeners,
-                      aidJavaArray.get(), NULL, srcJavaString.get());
-  }
+
+    ScopedLocalRef<jobject> srcJavaString(e, e->NewStringUTF(evtSrc.c_str()));
+    CHECK(srcJavaString.get());
+
+    if (data.size() > 0) {
+      ScopedLocalRef<jobject> dataJavaArray(e, e->NewByteArray(data.size()));
+      CHECK(dataJavaArray.get());
+      e->SetByteArrayRegion((jbyteArray)dataJavaArray.get(), 0, data.size(),
+                            (jbyte*)&data[0]);
+      CHECK(!e->ExceptionCheck());
+      e->CallVoidMethod(mNativeData->manager,
+                        android::gCachedNfcManagerNotifyTransactionListeners,
+                        aidJavaArray.get(), dataJavaArray.get(),
+                        srcJavaString.get());
+    } else {
+      e->CallVoidMethod(mNativeData->manager,
+                        android::gCachedNfcManagerNotifyTransactionListeners,
+                        aidJavaArray.get(), NULL, srcJavaString.get());
+    }
+  });
 }
 
 /**
@@ -18,8 +18,40 @@
  *  Asynchronous interval timer.
  */
 
+/******************************************************************************
+ *
+ *  The original Work has been changed by NXP Semiconductors.
+ *
+ *  Copyright (C) 2018 NXP Semiconductors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+#pragma once
+#include <signal.h>
+#include <stdint.h>
 #include <time.h>
 
+class TimerWheel;
+
+/*
+ * One-shot timer.  All timers are served by a single timing-wheel thread and
+ * their callbacks run on a pool of persistent worker threads, so an expiry
+ * does not normally create a thread.  A callback may block: an expiry that
+ * finds every worker busy starts another one, up to a fixed limit, which
+ * exits once idle.  set() with 0 ms disarms the timer.  The callback
+ * argument carries the timer in sival_ptr.
+ */
 class IntervalTimer {
  public:
   typedef void (*TIMER_FUNC)(union sigval);
@@ -29,8 +61,16 @@ class IntervalTimer {
   bool set(int ms, TIMER_FUNC cb);
   void kill();
   bool create(TIMER_FUNC);
+  bool isRunning(void);  // This function returns true if a valid timer is
+                         // running(curTime > 0)
 
  private:
-  timer_t mTimerId;
+  friend class TimerWheel;
+
   TIMER_FUNC mCb;
+  uint64_t mExpiry;      // wheel tick at which the timer fires
+  int mSlot;             // wheel slot holding the timer; -1 if not armed
+  IntervalTimer* mPrev;  // neighbours in the slot list
+  IntervalTimer* mNext;
+  uint64_t mPendingId;  // expiry queued for a worker; 0 if none
 };
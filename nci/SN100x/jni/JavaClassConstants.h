@@ -47,6 +47,7 @@ extern jmethodID gCachedNfcManagerNotifyLlcpFirstPacketReceived;
  */
 extern jmethodID gCachedNfcManagerNotifyHostEmuActivated;
 extern jmethodID gCachedNfcManagerNotifyHostEmuData;
+extern jmethodID gCachedNfcManagerNotifyHostEmuReplay;
 extern jmethodID gCachedNfcManagerNotifyHostEmuDeactivated;
 
 extern const char* gNativeP2pDeviceClassName;
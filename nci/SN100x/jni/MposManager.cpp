@@ -16,6 +16,7 @@
 *
 ******************************************************************************/
 #include "MposManager.h"
+#include "JniEventDispatcher.h"
 #include <nativehelper/ScopedLocalRef.h>
 #include <base/logging.h>
 #include "phNxpConfig.h"
@@ -482,41 +483,34 @@ void MposManager::notifyMPOSReaderEvent(mpos_rd_state_t aEvent)
 {
   DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: enter; event type is %s", __FUNCTION__, convertMposEventToString(aEvent));
-  JNIEnv* e = NULL;
-
-  ScopedAttach attach(mNativeData->vm, &e);
-  if (e == NULL) {
-    DLOG_IF(INFO, nfc_debug_enabled)
-      << StringPrintf("%s: jni env is null", __FUNCTION__);
-    return;
-  }
-
-  switch(aEvent)
-  {
-  case MPOS_READER_MODE_START:
-    e->CallVoidMethod(mNativeData->manager,
-        gCachedMposManagerNotifyETSIReaderModeStartConfig,
-        (uint16_t) swp_rdr_req_ntf_info.swp_rd_req_info.src);
-    break;
-  case MPOS_READER_MODE_STOP:
-    mSwpReaderTimer.kill();
-    e->CallVoidMethod(mNativeData->manager,
-        gCachedMposManagerNotifyETSIReaderModeStopConfig,
-        mDiscNtfTimeout);
-    break;
-  case MPOS_READER_MODE_TIMEOUT:
-    e->CallVoidMethod(mNativeData->manager,
-        gCachedMposManagerNotifyETSIReaderModeSwpTimeout,
-        mDiscNtfTimeout);
-    break;
-  case MPOS_READER_MODE_RESTART:
-    e->CallVoidMethod(mNativeData->manager,
-        gCachedMposManagerNotifyETSIReaderRestart);
-    break;
-  default:
+  JniEventDispatcher::getInstance().run([&](JNIEnv* e) {
+    switch(aEvent)
+    {
+    case MPOS_READER_MODE_START:
+      e->CallVoidMethod(mNativeData->manager,
+          gCachedMposManagerNotifyETSIReaderModeStartConfig,
+          (uint16_t) swp_rdr_req_ntf_info.swp_rd_req_info.src);
+      break;
+    case MPOS_READER_MODE_STOP:
+      mSwpReaderTimer.kill();
+      e->CallVoidMethod(mNativeData->manager,
+          gCachedMposManagerNotifyETSIReaderModeStopConfig,
+          mDiscNtfTimeout);
+      break;
+    case MPOS_READER_MODE_TIMEOUT:
+      e->CallVoidMethod(mNativeData->manager,
+          gCachedMposManagerNotifyETSIReaderModeSwpTimeout,
+          mDiscNtfTimeout);
+      break;
+    case MPOS_READER_MODE_RESTART:
+      e->CallVoidMethod(mNativeData->manager,
+          gCachedMposManagerNotifyETSIReaderRestart);
+      break;
+    default:
 
-    break;
-  }
+      break;
+    }
+  });
 }
 
 void MposManager::hanldeEtsiReaderReqEvent (tNFA_EE_DISCOVER_REQ* aInfo)
@@ -693,33 +687,29 @@ void MposManager::readerReqEventNtf (union sigval)
   }
   DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s:  ", __func__);
-  JNIEnv* e = NULL;
-
-  ScopedAttach attach(mMposMgr.mNativeData->vm, &e);
-  if (e == NULL) {
-    DLOG_IF(INFO, nfc_debug_enabled)
-      << StringPrintf("%s: jni env is null", __func__);
-    return;
-  }
-
   Rdr_req_ntf_info_t mSwp_info = mMposMgr.getSwpRrdReqInfo();
 
   DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: swp_rdr_req_ntf_info.swp_rd_req_info.src = 0x%4x ", __func__,
       mSwp_info.swp_rd_req_info.src);
 
-  if (mMposMgr.getEtsiReaederState() == STATE_SE_RDR_MODE_START_CONFIG) {
-    e->CallVoidMethod(mMposMgr.mNativeData->manager,
-        mMposMgr.gCachedMposManagerNotifyETSIReaderModeStartConfig,
-        (uint16_t) mSwp_info.swp_rd_req_info.src);
-  } else if (mMposMgr.getEtsiReaederState() == STATE_SE_RDR_MODE_STOP_CONFIG) {
+  if (mMposMgr.getEtsiReaederState() == STATE_SE_RDR_MODE_STOP_CONFIG) {
     DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: mSwpReaderTimer.kill() ", __func__);
     mMposMgr.mSwpReaderTimer.kill();
-    e->CallVoidMethod(mMposMgr.mNativeData->manager,
-        mMposMgr.gCachedMposManagerNotifyETSIReaderModeStopConfig,
-        mDiscNtfTimeout);
   }
+  JniEventDispatcher::getInstance().run([&](JNIEnv* e) {
+    if (mMposMgr.getEtsiReaederState() == STATE_SE_RDR_MODE_START_CONFIG) {
+      e->CallVoidMethod(mMposMgr.mNativeData->manager,
+          mMposMgr.gCachedMposManagerNotifyETSIReaderModeStartConfig,
+          (uint16_t) mSwp_info.swp_rd_req_info.src);
+    } else if (mMposMgr.getEtsiReaederState() ==
+               STATE_SE_RDR_MODE_STOP_CONFIG) {
+      e->CallVoidMethod(mMposMgr.mNativeData->manager,
+          mMposMgr.gCachedMposManagerNotifyETSIReaderModeStopConfig,
+          mDiscNtfTimeout);
+    }
+  });
 }
 
 /*******************************************************************************
@@ -30,8 +30,10 @@
 #include <nativehelper/ScopedPrimitiveArray.h>
 #include <nativehelper/ScopedUtfChars.h>
 #include <semaphore.h>
+#include <stdio.h>
 #include "HciEventManager.h"
 #include "JavaClassConstants.h"
+#include "JniEventDispatcher.h"
 #include "NfcAdaptation.h"
 #include "NfcJniUtil.h"
 #include "NfcTag.h"
@@ -150,6 +152,7 @@ jmethodID gCachedNfcManagerNotifyLlcpLinkDeactivated;
 jmethodID gCachedNfcManagerNotifyLlcpFirstPacketReceived;
 jmethodID gCachedNfcManagerNotifyHostEmuActivated;
 jmethodID gCachedNfcManagerNotifyHostEmuData;
+jmethodID gCachedNfcManagerNotifyHostEmuReplay;
 jmethodID gCachedNfcManagerNotifyHostEmuDeactivated;
 jmethodID gCachedNfcManagerNotifyRfFieldActivated;
 jmethodID gCachedNfcManagerNotifyRfFieldDeactivated;
@@ -829,6 +832,7 @@ static jboolean nfcManager_initNativeStruc(JNIEnv* e, jobject o) {
 
   memset(nat, 0, sizeof(*nat));
   e->GetJavaVM(&(nat->vm));
+  JniEventDispatcher::getInstance().start(nat->vm);
   nat->env_version = e->GetVersion();
   nat->manager = e->NewGlobalRef(o);
 
@@ -858,6 +862,9 @@ static jboolean nfcManager_initNativeStruc(JNIEnv* e, jobject o) {
   gCachedNfcManagerNotifyHostEmuData =
       e->GetMethodID(cls.get(), "notifyHostEmuData", "(I[B)V");
 
+  gCachedNfcManagerNotifyHostEmuReplay =
+      e->GetMethodID(cls.get(), "notifyHostEmuReplay", "(I[B)V");
+
   gCachedNfcManagerNotifyHostEmuDeactivated =
       e->GetMethodID(cls.get(), "notifyHostEmuDeactivated", "(I)V");
 
@@ -964,18 +971,18 @@ void nfaDeviceManagementCallback(uint8_t dmEvent,
 #endif      
 if (!sP2pActive && eventData->rf_field.status == NFA_STATUS_OK) {
         struct nfc_jni_native_data* nat = getNative(NULL, NULL);
-        JNIEnv* e = NULL;
-        ScopedAttach attach(nat->vm, &e);
-        if (e == NULL) {
-          LOG(ERROR) << StringPrintf("jni env is null");
-          return;
-        }
-        if (eventData->rf_field.rf_field_status == NFA_DM_RF_FIELD_ON)
-          e->CallVoidMethod(nat->manager,
-                            android::gCachedNfcManagerNotifyRfFieldActivated);
-        else
-          e->CallVoidMethod(nat->manager,
-                            android::gCachedNfcManagerNotifyRfFieldDeactivated);
+        bool fieldOn =
+            (eventData->rf_field.rf_field_status == NFA_DM_RF_FIELD_ON);
+        JniEventDispatcher::getInstance().post([nat, fieldOn](JNIEnv* e) {
+          e->CallVoidMethod(
+              nat->manager,
+              fieldOn ? android::gCachedNfcManagerNotifyRfFieldActivated
+                      : android::gCachedNfcManagerNotifyRfFieldDeactivated);
+          if (e->ExceptionCheck()) {
+            e->ExceptionClear();
+            LOG(ERROR) << StringPrintf("fail notify");
+          }
+        });
       }
       break;
 
@@ -1208,6 +1215,90 @@ static jboolean nfcManager_routeAid(JNIEnv* e, jobject, jbyteArray aid,
 #endif
 }
 
+/*******************************************************************************
+**
+** Function:        nfcManager_setHceStaticResponse
+**
+** Description:     Register a fixed response the stack answers an HCE
+**                  command with, without calling Java.
+**                  e: JVM environment.
+**                  owner: Id of the registering service.
+**                  aid: AID the command is valid for.
+**                  command: Command to match.
+**                  mask: Bits of command to compare; same length.
+**                  response: Response including status word.
+**
+** Returns:         True if registered.
+**
+*******************************************************************************/
+static jboolean nfcManager_setHceStaticResponse(JNIEnv* e, jobject,
+                                                jint owner, jbyteArray aid,
+                                                jbyteArray command,
+                                                jbyteArray mask,
+                                                jbyteArray response) {
+  ScopedByteArrayRO aidBytes(e, aid);
+  ScopedByteArrayRO commandBytes(e, command);
+  ScopedByteArrayRO maskBytes(e, mask);
+  ScopedByteArrayRO responseBytes(e, response);
+  if ((aidBytes.get() == NULL) || (commandBytes.get() == NULL) ||
+      (maskBytes.get() == NULL) || (responseBytes.get() == NULL))
+    return JNI_FALSE;  // NullPointerException thrown
+  if ((aidBytes.size() > 0xFF) || (maskBytes.size() != commandBytes.size()))
+    return JNI_FALSE;
+  return RoutingManager::getInstance().setHceStaticResponse(
+             owner, reinterpret_cast<const uint8_t*>(aidBytes.get()),
+             aidBytes.size(),
+             reinterpret_cast<const uint8_t*>(commandBytes.get()),
+             reinterpret_cast<const uint8_t*>(maskBytes.get()),
+             commandBytes.size(),
+             reinterpret_cast<const uint8_t*>(responseBytes.get()),
+             responseBytes.size())
+             ? JNI_TRUE
+             : JNI_FALSE;
+}
+
+/*******************************************************************************
+**
+** Function:        nfcManager_clearHceStaticResponses
+**
+** Description:     Drop the fixed HCE responses of a service.
+**                  e: JVM environment.
+**                  owner: Id of the service; negative for all services.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+static void nfcManager_clearHceStaticResponses(JNIEnv*, jobject, jint owner) {
+  RoutingManager::getInstance().clearHceStaticResponses(owner);
+}
+
+#if (NXP_EXTNS == TRUE)
+/*******************************************************************************
+**
+** Function:        nfcManager_routeAids
+**
+** Description:     Route a set of AIDs in one call.
+**                  e: JVM environment.
+**                  table: Packed entries, each
+**                         aidLen | aid | route | power | aidInfo.
+**                  count: Number of entries in table.
+**
+** Returns:         True if every AID was routed.
+**
+*******************************************************************************/
+static jboolean nfcManager_routeAids(JNIEnv* e, jobject, jbyteArray table,
+                                     jint count) {
+  ScopedByteArrayRO bytes(e, table);
+  if (bytes.get() == NULL) return JNI_FALSE;  // NullPointerException thrown
+  if (count <= 0) return JNI_TRUE;
+  const uint8_t* buf = reinterpret_cast<const uint8_t*>(&bytes[0]);
+  return RoutingManager::getInstance().addAidRoutingBatch(buf, bytes.size(),
+                                                          count)
+             ? JNI_TRUE
+             : JNI_FALSE;
+}
+#endif
+
 /*******************************************************************************
 **
 ** Function:        nfcManager_unrouteAid
@@ -2508,6 +2599,11 @@ static void nfcManager_doDump(JNIEnv* e, jobject obj, jobject fdobj) {
 
   NfcAdaptation& theInstance = NfcAdaptation::GetInstance();
   theInstance.Dump(fd);
+
+  uint32_t hits = 0, misses = 0;
+  EXTNS_MfcGetCacheStats(&hits, &misses);
+  dprintf(fd, "MIFARE Classic layout cache: %u hits, %u misses\n", hits,
+          misses);
 }
 
 static jint nfcManager_doGetNciVersion(JNIEnv*, jobject) {
@@ -2708,8 +2804,18 @@ static JNINativeMethod gMethods[] = {
 
     {"sendRawFrame", "([B)Z", (void*)nfcManager_sendRawFrame},
 
+    {"setHceStaticResponse", "(I[B[B[B[B)Z",
+     (void*)nfcManager_setHceStaticResponse},
+
+    {"clearHceStaticResponses", "(I)V",
+     (void*)nfcManager_clearHceStaticResponses},
+
     {"routeAid", "([BIII)Z", (void*)nfcManager_routeAid},
 
+#if (NXP_EXTNS == TRUE)
+    {"routeAids", "([BI)Z", (void*)nfcManager_routeAids},
+#endif
+
     {"unrouteAid", "([B)Z", (void*)nfcManager_unrouteAid},
 
     {"doSetRoutingEntry", "(IIII)Z",
@@ -26,6 +26,7 @@
 #include <base/logging.h>
 #include <errno.h>
 #include <malloc.h>
+#include <nativehelper/JNIHelp.h>
 #include <nativehelper/ScopedLocalRef.h>
 #include <nativehelper/ScopedPrimitiveArray.h>
 #include <semaphore.h>
@@ -39,11 +40,13 @@
 #include "NfcJniUtil.h"
 #include "NfcTag.h"
 #include "Pn544Interop.h"
+#include "PresenceCheckScheduler.h"
 
 #include "ndef_utils.h"
 #include "nfa_api.h"
 #include "nfa_rw_api.h"
 #include "nfc_brcm_defs.h"
+#include "nfc_config.h"
 #include "phNxpExtns.h"
 #include "rw_api.h"
 
@@ -54,8 +57,6 @@ extern nfc_jni_native_data* getNative(JNIEnv* e, jobject o);
 extern bool nfcManager_isNfcActive();
 }  // namespace android
 
-extern bool gActivated;
-extern SyncEvent gDeactivatedEvent;
 extern bool nfc_debug_enabled;
 
 /*****************************************************************************
@@ -99,6 +100,15 @@ static bool sCheckNdefCapable = false;  // whether tag has NDEF capability
 static tNFA_HANDLE sNdefTypeHandlerHandle = NFA_HANDLE_INVALID;
 static tNFA_INTF_TYPE sCurrentRfInterface = NFA_INTERFACE_ISO_DEP;
 static std::basic_string<uint8_t> sRxDataBuffer;
+static std::basic_string<uint8_t> sTxDataBuffer;
+// Allocation accounting for the transceive path; a steady-state APDU
+// exchange should only ever bump javaArrays.
+static struct {
+  uint32_t calls;
+  uint32_t rxGrowths;   // sRxDataBuffer had to reallocate
+  uint32_t txGrowths;   // sTxDataBuffer had to reallocate
+  uint32_t javaArrays;  // response byte[] handed back to the service
+} sTransceiveStats;
 static tNFA_STATUS sRxDataStatus = NFA_STATUS_OK;
 static bool sWaitingForTransceive = false;
 static bool sTransceiveRfTimeout = false;
@@ -135,6 +145,8 @@ static int sCurrentConnectedHandle = 0;
 #endif
 static int reSelect(tNFA_INTF_TYPE rfInterface, bool fSwitchIfNeeded);
 static bool switchRfInterface(tNFA_INTF_TYPE rfInterface);
+static jboolean doPresenceCheckRf();
+static uint32_t presenceCheckWindowMs();
 
 /*******************************************************************************
 **
@@ -977,8 +989,11 @@ void nativeNfcTag_doTransceiveStatus(tNFA_STATUS status, uint8_t* buf,
     return;
   }
   sRxDataStatus = status;
-  if (sRxDataStatus == NFA_STATUS_OK || sRxDataStatus == NFC_STATUS_CONTINUE)
+  if (sRxDataStatus == NFA_STATUS_OK || sRxDataStatus == NFC_STATUS_CONTINUE) {
+    size_t capacity = sRxDataBuffer.capacity();
     sRxDataBuffer.append(buf, bufLen);
+    if (sRxDataBuffer.capacity() != capacity) sTransceiveStats.rxGrowths++;
+  }
 
   if (sRxDataStatus == NFA_STATUS_OK) sTransceiveEvent.notifyOne();
 }
@@ -994,6 +1009,29 @@ void nativeNfcTag_notifyRfTimeout() {
   sTransceiveEvent.notifyOne();
 }
 
+/*******************************************************************************
+**
+** Function:        nativeNfcTag_reserveTransceiveBuffers
+**
+** Description:     Size the reusable command and response buffers for the
+**                  largest ISO-DEP frame the controller is configured for, so
+**                  that exchanges within that limit do not reallocate.
+**                  Capacity is kept across sessions.
+**
+** Returns:         None
+**
+*******************************************************************************/
+static void nativeNfcTag_reserveTransceiveBuffers() {
+  static size_t sReserved = 0;
+  if (sReserved != 0) return;
+
+  sReserved = NfcConfig::getUnsigned(NAME_ISO_DEP_MAX_TRANSCEIVE, 261);
+  sRxDataBuffer.reserve(sReserved);
+  sTxDataBuffer.reserve(sReserved);
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: reserved %zu bytes", __func__, sReserved);
+}
+
 /*******************************************************************************
 **
 ** Function:        nativeNfcTag_doTransceive
@@ -1034,11 +1072,26 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
 
   NfcTag& natTag = NfcTag::getInstance();
 
-  // get input buffer and length from java call
-  ScopedByteArrayRO bytes(e, data);
-  uint8_t* buf = const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(
-      &bytes[0]));  // TODO: API bug; NFA_SendRawFrame should take const*!
-  size_t bufLen = bytes.size();
+  if (data == NULL) {
+    jniThrowNullPointerException(e, NULL);
+    return NULL;
+  }
+
+  // copy the command into the reusable buffer rather than pinning the java
+  // array for the whole exchange
+  nativeNfcTag_reserveTransceiveBuffers();
+  uint32_t rxGrowths = sTransceiveStats.rxGrowths;
+  uint32_t txGrowths = sTransceiveStats.txGrowths;
+  uint32_t javaArrays = sTransceiveStats.javaArrays;
+  sTransceiveStats.calls++;
+
+  size_t bufLen = e->GetArrayLength(data);
+  size_t capacity = sTxDataBuffer.capacity();
+  sTxDataBuffer.resize(bufLen);
+  if (sTxDataBuffer.capacity() != capacity) sTransceiveStats.txGrowths++;
+  e->GetByteArrayRegion(data, 0, bufLen,
+                        reinterpret_cast<jbyte*>(&sTxDataBuffer[0]));
+  uint8_t* buf = &sTxDataBuffer[0];
 
   if (statusTargetLost) {
     targetLost = e->GetIntArrayElements(statusTargetLost, 0);
@@ -1096,6 +1149,9 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
         natTag.isT2tNackResponse(sRxDataBuffer.data(), sRxDataBuffer.size())) {
       isNack = true;
     }
+    // the tag answered, so a presence check right now would tell nothing new
+    if (!isNack && (sRxDataBuffer.size() > 0))
+      PresenceCheckScheduler::getInstance().notePresent();
 
     if (sRxDataBuffer.size() > 0) {
       if (isNack) {
@@ -1117,6 +1173,7 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
         if (transDataLen != 0) {
           result.reset(e->NewByteArray(transDataLen));
           if (result.get() != NULL) {
+            sTransceiveStats.javaArrays++;
             e->SetByteArrayRegion(result.get(), 0, transDataLen,
                                   (const jbyte*)transData);
           } else
@@ -1127,6 +1184,7 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
         // marshall data to java for return
         result.reset(e->NewByteArray(sRxDataBuffer.size()));
         if (result.get() != NULL) {
+          sTransceiveStats.javaArrays++;
           e->SetByteArrayRegion(result.get(), 0, sRxDataBuffer.size(),
                                 (const jbyte*)sRxDataBuffer.data());
         } else
@@ -1141,7 +1199,14 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
   sWaitingForTransceive = false;
   if (targetLost) e->ReleaseIntArrayElements(statusTargetLost, targetLost, 0);
 
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", __func__);
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: exit; allocs rx=%u tx=%u java=%u; totals calls=%u rx=%u tx=%u "
+      "java=%u",
+      __func__, sTransceiveStats.rxGrowths - rxGrowths,
+      sTransceiveStats.txGrowths - txGrowths,
+      sTransceiveStats.javaArrays - javaArrays, sTransceiveStats.calls,
+      sTransceiveStats.rxGrowths, sTransceiveStats.txGrowths,
+      sTransceiveStats.javaArrays);
   return result.release();
 }
 
@@ -1414,7 +1479,10 @@ TheEnd:
 ** Returns:         None
 **
 *******************************************************************************/
-void nativeNfcTag_resetPresenceCheck() { sIsTagPresent = true; }
+void nativeNfcTag_resetPresenceCheck() {
+  sIsTagPresent = true;
+  PresenceCheckScheduler::getInstance().reset();
+}
 
 /*******************************************************************************
 **
@@ -1445,30 +1513,6 @@ void nativeNfcTag_doPresenceCheckResult(tNFA_STATUS status) {
 *******************************************************************************/
 static jboolean nativeNfcTag_doPresenceCheck(JNIEnv*, jobject) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", __func__);
-  tNFA_STATUS status = NFA_STATUS_OK;
-  jboolean isPresent = JNI_FALSE;
-
-  // Special case for Kovio.  The deactivation would have already occurred
-  // but was ignored so that normal tag opertions could complete.  Now we
-  // want to process as if the deactivate just happened.
-  if (sCurrentConnectedTargetProtocol == TARGET_TYPE_KOVIO_BARCODE) {
-    DLOG_IF(INFO, nfc_debug_enabled)
-        << StringPrintf("%s: Kovio, force deactivate handling", __func__);
-    tNFA_DEACTIVATED deactivated = {NFA_DEACTIVATE_TYPE_IDLE};
-    {
-      SyncEventGuard g(gDeactivatedEvent);
-      gActivated = false;  // guard this variable from multi-threaded access
-      gDeactivatedEvent.notifyOne();
-    }
-
-    NfcTag::getInstance().setDeactivationState(deactivated);
-    nativeNfcTag_resetPresenceCheck();
-    NfcTag::getInstance().connectionEventHandler(NFA_DEACTIVATED_EVT, NULL);
-    nativeNfcTag_abortWaits();
-    NfcTag::getInstance().abort();
-
-    return JNI_FALSE;
-  }
 
   if (nfcManager_isNfcActive() == false) {
     DLOG_IF(INFO, nfc_debug_enabled)
@@ -1489,6 +1533,50 @@ static jboolean nativeNfcTag_doPresenceCheck(JNIEnv*, jobject) {
         << StringPrintf("%s: tag already deactivated", __func__);
     return JNI_FALSE;
   }
+
+  // Skip the RF exchange if the tag answered recently, and share a check
+  // that is already on the air
+  return PresenceCheckScheduler::getInstance().check(
+             presenceCheckWindowMs(),
+             []() { return doPresenceCheckRf() == JNI_TRUE; })
+             ? JNI_TRUE
+             : JNI_FALSE;
+}
+
+/*******************************************************************************
+**
+** Function:        presenceCheckWindowMs
+**
+** Description:     How long an answer from the tag proves it is present.
+**                  Technologies whose presence check disturbs the tag get a
+**                  longer window.
+**
+** Returns:         Window in milliseconds.
+**
+*******************************************************************************/
+static uint32_t presenceCheckWindowMs() {
+  // Kovio is checked by deactivating it
+  if (sCurrentConnectedTargetProtocol == TARGET_TYPE_KOVIO_BARCODE) return 1000;
+  // MIFARE Classic is checked by replaying the authentication
+  if (sCurrentConnectedTargetProtocol == NFC_PROTOCOL_MIFARE) return 500;
+  // an ISO-DEP check goes on the air between the application's APDUs
+  if (sCurrentConnectedTargetProtocol == NFA_PROTOCOL_ISO_DEP) return 250;
+  return 125;
+}
+
+/*******************************************************************************
+**
+** Function:        doPresenceCheckRf
+**
+** Description:     Check over RF if the tag is in the RF field.
+**
+** Returns:         True if tag is in RF field.
+**
+*******************************************************************************/
+static jboolean doPresenceCheckRf() {
+  tNFA_STATUS status = NFA_STATUS_OK;
+  jboolean isPresent = JNI_FALSE;
+
 #if (NXP_EXTNS == FALSE)
   //change MFC presencecheck to default
   if (sCurrentConnectedTargetProtocol == NFC_PROTOCOL_MIFARE) {
@@ -1991,6 +2079,7 @@ static JNINativeMethod gMethods[] = {
 *******************************************************************************/
 int register_com_android_nfc_NativeNfcTag(JNIEnv* e) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", __func__);
+  if (!NfcTag::cacheJavaIds(e, gNativeNfcTagClassName)) return JNI_ERR;
   return jniRegisterNativeMethods(e, gNativeNfcTagClassName, gMethods,
                                   NELEM(gMethods));
 }
@@ -21,6 +21,7 @@
 
 #include "JavaClassConstants.h"
 #include "NfcJniUtil.h"
+#include "PeerToPeer.h"
 
 using android::base::StringPrintf;
 
@@ -77,6 +78,7 @@ static JNINativeMethod gMethods[] = {
 **
 *******************************************************************************/
 int register_com_android_nfc_NativeP2pDevice(JNIEnv* e) {
+  if (!PeerToPeer::cacheJavaIds(e, gNativeP2pDeviceClassName)) return JNI_ERR;
   return jniRegisterNativeMethods(e, gNativeP2pDeviceClassName, gMethods,
                                   NELEM(gMethods));
 }
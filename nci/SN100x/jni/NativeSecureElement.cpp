@@ -259,8 +259,6 @@ static jbyteArray nativeNfcSecureElement_doGetAtr (JNIEnv* e, jobject, jint hand
 *******************************************************************************/
 static jbyteArray nativeNfcSecureElement_doTransceive (JNIEnv* e, jobject, jint handle, jbyteArray data)
 {
-    const int32_t recvBufferMaxSize = 0x8800;//1024; 34k
-    uint8_t recvBuffer [recvBufferMaxSize];
     int32_t recvBufferActualSize = 0;
     ScopedByteArrayRW bytes(e, data);
     LOG(INFO) << StringPrintf("%s: enter; handle=0x%X; buf len=%zu", __func__, handle, bytes.size());
@@ -269,6 +267,8 @@ static jbyteArray nativeNfcSecureElement_doTransceive (JNIEnv* e, jobject, jint
     if(!se.mIsWiredModeOpen)
         return NULL;
 
+    int32_t recvBufferMaxSize = 0;
+    uint8_t* recvBuffer = se.acquireResponseBuffer(recvBufferMaxSize);
     se.transceive(reinterpret_cast<uint8_t*>(&bytes[0]), bytes.size(), recvBuffer, recvBufferMaxSize, recvBufferActualSize, se.SmbTransceiveTimeOutVal);
 
     //copy results back to java
@@ -277,12 +277,54 @@ static jbyteArray nativeNfcSecureElement_doTransceive (JNIEnv* e, jobject, jint
     {
         e->SetByteArrayRegion(result, 0, recvBufferActualSize, (jbyte *) recvBuffer);
     }
+    se.releaseResponseBuffer();
 
     LOG(INFO) << StringPrintf("%s: exit: recv len=%d", __func__, recvBufferActualSize);
     return result;
 }
 /*******************************************************************************
 **
+** Function:        nativeNfcSecureElement_doTransceiveScript
+**
+** Description:     Send a script of APDUs to the secure element in one call;
+**                  see SecureElement::transceiveScript() for the encoding.
+**                  e: JVM environment.
+**                  o: Java object.
+**                  handle: Secure element's handle.
+**                  script: Encoded commands.
+**
+** Returns:         Encoded responses, or NULL if a command failed or its
+**                  status word did not match.
+**
+*******************************************************************************/
+static jbyteArray nativeNfcSecureElement_doTransceiveScript (JNIEnv* e, jobject, jint handle, jbyteArray script)
+{
+    ScopedByteArrayRO bytes(e, script);
+    LOG(INFO) << StringPrintf("%s: enter; handle=0x%X; script len=%zu", __func__, handle, bytes.size());
+
+    SecureElement &se = SecureElement::getInstance();
+    if(!se.mIsWiredModeOpen)
+        return NULL;
+
+    std::vector<uint8_t> responses;
+    if (!se.transceiveScript(reinterpret_cast<const uint8_t*>(&bytes[0]), bytes.size(), responses, se.SmbTransceiveTimeOutVal))
+    {
+        LOG(ERROR) << StringPrintf("%s: script stopped after %zu response bytes", __func__, responses.size());
+        return NULL;
+    }
+
+    //copy results back to java
+    jbyteArray result = e->NewByteArray(responses.size());
+    if (result != NULL)
+    {
+        e->SetByteArrayRegion(result, 0, responses.size(), (const jbyte *) responses.data());
+    }
+
+    LOG(INFO) << StringPrintf("%s: exit: responses len=%zu", __func__, responses.size());
+    return result;
+}
+/*******************************************************************************
+**
 ** Function:        nfcManager_doactivateSeInterface
 **
 ** Description:     Activate SecureElement Interface
@@ -378,6 +420,7 @@ static JNINativeMethod gMethods[] =
    {"doNativeDisconnectSecureElementConnection", "(I)Z", (void *) nativeNfcSecureElement_doDisconnectSecureElementConnection},
    {"doNativeResetSecureElement", "(I)Z", (void *) nativeNfcSecureElement_doResetSecureElement},
    {"doTransceive", "(I[B)[B", (void *) nativeNfcSecureElement_doTransceive},
+   {"doTransceiveScript", "(I[B)[B", (void *) nativeNfcSecureElement_doTransceiveScript},
    {"doNativeGetAtr", "(I)[B", (void *) nativeNfcSecureElement_doGetAtr},
    {"doactivateSeInterface", "()I",(void*)nfcManager_doactivateSeInterface},
    {"dodeactivateSeInterface", "()I",(void*)nfcManager_dodeactivateSeInterface},
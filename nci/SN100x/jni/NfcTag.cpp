@@ -50,6 +50,7 @@
 #include <nativehelper/ScopedPrimitiveArray.h>
 
 #include "JavaClassConstants.h"
+#include "JniEventDispatcher.h"
 #include "nfc_brcm_defs.h"
 #include "nfc_config.h"
 #include "phNxpExtns.h"
@@ -60,11 +61,14 @@ using android::base::StringPrintf;
 extern bool nfc_debug_enabled;
 
 #if (NXP_EXTNS == TRUE)
-static void deleteglobaldata(JNIEnv* e);
-static jobjectArray techActBytes1;
 int selectedId = 0;
-static jobjectArray techPollBytes2;
 #endif
+// Java NativeNfcTag class and members; see NfcTag::cacheJavaIds()
+static struct {
+  jclass tagClass;
+  jmethodID ctor;
+  jfieldID descriptor;
+} sTagIds;
 
 /*******************************************************************************
 **
@@ -621,8 +625,8 @@ TheEnd:
 **
 ** Function:        createNativeNfcTag
 **
-** Description:     Create a brand new Java NativeNfcTag object;
-**                  fill the objects's member variables with data;
+** Description:     Pack the tag into a descriptor;
+**                  create a brand new Java NativeNfcTag object holding it;
 **                  notify NFC service;
 **                  activationData: data from activation.
 **
@@ -633,109 +637,118 @@ void NfcTag::createNativeNfcTag(tNFA_ACTIVATED& activationData) {
   static const char fn[] = "NfcTag::createNativeNfcTag";
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", fn);
 
-  JNIEnv* e = NULL;
-  ScopedAttach attach(mNativeData->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("%s: jni env is null", fn);
+  if (sTagIds.tagClass == NULL) {
+    LOG(ERROR) << StringPrintf("%s: java ids not cached", fn);
     return;
   }
 
-  ScopedLocalRef<jclass> tag_cls(e,
-                                 e->GetObjectClass(mNativeData->cached_NfcTag));
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: failed to get class", fn);
-    return;
-  }
-
-  // create a new Java NativeNfcTag object
-  jmethodID ctor = e->GetMethodID(tag_cls.get(), "<init>", "()V");
-  ScopedLocalRef<jobject> tag(e, e->NewObject(tag_cls.get(), ctor));
-
-  // fill NativeNfcTag's mProtocols, mTechList, mTechHandles, mTechLibNfcTypes
-  fillNativeNfcTagMembers1(e, tag_cls.get(), tag.get());
-
-  // fill NativeNfcTag's members: mHandle, mConnectedTechnology
-  fillNativeNfcTagMembers2(e, tag_cls.get(), tag.get(), activationData);
-
-  // fill NativeNfcTag's members: mTechPollBytes
-  fillNativeNfcTagMembers3(e, tag_cls.get(), tag.get(), activationData);
-
-  // fill NativeNfcTag's members: mTechActBytes
-  fillNativeNfcTagMembers4(e, tag_cls.get(), tag.get(), activationData);
-
-  // fill NativeNfcTag's members: mUid
-  fillNativeNfcTagMembers5(e, tag_cls.get(), tag.get(), activationData);
+  // Everything the Java object needs is packed here, off the JVM
+  fillTechPollBytes(activationData);
+  fillTechActBytes(activationData);
+  fillUid(activationData);
+  buildTagDescriptor();
+
+  // Run on the dispatcher so the tag reaches Java in order with the other
+  // events; wait, since the tag must be published before the next event.
+  JniEventDispatcher::getInstance().run([&](JNIEnv* e) {
+    // create a new Java NativeNfcTag object
+    ScopedLocalRef<jobject> tag(e,
+                                e->NewObject(sTagIds.tagClass, sTagIds.ctor));
+    ScopedLocalRef<jbyteArray> descriptor(
+        e, e->NewByteArray(mTagDescriptor.size()));
+    if (tag.get() == NULL || descriptor.get() == NULL) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: fail create tag", fn);
+      return;
+    }
+    e->SetByteArrayRegion(descriptor.get(), 0, mTagDescriptor.size(),
+                          (const jbyte*)&mTagDescriptor[0]);
+    e->SetObjectField(tag.get(), sTagIds.descriptor, descriptor.get());
 
-  if (mNativeData->tag != NULL) {
-    e->DeleteGlobalRef(mNativeData->tag);
-  }
-  mNativeData->tag = e->NewGlobalRef(tag.get());
+    if (mNativeData->tag != NULL) {
+      e->DeleteGlobalRef(mNativeData->tag);
+    }
+    mNativeData->tag = e->NewGlobalRef(tag.get());
 
-  // notify NFC service about this new tag
+    // notify NFC service about this new tag
 #if (NXP_EXTNS == TRUE)
-  DLOG_IF(ERROR, nfc_debug_enabled) << StringPrintf("%s; mNumDiscNtf=%x", fn,mNumDiscNtf);
-  if(!mNumDiscNtf || NfcTag::getInstance().checkNextValidProtocol() == -1) {
-    mNumDiscNtf = 0;
+    DLOG_IF(ERROR, nfc_debug_enabled)
+        << StringPrintf("%s; mNumDiscNtf=%x", fn, mNumDiscNtf);
+    if (!mNumDiscNtf || NfcTag::getInstance().checkNextValidProtocol() == -1) {
+      mNumDiscNtf = 0;
+      DLOG_IF(INFO, nfc_debug_enabled)
+          << StringPrintf("%s: try notify nfc service", fn);
+      storeActivationParams();
+      e->CallVoidMethod(mNativeData->manager,
+                        android::gCachedNfcManagerNotifyNdefMessageListeners,
+                        tag.get());
+#else
     DLOG_IF(INFO, nfc_debug_enabled)
         << StringPrintf("%s: try notify nfc service", fn);
-    storeActivationParams();
-    e->CallVoidMethod(mNativeData->manager, android::gCachedNfcManagerNotifyNdefMessageListeners,
-                    tag.get());
-#else
-  DLOG_IF(INFO, nfc_debug_enabled)
-      << StringPrintf("%s: try notify nfc service", fn);
 
-  e->CallVoidMethod(mNativeData->manager,
-                    android::gCachedNfcManagerNotifyNdefMessageListeners,
-                    tag.get());
+    e->CallVoidMethod(mNativeData->manager,
+                      android::gCachedNfcManagerNotifyNdefMessageListeners,
+                      tag.get());
 #endif
-    if (e->ExceptionCheck()) {
-      e->ExceptionClear();
-      LOG(ERROR) << StringPrintf("%s: fail notify nfc service", fn);
-    }
+      if (e->ExceptionCheck()) {
+        e->ExceptionClear();
+        LOG(ERROR) << StringPrintf("%s: fail notify nfc service", fn);
+      }
 #if (NXP_EXTNS == TRUE)
-    deleteglobaldata(e);
-  } else {
-    DLOG_IF(ERROR, nfc_debug_enabled) << StringPrintf("%s: Selecting next tag", fn);
-  }
+    } else {
+      DLOG_IF(ERROR, nfc_debug_enabled)
+          << StringPrintf("%s: Selecting next tag", fn);
+    }
 #endif
+  });
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
 }
 
-#if (NXP_EXTNS == TRUE)
 /*******************************************************************************
 **
-** Function:        isCashBeeActivated
+** Function:        cacheJavaIds
 **
-** Description:     checks if cashbee tag is detected
+** Description:     Resolve the NativeNfcTag class, constructor and fields
+**                  once, so tag discovery does not look them up again.
+**                  e: JVM environment.
+**                  className: Name of the Java NativeNfcTag class.
 **
-** Returns:         True if tag is activated.
+** Returns:         True if everything was found.
 **
 *******************************************************************************/
-bool NfcTag::isCashBeeActivated() { return mCashbeeDetected; }
+bool NfcTag::cacheJavaIds(JNIEnv* e, const char* className) {
+  static const char fn[] = "NfcTag::cacheJavaIds";
+  if (sTagIds.tagClass != NULL) return true;
 
+  ScopedLocalRef<jclass> tagClass(e, e->FindClass(className));
+  if (tagClass.get() == NULL) {
+    e->ExceptionClear();
+    LOG(ERROR) << StringPrintf("%s: fail find class", fn);
+    return false;
+  }
+  jclass cls = tagClass.get();
+  sTagIds.ctor = e->GetMethodID(cls, "<init>", "()V");
+  sTagIds.descriptor = e->GetFieldID(cls, "mDescriptor", "[B");
+  if (e->ExceptionCheck()) {
+    e->ExceptionClear();
+    LOG(ERROR) << StringPrintf("%s: fail find member", fn);
+    return false;
+  }
+  sTagIds.tagClass = (jclass)e->NewGlobalRef(cls);
+  return true;
+}
+
+#if (NXP_EXTNS == TRUE)
 /*******************************************************************************
 **
-** Function:        deleteglobaldata
+** Function:        isCashBeeActivated
 **
-** Description:     Deletes the global data reference after notifying to service
-**                  e: JVM environment.
+** Description:     checks if cashbee tag is detected
 **
-** Returns:         None
+** Returns:         True if tag is activated.
 **
 *******************************************************************************/
-static void deleteglobaldata(JNIEnv* e) {
-  static const char fn [] = "deleteglobaldata";
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", fn);
-  if( techActBytes1 != NULL) {
-    e->DeleteGlobalRef(techActBytes1);
-  }
-  if(techPollBytes2 != NULL) {
-    e->DeleteGlobalRef(techPollBytes2);
-  }
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
-}
+bool NfcTag::isCashBeeActivated() { return mCashbeeDetected; }
 
 /*******************************************************************************
 **
@@ -756,115 +769,27 @@ void NfcTag::storeActivationParams() {
 
 /*******************************************************************************
 **
-** Function:        fillNativeNfcTagMembers1
-**
-** Description:     Fill NativeNfcTag's members: mProtocols, mTechList,
-*mTechHandles, mTechLibNfcTypes.
-**                  e: JVM environment.
-**                  tag_cls: Java NativeNfcTag class.
-**                  tag: Java NativeNfcTag object.
-**
-** Returns:         None
+** Function:        fillTechPollBytes
 **
-*******************************************************************************/
-void NfcTag::fillNativeNfcTagMembers1(JNIEnv* e, jclass tag_cls, jobject tag) {
-  static const char fn[] = "NfcTag::fillNativeNfcTagMembers1";
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", fn);
-
-  // create objects that represent NativeNfcTag's member variables
-  ScopedLocalRef<jintArray> techList(e, e->NewIntArray(mNumTechList));
-  ScopedLocalRef<jintArray> handleList(e, e->NewIntArray(mNumTechList));
-  ScopedLocalRef<jintArray> typeList(e, e->NewIntArray(mNumTechList));
-
-  {
-    ScopedIntArrayRW technologies(e, techList.get());
-    ScopedIntArrayRW handles(e, handleList.get());
-    ScopedIntArrayRW types(e, typeList.get());
-    for (int i = 0; i < mNumTechList; i++) {
-      mNativeData->tProtocols[i] = mTechLibNfcTypes[i];
-      mNativeData->handles[i] = mTechHandles[i];
-      technologies[i] = mTechList[i];
-      handles[i] = mTechHandles[i];
-      types[i] = mTechLibNfcTypes[i];
-    }
-  }
-
-  jfieldID f = NULL;
-
-  f = e->GetFieldID(tag_cls, "mTechList", "[I");
-  e->SetObjectField(tag, f, techList.get());
-
-  f = e->GetFieldID(tag_cls, "mTechHandles", "[I");
-  e->SetObjectField(tag, f, handleList.get());
-
-  f = e->GetFieldID(tag_cls, "mTechLibNfcTypes", "[I");
-  e->SetObjectField(tag, f, typeList.get());
-}
-
-/*******************************************************************************
-**
-** Function:        fillNativeNfcTagMembers2
-**
-** Description:     Fill NativeNfcTag's members: mConnectedTechIndex or
-*mConnectedTechnology.
+** Description:     Record the poll bytes of every technology added by this
+**                  activation; they become NativeNfcTag's mTechPollBytes.
 **                  The original Google's implementation is in
-*set_target_pollBytes(
-**                  in com_android_nfc_NativeNfcTag.cpp;
-**                  e: JVM environment.
-**                  tag_cls: Java NativeNfcTag class.
-**                  tag: Java NativeNfcTag object.
+**                  set_target_pollBytes() in com_android_nfc_NativeNfcTag.cpp;
 **                  activationData: data from activation.
 **
 ** Returns:         None
 **
 *******************************************************************************/
-void NfcTag::fillNativeNfcTagMembers2(JNIEnv* e, jclass tag_cls, jobject tag,
-                                      tNFA_ACTIVATED& /*activationData*/) {
-  static const char fn[] = "NfcTag::fillNativeNfcTagMembers2";
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", fn);
-  jfieldID f = e->GetFieldID(tag_cls, "mConnectedTechIndex", "I");
-  e->SetIntField(tag, f, (jint)0);
-}
-
-/*******************************************************************************
-**
-** Function:        fillNativeNfcTagMembers3
-**
-** Description:     Fill NativeNfcTag's members: mTechPollBytes.
-**                  The original Google's implementation is in
-*set_target_pollBytes(
-**                  in com_android_nfc_NativeNfcTag.cpp;
-**                  e: JVM environment.
-**                  tag_cls: Java NativeNfcTag class.
-**                  tag: Java NativeNfcTag object.
-**                  activationData: data from activation.
-**
-** Returns:         None
-**
-*******************************************************************************/
-void NfcTag::fillNativeNfcTagMembers3(JNIEnv* e, jclass tag_cls, jobject tag,
-                                      tNFA_ACTIVATED& activationData) {
-  static const char fn[] = "NfcTag::fillNativeNfcTagMembers3";
-  ScopedLocalRef<jbyteArray> pollBytes(e, e->NewByteArray(0));
-  ScopedLocalRef<jclass> byteArrayClass(e, e->GetObjectClass(pollBytes.get()));
-  ScopedLocalRef<jobjectArray> techPollBytes(
-      e, e->NewObjectArray(mNumTechList, byteArrayClass.get(), 0));
-  int len = 0;
+void NfcTag::fillTechPollBytes(tNFA_ACTIVATED& activationData) {
+  static const char fn[] = "NfcTag::fillTechPollBytes";
 #if (NXP_EXTNS == TRUE)
-  jobject obj1;
-  if(mTechListIndex == 0) {
-    techPollBytes2= reinterpret_cast<jobjectArray>(e->NewGlobalRef(techPollBytes.get()));
-  } else {
-    for(int j=0;j<mTechListIndex;j++) {
-      obj1 = e->GetObjectArrayElement(techPollBytes2,j);
-      e->SetObjectArrayElement(techPollBytes.get(),j,obj1);
-    }
-  }
-
+  // earlier technologies of a multi-protocol tag keep their bytes
   for (int i = mTechListIndex; i < mNumTechList; i++) {
 #else
   for (int i = 0; i < mNumTechList; i++) {
 #endif
+    std::vector<uint8_t>& pollBytes = mTechPollBytes[i];
+    pollBytes.clear();
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
         "%s: index=%d; rf tech params mode=%u", fn, i, mTechParams[i].mode);
     if (NFC_DISCOVERY_TYPE_POLL_A == mTechParams[i].mode ||
@@ -872,9 +797,8 @@ void NfcTag::fillNativeNfcTagMembers3(JNIEnv* e, jclass tag_cls, jobject tag,
         NFC_DISCOVERY_TYPE_LISTEN_A == mTechParams[i].mode ||
         NFC_DISCOVERY_TYPE_LISTEN_A_ACTIVE == mTechParams[i].mode) {
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: tech A", fn);
-      pollBytes.reset(e->NewByteArray(2));
-      e->SetByteArrayRegion(pollBytes.get(), 0, 2,
-                            (jbyte*)mTechParams[i].param.pa.sens_res);
+      const uint8_t* sensRes = mTechParams[i].param.pa.sens_res;
+      pollBytes.assign(sensRes, sensRes + 2);
     } else if (NFC_DISCOVERY_TYPE_POLL_B == mTechParams[i].mode ||
                NFC_DISCOVERY_TYPE_POLL_B_PRIME == mTechParams[i].mode ||
                NFC_DISCOVERY_TYPE_LISTEN_B == mTechParams[i].mode ||
@@ -890,13 +814,12 @@ void NfcTag::fillNativeNfcTagMembers3(JNIEnv* e, jclass tag_cls, jobject tag,
         *****************/
         DLOG_IF(INFO, nfc_debug_enabled)
             << StringPrintf("%s: tech B; TARGET_TYPE_ISO14443_3B", fn);
-        len = mTechParams[i].param.pb.sensb_res_len;
+        int len = mTechParams[i].param.pb.sensb_res_len;
         len = len - 4;  // subtract 4 bytes for NFCID0 at byte 2 through 5
-        pollBytes.reset(e->NewByteArray(len));
-        e->SetByteArrayRegion(pollBytes.get(), 0, len,
-                              (jbyte*)(mTechParams[i].param.pb.sensb_res + 4));
-      } else {
-        pollBytes.reset(e->NewByteArray(0));
+        if (len > 0) {
+          const uint8_t* appData = mTechParams[i].param.pb.sensb_res + 4;
+          pollBytes.assign(appData, appData + len);
+        }
       }
     } else if (NFC_DISCOVERY_TYPE_POLL_F == mTechParams[i].mode ||
                NFC_DISCOVERY_TYPE_POLL_F_ACTIVE == mTechParams[i].mode ||
@@ -911,16 +834,6 @@ void NfcTag::fillNativeNfcTagMembers3(JNIEnv* e, jclass tag_cls, jobject tag,
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: tech F", fn);
       uint8_t result[10];  // return result to NFC service
       memset(result, 0, sizeof(result));
-      len = 10;
-
-      /****
-      for (int ii = 0; ii < mTechParams [i].param.pf.sensf_res_len; ii++)
-      {
-          DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: tech F,
-      sendf_res[%d]=%d (0x%x)", fn, ii, mTechParams
-      [i].param.pf.sensf_res[ii],mTechParams [i].param.pf.sensf_res[ii]);
-      }
-      ***/
       memcpy(result, mTechParams[i].param.pf.sensf_res + 8, 8);  // copy PMm
       if (activationData.params.t3t.num_system_codes >
           0)  // copy the first System Code
@@ -931,8 +844,7 @@ void NfcTag::fillNativeNfcTagMembers3(JNIEnv* e, jclass tag_cls, jobject tag,
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
             "%s: tech F; sys code=0x%X 0x%X", fn, result[8], result[9]);
       }
-      pollBytes.reset(e->NewByteArray(len));
-      e->SetByteArrayRegion(pollBytes.get(), 0, len, (jbyte*)result);
+      pollBytes.assign(result, result + sizeof(result));
     } else if (NFC_DISCOVERY_TYPE_POLL_V == mTechParams[i].mode ||
                NFC_DISCOVERY_TYPE_LISTEN_ISO15693 == mTechParams[i].mode) {
       DLOG_IF(INFO, nfc_debug_enabled)
@@ -940,49 +852,31 @@ void NfcTag::fillNativeNfcTagMembers3(JNIEnv* e, jclass tag_cls, jobject tag,
       // iso 15693 response flags: 1 octet
       // iso 15693 Data Structure Format Identifier (DSF ID): 1 octet
       // used by public API: NfcV.getDsfId(), NfcV.getResponseFlags();
-      uint8_t data[2] = {activationData.params.i93.afi,
-                         activationData.params.i93.dsfid};
-      pollBytes.reset(e->NewByteArray(2));
-      e->SetByteArrayRegion(pollBytes.get(), 0, 2, (jbyte*)data);
+      pollBytes.push_back(activationData.params.i93.afi);
+      pollBytes.push_back(activationData.params.i93.dsfid);
     } else {
       LOG(ERROR) << StringPrintf("%s: tech unknown ????", fn);
-      pollBytes.reset(e->NewByteArray(0));
     }  // switch: every type of technology
-    e->SetObjectArrayElement(techPollBytes.get(), i, pollBytes.get());
   }  // for: every technology in the array
-#if (NXP_EXTNS == TRUE)
-  if (techPollBytes2 != NULL && mTechListIndex != 0 ) {
-    e->DeleteGlobalRef(techPollBytes2);
-    techPollBytes2= reinterpret_cast<jobjectArray>(e->NewGlobalRef(techPollBytes.get()));
-  }
-#endif
-  jfieldID f = e->GetFieldID(tag_cls, "mTechPollBytes", "[[B");
-  e->SetObjectField(tag, f, techPollBytes.get());
 }
 
 /*******************************************************************************
 **
-** Function:        fillNativeNfcTagMembers4
+** Function:        fillTechActBytes
 **
-** Description:     Fill NativeNfcTag's members: mTechActBytes.
+** Description:     Record the activation bytes of every technology added by
+**                  this activation; they become NativeNfcTag's
+**                  mTechActBytes.
 **                  The original Google's implementation is in
-*set_target_activationBytes()
-**                  in com_android_nfc_NativeNfcTag.cpp;
-**                  e: JVM environment.
-**                  tag_cls: Java NativeNfcTag class.
-**                  tag: Java NativeNfcTag object.
+**                  set_target_activationBytes() in
+**                  com_android_nfc_NativeNfcTag.cpp;
 **                  activationData: data from activation.
 **
 ** Returns:         None
 **
 *******************************************************************************/
-void NfcTag::fillNativeNfcTagMembers4(JNIEnv* e, jclass tag_cls, jobject tag,
-                                      tNFA_ACTIVATED& activationData) {
-  static const char fn[] = "NfcTag::fillNativeNfcTagMembers4";
-  ScopedLocalRef<jbyteArray> actBytes(e, e->NewByteArray(0));
-  ScopedLocalRef<jclass> byteArrayClass(e, e->GetObjectClass(actBytes.get()));
-  ScopedLocalRef<jobjectArray> techActBytes(
-      e, e->NewObjectArray(mNumTechList, byteArrayClass.get(), 0));
+void NfcTag::fillTechActBytes(tNFA_ACTIVATED& activationData) {
+  static const char fn[] = "NfcTag::fillTechActBytes";
 
 #if (NXP_EXTNS == TRUE)
   //merging sak for combi tag
@@ -993,9 +887,7 @@ void NfcTag::fillNativeNfcTagMembers4(JNIEnv* e, jclass tag_cls, jobject tag,
     }
     for (int i = 0; i < mNumTechList; i++) {
       mTechParams [i].param.pa.sel_rsp = merge_sak;
-      actBytes.reset(e->NewByteArray(1));
-      e->SetByteArrayRegion(actBytes.get(), 0, 1, (jbyte*) &mTechParams [i].param.pa.sel_rsp);
-      e->SetObjectArrayElement(techActBytes.get(), i, actBytes.get());
+      mTechActBytes[i].assign(1, merge_sak);
     }
   }
 
@@ -1003,6 +895,8 @@ void NfcTag::fillNativeNfcTagMembers4(JNIEnv* e, jclass tag_cls, jobject tag,
 #else
   for (int i = 0; i < mNumTechList; i++) {
 #endif
+    std::vector<uint8_t>& actBytes = mTechActBytes[i];
+    actBytes.clear();
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: index=%d", fn, i);
     if (NFC_PROTOCOL_T1T == mTechLibNfcTypes[i] ||
         NFC_PROTOCOL_T2T == mTechLibNfcTypes[i]) {
@@ -1010,26 +904,20 @@ void NfcTag::fillNativeNfcTagMembers4(JNIEnv* e, jclass tag_cls, jobject tag,
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: T1T; tech A", fn);
       else if (mTechLibNfcTypes[i] == NFC_PROTOCOL_T2T)
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: T2T; tech A", fn);
-      actBytes.reset(e->NewByteArray(1));
-      e->SetByteArrayRegion(actBytes.get(), 0, 1,
-                            (jbyte*)&mTechParams[i].param.pa.sel_rsp);
+      actBytes.push_back(mTechParams[i].param.pa.sel_rsp);
     } else if (NFC_PROTOCOL_T3T == mTechLibNfcTypes[i]) {
       // felica
       DLOG_IF(INFO, nfc_debug_enabled)
           << StringPrintf("%s: T3T; felica; tech F", fn);
       // really, there is no data
-      actBytes.reset(e->NewByteArray(0));
     } else if (NFC_PROTOCOL_MIFARE == mTechLibNfcTypes[i]) {
       DLOG_IF(INFO, nfc_debug_enabled)
           << StringPrintf("%s: Mifare Classic; tech A", fn);
-      actBytes.reset(e->NewByteArray(1));
-      e->SetByteArrayRegion(actBytes.get(), 0, 1,
-                            (jbyte*)&mTechParams[i].param.pa.sel_rsp);
+      actBytes.push_back(mTechParams[i].param.pa.sel_rsp);
     }
 #if (NXP_EXTNS == TRUE)
     else if (NFC_PROTOCOL_T3BT == mTechLibNfcTypes[i]) {
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: tech T3BT; chinaId card", fn);
-      actBytes.reset(e->NewByteArray(0));
     }
 #endif
     else if (NFC_PROTOCOL_ISO_DEP == mTechLibNfcTypes[i]) {
@@ -1052,15 +940,12 @@ void NfcTag::fillNativeNfcTagMembers4(JNIEnv* e, jclass tag_cls, jobject tag,
             DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
                 "%s: T4T; ISO_DEP for tech A; copy historical bytes; len=%u",
                 fn, pa_iso.his_byte_len);
-            actBytes.reset(e->NewByteArray(pa_iso.his_byte_len));
-            if (pa_iso.his_byte_len > 0)
-              e->SetByteArrayRegion(actBytes.get(), 0, pa_iso.his_byte_len,
-                                    (jbyte*)(pa_iso.his_byte));
+            actBytes.assign(pa_iso.his_byte,
+                            pa_iso.his_byte + pa_iso.his_byte_len);
           } else {
             LOG(ERROR) << StringPrintf(
                 "%s: T4T; ISO_DEP for tech A; wrong interface=%u", fn,
                 activationData.activate_ntf.intf_param.type);
-            actBytes.reset(e->NewByteArray(0));
           }
         } else if ((mTechParams[i].mode == NFC_DISCOVERY_TYPE_POLL_B) ||
                    (mTechParams[i].mode == NFC_DISCOVERY_TYPE_POLL_B_PRIME) ||
@@ -1077,26 +962,19 @@ void NfcTag::fillNativeNfcTagMembers4(JNIEnv* e, jclass tag_cls, jobject tag,
             DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
                 "%s: T4T; ISO_DEP for tech B; copy response bytes; len=%u", fn,
                 pb_iso.hi_info_len);
-            actBytes.reset(e->NewByteArray(pb_iso.hi_info_len));
-            if (pb_iso.hi_info_len > 0)
-              e->SetByteArrayRegion(actBytes.get(), 0, pb_iso.hi_info_len,
-                                    (jbyte*)(pb_iso.hi_info));
+            actBytes.assign(pb_iso.hi_info,
+                            pb_iso.hi_info + pb_iso.hi_info_len);
           } else {
             LOG(ERROR) << StringPrintf(
                 "%s: T4T; ISO_DEP for tech B; wrong interface=%u", fn,
                 activationData.activate_ntf.intf_param.type);
-            actBytes.reset(e->NewByteArray(0));
           }
         }
       } else if (mTechList[i] ==
                  TARGET_TYPE_ISO14443_3A)  // is TagTechnology.NFC_A by Java API
       {
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: T4T; tech A", fn);
-        actBytes.reset(e->NewByteArray(1));
-        e->SetByteArrayRegion(actBytes.get(), 0, 1,
-                              (jbyte*)&mTechParams[i].param.pa.sel_rsp);
-      } else {
-        actBytes.reset(e->NewByteArray(0));
+        actBytes.push_back(mTechParams[i].param.pa.sel_rsp);
       }
     }  // case NFC_PROTOCOL_ISO_DEP: //t4t
     else if (NFC_PROTOCOL_T5T == mTechLibNfcTypes[i]) {
@@ -1105,64 +983,44 @@ void NfcTag::fillNativeNfcTagMembers4(JNIEnv* e, jclass tag_cls, jobject tag,
       // iso 15693 response flags: 1 octet
       // iso 15693 Data Structure Format Identifier (DSF ID): 1 octet
       // used by public API: NfcV.getDsfId(), NfcV.getResponseFlags();
-      uint8_t data[2] = {activationData.params.i93.afi,
-                         activationData.params.i93.dsfid};
-      actBytes.reset(e->NewByteArray(2));
-      e->SetByteArrayRegion(actBytes.get(), 0, 2, (jbyte*)data);
+      actBytes.push_back(activationData.params.i93.afi);
+      actBytes.push_back(activationData.params.i93.dsfid);
     } else {
       DLOG_IF(INFO, nfc_debug_enabled)
           << StringPrintf("%s: tech unknown ????", fn);
-      actBytes.reset(e->NewByteArray(0));
     }
-    e->SetObjectArrayElement(techActBytes.get(), i, actBytes.get());
   }  // for: every technology in the array
-#if (NXP_EXTNS == TRUE)
-  if (techActBytes1 != NULL && mTechListIndex !=0 ) {
-    e->DeleteGlobalRef(techActBytes1);
-    techActBytes1 = reinterpret_cast<jobjectArray>(e->NewGlobalRef(techActBytes.get()));
-  }
-#endif
-  jfieldID f = e->GetFieldID(tag_cls, "mTechActBytes", "[[B");
-  e->SetObjectField(tag, f, techActBytes.get());
 }
 
 /*******************************************************************************
 **
-** Function:        fillNativeNfcTagMembers5
+** Function:        fillUid
 **
-** Description:     Fill NativeNfcTag's members: mUid.
+** Description:     Record the UID of the first technology; it becomes
+**                  NativeNfcTag's mUid.
 **                  The original Google's implementation is in
-*nfc_jni_Discovery_notification_callback()
-**                  in com_android_nfc_NativeNfcManager.cpp;
-**                  e: JVM environment.
-**                  tag_cls: Java NativeNfcTag class.
-**                  tag: Java NativeNfcTag object.
+**                  nfc_jni_Discovery_notification_callback() in
+**                  com_android_nfc_NativeNfcManager.cpp;
 **                  activationData: data from activation.
 **
 ** Returns:         None
 **
 *******************************************************************************/
-void NfcTag::fillNativeNfcTagMembers5(JNIEnv* e, jclass tag_cls, jobject tag,
-                                      tNFA_ACTIVATED& activationData) {
-  static const char fn[] = "NfcTag::fillNativeNfcTagMembers5";
-  int len = 0;
-  ScopedLocalRef<jbyteArray> uid(e, NULL);
+void NfcTag::fillUid(tNFA_ACTIVATED& activationData) {
+  static const char fn[] = "NfcTag::fillUid";
+  mUid.clear();
 
   if (NFC_DISCOVERY_TYPE_POLL_KOVIO == mTechParams[0].mode) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: Kovio", fn);
-    len = mTechParams[0].param.pk.uid_len;
-    uid.reset(e->NewByteArray(len));
-    e->SetByteArrayRegion(uid.get(), 0, len,
-                          (jbyte*)&mTechParams[0].param.pk.uid);
+    const uint8_t* uid = mTechParams[0].param.pk.uid;
+    mUid.assign(uid, uid + mTechParams[0].param.pk.uid_len);
   } else if (NFC_DISCOVERY_TYPE_POLL_A == mTechParams[0].mode ||
              NFC_DISCOVERY_TYPE_POLL_A_ACTIVE == mTechParams[0].mode ||
              NFC_DISCOVERY_TYPE_LISTEN_A == mTechParams[0].mode ||
              NFC_DISCOVERY_TYPE_LISTEN_A_ACTIVE == mTechParams[0].mode) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: tech A", fn);
-    len = mTechParams[0].param.pa.nfcid1_len;
-    uid.reset(e->NewByteArray(len));
-    e->SetByteArrayRegion(uid.get(), 0, len,
-                          (jbyte*)&mTechParams[0].param.pa.nfcid1);
+    const uint8_t* uid = mTechParams[0].param.pa.nfcid1;
+    mUid.assign(uid, uid + mTechParams[0].param.pa.nfcid1_len);
     // a tag's NFCID1 can change dynamically at each activation;
     // only the first byte (0x08) is constant; a dynamic NFCID1's length
     // must be 4 bytes (see NFC Digitial Protocol,
@@ -1177,45 +1035,79 @@ void NfcTag::fillNativeNfcTagMembers5(JNIEnv* e, jclass tag_cls, jobject tag,
     if(activationData.activate_ntf.protocol != NFA_PROTOCOL_T3BT) {
 #endif
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: tech B", fn);
-      uid.reset(e->NewByteArray(NFC_NFCID0_MAX_LEN));
-      e->SetByteArrayRegion(uid.get(), 0, NFC_NFCID0_MAX_LEN,
-                            (jbyte*)&mTechParams[0].param.pb.nfcid0);
+      const uint8_t* uid = mTechParams[0].param.pb.nfcid0;
+      mUid.assign(uid, uid + NFC_NFCID0_MAX_LEN);
 #if (NXP_EXTNS == TRUE)
     } else {
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: chinaId card", fn);
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: pipi_id[0]=%x", fn, mTechParams [0].param.pb.pupiid[0]);
-      uid.reset(e->NewByteArray(NFC_PUPIID_MAX_LEN));
-      e->SetByteArrayRegion(uid.get(), 0, NFC_PUPIID_MAX_LEN,
-              (jbyte*) &mTechParams [0].param.pb.pupiid);
+      const uint8_t* uid = mTechParams[0].param.pb.pupiid;
+      mUid.assign(uid, uid + NFC_PUPIID_MAX_LEN);
     }
 #endif
   } else if (NFC_DISCOVERY_TYPE_POLL_F == mTechParams[0].mode ||
              NFC_DISCOVERY_TYPE_POLL_F_ACTIVE == mTechParams[0].mode ||
              NFC_DISCOVERY_TYPE_LISTEN_F == mTechParams[0].mode ||
              NFC_DISCOVERY_TYPE_LISTEN_F_ACTIVE == mTechParams[0].mode) {
-    uid.reset(e->NewByteArray(NFC_NFCID2_LEN));
-    e->SetByteArrayRegion(uid.get(), 0, NFC_NFCID2_LEN,
-                          (jbyte*)&mTechParams[0].param.pf.nfcid2);
+    const uint8_t* uid = mTechParams[0].param.pf.nfcid2;
+    mUid.assign(uid, uid + NFC_NFCID2_LEN);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: tech F", fn);
   } else if (NFC_DISCOVERY_TYPE_POLL_V == mTechParams[0].mode ||
              NFC_DISCOVERY_TYPE_LISTEN_ISO15693 == mTechParams[0].mode) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: tech iso 15693", fn);
-    jbyte data[I93_UID_BYTE_LEN];               // 8 bytes
     for (int i = 0; i < I93_UID_BYTE_LEN; ++i)  // reverse the ID
-      data[i] = activationData.params.i93.uid[I93_UID_BYTE_LEN - i - 1];
-    uid.reset(e->NewByteArray(I93_UID_BYTE_LEN));
-    e->SetByteArrayRegion(uid.get(), 0, I93_UID_BYTE_LEN, data);
+      mUid.push_back(activationData.params.i93.uid[I93_UID_BYTE_LEN - i - 1]);
   } else {
     LOG(ERROR) << StringPrintf("%s: tech unknown ????", fn);
-    uid.reset(e->NewByteArray(0));
   }
-  jfieldID f = e->GetFieldID(tag_cls, "mUid", "[B");
-  e->SetObjectField(tag, f, uid.get());
+}
+
+/*******************************************************************************
+**
+** Function:        buildTagDescriptor
+**
+** Description:     Pack the technologies, handles, types, poll bytes,
+**                  activation bytes and UID of the tag into
+**                  mTagDescriptor, which NativeNfcTag decodes on first use.
+**                  Version 1 layout; lengths and values are one octet each:
+**                    version, count, uid len, uid,
+**                    count x (tech, handle, type, poll len, poll bytes,
+**                             act len, act bytes)
+**
+** Returns:         None
+**
+*******************************************************************************/
+void NfcTag::buildTagDescriptor() {
+  static const char fn[] = "NfcTag::buildTagDescriptor";
+  // The buffer keeps its capacity, so only the first tags allocate
+  mTagDescriptor.clear();
+  mTagDescriptor.push_back((uint8_t)TAG_DESCRIPTOR_VERSION);
+  mTagDescriptor.push_back((uint8_t)mNumTechList);
+  mTagDescriptor.push_back((uint8_t)mUid.size());
+  mTagDescriptor.insert(mTagDescriptor.end(), mUid.begin(), mUid.end());
+  for (int i = 0; i < mNumTechList; i++) {
+    mNativeData->tProtocols[i] = mTechLibNfcTypes[i];
+    mNativeData->handles[i] = mTechHandles[i];
+    mTagDescriptor.push_back((uint8_t)mTechList[i]);
+    mTagDescriptor.push_back((uint8_t)mTechHandles[i]);
+    mTagDescriptor.push_back((uint8_t)mTechLibNfcTypes[i]);
+    mTagDescriptor.push_back((uint8_t)mTechPollBytes[i].size());
+    mTagDescriptor.insert(mTagDescriptor.end(), mTechPollBytes[i].begin(),
+                          mTechPollBytes[i].end());
+    mTagDescriptor.push_back((uint8_t)mTechActBytes[i].size());
+    mTagDescriptor.insert(mTagDescriptor.end(), mTechActBytes[i].begin(),
+                          mTechActBytes[i].end());
+  }
+
 #if (NXP_EXTNS == TRUE)
   mTechListIndex = mNumTechList;
-  if(!mNumDiscNtf)
-    mTechListIndex = 0;
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s;mTechListIndex=%x",fn,mTechListIndex);
+  if (!mNumDiscNtf) mTechListIndex = 0;
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: %zu bytes; mTechListIndex=%x", fn,
+                      mTagDescriptor.size(), mTechListIndex);
+#else
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: %zu bytes", fn, mTagDescriptor.size());
 #endif
 }
 
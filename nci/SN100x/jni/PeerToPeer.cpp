@@ -30,10 +30,14 @@
 #include <nativehelper/ScopedLocalRef.h>
 
 #include "JavaClassConstants.h"
+#include "JniEventDispatcher.h"
 #include "NfcJniUtil.h"
 #include "llcp_defs.h"
 #include "nfc_config.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 using android::base::StringPrintf;
 
 /* Some older PN544-based solutions would only send the first SYMM back
@@ -54,6 +58,80 @@ extern void startRfDiscovery(bool isStart);
 extern bool isDiscoveryStarted();
 }  // namespace android
 
+// Java NativeP2pDevice class and members; see PeerToPeer::cacheJavaIds()
+static struct {
+  jclass deviceClass;
+  jmethodID ctor;
+  jfieldID mode;
+  jfieldID llcpVersion;
+  jfieldID handle;
+} sP2pDeviceIds;
+
+/*
+ * Lookup tables over the servers, clients and connections, keyed by JNI
+ * handle, NFA handle and service name.  Objects are added, removed and
+ * re-keyed one at a time as they change, and NFA_HANDLE_INVALID is never a
+ * key: clients still waiting for NFA_P2P_REG_CLIENT_EVT are queued oldest
+ * first instead.
+ */
+struct P2pHandleIndex {
+  std::unordered_map<PeerToPeer::tJNI_HANDLE, sp<P2pServer>> serverByJni;
+  std::unordered_map<tNFA_HANDLE, sp<P2pServer>> serverByNfa;
+  std::unordered_map<std::string, sp<P2pServer>> serverByName;
+  std::unordered_map<PeerToPeer::tJNI_HANDLE, sp<P2pClient>> clientByJni;
+  std::unordered_map<tNFA_HANDLE, sp<P2pClient>> clientByNfa;
+  std::deque<sp<P2pClient>> waitingClients;
+  std::unordered_map<PeerToPeer::tJNI_HANDLE, sp<NfaConn>> connByJni;
+  std::unordered_map<tNFA_HANDLE, sp<NfaConn>> connByNfa;
+};
+
+template <typename K, typename V>
+static sp<V> findInIndex(const std::unordered_map<K, sp<V>>& map,
+                         const K& key) {
+  auto it = map.find(key);
+  if (it == map.end()) return NULL;
+  return it->second;
+}
+
+// Erase key only if it still maps to value.
+template <typename K, typename V>
+static void eraseFromIndex(std::unordered_map<K, sp<V>>& map, const K& key,
+                           const sp<V>& value) {
+  auto it = map.find(key);
+  if ((it != map.end()) && (it->second == value)) map.erase(it);
+}
+
+static void addConnToIndex(P2pHandleIndex& index, const sp<NfaConn>& conn) {
+  index.connByJni[conn->mJniHandle] = conn;
+  if (conn->mNfaConnHandle != NFA_HANDLE_INVALID)
+    index.connByNfa[conn->mNfaConnHandle] = conn;
+}
+
+static void eraseConnFromIndex(P2pHandleIndex& index,
+                               const sp<NfaConn>& conn) {
+  eraseFromIndex(index.connByJni, conn->mJniHandle, conn);
+  eraseFromIndex(index.connByNfa, conn->mNfaConnHandle, conn);
+}
+
+static void addClientHandleToIndex(P2pHandleIndex& index,
+                                   const sp<P2pClient>& client) {
+  if (client->mNfaP2pClientHandle == NFA_HANDLE_INVALID)
+    index.waitingClients.push_back(client);
+  else
+    index.clientByNfa[client->mNfaP2pClientHandle] = client;
+}
+
+static void eraseClientHandleFromIndex(P2pHandleIndex& index,
+                                       const sp<P2pClient>& client) {
+  if (client->mNfaP2pClientHandle != NFA_HANDLE_INVALID) {
+    eraseFromIndex(index.clientByNfa, client->mNfaP2pClientHandle, client);
+    return;
+  }
+  auto it = std::find(index.waitingClients.begin(),
+                      index.waitingClients.end(), client);
+  if (it != index.waitingClients.end()) index.waitingClients.erase(it);
+}
+
 PeerToPeer PeerToPeer::sP2p;
 const std::string P2pServer::sSnepServiceName("urn:nfc:sn:snep");
 
@@ -74,10 +152,8 @@ PeerToPeer::PeerToPeer()
       mP2pListenTechMask(NFA_TECHNOLOGY_MASK_A | NFA_TECHNOLOGY_MASK_F |
                          NFA_TECHNOLOGY_MASK_A_ACTIVE |
                          NFA_TECHNOLOGY_MASK_F_ACTIVE),
-      mNextJniHandle(1) {
-  memset(mServers, 0, sizeof(mServers));
-  memset(mClients, 0, sizeof(mClients));
-}
+      mNextJniHandle(1),
+      mIndex(new P2pHandleIndex) {}
 
 /*******************************************************************************
 **
@@ -101,6 +177,41 @@ PeerToPeer::~PeerToPeer() {}
 *******************************************************************************/
 PeerToPeer& PeerToPeer::getInstance() { return sP2p; }
 
+/*******************************************************************************
+**
+** Function:        cacheJavaIds
+**
+** Description:     Resolve the NativeP2pDevice class, constructor and fields
+**                  once, so LLCP activation does not look them up again.
+**                  e: JVM environment.
+**                  className: Name of the Java NativeP2pDevice class.
+**
+** Returns:         True if everything was found.
+**
+*******************************************************************************/
+bool PeerToPeer::cacheJavaIds(JNIEnv* e, const char* className) {
+  static const char fn[] = "PeerToPeer::cacheJavaIds";
+  if (sP2pDeviceIds.deviceClass != NULL) return true;
+
+  ScopedLocalRef<jclass> cls(e, e->FindClass(className));
+  if (cls.get() == NULL) {
+    e->ExceptionClear();
+    LOG(ERROR) << StringPrintf("%s: fail find class", fn);
+    return false;
+  }
+  sP2pDeviceIds.ctor = e->GetMethodID(cls.get(), "<init>", "()V");
+  sP2pDeviceIds.mode = e->GetFieldID(cls.get(), "mMode", "I");
+  sP2pDeviceIds.llcpVersion = e->GetFieldID(cls.get(), "mLlcpVersion", "B");
+  sP2pDeviceIds.handle = e->GetFieldID(cls.get(), "mHandle", "I");
+  if (e->ExceptionCheck()) {
+    e->ExceptionClear();
+    LOG(ERROR) << StringPrintf("%s: fail find member", fn);
+    return false;
+  }
+  sP2pDeviceIds.deviceClass = (jclass)e->NewGlobalRef(cls.get());
+  return true;
+}
+
 /*******************************************************************************
 **
 ** Function:        initialize
@@ -119,69 +230,232 @@ void PeerToPeer::initialize() {
 
 /*******************************************************************************
 **
-** Function:        findServerLocked
+** Function:        indexServerLocked
+**
+** Description:     Add a new server to the handle lookup tables.
+**                  Assumes mMutex is already held.
+**                  server: Server to add.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::indexServerLocked(const sp<P2pServer>& server) {
+  AutoMutex index(mIndexMutex);
+  mIndex->serverByJni[server->mJniHandle] = server;
+  mIndex->serverByName[server->mServiceName] = server;
+  if (server->mNfaP2pServerHandle != NFA_HANDLE_INVALID)
+    mIndex->serverByNfa[server->mNfaP2pServerHandle] = server;
+}
+
+/*******************************************************************************
+**
+** Function:        unindexServerLocked
+**
+** Description:     Remove a server and all its connections from the handle
+**                  lookup tables.
+**                  Assumes mMutex is already held.
+**                  server: Server to remove.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::unindexServerLocked(const sp<P2pServer>& server) {
+  std::vector<sp<NfaConn>> conns;
+  server->getConnections(conns);
+
+  AutoMutex index(mIndexMutex);
+  eraseFromIndex(mIndex->serverByJni, server->mJniHandle, server);
+  eraseFromIndex(mIndex->serverByNfa, server->mNfaP2pServerHandle, server);
+  eraseFromIndex(mIndex->serverByName, server->mServiceName, server);
+  for (const sp<NfaConn>& conn : conns) eraseConnFromIndex(*mIndex, conn);
+}
+
+/*******************************************************************************
+**
+** Function:        indexClientLocked
+**
+** Description:     Add a new client and its connection to the handle lookup
+**                  tables.
+**                  Assumes mMutex is already held.
+**                  client: Client to add.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::indexClientLocked(const sp<P2pClient>& client) {
+  AutoMutex index(mIndexMutex);
+  mIndex->clientByJni[client->mClientConn->mJniHandle] = client;
+  addClientHandleToIndex(*mIndex, client);
+  addConnToIndex(*mIndex, client->mClientConn);
+}
+
+/*******************************************************************************
+**
+** Function:        unindexClientLocked
+**
+** Description:     Remove a client and its connection from the handle lookup
+**                  tables.
+**                  Assumes mMutex is already held.
+**                  client: Client to remove.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::unindexClientLocked(const sp<P2pClient>& client) {
+  AutoMutex index(mIndexMutex);
+  eraseFromIndex(mIndex->clientByJni, client->mClientConn->mJniHandle, client);
+  eraseClientHandleFromIndex(*mIndex, client);
+  eraseConnFromIndex(*mIndex, client->mClientConn);
+}
+
+/*******************************************************************************
+**
+** Function:        indexConnLocked
+**
+** Description:     Add a new server connection to the handle lookup tables.
+**                  Assumes mMutex is already held.
+**                  conn: Connection to add.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::indexConnLocked(const sp<NfaConn>& conn) {
+  AutoMutex index(mIndexMutex);
+  addConnToIndex(*mIndex, conn);
+}
+
+/*******************************************************************************
+**
+** Function:        unindexConnLocked
+**
+** Description:     Remove a server connection from the handle lookup tables.
+**                  Assumes mMutex is already held.
+**                  conn: Connection to remove.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::unindexConnLocked(const sp<NfaConn>& conn) {
+  AutoMutex index(mIndexMutex);
+  eraseConnFromIndex(*mIndex, conn);
+}
+
+/*******************************************************************************
+**
+** Function:        setNfaHandleLocked
+**
+** Description:     Change the NFA handle of a server and re-key it in the
+**                  handle lookup tables.  A server that was already removed
+**                  is not added back.
+**                  Assumes mMutex is already held.
+**                  server: Server to change.
+**                  value: New handle.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::setNfaHandleLocked(const sp<P2pServer>& server,
+                                    tNFA_HANDLE value) {
+  AutoMutex index(mIndexMutex);
+  bool indexed =
+      (findInIndex(mIndex->serverByJni, server->mJniHandle) == server);
+  eraseFromIndex(mIndex->serverByNfa, server->mNfaP2pServerHandle, server);
+  server->mNfaP2pServerHandle = value;
+  if (indexed && (value != NFA_HANDLE_INVALID))
+    mIndex->serverByNfa[value] = server;
+}
+
+/*******************************************************************************
+**
+** Function:        setNfaHandleLocked
+**
+** Description:     Change the NFA handle of a client and re-key it in the
+**                  handle lookup tables.  A client that was already removed
+**                  is not added back.
+**                  Assumes mMutex is already held.
+**                  client: Client to change.
+**                  value: New handle.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::setNfaHandleLocked(const sp<P2pClient>& client,
+                                    tNFA_HANDLE value) {
+  AutoMutex index(mIndexMutex);
+  bool indexed = (findInIndex(mIndex->clientByJni,
+                              client->mClientConn->mJniHandle) == client);
+  eraseClientHandleFromIndex(*mIndex, client);
+  client->mNfaP2pClientHandle = value;
+  if (indexed) addClientHandleToIndex(*mIndex, client);
+}
+
+/*******************************************************************************
+**
+** Function:        setNfaHandleLocked
+**
+** Description:     Change the NFA handle of a connection and re-key it in the
+**                  handle lookup tables.  A connection that was already
+**                  removed is not added back.
+**                  Assumes mMutex is already held.
+**                  conn: Connection to change.
+**                  value: New handle.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void PeerToPeer::setNfaHandleLocked(const sp<NfaConn>& conn,
+                                    tNFA_HANDLE value) {
+  AutoMutex index(mIndexMutex);
+  bool indexed = (findInIndex(mIndex->connByJni, conn->mJniHandle) == conn);
+  eraseFromIndex(mIndex->connByNfa, conn->mNfaConnHandle, conn);
+  conn->mNfaConnHandle = value;
+  if (indexed && (value != NFA_HANDLE_INVALID))
+    mIndex->connByNfa[value] = conn;
+}
+
+/*******************************************************************************
+**
+** Function:        findServer
 **
 ** Description:     Find a PeerToPeer object by connection handle.
-**                  Assumes mMutex is already held
 **                  nfaP2pServerHandle: Connectin handle.
 **
 ** Returns:         PeerToPeer object.
 **
 *******************************************************************************/
-sp<P2pServer> PeerToPeer::findServerLocked(tNFA_HANDLE nfaP2pServerHandle) {
-  for (int i = 0; i < sMax; i++) {
-    if ((mServers[i] != NULL) &&
-        (mServers[i]->mNfaP2pServerHandle == nfaP2pServerHandle)) {
-      return (mServers[i]);
-    }
-  }
-
-  // If here, not found
-  return NULL;
+sp<P2pServer> PeerToPeer::findServer(tNFA_HANDLE nfaP2pServerHandle) {
+  AutoMutex index(mIndexMutex);
+  return findInIndex(mIndex->serverByNfa, nfaP2pServerHandle);
 }
 
 /*******************************************************************************
 **
-** Function:        findServerLocked
+** Function:        findServer
 **
 ** Description:     Find a PeerToPeer object by connection handle.
-**                  Assumes mMutex is already held
-**                  serviceName: service name.
+**                  jniHandle: JNI handle.
 **
 ** Returns:         PeerToPeer object.
 **
 *******************************************************************************/
-sp<P2pServer> PeerToPeer::findServerLocked(tJNI_HANDLE jniHandle) {
-  for (int i = 0; i < sMax; i++) {
-    if ((mServers[i] != NULL) && (mServers[i]->mJniHandle == jniHandle)) {
-      return (mServers[i]);
-    }
-  }
-
-  // If here, not found
-  return NULL;
+sp<P2pServer> PeerToPeer::findServer(tJNI_HANDLE jniHandle) {
+  AutoMutex index(mIndexMutex);
+  return findInIndex(mIndex->serverByJni, jniHandle);
 }
 
 /*******************************************************************************
 **
-** Function:        findServerLocked
+** Function:        findServer
 **
 ** Description:     Find a PeerToPeer object by service name
-**                  Assumes mMutex is already heldf
 **                  serviceName: service name.
 **
 ** Returns:         PeerToPeer object.
 **
 *******************************************************************************/
-sp<P2pServer> PeerToPeer::findServerLocked(const char* serviceName) {
-  for (int i = 0; i < sMax; i++) {
-    if ((mServers[i] != NULL) &&
-        (mServers[i]->mServiceName.compare(serviceName) == 0))
-      return (mServers[i]);
-  }
-
-  // If here, not found
-  return NULL;
+sp<P2pServer> PeerToPeer::findServer(const char* serviceName) {
+  AutoMutex index(mIndexMutex);
+  return findInIndex(mIndex->serverByName, std::string(serviceName));
 }
 
 /*******************************************************************************
@@ -205,35 +479,30 @@ bool PeerToPeer::registerServer(tJNI_HANDLE jniHandle,
 
   mMutex.lock();
   // Check if already registered
-  if ((pSrv = findServerLocked(serviceName)) != NULL) {
+  if ((pSrv = findServer(serviceName)) != NULL) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
         "%s: service name=%s  already registered, handle: 0x%04x", fn,
         serviceName, pSrv->mNfaP2pServerHandle);
 
     // Update JNI handle
-    pSrv->mJniHandle = jniHandle;
+    {
+      AutoMutex index(mIndexMutex);
+      eraseFromIndex(mIndex->serverByJni, pSrv->mJniHandle, pSrv);
+      pSrv->mJniHandle = jniHandle;
+      mIndex->serverByJni[jniHandle] = pSrv;
+    }
     mMutex.unlock();
     return (true);
   }
 
-  for (int ii = 0; ii < sMax; ii++) {
-    if (mServers[ii] == NULL) {
-      pSrv = mServers[ii] = new P2pServer(jniHandle, serviceName);
-
-      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
-          "%s: added new p2p server  index: %d  handle: %u  name: %s", fn, ii,
-          jniHandle, serviceName);
-      break;
-    }
-  }
+  pSrv = new P2pServer(jniHandle, serviceName);
+  mServers.push_back(pSrv);
+  indexServerLocked(pSrv);
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: added new p2p server  index: %zu  handle: %u  name: %s", fn,
+      mServers.size() - 1, jniHandle, serviceName);
   mMutex.unlock();
 
-  if (pSrv == NULL) {
-    LOG(ERROR) << StringPrintf("%s: service name=%s  no free entry", fn,
-                               serviceName);
-    return (false);
-  }
-
   if (pSrv->registerWithStack()) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
         "%s: got new p2p server h=0x%X", fn, pSrv->mNfaP2pServerHandle);
@@ -260,14 +529,15 @@ void PeerToPeer::removeServer(tJNI_HANDLE jniHandle) {
 
   AutoMutex mutex(mMutex);
 
-  for (int i = 0; i < sMax; i++) {
-    if ((mServers[i] != NULL) && (mServers[i]->mJniHandle == jniHandle)) {
+  for (size_t i = 0; i < mServers.size(); i++) {
+    if (mServers[i]->mJniHandle == jniHandle) {
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
-          "%s: server jni_handle: %u;  nfa_handle: 0x%04x; name: %s; index=%d",
+          "%s: server jni_handle: %u;  nfa_handle: 0x%04x; name: %s; index=%zu",
           fn, jniHandle, mServers[i]->mNfaP2pServerHandle,
           mServers[i]->mServiceName.c_str(), i);
 
-      mServers[i] = NULL;
+      unindexServerLocked(mServers[i]);
+      mServers.erase(mServers.begin() + i);
       return;
     }
   }
@@ -296,61 +566,47 @@ void PeerToPeer::llcpActivatedHandler(nfc_jni_native_data* nat,
 
   mRemoteWKS = activated.remote_wks;
 
-  JNIEnv* e = NULL;
-  ScopedAttach attach(nat->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("%s: jni env is null", fn);
-    return;
-  }
-
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: get object class", fn);
-  ScopedLocalRef<jclass> tag_cls(e, e->GetObjectClass(nat->cached_P2pDevice));
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: fail get p2p device", fn);
-    return;
-  }
-
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: instantiate", fn);
-  /* New target instance */
-  jmethodID ctor = e->GetMethodID(tag_cls.get(), "<init>", "()V");
-  ScopedLocalRef<jobject> tag(e, e->NewObject(tag_cls.get(), ctor));
-
-  /* Set P2P Target mode */
-  jfieldID f = e->GetFieldID(tag_cls.get(), "mMode", "I");
-
-  if (activated.is_initiator == TRUE) {
-    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: p2p initiator", fn);
-    e->SetIntField(tag.get(), f, (jint)MODE_P2P_INITIATOR);
-  } else {
-    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: p2p target", fn);
-    e->SetIntField(tag.get(), f, (jint)MODE_P2P_TARGET);
-  }
-  /* Set LLCP version */
-  f = e->GetFieldID(tag_cls.get(), "mLlcpVersion", "B");
-  e->SetByteField(tag.get(), f, (jbyte)activated.remote_version);
-
-  /* Set tag handle */
-  f = e->GetFieldID(tag_cls.get(), "mHandle", "I");
-  e->SetIntField(tag.get(), f,
-                 (jint)0x1234);  // ?? This handle is not used for anything
-
-  if (nat->tag != NULL) {
-    e->DeleteGlobalRef(nat->tag);
-  }
-  nat->tag = e->NewGlobalRef(tag.get());
-
-  DLOG_IF(INFO, nfc_debug_enabled)
-      << StringPrintf("%s: notify nfc service", fn);
-
-  /* Notify manager that new a P2P device was found */
-  e->CallVoidMethod(nat->manager,
-                    android::gCachedNfcManagerNotifyLlcpLinkActivation,
-                    tag.get());
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: fail notify", fn);
-  }
+  JniEventDispatcher::getInstance().run([&](JNIEnv* e) {
+    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: instantiate", fn);
+    /* New target instance */
+    ScopedLocalRef<jobject> tag(
+        e, e->NewObject(sP2pDeviceIds.deviceClass, sP2pDeviceIds.ctor));
+    if (tag.get() == NULL) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: fail create p2p device", fn);
+      return;
+    }
+    /* Set P2P Target mode */
+    if (activated.is_initiator == TRUE) {
+      DLOG_IF(INFO, nfc_debug_enabled)
+          << StringPrintf("%s: p2p initiator", fn);
+      e->SetIntField(tag.get(), sP2pDeviceIds.mode, (jint)MODE_P2P_INITIATOR);
+    } else {
+      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: p2p target", fn);
+      e->SetIntField(tag.get(), sP2pDeviceIds.mode, (jint)MODE_P2P_TARGET);
+    }
+    /* Set LLCP version */
+    e->SetByteField(tag.get(), sP2pDeviceIds.llcpVersion,
+                    (jbyte)activated.remote_version);
+    /* Set tag handle */
+    e->SetIntField(tag.get(), sP2pDeviceIds.handle,
+                   (jint)0x1234);  // ?? This handle is not used for anything
+    if (nat->tag != NULL) {
+      e->DeleteGlobalRef(nat->tag);
+    }
+    nat->tag = e->NewGlobalRef(tag.get());
+    DLOG_IF(INFO, nfc_debug_enabled)
+        << StringPrintf("%s: notify nfc service", fn);
+
+    /* Notify manager that new a P2P device was found */
+    e->CallVoidMethod(nat->manager,
+                      android::gCachedNfcManagerNotifyLlcpLinkActivation,
+                      tag.get());
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: fail notify", fn);
+    }
+  });
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
 }
@@ -371,23 +627,18 @@ void PeerToPeer::llcpDeactivatedHandler(
   static const char fn[] = "PeerToPeer::llcpDeactivatedHandler";
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", fn);
 
-  JNIEnv* e = NULL;
-  ScopedAttach attach(nat->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("%s: jni env is null", fn);
-    return;
-  }
-
-  DLOG_IF(INFO, nfc_debug_enabled)
-      << StringPrintf("%s: notify nfc service", fn);
-  /* Notify manager that the LLCP is lost or deactivated */
-  e->CallVoidMethod(nat->manager,
-                    android::gCachedNfcManagerNotifyLlcpLinkDeactivated,
-                    nat->tag);
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: fail notify", fn);
-  }
+  JniEventDispatcher::getInstance().run([&](JNIEnv* e) {
+    DLOG_IF(INFO, nfc_debug_enabled)
+        << StringPrintf("%s: notify nfc service", fn);
+    /* Notify manager that the LLCP is lost or deactivated */
+    e->CallVoidMethod(nat->manager,
+                      android::gCachedNfcManagerNotifyLlcpLinkDeactivated,
+                      nat->tag);
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: fail notify", fn);
+    }
+  });
 
   // let the tag-reading code handle NDEF data event
   android::nativeNfcTag_registerNdefTypeHandler();
@@ -398,23 +649,18 @@ void PeerToPeer::llcpFirstPacketHandler(nfc_jni_native_data* nat) {
   static const char fn[] = "PeerToPeer::llcpFirstPacketHandler";
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", fn);
 
-  JNIEnv* e = NULL;
-  ScopedAttach attach(nat->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("%s: jni env is null", fn);
-    return;
-  }
-
-  DLOG_IF(INFO, nfc_debug_enabled)
-      << StringPrintf("%s: notify nfc service", fn);
-  /* Notify manager that the LLCP is lost or deactivated */
-  e->CallVoidMethod(nat->manager,
-                    android::gCachedNfcManagerNotifyLlcpFirstPacketReceived,
-                    nat->tag);
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: fail notify", fn);
-  }
+  JniEventDispatcher::getInstance().run([&](JNIEnv* e) {
+    DLOG_IF(INFO, nfc_debug_enabled)
+        << StringPrintf("%s: notify nfc service", fn);
+    /* Notify manager that the LLCP is lost or deactivated */
+    e->CallVoidMethod(nat->manager,
+                      android::gCachedNfcManagerNotifyLlcpFirstPacketReceived,
+                      nat->tag);
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: fail notify", fn);
+    }
+  });
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
 }
@@ -441,16 +687,33 @@ bool PeerToPeer::accept(tJNI_HANDLE serverJniHandle, tJNI_HANDLE connJniHandle,
       "recvWindow: %d",
       fn, serverJniHandle, connJniHandle, maxInfoUnit, recvWindow);
 
-  mMutex.lock();
-  if ((pSrv = findServerLocked(serverJniHandle)) == NULL) {
+  if ((pSrv = findServer(serverJniHandle)) == NULL) {
     LOG(ERROR) << StringPrintf("%s: unknown server jni handle: %u", fn,
                                serverJniHandle);
-    mMutex.unlock();
     return (false);
   }
-  mMutex.unlock();
 
-  return pSrv->accept(serverJniHandle, connJniHandle, maxInfoUnit, recvWindow);
+  sp<NfaConn> connection = pSrv->allocateConnection(connJniHandle);
+  {
+    AutoMutex mutex(mMutex);
+    // removeServer() may have run since the lookup above
+    if (findServer(pSrv->mJniHandle) != pSrv) {
+      pSrv->removeServerConnection(connJniHandle);
+      LOG(ERROR) << StringPrintf("%s: server jni handle %u was removed", fn,
+                                 serverJniHandle);
+      return (false);
+    }
+    indexConnLocked(connection);
+  }
+
+  bool stat =
+      pSrv->accept(serverJniHandle, connection, maxInfoUnit, recvWindow);
+  if (!stat && (pSrv->findServerConnection(connJniHandle) == NULL)) {
+    // accept() dropped the connection
+    AutoMutex mutex(mMutex);
+    unindexConnLocked(connection);
+  }
+  return stat;
 }
 
 /*******************************************************************************
@@ -470,13 +733,10 @@ bool PeerToPeer::deregisterServer(tJNI_HANDLE jniHandle) {
   sp<P2pServer> pSrv = NULL;
   bool isPollingTempStopped = false;
 
-  mMutex.lock();
-  if ((pSrv = findServerLocked(jniHandle)) == NULL) {
+  if ((pSrv = findServer(jniHandle)) == NULL) {
     LOG(ERROR) << StringPrintf("%s: unknown service handle: %u", fn, jniHandle);
-    mMutex.unlock();
     return (false);
   }
-  mMutex.unlock();
   if (isDiscoveryStarted()) {
     isPollingTempStopped = true;
     startRfDiscovery(false);
@@ -517,43 +777,29 @@ bool PeerToPeer::deregisterServer(tJNI_HANDLE jniHandle) {
 *******************************************************************************/
 bool PeerToPeer::createClient(tJNI_HANDLE jniHandle, uint16_t miu, uint8_t rw) {
   static const char fn[] = "PeerToPeer::createClient";
-  int i = 0;
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
       "%s: enter: jni h: %u  miu: %u  rw: %u", fn, jniHandle, miu, rw);
 
   mMutex.lock();
-  sp<P2pClient> client = NULL;
-  for (i = 0; i < sMax; i++) {
-    if (mClients[i] == NULL) {
-      mClients[i] = client = new P2pClient();
-
-      mClients[i]->mClientConn->mJniHandle = jniHandle;
-      mClients[i]->mClientConn->mMaxInfoUnit = miu;
-      mClients[i]->mClientConn->mRecvWindow = rw;
-      break;
-    }
-  }
+  sp<P2pClient> client = new P2pClient();
+  client->mClientConn->mJniHandle = jniHandle;
+  client->mClientConn->mMaxInfoUnit = miu;
+  client->mClientConn->mRecvWindow = rw;
+  mClients.push_back(client);
+  indexClientLocked(client);
   mMutex.unlock();
 
-  if (client == NULL) {
-    LOG(ERROR) << StringPrintf("%s: fail", fn);
-    return (false);
-  }
-
   DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: pClient: 0x%p  assigned for client jniHandle: %u",
                       fn, client.get(), jniHandle);
 
   {
-    if(i < sMax)
-    {
-      SyncEventGuard guard(mClients[i]->mRegisteringEvent);
-      NFA_P2pRegisterClient(NFA_P2P_DLINK_TYPE, nfaClientCallback);
-      mClients[i]->mRegisteringEvent.wait();  // wait for NFA_P2P_REG_CLIENT_EVT
-    }
+    SyncEventGuard guard(client->mRegisteringEvent);
+    NFA_P2pRegisterClient(NFA_P2P_DLINK_TYPE, nfaClientCallback);
+    client->mRegisteringEvent.wait();  // wait for NFA_P2P_REG_CLIENT_EVT
   }
 
-  if (i < sMax && mClients[i]->mNfaP2pClientHandle != NFA_HANDLE_INVALID) {
+  if (client->mNfaP2pClientHandle != NFA_HANDLE_INVALID) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
         "%s: exit; new client jniHandle: %u   NFA Handle: 0x%04x", fn,
         jniHandle, client->mClientConn->mNfaConnHandle);
@@ -582,25 +828,25 @@ void PeerToPeer::removeConn(tJNI_HANDLE jniHandle) {
 
   AutoMutex mutex(mMutex);
   // If the connection is a for a client, delete the client itself
-  for (int ii = 0; ii < sMax; ii++) {
-    if ((mClients[ii] != NULL) &&
-        (mClients[ii]->mClientConn->mJniHandle == jniHandle)) {
+  for (size_t ii = 0; ii < mClients.size(); ii++) {
+    if (mClients[ii]->mClientConn->mJniHandle == jniHandle) {
       if (mClients[ii]->mNfaP2pClientHandle != NFA_HANDLE_INVALID)
         NFA_P2pDeregister(mClients[ii]->mNfaP2pClientHandle);
 
-      mClients[ii] = NULL;
+      unindexClientLocked(mClients[ii]);
+      mClients.erase(mClients.begin() + ii);
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
-          "%s: deleted client handle: %u  index: %u", fn, jniHandle, ii);
+          "%s: deleted client handle: %u  index: %zu", fn, jniHandle, ii);
       return;
     }
   }
 
   // If the connection is for a server, just delete the connection
-  for (int ii = 0; ii < sMax; ii++) {
-    if (mServers[ii] != NULL) {
-      if (mServers[ii]->removeServerConnection(jniHandle)) {
-        return;
-      }
+  sp<NfaConn> conn = findConnection(jniHandle);
+  for (const sp<P2pServer>& server : mServers) {
+    if (server->removeServerConnection(jniHandle)) {
+      if (conn != NULL) unindexConnLocked(conn);
+      return;
     }
   }
 
@@ -725,13 +971,11 @@ bool PeerToPeer::createDataLinkConn(tJNI_HANDLE jniHandle,
 **
 *******************************************************************************/
 sp<P2pClient> PeerToPeer::findClient(tNFA_HANDLE nfaConnHandle) {
-  AutoMutex mutex(mMutex);
-  for (int i = 0; i < sMax; i++) {
-    if ((mClients[i] != NULL) &&
-        (mClients[i]->mNfaP2pClientHandle == nfaConnHandle))
-      return (mClients[i]);
-  }
-  return (NULL);
+  AutoMutex index(mIndexMutex);
+  if (nfaConnHandle != NFA_HANDLE_INVALID)
+    return findInIndex(mIndex->clientByNfa, nfaConnHandle);
+  if (mIndex->waitingClients.empty()) return NULL;
+  return mIndex->waitingClients.front();
 }
 
 /*******************************************************************************
@@ -745,33 +989,8 @@ sp<P2pClient> PeerToPeer::findClient(tNFA_HANDLE nfaConnHandle) {
 **
 *******************************************************************************/
 sp<P2pClient> PeerToPeer::findClient(tJNI_HANDLE jniHandle) {
-  AutoMutex mutex(mMutex);
-  for (int i = 0; i < sMax; i++) {
-    if ((mClients[i] != NULL) &&
-        (mClients[i]->mClientConn->mJniHandle == jniHandle))
-      return (mClients[i]);
-  }
-  return (NULL);
-}
-
-/*******************************************************************************
-**
-** Function:        findClientCon
-**
-** Description:     Find a PeerToPeer object with a client connection handle.
-**                  nfaConnHandle: Connection handle.
-**
-** Returns:         PeerToPeer object.
-**
-*******************************************************************************/
-sp<P2pClient> PeerToPeer::findClientCon(tNFA_HANDLE nfaConnHandle) {
-  AutoMutex mutex(mMutex);
-  for (int i = 0; i < sMax; i++) {
-    if ((mClients[i] != NULL) &&
-        (mClients[i]->mClientConn->mNfaConnHandle == nfaConnHandle))
-      return (mClients[i]);
-  }
-  return (NULL);
+  AutoMutex index(mIndexMutex);
+  return findInIndex(mIndex->clientByJni, jniHandle);
 }
 
 /*******************************************************************************
@@ -785,27 +1004,8 @@ sp<P2pClient> PeerToPeer::findClientCon(tNFA_HANDLE nfaConnHandle) {
 **
 *******************************************************************************/
 sp<NfaConn> PeerToPeer::findConnection(tNFA_HANDLE nfaConnHandle) {
-  AutoMutex mutex(mMutex);
-  // First, look through all the client control blocks
-  for (int ii = 0; ii < sMax; ii++) {
-    if ((mClients[ii] != NULL) &&
-        (mClients[ii]->mClientConn->mNfaConnHandle == nfaConnHandle)) {
-      return mClients[ii]->mClientConn;
-    }
-  }
-
-  // Not found yet. Look through all the server control blocks
-  for (int ii = 0; ii < sMax; ii++) {
-    if (mServers[ii] != NULL) {
-      sp<NfaConn> conn = mServers[ii]->findServerConnection(nfaConnHandle);
-      if (conn != NULL) {
-        return conn;
-      }
-    }
-  }
-
-  // Not found...
-  return NULL;
+  AutoMutex index(mIndexMutex);
+  return findInIndex(mIndex->connByNfa, nfaConnHandle);
 }
 
 /*******************************************************************************
@@ -819,27 +1019,8 @@ sp<NfaConn> PeerToPeer::findConnection(tNFA_HANDLE nfaConnHandle) {
 **
 *******************************************************************************/
 sp<NfaConn> PeerToPeer::findConnection(tJNI_HANDLE jniHandle) {
-  AutoMutex mutex(mMutex);
-  // First, look through all the client control blocks
-  for (int ii = 0; ii < sMax; ii++) {
-    if ((mClients[ii] != NULL) &&
-        (mClients[ii]->mClientConn->mJniHandle == jniHandle)) {
-      return mClients[ii]->mClientConn;
-    }
-  }
-
-  // Not found yet. Look through all the server control blocks
-  for (int ii = 0; ii < sMax; ii++) {
-    if (mServers[ii] != NULL) {
-      sp<NfaConn> conn = mServers[ii]->findServerConnection(jniHandle);
-      if (conn != NULL) {
-        return conn;
-      }
-    }
-  }
-
-  // Not found...
-  return NULL;
+  AutoMutex index(mIndexMutex);
+  return findInIndex(mIndex->connByJni, jniHandle);
 }
 
 /*******************************************************************************
@@ -899,6 +1080,190 @@ bool PeerToPeer::send(tJNI_HANDLE jniHandle, uint8_t* buffer,
   return nfaStat == NFA_STATUS_OK;
 }
 
+/*******************************************************************************
+**
+** Function:        sendChunk
+**
+** Description:     Hand one chunk to the stack, waiting while the link is
+**                  congested.
+**                  pConn: Connection.
+**                  chunk: Data to send.
+**
+** Returns:         True if ok.
+**
+*******************************************************************************/
+static bool sendChunk(const sp<NfaConn>& pConn,
+                      const std::vector<uint8_t>& chunk) {
+  tNFA_STATUS nfaStat = NFA_STATUS_FAILED;
+
+  while (pConn->mNfaConnHandle != NFA_HANDLE_INVALID) {
+    SyncEventGuard guard(pConn->mCongEvent);
+    nfaStat = NFA_P2pSendData(pConn->mNfaConnHandle, (uint16_t)chunk.size(),
+                              const_cast<uint8_t*>(chunk.data()));
+    if (nfaStat != NFA_STATUS_CONGESTED) break;
+    // woken by NFA_P2P_CONGEST_EVT or a disconnect, which notify every
+    // waiter since send() may be waiting too
+    pConn->mCongEvent.wait();
+  }
+  return nfaStat == NFA_STATUS_OK;
+}
+
+/*******************************************************************************
+**
+** Function:        txThread
+**
+** Description:     Drain a connection's outbound queue into the stack.
+**                  A chunk stays queued until the stack accepted it, so the
+**                  queue length counts chunks not yet handed over.
+**                  arg: NfaConn with one strong reference taken for us.
+**
+** Returns:         None
+**
+*******************************************************************************/
+static void* txThread(void* arg) {
+  static const char fn[] = "PeerToPeer::txThread";
+  NfaConn* raw = static_cast<NfaConn*>(arg);
+  sp<NfaConn> pConn = raw;
+  raw->decStrong(NULL);
+  uint32_t sent = 0;
+
+  while (true) {
+    std::vector<uint8_t>* chunk = NULL;
+    {
+      SyncEventGuard guard(pConn->mTxEvent);
+      if (pConn->mTxQueue.empty() || pConn->mTxFailed) {
+        pConn->mTxQueue.clear();
+        pConn->mTxBusy = false;
+        pConn->mTxEvent.notifyAll();
+        break;
+      }
+      // Only this thread pops, so the front element stays put while unlocked
+      chunk = &pConn->mTxQueue.front();
+    }
+    bool ok = sendChunk(pConn, *chunk);
+    SyncEventGuard guard(pConn->mTxEvent);
+    pConn->mTxQueue.pop_front();
+    if (ok)
+      sent++;
+    else
+      pConn->mTxFailed = true;
+    pConn->mTxEvent.notifyAll();  // unblock sendQueued() / flush()
+  }
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: exit; jni handle: %u  chunks sent: %u", fn, pConn->mJniHandle, sent);
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function:        sendQueued
+**
+** Description:     Queue data for a connection's sender thread.
+**                  jniHandle: Handle of connection.
+**                  buffer: Buffer of data.
+**                  bufferLen: Length of data.
+**                  maxChunk: Max length of each chunk; 0 for the peer's MIU.
+**
+** Returns:         True if ok.
+**
+*******************************************************************************/
+bool PeerToPeer::sendQueued(tJNI_HANDLE jniHandle, const uint8_t* buffer,
+                            uint32_t bufferLen, uint16_t maxChunk) {
+  static const char fn[] = "PeerToPeer::sendQueued";
+  sp<NfaConn> pConn = NULL;
+
+  if ((pConn = findConnection(jniHandle)) == NULL) {
+    LOG(ERROR) << StringPrintf("%s: can't find connection handle: %u", fn,
+                               jniHandle);
+    return (false);
+  }
+
+  uint16_t chunkLen = pConn->mRemoteMaxInfoUnit;
+  if ((maxChunk != 0) && ((chunkLen == 0) || (maxChunk < chunkLen)))
+    chunkLen = maxChunk;
+  if (chunkLen == 0) {
+    LOG(ERROR) << StringPrintf("%s: peer MIU unknown; jni handle: %u", fn,
+                               jniHandle);
+    return (false);
+  }
+  // Keep up to the peer's receive window of chunks ahead of the stack
+  size_t window = pConn->mRemoteRecvWindow > 0 ? pConn->mRemoteRecvWindow : 1;
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: jniHandle: %u  nfaHandle: 0x%04X  len: %u  chunk: %u  window: %zu",
+      fn, jniHandle, pConn->mNfaConnHandle, bufferLen, chunkLen, window);
+
+  uint32_t offset = 0;
+  while (offset < bufferLen) {
+    uint32_t len = bufferLen - offset;
+    if (len > chunkLen) len = chunkLen;
+
+    SyncEventGuard guard(pConn->mTxEvent);
+    while ((pConn->mTxQueue.size() >= window) && !pConn->mTxFailed &&
+           (pConn->mNfaConnHandle != NFA_HANDLE_INVALID))
+      pConn->mTxEvent.wait();
+    if (pConn->mTxFailed || (pConn->mNfaConnHandle == NFA_HANDLE_INVALID)) {
+      LOG(ERROR) << StringPrintf(
+          "%s: data not queued; jni handle: %u  failed: %u", fn, jniHandle,
+          pConn->mTxFailed);
+      return (false);
+    }
+    pConn->mTxQueue.emplace_back(buffer + offset, buffer + offset + len);
+    offset += len;
+
+    if (!pConn->mTxBusy) {
+      pthread_t thread;
+      pthread_attr_t attr;
+      pthread_attr_init(&attr);
+      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      pConn->incStrong(NULL);  // released by txThread()
+      if (pthread_create(&thread, &attr, txThread, pConn.get()) != 0) {
+        LOG(ERROR) << StringPrintf("%s: fail create thread", fn);
+        pConn->decStrong(NULL);
+        pConn->mTxQueue.pop_back();
+        pthread_attr_destroy(&attr);
+        return (false);
+      }
+      pthread_attr_destroy(&attr);
+      pConn->mTxBusy = true;
+    }
+  }
+  return (true);
+}
+
+/*******************************************************************************
+**
+** Function:        flush
+**
+** Description:     Wait until all data queued by sendQueued() was handed
+**                  to the stack.
+**                  jniHandle: Handle of connection.
+**
+** Returns:         True if every queued chunk was sent.
+**
+*******************************************************************************/
+bool PeerToPeer::flush(tJNI_HANDLE jniHandle) {
+  static const char fn[] = "PeerToPeer::flush";
+  sp<NfaConn> pConn = NULL;
+
+  if ((pConn = findConnection(jniHandle)) == NULL) {
+    LOG(ERROR) << StringPrintf("%s: can't find connection handle: %u", fn,
+                               jniHandle);
+    return (false);
+  }
+
+  SyncEventGuard guard(pConn->mTxEvent);
+  // The sender thread notices a disconnect through sendChunk() failing
+  while (pConn->mTxBusy) pConn->mTxEvent.wait();
+  bool ok = !pConn->mTxFailed;
+  pConn->mTxFailed = false;
+
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: exit; jni handle: %u  ok: %u", fn, jniHandle, ok);
+  return ok;
+}
+
 /*******************************************************************************
 **
 ** Function:        receive
@@ -957,6 +1322,83 @@ bool PeerToPeer::receive(tJNI_HANDLE jniHandle, uint8_t* buffer,
   return retVal;
 }
 
+/*******************************************************************************
+**
+** Function:        receiveBatch
+**
+** Description:     Receive all SDUs queued for a connection in one call.
+**                  jniHandle: Handle of connection.
+**                  buffer: Buffer to store data.
+**                  bufferLen: Max length of buffer.
+**                  sduLengths: Receives the length of each SDU.
+**                  maxSdus: Number of entries in sduLengths.
+**                  numSdus: Number of SDUs received.
+**
+** Returns:         True if ok.
+**
+*******************************************************************************/
+bool PeerToPeer::receiveBatch(tJNI_HANDLE jniHandle, uint8_t* buffer,
+                              uint32_t bufferLen, uint16_t* sduLengths,
+                              uint16_t maxSdus, uint16_t& numSdus) {
+  static const char fn[] = "PeerToPeer::receiveBatch";
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: enter; jniHandle: %u  bufferLen: %u  maxSdus: %u", fn, jniHandle,
+      bufferLen, maxSdus);
+  sp<NfaConn> pConn = NULL;
+  tNFA_STATUS stat = NFA_STATUS_FAILED;
+  uint32_t actualDataLen = 0;
+  uint32_t offset = 0;
+  bool isMoreData = false;
+
+  numSdus = 0;
+  if ((maxSdus == 0) || (bufferLen == 0)) return (false);
+
+  if ((pConn = findConnection(jniHandle)) == NULL) {
+    LOG(ERROR) << StringPrintf("%s: can't find connection handle: %u", fn,
+                               jniHandle);
+    return (false);
+  }
+
+  // Block for the first SDU exactly like receive()
+  while (pConn->mNfaConnHandle != NFA_HANDLE_INVALID) {
+    // NFA_P2pReadData() is synchronous
+    stat = NFA_P2pReadData(pConn->mNfaConnHandle, bufferLen, &actualDataLen,
+                           buffer, &isMoreData);
+    if ((stat == NFA_STATUS_OK) && (actualDataLen > 0)) break;
+    DLOG_IF(INFO, nfc_debug_enabled)
+        << StringPrintf("%s: waiting for data...", fn);
+    {
+      SyncEventGuard guard(pConn->mReadEvent);
+      pConn->mReadEvent.wait();
+    }
+  }  // while
+  if ((stat != NFA_STATUS_OK) || (actualDataLen == 0)) {
+    DLOG_IF(INFO, nfc_debug_enabled)
+        << StringPrintf("%s: exit; connection closed", fn);
+    return (false);
+  }
+  sduLengths[numSdus++] = (uint16_t)actualDataLen;
+  offset = actualDataLen;
+
+  // Drain what is already queued without waiting again. Stop short of a
+  // partial read so that every SDU boundary is preserved.
+  while (isMoreData && (numSdus < maxSdus) &&
+         (offset < bufferLen) && (bufferLen - offset >= pConn->mMaxInfoUnit) &&
+         (pConn->mNfaConnHandle != NFA_HANDLE_INVALID)) {
+    actualDataLen = 0;
+    stat = NFA_P2pReadData(pConn->mNfaConnHandle, bufferLen - offset,
+                           &actualDataLen, buffer + offset, &isMoreData);
+    if ((stat != NFA_STATUS_OK) || (actualDataLen == 0)) break;
+    sduLengths[numSdus++] = (uint16_t)actualDataLen;
+    offset += actualDataLen;
+  }
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: exit; nfa h: 0x%X  sdus: %u  total len: %u  more: %u", fn,
+      pConn->mNfaConnHandle, numSdus, offset, isMoreData);
+  return (true);
+}
+
 /*******************************************************************************
 **
 ** Function:        disconnectConnOriented
@@ -992,7 +1434,7 @@ bool PeerToPeer::disconnectConnOriented(tJNI_HANDLE jniHandle) {
 
   {
     SyncEventGuard guard1(pConn->mCongEvent);
-    pConn->mCongEvent.notifyOne();  // unblock send() if congested
+    pConn->mCongEvent.notifyAll();  // unblock send() if congested
   }
   {
     SyncEventGuard guard2(pConn->mReadEvent);
@@ -1178,36 +1620,37 @@ void PeerToPeer::handleNfcOnOff(bool isOn) {
   AutoMutex mutex(mMutex);
   if (isOn) {
     // Start with no clients or servers
-    memset(mServers, 0, sizeof(mServers));
-    memset(mClients, 0, sizeof(mClients));
+    mServers.clear();
+    mClients.clear();
+    AutoMutex index(mIndexMutex);
+    mIndex.reset(new P2pHandleIndex);
   } else {
     // Disconnect through all the clients
-    for (int ii = 0; ii < sMax; ii++) {
-      if (mClients[ii] != NULL) {
-        if (mClients[ii]->mClientConn->mNfaConnHandle == NFA_HANDLE_INVALID) {
-          SyncEventGuard guard(mClients[ii]->mConnectingEvent);
-          mClients[ii]->mConnectingEvent.notifyOne();
-        } else {
-          mClients[ii]->mClientConn->mNfaConnHandle = NFA_HANDLE_INVALID;
-          {
-            SyncEventGuard guard1(mClients[ii]->mClientConn->mCongEvent);
-            mClients[ii]
-                ->mClientConn->mCongEvent.notifyOne();  // unblock send()
-          }
-          {
-            SyncEventGuard guard2(mClients[ii]->mClientConn->mReadEvent);
-            mClients[ii]
-                ->mClientConn->mReadEvent.notifyOne();  // unblock receive()
-          }
+    for (const sp<P2pClient>& client : mClients) {
+      if (client->mClientConn->mNfaConnHandle == NFA_HANDLE_INVALID) {
+        SyncEventGuard guard(client->mConnectingEvent);
+        client->mConnectingEvent.notifyOne();
+      } else {
+        setNfaHandleLocked(client->mClientConn, NFA_HANDLE_INVALID);
+        {
+          SyncEventGuard guard1(client->mClientConn->mCongEvent);
+          client->mClientConn->mCongEvent.notifyAll();  // unblock send()
+        }
+        {
+          SyncEventGuard guard2(client->mClientConn->mReadEvent);
+          client->mClientConn->mReadEvent.notifyOne();  // unblock receive()
         }
       }
     }  // loop
 
     // Now look through all the server control blocks
-    for (int ii = 0; ii < sMax; ii++) {
-      if (mServers[ii] != NULL) {
-        mServers[ii]->unblockAll();
-      }
+    std::vector<sp<NfaConn>> conns;
+    for (const sp<P2pServer>& server : mServers) {
+      conns.clear();
+      server->getConnections(conns);
+      for (const sp<NfaConn>& conn : conns)
+        setNfaHandleLocked(conn, NFA_HANDLE_INVALID);
+      server->unblockAll();
     }  // loop
   }
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
@@ -1243,16 +1686,14 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent,
           fn, eventData->reg_server.server_handle,
           eventData->reg_server.server_sap, eventData->reg_server.service_name);
 
-      sP2p.mMutex.lock();
-      pSrv = sP2p.findServerLocked(eventData->reg_server.service_name);
-      sP2p.mMutex.unlock();
+      pSrv = sP2p.findServer(eventData->reg_server.service_name);
       if (pSrv == NULL) {
         LOG(ERROR) << StringPrintf(
             "%s: NFA_P2P_REG_SERVER_EVT for unknown service: %s", fn,
             eventData->reg_server.service_name);
       } else {
+        sP2p.setNfaHandle(pSrv, eventData->reg_server.server_handle);
         SyncEventGuard guard(pSrv->mRegServerEvent);
-        pSrv->mNfaP2pServerHandle = eventData->reg_server.server_handle;
         pSrv->mRegServerEvent.notifyOne();  // unblock registerServer()
       }
       break;
@@ -1276,9 +1717,7 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent,
           fn, eventData->conn_req.server_handle,
           eventData->conn_req.conn_handle, eventData->conn_req.remote_sap);
 
-      sP2p.mMutex.lock();
-      pSrv = sP2p.findServerLocked(eventData->conn_req.server_handle);
-      sP2p.mMutex.unlock();
+      pSrv = sP2p.findServer(eventData->conn_req.server_handle);
       if (pSrv == NULL) {
         LOG(ERROR) << StringPrintf("%s: NFA_P2P_CONN_REQ_EVT; unknown server h",
                                    fn);
@@ -1293,8 +1732,8 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent,
         LOG(ERROR) << StringPrintf(
             "%s: NFA_P2P_CONN_REQ_EVT; server not listening", fn);
       } else {
+        sP2p.setNfaHandle(pConn, eventData->conn_req.conn_handle);
         SyncEventGuard guard(pSrv->mConnRequestEvent);
-        pConn->mNfaConnHandle = eventData->conn_req.conn_handle;
         pConn->mRemoteMaxInfoUnit = eventData->conn_req.remote_miu;
         pConn->mRemoteRecvWindow = eventData->conn_req.remote_rw;
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
@@ -1322,7 +1761,7 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent,
             eventData->disc.handle);
       } else {
         sP2p.mDisconnectMutex.lock();
-        pConn->mNfaConnHandle = NFA_HANDLE_INVALID;
+        sP2p.setNfaHandle(pConn, NFA_HANDLE_INVALID);
         {
           DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
               "%s: NFA_P2P_DISC_EVT; try guard disconn event", fn);
@@ -1335,7 +1774,7 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent,
           DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
               "%s: NFA_P2P_DISC_EVT; try guard congest event", fn);
           SyncEventGuard guard1(pConn->mCongEvent);
-          pConn->mCongEvent.notifyOne();  // unblock write (if congested)
+          pConn->mCongEvent.notifyAll();  // unblock write (if congested)
           DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
               "%s: NFA_P2P_DISC_EVT; notified congest event", fn);
         }
@@ -1378,7 +1817,7 @@ void PeerToPeer::nfaServerCallback(tNFA_P2P_EVT p2pEvent,
             eventData->congest.handle, eventData->congest.is_congested);
         if (eventData->congest.is_congested == FALSE) {
           SyncEventGuard guard(pConn->mCongEvent);
-          pConn->mCongEvent.notifyOne();
+          pConn->mCongEvent.notifyAll();
         }
       }
       break;
@@ -1423,8 +1862,8 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent,
             "%s: NFA_P2P_REG_CLIENT_EVT; Conn Handle: 0x%04x, pClient: 0x%p",
             fn, eventData->reg_client.client_handle, pClient.get());
 
+        sP2p.setNfaHandle(pClient, eventData->reg_client.client_handle);
         SyncEventGuard guard(pClient->mRegisteringEvent);
-        pClient->mNfaP2pClientHandle = eventData->reg_client.client_handle;
         pClient->mRegisteringEvent.notifyOne();
       }
       break;
@@ -1462,8 +1901,9 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent,
             eventData->connected.conn_handle, eventData->connected.remote_sap,
             pClient.get());
 
+        sP2p.setNfaHandle(pClient->mClientConn,
+                          eventData->connected.conn_handle);
         SyncEventGuard guard(pClient->mConnectingEvent);
-        pClient->mClientConn->mNfaConnHandle = eventData->connected.conn_handle;
         pClient->mClientConn->mRemoteMaxInfoUnit =
             eventData->connected.remote_miu;
         pClient->mClientConn->mRemoteRecvWindow =
@@ -1490,7 +1930,7 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent,
         pClient->mConnectingEvent.notifyOne();
       } else {
         sP2p.mDisconnectMutex.lock();
-        pConn->mNfaConnHandle = NFA_HANDLE_INVALID;
+        sP2p.setNfaHandle(pConn, NFA_HANDLE_INVALID);
         {
           DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
               "%s: NFA_P2P_DISC_EVT; try guard disconn event", fn);
@@ -1503,7 +1943,7 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent,
           DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
               "%s: NFA_P2P_DISC_EVT; try guard congest event", fn);
           SyncEventGuard guard1(pConn->mCongEvent);
-          pConn->mCongEvent.notifyOne();  // unblock write (if congested)
+          pConn->mCongEvent.notifyAll();  // unblock write (if congested)
           DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
               "%s: NFA_P2P_DISC_EVT; notified congest event", fn);
         }
@@ -1546,7 +1986,7 @@ void PeerToPeer::nfaClientCallback(tNFA_P2P_EVT p2pEvent,
             eventData->congest.handle, eventData->congest.is_congested);
 
         SyncEventGuard guard(pConn->mCongEvent);
-        pConn->mCongEvent.notifyOne();
+        pConn->mCongEvent.notifyAll();
       }
       break;
 
@@ -1611,8 +2051,6 @@ PeerToPeer::tJNI_HANDLE PeerToPeer::getNewJniHandle() {
 P2pServer::P2pServer(PeerToPeer::tJNI_HANDLE jniHandle, const char* serviceName)
     : mNfaP2pServerHandle(NFA_HANDLE_INVALID), mJniHandle(jniHandle) {
   mServiceName.assign(serviceName);
-
-  memset(mServerConn, 0, sizeof(mServerConn));
 }
 
 bool P2pServer::registerWithStack() {
@@ -1671,17 +2109,11 @@ bool P2pServer::registerWithStack() {
 }
 
 bool P2pServer::accept(PeerToPeer::tJNI_HANDLE serverJniHandle,
-                       PeerToPeer::tJNI_HANDLE connJniHandle, int maxInfoUnit,
+                       const sp<NfaConn>& connection, int maxInfoUnit,
                        int recvWindow) {
   static const char fn[] = "P2pServer::accept";
   tNFA_STATUS nfaStat = NFA_STATUS_OK;
-
-  sp<NfaConn> connection = allocateConnection(connJniHandle);
-  if (connection == NULL) {
-    LOG(ERROR) << StringPrintf("%s: failed to allocate new server connection",
-                               fn);
-    return false;
-  }
+  PeerToPeer::tJNI_HANDLE connJniHandle = connection->mJniHandle;
 
   {
     // Wait for NFA_P2P_CONN_REQ_EVT or NFA_NDEF_DATA_EVT when remote device
@@ -1733,34 +2165,39 @@ bool P2pServer::accept(PeerToPeer::tJNI_HANDLE serverJniHandle,
 
 void P2pServer::unblockAll() {
   AutoMutex mutex(mMutex);
-  for (int jj = 0; jj < MAX_NFA_CONNS_PER_SERVER; jj++) {
-    if (mServerConn[jj] != NULL) {
-      mServerConn[jj]->mNfaConnHandle = NFA_HANDLE_INVALID;
-      {
-        SyncEventGuard guard1(mServerConn[jj]->mCongEvent);
-        mServerConn[jj]
-            ->mCongEvent.notifyOne();  // unblock write (if congested)
-      }
-      {
-        SyncEventGuard guard2(mServerConn[jj]->mReadEvent);
-        mServerConn[jj]->mReadEvent.notifyOne();  // unblock receive()
-      }
+  for (const sp<NfaConn>& conn : mServerConn) {
+    {
+      SyncEventGuard guard1(conn->mCongEvent);
+      conn->mCongEvent.notifyAll();  // unblock write (if congested)
+    }
+    {
+      SyncEventGuard guard2(conn->mReadEvent);
+      conn->mReadEvent.notifyOne();  // unblock receive()
     }
   }
 }
 
 sp<NfaConn> P2pServer::allocateConnection(PeerToPeer::tJNI_HANDLE jniHandle) {
   AutoMutex mutex(mMutex);
-  // First, find a free connection block to handle the connection
-  for (int ii = 0; ii < MAX_NFA_CONNS_PER_SERVER; ii++) {
-    if (mServerConn[ii] == NULL) {
-      mServerConn[ii] = new NfaConn;
-      mServerConn[ii]->mJniHandle = jniHandle;
-      return mServerConn[ii];
-    }
-  }
+  sp<NfaConn> conn = new NfaConn;
+  conn->mJniHandle = jniHandle;
+  mServerConn.push_back(conn);
+  return conn;
+}
 
-  return NULL;
+/*******************************************************************************
+**
+** Function:        getConnections
+**
+** Description:     Append all server connections to a list.
+**                  conns: List to append to.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void P2pServer::getConnections(std::vector<sp<NfaConn>>& conns) {
+  AutoMutex mutex(mMutex);
+  conns.insert(conns.end(), mServerConn.begin(), mServerConn.end());
 }
 
 /*******************************************************************************
@@ -1774,13 +2211,9 @@ sp<NfaConn> P2pServer::allocateConnection(PeerToPeer::tJNI_HANDLE jniHandle) {
 **
 *******************************************************************************/
 sp<NfaConn> P2pServer::findServerConnection(tNFA_HANDLE nfaConnHandle) {
-  int jj = 0;
-
   AutoMutex mutex(mMutex);
-  for (jj = 0; jj < MAX_NFA_CONNS_PER_SERVER; jj++) {
-    if ((mServerConn[jj] != NULL) &&
-        (mServerConn[jj]->mNfaConnHandle == nfaConnHandle))
-      return (mServerConn[jj]);
+  for (const sp<NfaConn>& conn : mServerConn) {
+    if (conn->mNfaConnHandle == nfaConnHandle) return (conn);
   }
 
   // If here, not found
@@ -1798,12 +2231,9 @@ sp<NfaConn> P2pServer::findServerConnection(tNFA_HANDLE nfaConnHandle) {
 **
 *******************************************************************************/
 sp<NfaConn> P2pServer::findServerConnection(PeerToPeer::tJNI_HANDLE jniHandle) {
-  int jj = 0;
-
   AutoMutex mutex(mMutex);
-  for (jj = 0; jj < MAX_NFA_CONNS_PER_SERVER; jj++) {
-    if ((mServerConn[jj] != NULL) && (mServerConn[jj]->mJniHandle == jniHandle))
-      return (mServerConn[jj]);
+  for (const sp<NfaConn>& conn : mServerConn) {
+    if (conn->mJniHandle == jniHandle) return (conn);
   }
 
   // If here, not found
@@ -1821,13 +2251,10 @@ sp<NfaConn> P2pServer::findServerConnection(PeerToPeer::tJNI_HANDLE jniHandle) {
 **
 *******************************************************************************/
 bool P2pServer::removeServerConnection(PeerToPeer::tJNI_HANDLE jniHandle) {
-  int jj = 0;
-
   AutoMutex mutex(mMutex);
-  for (jj = 0; jj < MAX_NFA_CONNS_PER_SERVER; jj++) {
-    if ((mServerConn[jj] != NULL) &&
-        (mServerConn[jj]->mJniHandle == jniHandle)) {
-      mServerConn[jj] = NULL;
+  for (auto it = mServerConn.begin(); it != mServerConn.end(); ++it) {
+    if ((*it)->mJniHandle == jniHandle) {
+      mServerConn.erase(it);
       return true;
     }
   }
@@ -1881,4 +2308,6 @@ NfaConn::NfaConn()
       mMaxInfoUnit(0),
       mRecvWindow(0),
       mRemoteMaxInfoUnit(0),
-      mRemoteRecvWindow(0) {}
+      mRemoteRecvWindow(0),
+      mTxBusy(false),
+      mTxFailed(false) {}
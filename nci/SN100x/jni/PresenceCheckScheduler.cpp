@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *  Decide which presence checks need to go over RF.
+ */
+
+#include "PresenceCheckScheduler.h"
+#include <android-base/stringprintf.h>
+#include <base/logging.h>
+#include <time.h>
+#include <algorithm>
+
+using android::base::StringPrintf;
+
+extern bool nfc_debug_enabled;
+
+namespace {
+// Each idle RF check doubles the window, up to this many times
+const uint32_t MAX_IDLE_SHIFT = 2;
+// Idle growth never takes the window past this
+const uint32_t MAX_WINDOW_MS = 1000;
+}  // namespace
+
+/*******************************************************************************
+**
+** Function:        PresenceCheckScheduler
+**
+** Description:     Initialize member variables.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+PresenceCheckScheduler::PresenceCheckScheduler()
+    : mProofValid(false),
+      mLastProofMs(0),
+      mIdleChecks(0),
+      mInFlight(false),
+      mGeneration(0),
+      mEpoch(0),
+      mLastResult(false),
+      mRfChecks(0),
+      mSkipped(0),
+      mCoalesced(0) {}
+
+/*******************************************************************************
+**
+** Function:        getInstance
+**
+** Description:     Get the singleton of this object.
+**
+** Returns:         Reference to this object.
+**
+*******************************************************************************/
+PresenceCheckScheduler& PresenceCheckScheduler::getInstance() {
+  static PresenceCheckScheduler sScheduler;
+  return sScheduler;
+}
+
+uint64_t PresenceCheckScheduler::nowMs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*******************************************************************************
+**
+** Function:        reset
+**
+** Description:     Forget what is known about the tag.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void PresenceCheckScheduler::reset() {
+  SyncEventGuard guard(mEvent);
+  mProofValid = false;
+  mIdleChecks = 0;
+  // a check still on the air was for the previous tag
+  mEpoch++;
+}
+
+/*******************************************************************************
+**
+** Function:        notePresent
+**
+** Description:     Record that the tag just answered a command.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void PresenceCheckScheduler::notePresent() {
+  SyncEventGuard guard(mEvent);
+  mProofValid = true;
+  mLastProofMs = nowMs();
+  mIdleChecks = 0;
+}
+
+/*******************************************************************************
+**
+** Function:        check
+**
+** Description:     Answer a presence check, over RF only if needed.
+**
+** Returns:         True if the tag is present.
+**
+*******************************************************************************/
+bool PresenceCheckScheduler::check(uint32_t windowMs, const Check_t& rfCheck) {
+  static const char fn[] = "PresenceCheckScheduler::check";
+  bool present = false;
+
+  mEvent.start();
+  while (mInFlight) {
+    uint32_t generation = mGeneration;
+    uint32_t waitEpoch = mEpoch;
+    mCoalesced++;
+    while (generation == mGeneration) mEvent.wait();
+    // a reset while waiting means the shared result was for the previous tag
+    if (waitEpoch != mEpoch) {
+      DLOG_IF(INFO, nfc_debug_enabled)
+          << StringPrintf("%s: tag changed during shared check", fn);
+      continue;
+    }
+    present = mLastResult;
+    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+        "%s: shared check on the air; present=%u; coalesced=%u", fn, present,
+        mCoalesced);
+    mEvent.end();
+    return present;
+  }
+
+  uint64_t window = std::min<uint64_t>(
+      (uint64_t)windowMs << mIdleChecks,
+      std::max(windowMs, MAX_WINDOW_MS));
+  uint64_t now = nowMs();
+  if (mProofValid && (now - mLastProofMs < window)) {
+    mSkipped++;
+    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+        "%s: answered %u ms ago; window=%u ms; skipped=%u", fn,
+        (uint32_t)(now - mLastProofMs), (uint32_t)window, mSkipped);
+    mEvent.end();
+    return true;
+  }
+  uint32_t epoch = mEpoch;
+  mInFlight = true;
+  mEvent.end();
+
+  present = rfCheck();
+
+  mEvent.start();
+  mInFlight = false;
+  mLastResult = present;
+  mGeneration++;
+  mRfChecks++;
+  if (epoch == mEpoch) {
+    mProofValid = present;
+    mLastProofMs = nowMs();
+    mIdleChecks = present ? std::min(mIdleChecks + 1, MAX_IDLE_SHIFT) : 0;
+  }
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: present=%u; rf=%u skipped=%u coalesced=%u", fn, present, mRfChecks,
+      mSkipped, mCoalesced);
+  mEvent.notifyAll();
+  mEvent.end();
+  return present;
+}
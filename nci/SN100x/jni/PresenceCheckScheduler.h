@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *  Decide which presence checks need to go over RF.
+ *
+ *  The NFC service asks for a presence check at a fixed cadence.  A tag that
+ *  answered a moment ago is known to be in the field, so a check inside its
+ *  technology's window is answered without RF; the window grows while the
+ *  tag sits idle.  Callers that arrive while a check is on the air wait for
+ *  that check and share its result.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include "SyncEvent.h"
+
+class PresenceCheckScheduler {
+ public:
+  typedef std::function<bool()> Check_t;
+
+  /*******************************************************************************
+  **
+  ** Function:        getInstance
+  **
+  ** Description:     Get the singleton of this object.
+  **
+  ** Returns:         Reference to this object.
+  **
+  *******************************************************************************/
+  static PresenceCheckScheduler& getInstance();
+
+  /*******************************************************************************
+  **
+  ** Function:        reset
+  **
+  ** Description:     Forget what is known about the tag; call when a tag is
+  **                  activated.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  void reset();
+
+  /*******************************************************************************
+  **
+  ** Function:        notePresent
+  **
+  ** Description:     Record that the tag just answered a command.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  void notePresent();
+
+  /*******************************************************************************
+  **
+  ** Function:        check
+  **
+  ** Description:     Answer a presence check.  Returns at once if the tag
+  **                  answered within the window, waits for the check on the
+  **                  air if there is one, and otherwise runs rfCheck.
+  **                  windowMs: How long an answer proves presence for this
+  **                            technology.
+  **                  rfCheck: Presence check over RF; true if present.
+  **
+  ** Returns:         True if the tag is present.
+  **
+  *******************************************************************************/
+  bool check(uint32_t windowMs, const Check_t& rfCheck);
+
+ private:
+  PresenceCheckScheduler();
+
+  static uint64_t nowMs();
+
+  // Protected by mEvent
+  SyncEvent mEvent;
+  bool mProofValid;
+  uint64_t mLastProofMs;
+  uint32_t mIdleChecks;
+  bool mInFlight;
+  uint32_t mGeneration;
+  uint32_t mEpoch;
+  bool mLastResult;
+  uint32_t mRfChecks;
+  uint32_t mSkipped;
+  uint32_t mCoalesced;
+};
@@ -27,8 +27,13 @@
 #include <base/logging.h>
 #include <nativehelper/JNIHelp.h>
 #include <nativehelper/ScopedLocalRef.h>
+#include <nativehelper/ScopedPrimitiveArray.h>
+#include <time.h>
+#include <new>
 
 #include "JavaClassConstants.h"
+#include "JniEventDispatcher.h"
+#include "LmrtPlanner.h"
 #include "RoutingManager.h"
 #include "nfa_ce_api.h"
 #include "nfa_ee_api.h"
@@ -53,7 +58,9 @@ const JNINativeMethod RoutingManager::sMethods[] = {
          com_android_nfc_cardemulation_doGetDefaultOffHostRouteDestination},
     {"doGetAidMatchingMode", "()I",
      (void*)
-         RoutingManager::com_android_nfc_cardemulation_doGetAidMatchingMode}};
+         RoutingManager::com_android_nfc_cardemulation_doGetAidMatchingMode},
+    {"doPlanAidRouting", "([B[III)[I",
+     (void*)RoutingManager::com_android_nfc_cardemulation_doPlanAidRouting}};
 
 static const int MAX_NUM_EE = 5;
 // SCBR from host works only when App is in foreground
@@ -109,6 +116,17 @@ RoutingManager::RoutingManager() {
   mIsScbrSupported = false;
 
   mNfcFOnDhHandle = NFA_HANDLE_INVALID;
+  mNativeData = NULL;
+  mHceSlots = NULL;
+  mHceHead = 0;
+  mHceCount = 0;
+  memset(mHceLatency, 0, sizeof(mHceLatency));
+  mHceJavaSelected = true;
+  mHceSelectLen = 0;
+#if (NXP_EXTNS == TRUE)
+  mAidAddPending = 0;
+  mAidAddFailed = 0;
+#endif
 }
 
 RoutingManager::~RoutingManager() { NFA_EeDeregister(nfaEeCallback); }
@@ -130,7 +148,7 @@ bool RoutingManager::initialize(nfc_jni_native_data* native) {
     mEeRegisterEvent.wait();
   }
 
-  mRxDataBuffer.clear();
+  allocHceSlots();
 #if (NXP_EXTNS == TRUE)
     memset(&gRouteInfo, 0x00, sizeof(RouteInfo_t));
     unsigned long tech = 0;
@@ -235,6 +253,13 @@ bool RoutingManager::initialize(nfc_jni_native_data* native) {
       }
     }
   }
+  {
+    // The stack starts with empty default routing after NFC is enabled, and
+    // the UICC routes above were not staged
+    SyncEventGuard guard(mRoutingEvent);
+    mLmrtStaged.clear();
+    mLmrtCommitted.clear();
+  }
 
   // Tell the host-routing to only listen on Nfc-A
 #if (NXP_EXTNS == TRUE)
@@ -298,148 +323,275 @@ RoutingManager& RoutingManager::getInstance() {
 }
 
 void RoutingManager::enableRoutingToHost() {
-  tNFA_STATUS nfaStat;
   tNFA_TECHNOLOGY_MASK techMask;
   tNFA_PROTOCOL_MASK protoMask;
-  SyncEventGuard guard(mRoutingEvent);
+  {
+    SyncEventGuard guard(mRoutingEvent);
 
-  // Set default routing at one time when the NFCEE IDs for Nfc-A and Nfc-F are
-  // same
-  if (mDefaultEe == mDefaultFelicaRoute) {
-    // Route Nfc-A/Nfc-F to host if we don't have a SE
-    techMask = (mSeTechMask ^ (NFA_TECHNOLOGY_MASK_A | NFA_TECHNOLOGY_MASK_F));
-    if (techMask != 0) {
-      nfaStat = NFA_EeSetDefaultTechRouting(mDefaultEe, techMask, 0, 0,
-                                            techMask, techMask, techMask);
-      if (nfaStat == NFA_STATUS_OK)
-        mRoutingEvent.wait();
+    // Set default routing at one time when the NFCEE IDs for Nfc-A and Nfc-F
+    // are same
+    if (mDefaultEe == mDefaultFelicaRoute) {
+      // Route Nfc-A/Nfc-F to host if we don't have a SE
+      techMask =
+          (mSeTechMask ^ (NFA_TECHNOLOGY_MASK_A | NFA_TECHNOLOGY_MASK_F));
+      if (techMask != 0) {
+        const tNFA_TECHNOLOGY_MASK tech[LMRT_POWER_STATES] = {
+            techMask, 0, 0, techMask, techMask, techMask};
+        stageTechRouting(mDefaultEe, tech);
+      }
+      // Default routing for IsoDep and T3T protocol
+      if (mIsScbrSupported)
+        protoMask = NFA_PROTOCOL_MASK_ISO_DEP;
       else
-        LOG(ERROR) << StringPrintf(
-            "Fail to set default tech routing for Nfc-A/Nfc-F");
-    }
-    // Default routing for IsoDep and T3T protocol
-    if (mIsScbrSupported)
-      protoMask = NFA_PROTOCOL_MASK_ISO_DEP;
-    else
-      protoMask = (NFA_PROTOCOL_MASK_ISO_DEP | NFA_PROTOCOL_MASK_T3T);
+        protoMask = (NFA_PROTOCOL_MASK_ISO_DEP | NFA_PROTOCOL_MASK_T3T);
 
-    nfaStat = NFA_EeSetDefaultProtoRouting(
-        mDefaultEe, protoMask, 0, 0, protoMask, mDefaultEe ? protoMask : 0,
-        mDefaultEe ? protoMask : 0);
-    if (nfaStat == NFA_STATUS_OK)
-      mRoutingEvent.wait();
-    else
-      LOG(ERROR) << StringPrintf(
-          "Fail to set default proto routing for protocol: 0x%x", protoMask);
-  } else {
-    // Route Nfc-A to host if we don't have a SE
-    techMask = NFA_TECHNOLOGY_MASK_A;
-    if ((mSeTechMask & NFA_TECHNOLOGY_MASK_A) == 0) {
-      nfaStat = NFA_EeSetDefaultTechRouting(mDefaultEe, techMask, 0, 0,
-                                            techMask, techMask, techMask);
-      if (nfaStat == NFA_STATUS_OK)
-        mRoutingEvent.wait();
-      else
-        LOG(ERROR) << StringPrintf(
-            "Fail to set default tech routing for Nfc-A");
-    }
-    // Default routing for IsoDep protocol
-    protoMask = NFA_PROTOCOL_MASK_ISO_DEP;
-    nfaStat = NFA_EeSetDefaultProtoRouting(
-        mDefaultEe, protoMask, 0, 0, protoMask, mDefaultEe ? protoMask : 0,
-        mDefaultEe ? protoMask : 0);
-    if (nfaStat == NFA_STATUS_OK)
-      mRoutingEvent.wait();
-    else
-      LOG(ERROR) << StringPrintf(
-          "Fail to set default proto routing for IsoDep");
-
-    // Route Nfc-F to host if we don't have a SE
-    techMask = NFA_TECHNOLOGY_MASK_F;
-    if ((mSeTechMask & NFA_TECHNOLOGY_MASK_F) == 0) {
-      nfaStat = NFA_EeSetDefaultTechRouting(mDefaultFelicaRoute, techMask, 0, 0,
-                                            techMask, techMask, techMask);
-      if (nfaStat == NFA_STATUS_OK)
-        mRoutingEvent.wait();
-      else
-        LOG(ERROR) << StringPrintf(
-            "Fail to set default tech routing for Nfc-F");
-    }
-    // Default routing for T3T protocol
-    if (!mIsScbrSupported) {
-      protoMask = NFA_PROTOCOL_MASK_T3T;
-      nfaStat =
-          NFA_EeSetDefaultProtoRouting(NFC_DH_ID, protoMask, 0, 0, 0, 0, 0);
-      if (nfaStat == NFA_STATUS_OK)
-        mRoutingEvent.wait();
-      else
-        LOG(ERROR) << StringPrintf("Fail to set default proto routing for T3T");
+      const tNFA_PROTOCOL_MASK screenOff = mDefaultEe ? protoMask : 0;
+      const tNFA_PROTOCOL_MASK proto[LMRT_POWER_STATES] = {
+          protoMask, 0, 0, protoMask, screenOff, screenOff};
+      stageProtoRouting(mDefaultEe, proto);
+    } else {
+      // Route Nfc-A to host if we don't have a SE
+      techMask = NFA_TECHNOLOGY_MASK_A;
+      if ((mSeTechMask & NFA_TECHNOLOGY_MASK_A) == 0) {
+        const tNFA_TECHNOLOGY_MASK tech[LMRT_POWER_STATES] = {
+            techMask, 0, 0, techMask, techMask, techMask};
+        stageTechRouting(mDefaultEe, tech);
+      }
+      // Default routing for IsoDep protocol
+      protoMask = NFA_PROTOCOL_MASK_ISO_DEP;
+      const tNFA_PROTOCOL_MASK screenOff = mDefaultEe ? protoMask : 0;
+      const tNFA_PROTOCOL_MASK proto[LMRT_POWER_STATES] = {
+          protoMask, 0, 0, protoMask, screenOff, screenOff};
+      stageProtoRouting(mDefaultEe, proto);
+
+      // Route Nfc-F to host if we don't have a SE
+      techMask = NFA_TECHNOLOGY_MASK_F;
+      if ((mSeTechMask & NFA_TECHNOLOGY_MASK_F) == 0) {
+        const tNFA_TECHNOLOGY_MASK tech[LMRT_POWER_STATES] = {
+            techMask, 0, 0, techMask, techMask, techMask};
+        stageTechRouting(mDefaultFelicaRoute, tech);
+      }
+      // Default routing for T3T protocol
+      if (!mIsScbrSupported) {
+        const tNFA_PROTOCOL_MASK t3t[LMRT_POWER_STATES] = {
+            NFA_PROTOCOL_MASK_T3T, 0, 0, 0, 0, 0};
+        stageProtoRouting(NFC_DH_ID, t3t);
+      }
     }
   }
+  flushDefaultRouting();
 }
 
 void RoutingManager::disableRoutingToHost() {
-  tNFA_STATUS nfaStat;
   tNFA_TECHNOLOGY_MASK techMask;
-  SyncEventGuard guard(mRoutingEvent);
+  const uint8_t none[LMRT_POWER_STATES] = {0};
+  {
+    SyncEventGuard guard(mRoutingEvent);
 
-  // Set default routing at one time when the NFCEE IDs for Nfc-A and Nfc-F are
-  // same
-  if (mDefaultEe == mDefaultFelicaRoute) {
-    // Default routing for Nfc-A/Nfc-F technology if we don't have a SE
-    techMask = (mSeTechMask ^ (NFA_TECHNOLOGY_MASK_A | NFA_TECHNOLOGY_MASK_F));
-    if (techMask != 0) {
-      nfaStat = NFA_EeSetDefaultTechRouting(mDefaultEe, 0, 0, 0, 0, 0, 0);
-      if (nfaStat == NFA_STATUS_OK)
-        mRoutingEvent.wait();
-      else
-        LOG(ERROR) << StringPrintf(
-            "Fail to set default tech routing for Nfc-A/Nfc-F");
+    // Set default routing at one time when the NFCEE IDs for Nfc-A and Nfc-F
+    // are same
+    if (mDefaultEe == mDefaultFelicaRoute) {
+      // Default routing for Nfc-A/Nfc-F technology if we don't have a SE
+      techMask =
+          (mSeTechMask ^ (NFA_TECHNOLOGY_MASK_A | NFA_TECHNOLOGY_MASK_F));
+      if (techMask != 0) stageTechRouting(mDefaultEe, none);
+      // Default routing for IsoDep
+      stageProtoRouting(mDefaultEe, none);
+    } else {
+      // Default routing for Nfc-A technology if we don't have a SE
+      if ((mSeTechMask & NFA_TECHNOLOGY_MASK_A) == 0)
+        stageTechRouting(mDefaultEe, none);
+      // Default routing for IsoDep protocol
+      stageProtoRouting(mDefaultEe, none);
+
+      // Default routing for Nfc-F technology if we don't have a SE
+      if ((mSeTechMask & NFA_TECHNOLOGY_MASK_F) == 0)
+        stageTechRouting(mDefaultFelicaRoute, none);
+      // Default routing for T3T protocol
+      if (!mIsScbrSupported) stageProtoRouting(NFC_DH_ID, none);
     }
-    // Default routing for IsoDep
-    nfaStat = NFA_EeSetDefaultProtoRouting(mDefaultEe, 0, 0, 0, 0, 0, 0);
-    if (nfaStat == NFA_STATUS_OK)
-      mRoutingEvent.wait();
-    else
-      LOG(ERROR) << StringPrintf(
-          "Fail to set default proto routing for IsoDep");
-  } else {
-    // Default routing for Nfc-A technology if we don't have a SE
-    if ((mSeTechMask & NFA_TECHNOLOGY_MASK_A) == 0) {
-      nfaStat = NFA_EeSetDefaultTechRouting(mDefaultEe, 0, 0, 0, 0, 0, 0);
-      if (nfaStat == NFA_STATUS_OK)
-        mRoutingEvent.wait();
-      else
-        LOG(ERROR) << StringPrintf(
-            "Fail to set default tech routing for Nfc-A");
+  }
+  flushDefaultRouting();
+}
+
+/*******************************************************************************
+**
+** Function:        stageTechRouting
+**
+** Description:     Record the default technology routing wanted for an NFCEE.
+**                  Nothing is sent until flushDefaultRouting().
+**                  Caller holds mRoutingEvent.
+**                  nfceeID: NFCEE ID.
+**                  masks: One technology mask per power state.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void RoutingManager::stageTechRouting(uint16_t nfceeID,
+                                      const tNFA_TECHNOLOGY_MASK* masks) {
+  LmrtRoute_t& route = mLmrtStaged[nfceeID];
+  route.hasTech = true;
+  memcpy(route.tech, masks, sizeof(route.tech));
+}
+
+/*******************************************************************************
+**
+** Function:        stageProtoRouting
+**
+** Description:     Record the default protocol routing wanted for an NFCEE.
+**                  Nothing is sent until flushDefaultRouting().
+**                  Caller holds mRoutingEvent.
+**                  nfceeID: NFCEE ID.
+**                  masks: One protocol mask per power state.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void RoutingManager::stageProtoRouting(uint16_t nfceeID,
+                                       const tNFA_PROTOCOL_MASK* masks) {
+  LmrtRoute_t& route = mLmrtStaged[nfceeID];
+  route.hasProto = true;
+  memcpy(route.proto, masks, sizeof(route.proto));
+}
+
+/*******************************************************************************
+**
+** Function:        flushDefaultRouting
+**
+** Description:     Hand the staged default routing to the stack.  Entries
+**                  equal to what the stack last accepted for the same NFCEE
+**                  are skipped, so enabling or disabling host routing again
+**                  costs no commands.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void RoutingManager::flushDefaultRouting() {
+  static const char fn[] = "RoutingManager::flushDefaultRouting";
+  tNFA_STATUS nfaStat = NFA_STATUS_FAILED;
+  int sent = 0, skipped = 0;
+
+  SyncEventGuard guard(mRoutingEvent);
+  for (auto& staged : mLmrtStaged) {
+    const uint16_t nfceeID = staged.first;
+    const LmrtRoute_t& want = staged.second;
+    auto it = mLmrtCommitted.find(nfceeID);
+    LmrtRoute_t* have = (it == mLmrtCommitted.end()) ? NULL : &it->second;
+
+    if (want.hasTech) {
+      if (have && have->hasTech &&
+          !memcmp(have->tech, want.tech, sizeof(want.tech))) {
+        skipped++;
+      } else {
+        nfaStat = NFA_EeSetDefaultTechRouting(
+            nfceeID, want.tech[0], want.tech[1], want.tech[2], want.tech[3],
+            want.tech[4], want.tech[5]);
+        if (nfaStat == NFA_STATUS_OK) {
+          mRoutingEvent.wait();
+          LmrtRoute_t& done = mLmrtCommitted[nfceeID];
+          done.hasTech = true;
+          memcpy(done.tech, want.tech, sizeof(done.tech));
+          sent++;
+        } else {
+          LOG(ERROR) << StringPrintf(
+              "%s: fail to set default tech routing to 0x%x", fn, nfceeID);
+        }
+        it = mLmrtCommitted.find(nfceeID);
+        have = (it == mLmrtCommitted.end()) ? NULL : &it->second;
+      }
     }
-    // Default routing for IsoDep protocol
-    nfaStat = NFA_EeSetDefaultProtoRouting(mDefaultEe, 0, 0, 0, 0, 0, 0);
-    if (nfaStat == NFA_STATUS_OK)
-      mRoutingEvent.wait();
-    else
-      LOG(ERROR) << StringPrintf(
-          "Fail to set default proto routing for IsoDep");
-
-    // Default routing for Nfc-F technology if we don't have a SE
-    if ((mSeTechMask & NFA_TECHNOLOGY_MASK_F) == 0) {
-      nfaStat =
-          NFA_EeSetDefaultTechRouting(mDefaultFelicaRoute, 0, 0, 0, 0, 0, 0);
-      if (nfaStat == NFA_STATUS_OK)
-        mRoutingEvent.wait();
-      else
-        LOG(ERROR) << StringPrintf(
-            "Fail to set default tech routing for Nfc-F");
+    if (want.hasProto) {
+      if (have && have->hasProto &&
+          !memcmp(have->proto, want.proto, sizeof(want.proto))) {
+        skipped++;
+      } else {
+        nfaStat = NFA_EeSetDefaultProtoRouting(
+            nfceeID, want.proto[0], want.proto[1], want.proto[2],
+            want.proto[3], want.proto[4], want.proto[5]);
+        if (nfaStat == NFA_STATUS_OK) {
+          mRoutingEvent.wait();
+          LmrtRoute_t& done = mLmrtCommitted[nfceeID];
+          done.hasProto = true;
+          memcpy(done.proto, want.proto, sizeof(done.proto));
+          sent++;
+        } else {
+          LOG(ERROR) << StringPrintf(
+              "%s: fail to set default proto routing to 0x%x", fn, nfceeID);
+        }
+      }
     }
-    // Default routing for T3T protocol
-    if (!mIsScbrSupported) {
-      nfaStat = NFA_EeSetDefaultProtoRouting(NFC_DH_ID, 0, 0, 0, 0, 0, 0);
-      if (nfaStat == NFA_STATUS_OK)
-        mRoutingEvent.wait();
-      else
-        LOG(ERROR) << StringPrintf("Fail to set default proto routing for T3T");
+  }
+  mLmrtStaged.clear();
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: entries sent: %d  unchanged: %d", fn, sent, skipped);
+}
+
+/*******************************************************************************
+**
+** Function:        forgetDefaultRouting
+**
+** Description:     Send anything staged, then drop the record of what the
+**                  stack holds.  Called before default routing is written
+**                  around the staging table, or when the stack was reset, so
+**                  the next flush resends every entry.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void RoutingManager::forgetDefaultRouting() {
+  flushDefaultRouting();
+  SyncEventGuard guard(mRoutingEvent);
+  mLmrtCommitted.clear();
+}
+
+/*******************************************************************************
+**
+** Function:        addFixedLmrtEntries
+**
+** Description:     Account for the technology, protocol and system code
+**                  entries that share the routing table with the AIDs.
+**                  The stack sends one entry per technology or protocol
+**                  routed to an NFCEE in any power state, and one per
+**                  registered system code.  Masks written to one NFCEE by
+**                  more than one path are merged, so the count can only be
+**                  too high, never too low.
+**                  planner: Receives the entries.
+**
+** Returns:         None
+**
+*******************************************************************************/
+void RoutingManager::addFixedLmrtEntries(LmrtPlanner& planner) {
+  map<uint16_t, pair<tNFA_TECHNOLOGY_MASK, tNFA_PROTOCOL_MASK> > masks;
+  uint32_t sysCodes = 0;
+  {
+    SyncEventGuard guard(mRoutingEvent);
+    for (auto& committed : mLmrtCommitted) {
+      auto& mask = masks[committed.first];
+      for (int xx = 0; xx < LMRT_POWER_STATES; xx++) {
+        if (committed.second.hasTech) mask.first |= committed.second.tech[xx];
+        if (committed.second.hasProto)
+          mask.second |= committed.second.proto[xx];
+      }
+    }
+#if (NXP_EXTNS == TRUE)
+    for (int xx = 0; xx < gRouteInfo.num_entries; xx++) {
+      const ProtoRoutInfo_t& info = gRouteInfo.protoInfo[xx];
+      masks[info.ee_handle].second |=
+          info.protocols_switch_on | info.protocols_switch_off |
+          info.protocols_battery_off | info.protocols_screen_lock |
+          info.protocols_screen_off | info.protocols_screen_off_lock;
+    }
+#endif
+    if (mIsScbrSupported) sysCodes = 1 + mMapScbrHandle.size();
+  }
+
+  for (auto& mask : masks) {
+    for (uint8_t bit = 0x01; bit != 0; bit <<= 1) {
+      if (mask.second.first & bit) planner.addTech();
+      if (mask.second.second & bit) planner.addProto();
     }
   }
+  while (sysCodes-- > 0) planner.addSystemCode();
 }
 
 #if(NXP_EXTNS == TRUE)
@@ -477,6 +629,97 @@ bool RoutingManager::addAidRouting(const uint8_t* aid, uint8_t aidLen,
 }
 
 
+#if (NXP_EXTNS == TRUE)
+/*******************************************************************************
+**
+** Function:        addAidRoutingBatch
+**
+** Description:     Route a whole set of AIDs.  Checks the set against the
+**                  space left in the AID routing table first, then submits
+**                  the entries back to back and waits for the responses
+**                  together instead of one round trip per AID.
+**                  table: Packed entries, each
+**                         aidLen(1) | aid(aidLen) | route(1) | power(1) |
+**                         aidInfo(1).
+**                  tableLen: Length of table.
+**                  count: Number of entries in table.
+**
+** Returns:         True if every AID was routed and accepted.
+**
+*******************************************************************************/
+bool RoutingManager::addAidRoutingBatch(const uint8_t* table,
+                                        uint32_t tableLen, uint32_t count) {
+  static const char fn[] = "RoutingManager::addAidRoutingBatch";
+  // Bytes an AID entry takes in the table: TAG + LENGTH + ROUTE + POWER
+  static const uint32_t kAidHeaderLen = 4;
+  // Requests outstanding in the stack at once, so a large set does not
+  // drain the stack's message buffers
+  static const uint32_t kMaxAidsInFlight = 32;
+  static const long kAidRspTimeoutMs = 1000;
+  SecureElement& se = SecureElement::getInstance();
+  uint32_t needed = 0, offset = 0, routed = 0;
+
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: enter; count: %u", fn, count);
+  // Validate the layout and size the set before touching the table
+  for (uint32_t xx = 0; xx < count; xx++) {
+    if ((offset >= tableLen) || (offset + 1 + table[offset] + 3 > tableLen)) {
+      LOG(ERROR) << StringPrintf("%s: malformed entry %u", fn, xx);
+      return false;
+    }
+    needed += table[offset] + kAidHeaderLen;
+    offset += 1 + table[offset] + 3;
+  }
+  uint32_t remaining = NFA_GetRemainingAidTableSize();
+  if (needed > remaining) {
+    LOG(ERROR) << StringPrintf("%s: %u bytes needed, %u left in AID table", fn,
+                               needed, remaining);
+    return false;
+  }
+
+  SyncEventGuard guard(mAidAddRemoveEvent);
+  mAidAddPending = 0;
+  mAidAddFailed = 0;
+  offset = 0;
+  for (uint32_t xx = 0; xx < count; xx++) {
+    uint8_t aidLen = table[offset];
+    uint8_t* aid = const_cast<uint8_t*>(&table[offset + 1]);
+    int route = table[offset + 1 + aidLen];
+    int power = table[offset + 2 + aidLen];
+    int aidInfo = table[offset + 3 + aidLen];
+    offset += 1 + aidLen + 3;
+
+    tNFA_HANDLE handle = se.getEseHandleFromGenericId(route);
+    if (handle == NFA_HANDLE_INVALID) {
+      LOG(ERROR) << StringPrintf("%s: no EE for route 0x%x", fn, route);
+      continue;
+    }
+    while ((mAidAddPending >= kMaxAidsInFlight) &&
+           mAidAddRemoveEvent.wait(kAidRspTimeoutMs))
+      ;
+    if (NFA_EeAddAidRouting(handle, aidLen, aid, power, aidInfo) ==
+        NFA_STATUS_OK) {
+      mAidAddPending++;
+      routed++;
+    } else {
+      LOG(ERROR) << StringPrintf("%s: failed to route AID %u", fn, xx);
+    }
+  }
+  // One wait for everything still outstanding
+  while ((mAidAddPending > 0) && mAidAddRemoveEvent.wait(kAidRspTimeoutMs))
+    ;
+  if (mAidAddPending > 0) {
+    LOG(ERROR) << StringPrintf("%s: %u responses missing", fn, mAidAddPending);
+    mAidAddPending = 0;
+  }
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: exit; routed %u of %u; rejected: %u", fn, routed, count,
+      mAidAddFailed);
+  return (routed == count) && (mAidAddFailed == 0);
+}
+#endif
+
 bool RoutingManager::removeAidRouting(const uint8_t* aid, uint8_t aidLen) {
   static const char fn[] = "RoutingManager::removeAidRouting";
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", fn);
@@ -500,6 +743,7 @@ bool RoutingManager::commitRouting() {
   static const char fn[] = "RoutingManager::commitRouting";
   tNFA_STATUS nfaStat = 0;
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", fn);
+  flushDefaultRouting();
   {
     SyncEventGuard guard(mEeUpdateEvent);
     nfaStat = NFA_EeUpdateNow();
@@ -547,92 +791,435 @@ void RoutingManager::onNfccShutdown() {
 }
 
 void RoutingManager::notifyActivated(uint8_t technology) {
-  JNIEnv* e = NULL;
-  ScopedAttach attach(mNativeData->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("jni env is null");
-    return;
-  }
-
-  e->CallVoidMethod(mNativeData->manager,
-                    android::gCachedNfcManagerNotifyHostEmuActivated,
-                    (int)technology);
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("fail notify");
-  }
+  resetHceSession();
+  JniEventDispatcher::getInstance().post([this, technology](JNIEnv* e) {
+    e->CallVoidMethod(mNativeData->manager,
+                      android::gCachedNfcManagerNotifyHostEmuActivated,
+                      (int)technology);
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("fail notify");
+    }
+  });
 }
 
 void RoutingManager::notifyDeactivated(uint8_t technology) {
-  mRxDataBuffer.clear();
-  JNIEnv* e = NULL;
-  ScopedAttach attach(mNativeData->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("jni env is null");
-    return;
-  }
+  // Java must see every APDU of the session before the deactivation; the
+  // dispatcher keeps that order, this only waits so the slots can be reset
+  flushHceData();
+  resetHceSession();
+  JniEventDispatcher::getInstance().post([this, technology](JNIEnv* e) {
+    e->CallVoidMethod(mNativeData->manager,
+                      android::gCachedNfcManagerNotifyHostEmuDeactivated,
+                      (int)technology);
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("fail notify");
+    }
+  });
+}
 
-  e->CallVoidMethod(mNativeData->manager,
-                    android::gCachedNfcManagerNotifyHostEmuDeactivated,
-                    (int)technology);
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("fail notify");
-  }
+namespace {
+uint64_t monotonicUs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
 }
+// Upper bounds of the HCE latency buckets in microseconds; the last bucket
+// takes everything slower
+const uint32_t kHceLatencyBoundsUs[] = {100,  250,   500,   1000,  2000,
+                                        5000, 10000, 20000, 50000};
+}  // namespace
 
+/*******************************************************************************
+**
+** Function:        handleData
+**
+** Description:     Reassemble an APDU from NFA_CE_DATA_EVT fragments and queue
+**                  it for delivery to Java.  Runs on the stack thread.
+**                  technology: Listen technology the data came in on.
+**                  data, dataLen: Fragment.
+**                  status: NFC_STATUS_CONTINUE if more fragments follow.
+**
+** Returns:         None.
+**
+*******************************************************************************/
 void RoutingManager::handleData(uint8_t technology, const uint8_t* data,
                                 uint32_t dataLen, tNFA_STATUS status) {
-  if (status == NFC_STATUS_CONTINUE) {
-    if (dataLen > 0) {
-      mRxDataBuffer.insert(mRxDataBuffer.end(), &data[0],
-                           &data[dataLen]);  // append data; more to come
+  static const char fn[] = "RoutingManager::handleData";
+  if (mHceSlots == NULL && !allocHceSlots()) {
+    LOG(ERROR) << StringPrintf("%s: no APDU buffer", fn);
+    return;
+  }
+  HceApdu_t* apdu;
+  {
+    SyncEventGuard guard(mHceDataEvent);
+    // Every slot is queued; wait for the dispatcher to free one
+    while (mHceCount >= HCE_APDU_SLOTS) mHceDataEvent.wait();
+    apdu = &mHceSlots[(mHceHead + mHceCount) % HCE_APDU_SLOTS];
+  }
+
+  if (apdu->len == 0 && !apdu->overflow) apdu->arrivalUs = monotonicUs();
+  if (dataLen > 0) {
+    if (apdu->len + dataLen > HCE_MAX_APDU_LEN) {
+      apdu->overflow = true;
+    } else {
+      memcpy(&apdu->data[apdu->len], data, dataLen);
+      apdu->len += dataLen;
     }
+  }
+  if (status == NFC_STATUS_CONTINUE) {
     return;  // expect another NFA_CE_DATA_EVT to come
   } else if (status == NFA_STATUS_OK) {
-    if (dataLen > 0) {
-      mRxDataBuffer.insert(mRxDataBuffer.end(), &data[0],
-                           &data[dataLen]);  // append data
-    }
     // entire data packet has been received; no more NFA_CE_DATA_EVT
   } else if (status == NFA_STATUS_FAILED) {
-    LOG(ERROR) << StringPrintf("RoutingManager::handleData: read data fail");
-    goto TheEnd;
+    LOG(ERROR) << StringPrintf("%s: read data fail", fn);
+    apdu->overflow = true;
+  }
+  if (apdu->overflow) {
+    LOG(ERROR) << StringPrintf("%s: dropping APDU", fn);
+    apdu->len = 0;
+    apdu->overflow = false;
+    return;
+  }
+  apdu->technology = technology;
+  apdu->replayLen = 0;
+  if (answerHceFromCache(*apdu)) {
+    apdu->len = 0;
+    return;
   }
 
   {
-    JNIEnv* e = NULL;
-    ScopedAttach attach(mNativeData->vm, &e);
-    if (e == NULL) {
-      LOG(ERROR) << StringPrintf("jni env is null");
-      goto TheEnd;
+    SyncEventGuard guard(mHceDataEvent);
+    mHceCount++;
+  }
+  // Events run in order, so this delivers the oldest queued slot
+  JniEventDispatcher::getInstance().post([this](JNIEnv* e) {
+    HceApdu_t* head;
+    {
+      SyncEventGuard guard(mHceDataEvent);
+      head = &mHceSlots[mHceHead];
+    }
+    deliverHceApdu(e, *head);
+    SyncEventGuard guard(mHceDataEvent);
+    mHceHead = (mHceHead + 1) % HCE_APDU_SLOTS;
+    mHceCount--;
+    mHceDataEvent.notifyOne();
+  });
+}
+
+/*******************************************************************************
+**
+** Function:        allocHceSlots
+**
+** Description:     Allocate the APDU slots.  They live for the rest of the
+**                  process.
+**
+** Returns:         True if the APDU slots are available.
+**
+*******************************************************************************/
+bool RoutingManager::allocHceSlots() {
+  if (mHceSlots == NULL) {
+    mHceSlots = new (std::nothrow) HceApdu_t[HCE_APDU_SLOTS];
+    if (mHceSlots == NULL) return false;
+    for (uint32_t xx = 0; xx < HCE_APDU_SLOTS; xx++) {
+      mHceSlots[xx].len = 0;
+      mHceSlots[xx].overflow = false;
+      mHceSlots[xx].replayLen = 0;
     }
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function:        deliverHceApdu
+**
+** Description:     Pass one APDU to Java, record its latency and free the
+**                  slot for reuse.
+**                  e: JVM environment of the calling thread.
+**                  apdu: Slot holding the APDU.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void RoutingManager::deliverHceApdu(JNIEnv* e, HceApdu_t& apdu) {
+  if (apdu.replayLen > 0) {
+    // The reader already has the answer to this SELECT
+    sendHceToJava(e, apdu.technology, apdu.replay, apdu.replayLen, true);
+    apdu.replayLen = 0;
+  }
+  sendHceToJava(e, apdu.technology, apdu.data, apdu.len, false);
+  recordHceLatency(apdu.arrivalUs);
+  SyncEventGuard guard(mHceDataEvent);
+  apdu.len = 0;
+}
+
+/*******************************************************************************
+**
+** Function:        sendHceToJava
+**
+** Description:     Pass one APDU to Java.
+**                  e: JVM environment of the calling thread.
+**                  technology: Listen technology the data came in on.
+**                  data, len: APDU.
+**                  replay: True for a SELECT the stack already answered;
+**                  Java forwards it but drops the service's answer.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void RoutingManager::sendHceToJava(JNIEnv* e, uint8_t technology,
+                                   const uint8_t* data, uint32_t len,
+                                   bool replay) {
+  // Java keeps the array after the callback returns, so it cannot be reused
+  ScopedLocalRef<jobject> dataJavaArray(e, e->NewByteArray(len));
+  if (dataJavaArray.get() == NULL) {
+    LOG(ERROR) << StringPrintf("fail allocate array");
+    e->ExceptionClear();
+    return;
+  }
+  e->SetByteArrayRegion((jbyteArray)dataJavaArray.get(), 0, len,
+                        (const jbyte*)data);
+  if (e->ExceptionCheck()) {
+    e->ExceptionClear();
+    LOG(ERROR) << StringPrintf("fail fill array");
+    return;
+  }
+  e->CallVoidMethod(mNativeData->manager,
+                    replay ? android::gCachedNfcManagerNotifyHostEmuReplay
+                           : android::gCachedNfcManagerNotifyHostEmuData,
+                    (int)technology, dataJavaArray.get());
+  if (e->ExceptionCheck()) {
+    e->ExceptionClear();
+    LOG(ERROR) << StringPrintf("fail notify");
+  }
+}
+
+/*******************************************************************************
+**
+** Function:        recordHceLatency
+**
+** Description:     Count one answered APDU in the latency histogram.
+**                  arrivalUs: When its first fragment arrived.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void RoutingManager::recordHceLatency(uint64_t arrivalUs) {
+  uint64_t latencyUs = monotonicUs() - arrivalUs;
+  int bucket = 0;
+  while ((bucket < HCE_LATENCY_BUCKETS - 1) &&
+         (latencyUs > kHceLatencyBoundsUs[bucket]))
+    bucket++;
+  SyncEventGuard guard(mHceDataEvent);
+  mHceLatency[bucket]++;
+}
 
-    ScopedLocalRef<jobject> dataJavaArray(
-        e, e->NewByteArray(mRxDataBuffer.size()));
-    if (dataJavaArray.get() == NULL) {
-      LOG(ERROR) << StringPrintf("fail allocate array");
-      goto TheEnd;
+/*******************************************************************************
+**
+** Function:        answerHceFromCache
+**
+** Description:     Answer an APDU from the static responses registered for
+**                  the selected AID.  Runs on the stack thread.
+**                  A SELECT answered here is not seen by Java, so it is
+**                  kept and replayed to Java in front of the next APDU that
+**                  does go to Java.  Java forwards the replay to the
+**                  service and drops the service's answer to it.
+**                  apdu: Complete APDU.
+**
+** Returns:         True if the APDU was answered.
+**
+*******************************************************************************/
+bool RoutingManager::answerHceFromCache(HceApdu_t& apdu) {
+  static const char fn[] = "RoutingManager::answerHceFromCache";
+  // HCE-F has its own response timer handling; ISO-DEP only
+  if (apdu.technology == NFA_TECHNOLOGY_MASK_F) return false;
+
+  const uint8_t* cmd = apdu.data;
+  bool isSelect = (apdu.len >= 5) && (cmd[0] == 0x00) && (cmd[1] == 0xA4) &&
+                  (cmd[2] == 0x04) && (5u + cmd[4] <= apdu.len);
+  if (isSelect) mHceSelectedAid.assign(&cmd[5], &cmd[5 + cmd[4]]);
+
+  const HceStaticResponse_t* hit = NULL;
+  std::shared_ptr<const HceResponseTable_t> table =
+      std::atomic_load(&mHceResponses);
+  if (table && !mHceSelectedAid.empty()) {
+    HceResponseTable_t::const_iterator it = table->find(mHceSelectedAid);
+    for (size_t xx = 0; (it != table->end()) && (xx < it->second.size());
+         xx++) {
+      const HceStaticResponse_t& entry = it->second[xx];
+      if (entry.command.size() != apdu.len) continue;
+      uint32_t yy = 0;
+      while ((yy < apdu.len) && (((cmd[yy] ^ entry.command[yy]) &
+                                  entry.mask[yy]) == 0))
+        yy++;
+      if (yy == apdu.len) {
+        hit = &entry;
+        break;
+      }
     }
+  }
+  if (isSelect && (hit != NULL) && (apdu.len > HCE_MAX_SELECT_LEN))
+    hit = NULL;  // could not be replayed
+  if ((hit != NULL) &&
+      (NFA_SendRawFrame(const_cast<uint8_t*>(hit->response.data()),
+                        hit->response.size(), 0) != NFA_STATUS_OK)) {
+    LOG(ERROR) << StringPrintf("%s: fail send cached response", fn);
+    hit = NULL;
+  }
 
-    e->SetByteArrayRegion((jbyteArray)dataJavaArray.get(), 0,
-                          mRxDataBuffer.size(), (jbyte*)(&mRxDataBuffer[0]));
-    if (e->ExceptionCheck()) {
-      e->ExceptionClear();
-      LOG(ERROR) << StringPrintf("fail fill array");
-      goto TheEnd;
+  if (hit == NULL) {
+    if (isSelect) {
+      mHceJavaSelected = true;
+    } else if (!mHceJavaSelected) {
+      // Java must know what the reader selected before it sees this
+      memcpy(apdu.replay, mHceSelectCmd, mHceSelectLen);
+      apdu.replayLen = mHceSelectLen;
+      mHceJavaSelected = true;
     }
+    return false;
+  }
+  if (isSelect) {
+    memcpy(mHceSelectCmd, cmd, apdu.len);
+    mHceSelectLen = apdu.len;
+    mHceJavaSelected = false;
+  }
+  recordHceLatency(apdu.arrivalUs);
+  return true;
+}
 
-    e->CallVoidMethod(mNativeData->manager,
-                      android::gCachedNfcManagerNotifyHostEmuData,
-                      (int)technology, dataJavaArray.get());
-    if (e->ExceptionCheck()) {
-      e->ExceptionClear();
-      LOG(ERROR) << StringPrintf("fail notify");
+/*******************************************************************************
+**
+** Function:        resetHceSession
+**
+** Description:     Forget the selected AID at the start and end of an HCE
+**                  session.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void RoutingManager::resetHceSession() {
+  mHceSelectedAid.clear();
+  mHceJavaSelected = true;
+  mHceSelectLen = 0;
+}
+
+/*******************************************************************************
+**
+** Function:        setHceStaticResponse
+**
+** Description:     Register a fixed response to a command for an AID.  An
+**                  AID belongs to one owner at a time; entries of other
+**                  owners for the same AID are dropped.
+**                  owner: Id of the registering service.
+**                  aid, aidLen: AID the command is valid for.
+**                  command, mask, commandLen: Command bytes to match; only
+**                  bits set in mask are compared.  The length must match.
+**                  response, responseLen: Response including status word.
+**
+** Returns:         True if registered.
+**
+*******************************************************************************/
+bool RoutingManager::setHceStaticResponse(int owner, const uint8_t* aid,
+                                          uint8_t aidLen,
+                                          const uint8_t* command,
+                                          const uint8_t* mask,
+                                          uint32_t commandLen,
+                                          const uint8_t* response,
+                                          uint32_t responseLen) {
+  static const char fn[] = "RoutingManager::setHceStaticResponse";
+  if ((aidLen == 0) || (commandLen < 4) || (commandLen > HCE_MAX_APDU_LEN) ||
+      (responseLen < 2)) {
+    LOG(ERROR) << StringPrintf("%s: invalid entry", fn);
+    return false;
+  }
+  HceStaticResponse_t entry;
+  entry.owner = owner;
+  entry.command.assign(command, command + commandLen);
+  entry.mask.assign(mask, mask + commandLen);
+  entry.response.assign(response, response + responseLen);
+
+  AutoMutex mutex(mHceResponseMutex);
+  std::shared_ptr<const HceResponseTable_t> current =
+      std::atomic_load(&mHceResponses);
+  std::shared_ptr<HceResponseTable_t> table =
+      current ? std::make_shared<HceResponseTable_t>(*current)
+              : std::make_shared<HceResponseTable_t>();
+  std::vector<HceStaticResponse_t>& entries =
+      (*table)[std::vector<uint8_t>(aid, aid + aidLen)];
+  for (size_t xx = entries.size(); xx-- > 0;) {
+    if ((entries[xx].owner != owner) ||
+        ((entries[xx].command == entry.command) &&
+         (entries[xx].mask == entry.mask)))
+      entries.erase(entries.begin() + xx);
+  }
+  entries.push_back(entry);
+  std::atomic_store(&mHceResponses,
+                    std::shared_ptr<const HceResponseTable_t>(table));
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: owner %d; %zu entries for AID", fn, owner, entries.size());
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function:        clearHceStaticResponses
+**
+** Description:     Drop static responses.
+**                  owner: Id of the service; negative for all services.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void RoutingManager::clearHceStaticResponses(int owner) {
+  AutoMutex mutex(mHceResponseMutex);
+  std::shared_ptr<const HceResponseTable_t> current =
+      std::atomic_load(&mHceResponses);
+  if (!current) return;
+  std::shared_ptr<HceResponseTable_t> table;
+  if (owner >= 0) {
+    table = std::make_shared<HceResponseTable_t>();
+    for (HceResponseTable_t::const_iterator it = current->begin();
+         it != current->end(); it++) {
+      for (const HceStaticResponse_t& entry : it->second)
+        if (entry.owner != owner) (*table)[it->first].push_back(entry);
     }
   }
-TheEnd:
-  mRxDataBuffer.clear();
+  std::atomic_store(&mHceResponses,
+                    std::shared_ptr<const HceResponseTable_t>(table));
+}
+
+/*******************************************************************************
+**
+** Function:        flushHceData
+**
+** Description:     Drop a partly received APDU, wait until every queued APDU
+**                  has reached Java and log the latency histogram.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void RoutingManager::flushHceData() {
+  static const char fn[] = "RoutingManager::flushHceData";
+  if (mHceSlots == NULL) return;
+  SyncEventGuard guard(mHceDataEvent);
+  while (mHceCount > 0) mHceDataEvent.wait();
+  HceApdu_t& partial = mHceSlots[mHceHead];
+  partial.len = 0;
+  partial.overflow = false;
+
+  std::string histogram;
+  for (int xx = 0; xx < HCE_LATENCY_BUCKETS; xx++) {
+    if (xx < HCE_LATENCY_BUCKETS - 1)
+      histogram += StringPrintf(" <=%uus:%u", kHceLatencyBoundsUs[xx],
+                                mHceLatency[xx]);
+    else
+      histogram += StringPrintf(" >%uus:%u", kHceLatencyBoundsUs[xx - 1],
+                                mHceLatency[xx]);
+  }
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: APDU latency%s", fn, histogram.c_str());
 }
 
 void RoutingManager::stackCallback(uint8_t event,
@@ -799,6 +1386,8 @@ void RoutingManager::nfaEeCallback(tNFA_EE_EVT event,
           "%s: NFA_EE_ADD_AID_EVT  status=%u", fn, eventData->status);
     #if(NXP_EXTNS == TRUE)
         SyncEventGuard guard(routingManager.mAidAddRemoveEvent);
+        if (eventData->status != NFA_STATUS_OK) routingManager.mAidAddFailed++;
+        if (routingManager.mAidAddPending > 0) routingManager.mAidAddPending--;
         routingManager.mAidAddRemoveEvent.notifyOne();
     #endif
     } break;
@@ -937,13 +1526,14 @@ void RoutingManager::deregisterT3tIdentifier(int handle) {
     }
   }
   if (mIsScbrSupported) {
+    // mMapScbrHandle is read by addFixedLmrtEntries()
+    SyncEventGuard guard(mRoutingEvent);
     map<int, uint16_t>::iterator it = mMapScbrHandle.find(handle);
     // find system code for given handle
     if (it != mMapScbrHandle.end()) {
       uint16_t systemCode = it->second;
       mMapScbrHandle.erase(handle);
       if (systemCode != 0) {
-        SyncEventGuard guard(mRoutingEvent);
         tNFA_STATUS nfaStat = NFA_EeRemoveSystemCodeRouting(systemCode);
         if (nfaStat == NFA_STATUS_OK) {
           mRoutingEvent.wait();
@@ -1026,6 +1616,58 @@ int RoutingManager::com_android_nfc_cardemulation_doGetAidMatchingMode(
   return getInstance().mAidMatchingMode;
 }
 
+/*******************************************************************************
+**
+** Function:        com_android_nfc_cardemulation_doPlanAidRouting
+**
+** Description:     Fit a candidate AID set into the routing table without
+**                  touching the controller.  See LmrtPlanner.
+**                  e: JVM environment.
+**                  table: Packed entries, each
+**                         aidLen | aid | route | power | aidInfo.
+**                  priorities: One priority per entry; higher is kept longer.
+**                  capacity: AID table size in bytes.
+**                  maxAids: Maximum number of AID entries; 0 for no limit.
+**
+** Returns:         Indices of the entries to route, or null if table is
+**                  malformed.
+**
+*******************************************************************************/
+jintArray RoutingManager::com_android_nfc_cardemulation_doPlanAidRouting(
+    JNIEnv* e, jobject, jbyteArray table, jintArray priorities, jint capacity,
+    jint maxAids) {
+  static const char fn[] = "RoutingManager::doPlanAidRouting";
+  ScopedByteArrayRO bytes(e, table);
+  ScopedIntArrayRO prio(e, priorities);
+  if ((bytes.get() == NULL) || (prio.get() == NULL))
+    return NULL;  // NullPointerException thrown
+
+  const uint8_t* buf = reinterpret_cast<const uint8_t*>(bytes.get());
+  size_t len = bytes.size(), offset = 0;
+  LmrtPlanner planner(getInstance().mAidMatchingMode);
+  for (size_t xx = 0; xx < prio.size(); xx++) {
+    if ((offset >= len) || (offset + 1 + buf[offset] + 3 > len)) {
+      LOG(ERROR) << StringPrintf("%s: malformed entry %zu", fn, xx);
+      return NULL;
+    }
+    uint8_t aidLen = buf[offset];
+    planner.addAid(&buf[offset + 1], aidLen, buf[offset + 1 + aidLen],
+                   buf[offset + 2 + aidLen], buf[offset + 3 + aidLen],
+                   prio[xx]);
+    offset += 1 + aidLen + 3;
+  }
+  getInstance().addFixedLmrtEntries(planner);
+
+  std::vector<uint32_t> kept;
+  planner.plan((capacity > 0) ? capacity : 0, (maxAids > 0) ? maxAids : 0,
+               kept);
+  jintArray result = e->NewIntArray(kept.size());
+  if (result == NULL) return NULL;
+  std::vector<jint> indices(kept.begin(), kept.end());
+  e->SetIntArrayRegion(result, 0, indices.size(), indices.data());
+  return result;
+}
+
 #if(NXP_EXTNS == TRUE)
 /*******************************************************************************
  **
@@ -1063,6 +1705,7 @@ void RoutingManager::registerProtoRouteEnrty(tNFA_HANDLE     ee_handle,
                                          )
 {
     static const char fn [] = "RoutingManager::registerProtoRouteEnrty";
+    forgetDefaultRouting();
     bool new_entry = true;
     uint8_t i = 0;
     tNFA_STATUS nfaStat = NFA_STATUS_FAILED;
@@ -1240,6 +1883,7 @@ bool RoutingManager::setRoutingEntry(int type, int value, int route, int power)
 {
     static const char fn [] = "RoutingManager::setRoutingEntry";
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter, >>>>>>>> type:0x%x value =0x%x route:%x power:0x%x", fn, type, value ,route, power);
+    forgetDefaultRouting();
     unsigned long max_tech_mask = 0x03;
     unsigned long uiccListenTech = 0;
 
@@ -1496,6 +2140,7 @@ bool RoutingManager::clearRoutingEntry(int type)
 {
     static const char fn [] = "RoutingManager::clearRoutingEntry";
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter, type:0x%x", fn, type );
+    forgetDefaultRouting();
     tNFA_STATUS nfaStat = NFA_STATUS_FAILED;
     //tNFA_HANDLE ee_handle = NFA_HANDLE_INVLAID;
 
@@ -37,6 +37,7 @@
 *
 ******************************************************************************/
 #pragma once
+#include <memory>
 #include <vector>
 #include "NfcJniUtil.h"
 #include "RouteDataSet.h"
@@ -100,6 +101,26 @@ typedef struct routeInfo {
     ProtoRoutInfo_t protoInfo[4];
 }RouteInfo_t;
 #endif
+
+/* Number of power states in a default tech/proto routing entry */
+#define LMRT_POWER_STATES 6
+
+/* Default tech and protocol routing of one NFCEE as handed to
+ * NFA_EeSetDefaultTechRouting/NFA_EeSetDefaultProtoRouting, one mask per
+ * power state: switch on, switch off, battery off, screen lock, screen off,
+ * screen off lock */
+typedef struct {
+  bool hasTech;
+  bool hasProto;
+  tNFA_TECHNOLOGY_MASK tech[LMRT_POWER_STATES];
+  tNFA_PROTOCOL_MASK proto[LMRT_POWER_STATES];
+} LmrtRoute_t;
+
+/* Default routing keyed by NFCEE ID */
+typedef map<uint16_t, LmrtRoute_t> LmrtTable_t;
+
+class LmrtPlanner;
+
 class RoutingManager {
  public:
 #if(NXP_EXTNS == TRUE)
@@ -119,6 +140,11 @@ class RoutingManager {
   void deregisterT3tIdentifier(int handle);
   void onNfccShutdown();
   int registerJniFunctions(JNIEnv* e);
+  bool setHceStaticResponse(int owner, const uint8_t* aid, uint8_t aidLen,
+                            const uint8_t* command, const uint8_t* mask,
+                            uint32_t commandLen, const uint8_t* response,
+                            uint32_t responseLen);
+  void clearHceStaticResponses(int owner);
 #if(NXP_EXTNS == TRUE)
     uint16_t getUiccRouteLocId(const int route);
     static const int NFA_SET_AID_ROUTING = 4;
@@ -147,19 +173,66 @@ class RoutingManager {
     uint32_t getUicc2selected();
     bool addAidRouting(const uint8_t* aid, uint8_t aidLen,
                                    int route, int aidInfo, int power);
+    bool addAidRoutingBatch(const uint8_t* table, uint32_t tableLen,
+                            uint32_t count);
 
     SyncEvent       mAidAddRemoveEvent;
+    // AID adds the stack has not answered, and adds it answered with an
+    // error; protected by mAidAddRemoveEvent
+    uint32_t        mAidAddPending;
+    uint32_t        mAidAddFailed;
 #endif
  private:
   RoutingManager();
   ~RoutingManager();
   RoutingManager(const RoutingManager&);
   RoutingManager& operator=(const RoutingManager&);
+  friend class RoutingManagerPeer;
+
+  // Longest extended length C-APDU: header, 3-byte Lc, 65535 data, 3-byte Le
+  static const uint32_t HCE_MAX_APDU_LEN = 4 + 3 + 65535 + 3;
+  // Longest SELECT by AID: header, Lc, up to 255 AID bytes, Le
+  static const uint32_t HCE_MAX_SELECT_LEN = 5 + 255 + 1;
+  static const uint32_t HCE_APDU_SLOTS = 4;
+  static const int HCE_LATENCY_BUCKETS = 10;
+  struct HceApdu_t {
+    uint8_t technology;
+    uint32_t len;
+    bool overflow;
+    uint64_t arrivalUs;  // first fragment, CLOCK_MONOTONIC
+    // SELECT answered natively that Java must see first; see
+    // answerHceFromCache()
+    uint32_t replayLen;
+    uint8_t replay[HCE_MAX_SELECT_LEN];
+    uint8_t data[HCE_MAX_APDU_LEN];
+  };
+  struct HceStaticResponse_t {
+    int owner;
+    std::vector<uint8_t> command;
+    std::vector<uint8_t> mask;
+    std::vector<uint8_t> response;
+  };
+  // Static responses by AID
+  typedef map<std::vector<uint8_t>, std::vector<HceStaticResponse_t> >
+      HceResponseTable_t;
 
   void handleData(uint8_t technology, const uint8_t* data, uint32_t dataLen,
                   tNFA_STATUS status);
+  bool allocHceSlots();
+  void deliverHceApdu(JNIEnv* e, HceApdu_t& apdu);
+  void flushHceData();
+  void sendHceToJava(JNIEnv* e, uint8_t technology, const uint8_t* data,
+                     uint32_t len, bool replay);
+  bool answerHceFromCache(HceApdu_t& apdu);
+  void recordHceLatency(uint64_t arrivalUs);
+  void resetHceSession();
   void notifyActivated(uint8_t technology);
   void notifyDeactivated(uint8_t technology);
+  void stageTechRouting(uint16_t nfceeID, const tNFA_TECHNOLOGY_MASK* masks);
+  void stageProtoRouting(uint16_t nfceeID, const tNFA_PROTOCOL_MASK* masks);
+  void flushDefaultRouting();
+  void forgetDefaultRouting();
+  void addFixedLmrtEntries(LmrtPlanner& planner);
 
   // See AidRoutingManager.java for corresponding
   // AID_MATCHING_ constants
@@ -180,8 +253,31 @@ class RoutingManager {
   static int com_android_nfc_cardemulation_doGetDefaultOffHostRouteDestination(
       JNIEnv* e);
   static int com_android_nfc_cardemulation_doGetAidMatchingMode(JNIEnv* e);
+  static jintArray com_android_nfc_cardemulation_doPlanAidRouting(
+      JNIEnv* e, jobject, jbyteArray table, jintArray priorities,
+      jint capacity, jint maxAids);
 
-  std::vector<uint8_t> mRxDataBuffer;
+  // HCE APDUs are reassembled into a ring of preallocated slots and handed
+  // to the JNI event dispatcher, one event per slot.  Slots mHceHead ..
+  // mHceHead + mHceCount - 1 are queued or being delivered; the next one is
+  // filled by the stack thread.  mHceCount, mHceHead and mHceLatency are
+  // protected by mHceDataEvent.
+  HceApdu_t* mHceSlots;
+  uint32_t mHceHead;
+  uint32_t mHceCount;
+  SyncEvent mHceDataEvent;
+  // APDUs by time from RF data arrival to the end of the Java callback
+  uint32_t mHceLatency[HCE_LATENCY_BUCKETS];
+  // Responses answered without Java.  Readers on the stack thread load the
+  // snapshot without locking; writers replace it under mHceResponseMutex.
+  std::shared_ptr<const HceResponseTable_t> mHceResponses;
+  Mutex mHceResponseMutex;
+  // Session state, stack thread only: the AID the reader last selected and
+  // whether Java has seen that SELECT
+  std::vector<uint8_t> mHceSelectedAid;
+  bool mHceJavaSelected;
+  uint32_t mHceSelectLen;
+  uint8_t mHceSelectCmd[HCE_MAX_SELECT_LEN];
   map<int, uint16_t> mMapScbrHandle;
 
   // Fields below are final after initialize()
@@ -202,6 +298,10 @@ class RoutingManager {
   static const JNINativeMethod sMethods[];
   SyncEvent mEeRegisterEvent;
   SyncEvent mRoutingEvent;
+  // Default routing waiting to be handed to the stack, and the last default
+  // routing the stack accepted; protected by mRoutingEvent
+  LmrtTable_t mLmrtStaged;
+  LmrtTable_t mLmrtCommitted;
   SyncEvent mEeUpdateEvent;
   SyncEvent mEeInfoEvent;
   SyncEvent mEeSetModeEvent;
@@ -25,6 +25,7 @@
 #include "SecureElement.h"
 #include <nativehelper/ScopedLocalRef.h>
 #include "JavaClassConstants.h"
+#include "JniEventDispatcher.h"
 #include "NfcJniUtil.h"
 #include <android-base/stringprintf.h>
 #include <base/logging.h>
@@ -289,7 +290,6 @@ void SecureElement::notifyListenModeState (bool isActivated) {
     DLOG_IF(INFO, nfc_debug_enabled)
                 << StringPrintf("%s: enter; listen mode active=%u", fn, isActivated);
 
-    JNIEnv* e = NULL;
     if (mNativeData == NULL)
     {
         DLOG_IF(ERROR, nfc_debug_enabled)
@@ -297,31 +297,23 @@ void SecureElement::notifyListenModeState (bool isActivated) {
         return;
     }
 
-    ScopedAttach attach(mNativeData->vm, &e);
-    if (e == NULL)
-    {
-        DLOG_IF(ERROR, nfc_debug_enabled)
-                << StringPrintf("%s: jni env is null", fn);
-        return;
-    }
-
     mActivatedInListenMode = isActivated;
 
-    if (mNativeData != NULL) {
+    JniEventDispatcher::getInstance().post([this, isActivated](JNIEnv* e) {
         if (isActivated) {
             e->CallVoidMethod (mNativeData->manager, android::gCachedNfcManagerNotifySeListenActivated);
         }
         else {
             e->CallVoidMethod (mNativeData->manager, android::gCachedNfcManagerNotifySeListenDeactivated);
         }
-    }
 
-    if (e->ExceptionCheck())
-    {
-        e->ExceptionClear();
-        DLOG_IF(ERROR, nfc_debug_enabled)
-                << StringPrintf("%s: fail notify", fn);
-    }
+        if (e->ExceptionCheck())
+        {
+            e->ExceptionClear();
+            DLOG_IF(ERROR, nfc_debug_enabled)
+                    << StringPrintf("%s: fail notify", fn);
+        }
+    });
 
     DLOG_IF(INFO, nfc_debug_enabled)
                 << StringPrintf("%s: exit", fn);
@@ -729,24 +721,147 @@ void SecureElement::nfaHciCallback(tNFA_HCI_EVT event,
 }
 
 bool SecureElement::notifySeInitialized() {
-    JNIEnv* e = NULL;
-    static const char fn [] = "SecureElement::notifySeInitialized";
-    ScopedAttach attach(mNativeData->vm, &e);
-    if (e == NULL)
-    {
-        DLOG_IF(ERROR, nfc_debug_enabled)
-            << StringPrintf("%s: jni env is null", fn);
-        return false;
-    }
     if(mNativeData == NULL)
     {
         return false;
     }
-    e->CallVoidMethod (mNativeData->manager, android::gCachedNfcManagerNotifySeInitialized);
-    CHECK(!e->ExceptionCheck());
+    JniEventDispatcher::getInstance().run([this](JNIEnv* e) {
+        e->CallVoidMethod (mNativeData->manager, android::gCachedNfcManagerNotifySeInitialized);
+        CHECK(!e->ExceptionCheck());
+    });
     return true;
 }
 
+/*******************************************************************************
+**
+** Function:        acquireResponseBuffer
+**
+** Description:     Lock and return the buffer that APDU responses are
+**                  received into.  Passing it to transceive() avoids a copy;
+**                  it is not cleared between uses, so only the bytes
+**                  reported by transceive() are valid.
+**                  bufferSize: Receives the size of the buffer.
+**
+** Returns:         Response buffer; release with releaseResponseBuffer().
+**
+*******************************************************************************/
+uint8_t* SecureElement::acquireResponseBuffer (int32_t& bufferSize)
+{
+    mResponseBufferMutex.lock ();
+    bufferSize = sizeof(mResponseData);
+    return mResponseData;
+}
+
+/*******************************************************************************
+**
+** Function:        releaseResponseBuffer
+**
+** Description:     Unlock the buffer returned by acquireResponseBuffer().
+**
+** Returns:         None
+**
+*******************************************************************************/
+void SecureElement::releaseResponseBuffer ()
+{
+    mResponseBufferMutex.unlock ();
+}
+
+/*******************************************************************************
+**
+** Function:        transceiveScript
+**
+** Description:     Send a script of APDUs to the secure element in one call.
+**                  Each command in the script is encoded as a 2-byte
+**                  big-endian length, the APDU, a 2-byte expected status
+**                  word and a 2-byte status word mask (0x0000 accepts any
+**                  response).  For every command executed, the response
+**                  is appended to responses as a 2-byte big-endian length
+**                  followed by the response bytes.  Execution stops after
+**                  the first command that fails or whose status word does
+**                  not match.
+**                  script: Encoded commands.
+**                  scriptSize: Length of script.
+**                  responses: Receives the encoded responses.
+**                  timeoutMillisec: Timeout of each command in millisecond.
+**
+** Returns:         True if the script was well formed and every command
+**                  succeeded with a matching status word.
+**
+*******************************************************************************/
+bool SecureElement::transceiveScript (const uint8_t* script, int32_t scriptSize,
+        std::vector<uint8_t>& responses, int32_t timeoutMillisec)
+{
+    static const char fn [] = "SecureElement::transceiveScript";
+    bool isSuccess = true;
+    int32_t recvBufferMaxSize = 0;
+    int32_t numCommands = 0;
+    int32_t offset = 0;
+
+    LOG(INFO) << StringPrintf("%s: enter; scriptSize=%d", fn, scriptSize);
+    responses.clear ();
+    uint8_t* recvBuffer = acquireResponseBuffer (recvBufferMaxSize);
+    while (offset < scriptSize)
+    {
+        if (scriptSize - offset < 2)
+        {
+            LOG(ERROR) << StringPrintf("%s: truncated command header", fn);
+            isSuccess = false;
+            break;
+        }
+        int32_t cmdLen = (script[offset] << 8) | script[offset + 1];
+        offset += 2;
+        if (cmdLen == 0 || scriptSize - offset < cmdLen + 4)
+        {
+            LOG(ERROR) << StringPrintf("%s: bad command %d; len=%d", fn, numCommands, cmdLen);
+            isSuccess = false;
+            break;
+        }
+        const uint8_t* cmd = script + offset;
+        offset += cmdLen;
+        uint16_t expectedSw = (script[offset] << 8) | script[offset + 1];
+        uint16_t swMask = (script[offset + 2] << 8) | script[offset + 3];
+        offset += 4;
+
+        int32_t recvBufferActualSize = 0;
+        isSuccess = transceive (const_cast<uint8_t*>(cmd), cmdLen, recvBuffer,
+                recvBufferMaxSize, recvBufferActualSize, timeoutMillisec);
+        numCommands++;
+        if (!isSuccess)
+            recvBufferActualSize = 0;
+        responses.push_back ((uint8_t)(recvBufferActualSize >> 8));
+        responses.push_back ((uint8_t)recvBufferActualSize);
+        responses.insert (responses.end (), recvBuffer, recvBuffer + recvBufferActualSize);
+        if (!isSuccess)
+        {
+            LOG(ERROR) << StringPrintf("%s: command %d not sent", fn, numCommands - 1);
+            break;
+        }
+
+        if (swMask != 0)
+        {
+            bool swMatch = false;
+            if (recvBufferActualSize >= 2)
+            {
+                uint16_t sw = (recvBuffer[recvBufferActualSize - 2] << 8) |
+                        recvBuffer[recvBufferActualSize - 1];
+                swMatch = ((sw & swMask) == (expectedSw & swMask));
+            }
+            if (!swMatch)
+            {
+                LOG(ERROR) << StringPrintf("%s: command %d; SW does not match 0x%04X/0x%04X",
+                        fn, numCommands - 1, expectedSw, swMask);
+                isSuccess = false;
+                break;
+            }
+        }
+    }
+    releaseResponseBuffer ();
+
+    LOG(INFO) << StringPrintf("%s: exit; isSuccess: %d; commands: %d; response size: %zu",
+            fn, isSuccess, numCommands, responses.size ());
+    return isSuccess;
+}
+
 /*******************************************************************************
 **
 ** Function:        transceive
@@ -774,6 +889,11 @@ bool SecureElement::transceive (uint8_t* xmitBuffer, int32_t xmitBufferSize, uin
     mTransceiveStatus = NFA_STATUS_OK;
     uint8_t newSelectCmd[NCI_MAX_AID_LEN + 10];
     isSuccess                  = false;
+    // a caller holding acquireResponseBuffer() receives in place; any other
+    // buffer gets a copy of the response and must not race with the holder
+    bool inPlace = (recvBuffer == mResponseData);
+    if (!inPlace)
+        mResponseBufferMutex.lock ();
 
     // Check if we need to replace an "empty" SELECT command.
     // 1. Has there been a AID configured, and
@@ -819,7 +939,6 @@ bool SecureElement::transceive (uint8_t* xmitBuffer, int32_t xmitBufferSize, uin
     {
         SyncEventGuard guard (mTransceiveEvent);
         mActualResponseSize = 0;
-        memset (mResponseData, 0, sizeof(mResponseData));
         nfaStat = NFA_HciSendApdu (mNfaHciHandle, mActiveEeHandle, xmitBufferSize, xmitBuffer, sizeof(mResponseData), mResponseData, timeoutMillisec);
 
         if (nfaStat == NFA_STATUS_OK)
@@ -894,9 +1013,12 @@ bool SecureElement::transceive (uint8_t* xmitBuffer, int32_t xmitBufferSize, uin
         else
             recvBufferActualSize = mActualResponseSize;
 
-        memcpy (recvBuffer, mResponseData, recvBufferActualSize);
+        if (!inPlace)
+            memcpy (recvBuffer, mResponseData, recvBufferActualSize);
      isSuccess = true;
         TheEnd:
+     if (!inPlace)
+         mResponseBufferMutex.unlock ();
      return (isSuccess);
 }
 
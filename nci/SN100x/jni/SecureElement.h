@@ -17,6 +17,7 @@
 ******************************************************************************/
 
 #pragma once
+#include <vector>
 #include "nfa_hci_api.h"
 #include "nfa_hci_defs.h"
 #include "NfcJniUtil.h"
@@ -105,6 +106,7 @@ void getEeHandleList(tNFA_HANDLE *list, uint8_t* count);
 
 
  private:
+  friend class SecureElementPeer;
   static SecureElement sSecElem;
   static const char* APP_NAME;
   static const tNFA_HANDLE EE_HANDLE_ESE = 0x4C0;
@@ -158,6 +160,7 @@ void getEeHandleList(tNFA_HANDLE *list, uint8_t* count);
   uint8_t mVerInfo [3];
   uint8_t mAtrInfo[40];
   uint8_t mResponseData [MAX_RESPONSE_SIZE];
+  Mutex   mResponseBufferMutex;   // held while mResponseData is in use
   uint8_t mAtrRespData [EVT_ABORT_MAX_RSP_LEN];
   uint8_t mAtrRespLen;
   uint8_t mNumEePresent;          // actual number of usable EE's
@@ -269,6 +272,54 @@ bool transceive (uint8_t* xmitBuffer, int32_t xmitBufferSize, uint8_t* recvBuffe
        int32_t recvBufferMaxSize, int32_t& recvBufferActualSize, int32_t timeoutMillisec);
 /*******************************************************************************
 **
+** Function:        acquireResponseBuffer
+**
+** Description:     Lock and return the buffer that APDU responses are
+**                  received into.  Passing it to transceive() avoids a copy;
+**                  it is not cleared between uses, so only the bytes
+**                  reported by transceive() are valid.
+**                  bufferSize: Receives the size of the buffer.
+**
+** Returns:         Response buffer; release with releaseResponseBuffer().
+**
+*******************************************************************************/
+uint8_t* acquireResponseBuffer (int32_t& bufferSize);
+/*******************************************************************************
+**
+** Function:        releaseResponseBuffer
+**
+** Description:     Unlock the buffer returned by acquireResponseBuffer().
+**
+** Returns:         None
+**
+*******************************************************************************/
+void releaseResponseBuffer ();
+/*******************************************************************************
+**
+** Function:        transceiveScript
+**
+** Description:     Send a script of APDUs to the secure element in one call.
+**                  Each command in the script is encoded as a 2-byte
+**                  big-endian length, the APDU, a 2-byte expected status
+**                  word and a 2-byte status word mask (0x0000 accepts any
+**                  response).  For every command executed, the response
+**                  is appended to responses as a 2-byte big-endian length
+**                  followed by the response bytes.  Execution stops after
+**                  the first command that fails or whose status word does
+**                  not match.
+**                  script: Encoded commands.
+**                  scriptSize: Length of script.
+**                  responses: Receives the encoded responses.
+**                  timeoutMillisec: Timeout of each command in millisecond.
+**
+** Returns:         True if the script was well formed and every command
+**                  succeeded with a matching status word.
+**
+*******************************************************************************/
+bool transceiveScript (const uint8_t* script, int32_t scriptSize,
+        std::vector<uint8_t>& responses, int32_t timeoutMillisec);
+/*******************************************************************************
+**
 ** Function:        activate
 **
 ** Description:     Turn on the secure element.
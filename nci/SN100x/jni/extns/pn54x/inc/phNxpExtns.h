@@ -48,6 +48,7 @@ NFCSTATUS EXTNS_CheckMfcResponse(uint8_t** sTransceiveData,
 void MfcPresenceCheckResult(NFCSTATUS status);
 void MfcResetPresenceCheckStatus(void);
 NFCSTATUS EXTNS_GetPresenceCheckStatus(void);
+void EXTNS_MfcGetCacheStats(uint32_t* hits, uint32_t* misses);
 
 /*
  * Events from JNI for NXP Extensions
@@ -424,7 +424,13 @@ NFCSTATUS EXTNS_MfcTransceive(uint8_t* p_data, uint32_t len) {
 *******************************************************************************/
 NFCSTATUS EXTNS_MfcInit(tNFA_ACTIVATED activationData) {
   tNFC_ACTIVATE_DEVT rfDetail = activationData.activate_ntf;
+  uint8_t uidLen = rfDetail.rf_tech_param.param.pa.nfcid1_len;
 
+  /* The UID keys the MIFARE Classic layout cache */
+  if (uidLen > PHNFC_MAX_UID_LENGTH) uidLen = 0;
+  memcpy(NdefMap->psRemoteDevInfo->RemoteDevInfo.Iso14443A_Info.Uid,
+         rfDetail.rf_tech_param.param.pa.nfcid1, uidLen);
+  NdefMap->psRemoteDevInfo->RemoteDevInfo.Iso14443A_Info.UidLength = uidLen;
   NdefMap->psRemoteDevInfo->RemoteDevInfo.Iso14443A_Info.Sak =
       rfDetail.rf_tech_param.param.pa.sel_rsp;
   NdefMap->psRemoteDevInfo->RemoteDevInfo.Iso14443A_Info.AtqA[0] =
@@ -609,6 +615,20 @@ void MfcPresenceCheckResult(NFCSTATUS status) {
   sem_post(&gAuthCmdBuf.semPresenceCheck);
 }
 void MfcResetPresenceCheckStatus(void) { gAuthCmdBuf.auth_sent = false; }
+
+/*******************************************************************************
+**
+** Function         EXTNS_MfcGetCacheStats
+**
+** Description      Hits and misses of the MIFARE Classic layout cache since
+**                  the stack started, for the NFC service dump.
+**
+** Returns          void
+**
+*******************************************************************************/
+void EXTNS_MfcGetCacheStats(uint32_t* hits, uint32_t* misses) {
+  Mfc_GetCacheStats(hits, misses);
+}
 /*******************************************************************************
 **
 ** Function         EXTNS_CheckMfcResponse
@@ -31,10 +31,17 @@
 #define LOG_TAG "pn54x"
 
 #include <phNxpConfig.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
-#include <list>
 #include <sys/stat.h>
 
 #include <android-base/stringprintf.h>
@@ -43,6 +50,8 @@
 #include <cutils/log.h>
 #include <cutils/properties.h>
 #include <errno.h>
+#include "phNxpConfigCache.h"
+#include "sparse_crc32.h"
 
 using android::base::StringPrintf;
 
@@ -68,6 +77,7 @@ const int transport_config_path_size =
 #define IsStringValue 0x80000000
 
 const char config_timestamp_path[] = "/data/nfc/libnfc-nxpConfigState.bin";
+const char config_cache_path[] = "/data/nfc/libnfc-nxpConfigCache.bin";
 const char default_nxp_config_path[] = "vendor/etc/libnfc-nxp.conf";
 
 /**
@@ -122,6 +132,63 @@ typedef enum
   TARGET_INVALID                       = 0xFF
 } TARGETTYPE;
 
+namespace {
+
+/* Read-only view of a whole config file. The file is memory-mapped so the
+ * parser can tokenize it in place; if mapping fails the file is read into a
+ * heap buffer instead. */
+class ConfigFileMap {
+ public:
+  explicit ConfigFileMap(const char* fileName)
+      : m_data(nullptr), m_size(0), m_mapped(false) {
+    int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) &&
+        file_stat.st_size > 0) {
+      const size_t file_size = file_stat.st_size;
+      void* addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        madvise(addr, file_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const uint8_t*>(addr);
+        m_size = file_size;
+        m_mapped = true;
+      } else {
+        uint8_t* buffer = new uint8_t[file_size];
+        if (pread(fd, buffer, file_size, 0) == (ssize_t)file_size) {
+          m_data = buffer;
+          m_size = file_size;
+        } else {
+          delete[] buffer;
+        }
+      }
+    }
+    close(fd);
+  }
+
+  ~ConfigFileMap() {
+    if (m_data == nullptr) return;
+    if (m_mapped)
+      munmap(const_cast<uint8_t*>(m_data), m_size);
+    else
+      delete[] m_data;
+  }
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+ private:
+  ConfigFileMap(const ConfigFileMap&) = delete;
+  ConfigFileMap& operator=(const ConfigFileMap&) = delete;
+
+  const uint8_t* m_data;
+  size_t m_size;
+  bool m_mapped;
+};
+
+}  // namespace
+
 using namespace ::std;
 
 void findConfigFilePathFromTransportConfigPaths(const string& configName, string& filePath);
@@ -131,6 +198,8 @@ class CNxpNfcParam : public string {
   CNxpNfcParam();
   CNxpNfcParam(const char* name, const string& value);
   CNxpNfcParam(const char* name, unsigned long value);
+  CNxpNfcParam(const char* name, size_t nameLen, const string& value);
+  CNxpNfcParam(const char* name, size_t nameLen, unsigned long value);
   virtual ~CNxpNfcParam();
   unsigned long numValue() const { return m_numValue; }
   const char* str_value() const { return m_str_value.c_str(); }
@@ -141,6 +210,27 @@ class CNxpNfcParam : public string {
   unsigned long m_numValue;
 };
 
+/* Immutable, hash-indexed copy of the merged settings. A new snapshot is
+ * published each time a config file is (re)loaded; readers keep the one they
+ * obtained alive for the duration of the lookup, so no lock is needed. */
+class CNxpNfcConfigSnapshot {
+ public:
+  explicit CNxpNfcConfigSnapshot(const vector<const CNxpNfcParam*>& params);
+  const CNxpNfcParam* find(const char* p_name) const;
+
+ private:
+  struct NameHash {
+    size_t operator()(const char* p_name) const;
+  };
+  struct NameEqual {
+    bool operator()(const char* a, const char* b) const {
+      return strcmp(a, b) == 0;
+    }
+  };
+  vector<CNxpNfcParam> m_params;
+  unordered_map<const char*, const CNxpNfcParam*, NameHash, NameEqual> m_index;
+};
+
 class CNxpNfcConfig : public vector<const CNxpNfcParam*> {
  public:
   virtual ~CNxpNfcConfig();
@@ -152,21 +242,32 @@ class CNxpNfcConfig : public vector<const CNxpNfcParam*> {
   bool getValue(const char* name, unsigned long& rValue) const;
   bool getValue(const char* name, unsigned short& rValue) const;
   bool getValue(const char* name, char* pValue, long len, long* readlen) const;
-  const CNxpNfcParam* find(const char* p_name) const;
+  shared_ptr<const CNxpNfcConfigSnapshot> snapshot() const {
+    return atomic_load(&mSnapshot);
+  }
   void clean();
 
  private:
+  friend class CNxpNfcConfigPeer;
   CNxpNfcConfig();
   bool readConfig(const char* name, bool bResetContent);
+  bool readConfigCached(const char* name);
+  bool loadCache(const vector<string>& sources);
+  void saveCache();
+  void updateTimeStamp(const char* name, const struct stat& file_stat);
   int file_exist (const char* filename);
   int getconfiguration_id (char * config_file);
-  void moveFromList();
-  void moveToList();
-  void add(const CNxpNfcParam* pParam);
-  list<const CNxpNfcParam*> m_list;
+  void add(vector<const CNxpNfcParam*>& parsed, const CNxpNfcParam* pParam);
+  void merge(vector<const CNxpNfcParam*>& overlay);
+  void purge();
+  void publish();
   bool mValidFile;
   bool mDynamConfig;
   unsigned long m_timeStamp;
+  shared_ptr<const CNxpNfcConfigSnapshot> mSnapshot;
+  // files read since the last reset, in order, recorded for the cache
+  vector<phNxpConfigCacheSource> m_sources;
+  const char* mCachePath;
 
   unsigned long state;
 
@@ -520,8 +621,8 @@ void findConfigFilePathFromTransportConfigPaths(const string& configName,
 **
 ** Function:    CNxpNfcConfig::readConfig()
 **
-** Description: read Config settings and parse them into a linked list
-**              move the element from linked list to a array at the end
+** Description: read Config settings and parse them into a flat array,
+**              then merge the array over the current settings
 **
 ** Returns:     1, if there are any config data, 0 otherwise
 **
@@ -537,19 +638,27 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
     END_LINE
   };
 
-  FILE* fd;
   struct stat buf;
-  string token;
+  // the token is a span of the mapped file, only values are copied out
+  const char* token = nullptr;
+  size_t tokenLen = 0;
   string strValue;
+  strValue.reserve(256);
   unsigned long numValue = 0;
   CNxpNfcParam* pParam = NULL;
+  vector<const CNxpNfcParam*> parsed;
   int i = 0;
   int base = 0;
   char c;
   int bflag = 0;
   state = BEGIN_LINE;
-  /* open config file, read it into a buffer */
-  if ((fd = fopen(name, "rb")) == NULL) {
+  /* map the config file, or read it into a buffer */
+  ConfigFileMap configFile(name);
+  const uint8_t* p_config = configFile.data();
+  const size_t config_size = configFile.size();
+  if (bResetContent) m_sources.clear();
+  if (p_config == nullptr) {
+    m_sources.push_back({name, false, 0});
     LOG(ERROR) << StringPrintf("%s Cannot open config file %s", __func__, name);
     if (bResetContent) {
       LOG(ERROR) << StringPrintf("%s Using default value for all settings",
@@ -559,41 +668,33 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
     return false;
   }
   stat(name, &buf);
-  if (mDynamConfig)
-      m_timeStamp = (unsigned long)buf.st_mtime;
-  else
-  {
-      if(strcmp(default_nxp_config_path, name) == 0)
-          m_timeStamp = (unsigned long)buf.st_mtime;
-  }
+  updateTimeStamp(name, buf);
+  m_sources.push_back(
+      {name, true, sparse_crc32_fast(0, (const void*)p_config, config_size)});
 
   mValidFile = true;
-  if (size() > 0) {
-    if (bResetContent)
-      clean();
-    else
-      moveToList();
-  }
+  if (bResetContent) purge();
+  const auto parseStart = chrono::steady_clock::now();
 
-  while (!feof(fd) && fread(&c, 1, 1, fd) == 1) {
+  for (size_t offset = 0; offset != config_size; ++offset) {
+    c = p_config[offset];
     switch (state & 0xff) {
       case BEGIN_LINE:
         if (c == '#') {
           state = END_LINE;
         } else if (isPrintable(c)) {
           i = 0;
-          token.erase();
+          token = reinterpret_cast<const char*>(p_config + offset);
+          tokenLen = 1;
           strValue.erase();
           state = TOKEN;
-          token.push_back(c);
         }
         break;
       case TOKEN:
         if (c == '=') {
-          token.push_back('\0');
           state = BEGIN_QUOTE;
         } else if (isPrintable(c)) {
-          token.push_back(c);
+          ++tokenLen;
         } else {
           state = END_LINE;
         }
@@ -678,11 +779,11 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
             while (n-- > 0) strValue.push_back(((numValue >> (n * 8)) & 0xFF));
           }
           if (strValue.length() > 0)
-            pParam = new CNxpNfcParam(token.c_str(), strValue);
+            pParam = new CNxpNfcParam(token, tokenLen, strValue);
           else
-            pParam = new CNxpNfcParam(token.c_str(), numValue);
+            pParam = new CNxpNfcParam(token, tokenLen, numValue);
 
-          add(pParam);
+          add(parsed, pParam);
           strValue.erase();
           numValue = 0;
         }
@@ -691,8 +792,8 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
         if (c == '"') {
           strValue.push_back('\0');
           state = END_LINE;
-          pParam = new CNxpNfcParam(token.c_str(), strValue);
-          add(pParam);
+          pParam = new CNxpNfcParam(token, tokenLen, strValue);
+          add(parsed, pParam);
         } else if (isPrintable(c)) {
           strValue.push_back(c);
         }
@@ -707,9 +808,14 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
     }
   }
 
-  fclose(fd);
-
-  moveFromList();
+  merge(parsed);
+  publish();
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s parsed %s in %lld us, %zu settings", __func__, name,
+      (long long)chrono::duration_cast<chrono::microseconds>(
+          chrono::steady_clock::now() - parseStart)
+          .count(),
+      size());
   return size() > 0;
 }
 
@@ -722,7 +828,12 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
 ** Returns:     none
 **
 *******************************************************************************/
-CNxpNfcConfig::CNxpNfcConfig() : mValidFile(true), mDynamConfig(true), m_timeStamp(0), state(0) {}
+CNxpNfcConfig::CNxpNfcConfig()
+    : mValidFile(true),
+      mDynamConfig(true),
+      m_timeStamp(0),
+      mCachePath(config_cache_path),
+      state(0) {}
 
 /*******************************************************************************
 **
@@ -770,7 +881,7 @@ CNxpNfcConfig& CNxpNfcConfig::GetInstance() {
     if (alternative_config_path[0] != '\0') {
       strPath.assign(alternative_config_path);
       strPath += config_name;
-      theInstance.readConfig(strPath.c_str(), true);
+      theInstance.readConfigCached(strPath.c_str());
       if (!theInstance.empty()) {
         return theInstance;
       }
@@ -781,7 +892,7 @@ CNxpNfcConfig& CNxpNfcConfig::GetInstance() {
     {
         ALOGI("default config file exists = %s, dynamic selection disabled", strPath.c_str());
         theInstance.mDynamConfig = false;
-        theInstance.readConfig(strPath.c_str(), true);
+        theInstance.readConfigCached(strPath.c_str());
         /*
          * if libnfc-nxp.conf exists then dynamic selection will
          * be turned off by default we will not have this file.
@@ -796,12 +907,139 @@ CNxpNfcConfig& CNxpNfcConfig::GetInstance() {
         findConfigFilePathFromTransportConfigPaths(config_name_default, strPath);
     }
     ALOGI("config file used = %s\n", strPath.c_str());
-    theInstance.readConfig(strPath.c_str(), true);
+    theInstance.readConfigCached(strPath.c_str());
   }
 
   return theInstance;
 }
 
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::readConfigCached()
+**
+** Description: load the settings of config file |name| from the binary cache,
+**              or parse the file and rewrite the cache if the cache does not
+**              match it. The load time is logged so boot logs show the cost
+**              of either path.
+**
+** Returns:     true if there are any config data
+**
+*******************************************************************************/
+bool CNxpNfcConfig::readConfigCached(const char* name) {
+  const auto loadStart = chrono::steady_clock::now();
+  const bool cached = loadCache({name});
+  if (!cached) {
+    readConfig(name, true);
+    saveCache();
+  }
+  ALOGI("config %s in %lld us, %zu settings\n",
+        cached ? "loaded from cache" : "parsed",
+        (long long)chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - loadStart)
+            .count(),
+        size());
+  return size() > 0;
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::updateTimeStamp()
+**
+** Description: remember the modification time checkTimestamp() compares
+**              against, if |name| is the file it tracks
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNxpNfcConfig::updateTimeStamp(const char* name,
+                                    const struct stat& file_stat) {
+  if (mDynamConfig || strcmp(default_nxp_config_path, name) == 0)
+    m_timeStamp = (unsigned long)file_stat.st_mtime;
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::loadCache()
+**
+** Description: load the parsed setting table from the binary cache if it was
+**              built from exactly |sources| and none of them has changed
+**
+** Returns:     true if the setting table was loaded from the cache
+**
+*******************************************************************************/
+bool CNxpNfcConfig::loadCache(const vector<string>& sources) {
+  phNxpConfigCacheImage image;
+  if (!phNxpConfigCache_Read(mCachePath, image)) return false;
+  if (image.sources.size() != sources.size()) return false;
+
+  for (size_t n = 0; n < sources.size(); ++n) {
+    const phNxpConfigCacheSource& src = image.sources[n];
+    if (src.path != sources[n]) return false;
+    ConfigFileMap configFile(src.path.c_str());
+    if ((configFile.data() != nullptr) != src.present) return false;
+    if (src.present && sparse_crc32_fast(0, configFile.data(),
+                                         configFile.size()) != src.crc32) {
+      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+          "%s %s modified, ignoring cache", __func__, src.path.c_str());
+      return false;
+    }
+  }
+
+  // entries were written from the sorted table, so they are still sorted
+  purge();
+  reserve(image.entries.size());
+  for (const phNxpConfigCacheEntry& entry : image.entries) {
+    if (entry.isString)
+      push_back(new CNxpNfcParam(entry.name.c_str(), entry.strValue));
+    else
+      push_back(new CNxpNfcParam(entry.name.c_str(),
+                                 (unsigned long)entry.numValue));
+  }
+  // checkTimestamp() still tracks the mtime the parser would have recorded
+  for (const phNxpConfigCacheSource& src : image.sources) {
+    struct stat file_stat;
+    if (src.present && stat(src.path.c_str(), &file_stat) == 0)
+      updateTimeStamp(src.path.c_str(), file_stat);
+  }
+  m_sources.swap(image.sources);
+  mValidFile = true;
+  publish();
+  return size() > 0;
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::saveCache()
+**
+** Description: write the current setting table to the binary cache
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNxpNfcConfig::saveCache() {
+  if (!mValidFile || empty()) return;
+
+  // this library tracks changes by mtime, the config CRC32 slots stay unused
+  phNxpConfigCacheImage image;
+  image.config_crc32 = 0;
+  image.config_crc32_rf = 0;
+  image.config_crc32_tr = 0;
+  image.sources = m_sources;
+  image.entries.reserve(size());
+  for (const CNxpNfcParam* pParam : *this) {
+    phNxpConfigCacheEntry entry;
+    entry.name = *pParam;
+    entry.isString = pParam->str_len() > 0;
+    entry.numValue = pParam->numValue();
+    entry.strValue.assign(pParam->str_value(), pParam->str_len());
+    image.entries.push_back(entry);
+  }
+  if (!phNxpConfigCache_Write(mCachePath, image)) {
+    LOG(ERROR) << StringPrintf("%s Unable to write file '%s'", __func__,
+                               mCachePath);
+  }
+}
+
 /*******************************************************************************
 **
 ** Function:    CNxpNfcConfig::getValue()
@@ -813,7 +1051,8 @@ CNxpNfcConfig& CNxpNfcConfig::GetInstance() {
 **
 *******************************************************************************/
 bool CNxpNfcConfig::getValue(const char* name, char* pValue, size_t len) const {
-  const CNxpNfcParam* pParam = find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
   if (pParam == NULL) return false;
 
   if (pParam->str_len() > 0) {
@@ -826,7 +1065,8 @@ bool CNxpNfcConfig::getValue(const char* name, char* pValue, size_t len) const {
 
 bool CNxpNfcConfig::getValue(const char* name, char* pValue, long len,
                              long* readlen) const {
-  const CNxpNfcParam* pParam = find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
   if (pParam == NULL) return false;
 
   if (pParam->str_len() > 0) {
@@ -854,7 +1094,8 @@ bool CNxpNfcConfig::getValue(const char* name, char* pValue, long len,
 **
 *******************************************************************************/
 bool CNxpNfcConfig::getValue(const char* name, unsigned long& rValue) const {
-  const CNxpNfcParam* pParam = find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
   if (pParam == NULL) return false;
 
   if (pParam->str_len() == 0) {
@@ -875,7 +1116,8 @@ bool CNxpNfcConfig::getValue(const char* name, unsigned long& rValue) const {
 **
 *******************************************************************************/
 bool CNxpNfcConfig::getValue(const char* name, unsigned short& rValue) const {
-  const CNxpNfcParam* pParam = find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
   if (pParam == NULL) return false;
 
   if (pParam->str_len() == 0) {
@@ -887,34 +1129,83 @@ bool CNxpNfcConfig::getValue(const char* name, unsigned short& rValue) const {
 
 /*******************************************************************************
 **
-** Function:    CNxpNfcConfig::find()
+** Function:    CNxpNfcConfigSnapshot::CNxpNfcConfigSnapshot()
 **
-** Description: search if a setting exist in the setting array
+** Description: copy the merged settings and build the name index
 **
-** Returns:     pointer to the setting object
+** Returns:     none
 **
 *******************************************************************************/
-const CNxpNfcParam* CNxpNfcConfig::find(const char* p_name) const {
-  if (size() == 0) return NULL;
-
-  for (const_iterator it = begin(), itEnd = end(); it != itEnd; ++it) {
-    if (**it < p_name) {
-      continue;
-    } else if (**it == p_name) {
-      if ((*it)->str_len() > 0) {
-        DLOG_IF(INFO, gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)
-            << StringPrintf("%s found %s=%s\n", __func__, p_name,
-                            (*it)->str_value());
-      } else {
-        DLOG_IF(INFO, gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)
-            << StringPrintf("%s found %s=(0x%lx)\n", __func__, p_name,
-                            (*it)->numValue());
-      }
-      return *it;
-    } else
-      break;
+CNxpNfcConfigSnapshot::CNxpNfcConfigSnapshot(
+    const vector<const CNxpNfcParam*>& params) {
+  // reserve up front so the index keys never dangle on reallocation
+  m_params.reserve(params.size());
+  m_index.reserve(params.size());
+  for (const CNxpNfcParam* pParam : params) {
+    m_params.push_back(*pParam);
+    const CNxpNfcParam& rParam = m_params.back();
+    m_index[rParam.c_str()] = &rParam;
+  }
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfigSnapshot::NameHash::operator()
+**
+** Description: FNV-1a hash of a setting name
+**
+** Returns:     hash value
+**
+*******************************************************************************/
+size_t CNxpNfcConfigSnapshot::NameHash::operator()(const char* p_name) const {
+  size_t hash = 2166136261u;
+  while (*p_name) {
+    hash ^= (unsigned char)*p_name++;
+    hash *= 16777619u;
   }
-  return NULL;
+  return hash;
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfigSnapshot::find()
+**
+** Description: search if a setting exist in the snapshot
+**
+** Returns:     pointer to the setting object, valid while the snapshot is held
+**
+*******************************************************************************/
+const CNxpNfcParam* CNxpNfcConfigSnapshot::find(const char* p_name) const {
+  auto it = m_index.find(p_name);
+  if (it == m_index.end()) return NULL;
+
+  const CNxpNfcParam* pParam = it->second;
+  if (pParam->str_len() > 0) {
+    DLOG_IF(INFO, gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)
+        << StringPrintf("%s found %s=%s\n", __func__, p_name,
+                        pParam->str_value());
+  } else {
+    DLOG_IF(INFO, gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)
+        << StringPrintf("%s found %s=(0x%lx)\n", __func__, p_name,
+                        pParam->numValue());
+  }
+  return pParam;
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::publish()
+**
+** Description: atomically replace the snapshot seen by readers with the
+**              current content of the setting array
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNxpNfcConfig::publish() {
+  shared_ptr<const CNxpNfcConfigSnapshot> snap;
+  if (size() > 0) snap = make_shared<const CNxpNfcConfigSnapshot>(*this);
+  atomic_store(&mSnapshot, snap);
 }
 
 /*******************************************************************************
@@ -929,72 +1220,81 @@ const CNxpNfcParam* CNxpNfcConfig::find(const char* p_name) const {
 void CNxpNfcConfig::clean() {
   if (size() == 0) return;
 
-  for (iterator it = begin(), itEnd = end(); it != itEnd; ++it) delete *it;
-
-  clear();
+  purge();
+  publish();
 }
 
 /*******************************************************************************
 **
-** Function:    CNxpNfcConfig::Add()
+** Function:    CNxpNfcConfig::purge()
 **
-** Description: add a setting object to the list
+** Description: delete the setting objects without touching the published
+**              snapshot, so a reload never exposes an empty config to readers
 **
 ** Returns:     none
 **
 *******************************************************************************/
-void CNxpNfcConfig::add(const CNxpNfcParam* pParam) {
-  if (m_list.size() == 0) {
-    m_list.push_back(pParam);
-    return;
-  }
-  for (list<const CNxpNfcParam*>::iterator it = m_list.begin(),
-                                           itEnd = m_list.end();
-       it != itEnd; ++it) {
-    if (**it < pParam->c_str()) continue;
-
-    m_list.insert(it, pParam);
-    return;
-  }
-  m_list.push_back(pParam);
+void CNxpNfcConfig::purge() {
+  for (iterator it = begin(), itEnd = end(); it != itEnd; ++it) delete *it;
+  clear();
 }
 
 /*******************************************************************************
 **
-** Function:    CNxpNfcConfig::moveFromList()
+** Function:    CNxpNfcConfig::add()
 **
-** Description: move the setting object from list to array
+** Description: append a setting object parsed from the current file
 **
 ** Returns:     none
 **
 *******************************************************************************/
-void CNxpNfcConfig::moveFromList() {
-  if (m_list.size() == 0) return;
-
-  for (list<const CNxpNfcParam*>::iterator it = m_list.begin(),
-                                           itEnd = m_list.end();
-       it != itEnd; ++it)
-    push_back(*it);
-
-  m_list.clear();
+void CNxpNfcConfig::add(vector<const CNxpNfcParam*>& parsed,
+                        const CNxpNfcParam* pParam) {
+  parsed.push_back(pParam);
 }
 
 /*******************************************************************************
 **
-** Function:    CNxpNfcConfig::moveToList()
+** Function:    CNxpNfcConfig::merge()
 **
-** Description: move the setting object from array to list
+** Description: sort the settings parsed from one file and merge them into the
+**              setting array in a single pass. Precedence, lowest first:
+**              previously loaded files, then earlier lines of this file, then
+**              later lines of this file.
 **
 ** Returns:     none
 **
 *******************************************************************************/
-void CNxpNfcConfig::moveToList() {
-  if (m_list.size() != 0) m_list.clear();
+void CNxpNfcConfig::merge(vector<const CNxpNfcParam*>& overlay) {
+  if (overlay.empty()) return;
 
-  for (iterator it = begin(), itEnd = end(); it != itEnd; ++it)
-    m_list.push_back(*it);
-
-  clear();
+  auto byName = [](const CNxpNfcParam* a, const CNxpNfcParam* b) {
+    return *a < *b;
+  };
+  // stable sort keeps file order among duplicates; keep the last of each run
+  stable_sort(overlay.begin(), overlay.end(), byName);
+  size_t unique = 0;
+  for (size_t n = 0; n < overlay.size(); ++n) {
+    if (unique > 0 && *overlay[unique - 1] == *overlay[n]) {
+      delete overlay[unique - 1];
+      overlay[unique - 1] = overlay[n];
+    } else {
+      overlay[unique++] = overlay[n];
+    }
+  }
+  overlay.resize(unique);
+
+  vector<const CNxpNfcParam*> merged;
+  merged.reserve(size() + overlay.size());
+  iterator base = begin(), baseEnd = end();
+  for (const CNxpNfcParam* pParam : overlay) {
+    while (base != baseEnd && **base < *pParam) merged.push_back(*base++);
+    if (base != baseEnd && **base == *pParam) delete *base++;
+    merged.push_back(pParam);
+  }
+  merged.insert(merged.end(), base, baseEnd);
+  swap(merged);
+  overlay.clear();
 }
 
 /*******************************************************************************
@@ -1085,6 +1385,32 @@ CNxpNfcParam::CNxpNfcParam(const char* name, const string& value)
 CNxpNfcParam::CNxpNfcParam(const char* name, unsigned long value)
     : string(name), m_numValue(value) {}
 
+/*******************************************************************************
+**
+** Function:    CNxpNfcParam::CNxpNfcParam()
+**
+** Description: class constructor taking a name that is not NUL-terminated
+**
+** Returns:     none
+**
+*******************************************************************************/
+CNxpNfcParam::CNxpNfcParam(const char* name, size_t nameLen,
+                           const string& value)
+    : string(name, nameLen), m_str_value(value), m_numValue(0) {}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcParam::CNxpNfcParam()
+**
+** Description: class constructor taking a name that is not NUL-terminated
+**
+** Returns:     none
+**
+*******************************************************************************/
+CNxpNfcParam::CNxpNfcParam(const char* name, size_t nameLen,
+                           unsigned long value)
+    : string(name, nameLen), m_numValue(value) {}
+
 /*******************************************************************************
 **
 ** Function:    GetStrValue
@@ -1138,7 +1464,8 @@ extern int GetNxpNumValue(const char* name, void* pValue, unsigned long len) {
   if (!pValue) return false;
 
   CNxpNfcConfig& rConfig = CNxpNfcConfig::GetInstance();
-  const CNxpNfcParam* pParam = rConfig.find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = rConfig.snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
 
   if (pParam == NULL) return false;
 
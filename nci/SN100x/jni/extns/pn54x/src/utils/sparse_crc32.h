@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBSPARSE_SPARSE_CRC32_H_
+#define _LIBSPARSE_SPARSE_CRC32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Byte-at-a-time reference implementation. */
+uint32_t sparse_crc32(uint32_t crc, const void* buf, size_t size);
+
+/* Same CRC-32 as sparse_crc32(), computed with the CPU CRC32/carry-less
+ * multiply instructions when available, slice-by-8 tables otherwise. */
+uint32_t sparse_crc32_fast(uint32_t crc, const void* buf, size_t size);
+
+#endif
@@ -0,0 +1,56 @@
+LOCAL_PATH := $(call my-dir)
+NXP_CONFIG_UTILS := ../../jni/extns/pn54x/src/utils
+
+NXP_CONFIG_TEST_INCLUDES := \
+    $(LOCAL_PATH)/$(NXP_CONFIG_UTILS) \
+    $(LOCAL_PATH)/../../jni/extns/pn54x/src/log
+
+NXP_CONFIG_TEST_SRCS := \
+    $(NXP_CONFIG_UTILS)/phNxpConfigCache.cpp \
+    $(NXP_CONFIG_UTILS)/sparse_crc32.cpp
+
+NXP_CONFIG_TEST_LIBS := \
+    libbase \
+    libchrome \
+    libcutils \
+    liblog
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_config_test
+LOCAL_SRC_FILES := phNxpConfig_test.cpp $(NXP_CONFIG_TEST_SRCS)
+LOCAL_TEST_DATA := \
+    $(call find-test-data-in-subdirs,$(LOCAL_PATH),*,corpus expected)
+LOCAL_C_INCLUDES := $(NXP_CONFIG_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NXP_CONFIG_TEST_LIBS)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_config_benchmark
+LOCAL_SRC_FILES := phNxpConfig_benchmark.cpp $(NXP_CONFIG_TEST_SRCS)
+LOCAL_C_INCLUDES := $(NXP_CONFIG_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NXP_CONFIG_TEST_LIBS)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_BENCHMARK)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_config_fuzzer
+LOCAL_SRC_FILES := phNxpConfig_fuzzer.cpp $(NXP_CONFIG_TEST_SRCS)
+LOCAL_C_INCLUDES := $(NXP_CONFIG_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NXP_CONFIG_TEST_LIBS)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_FUZZ_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_crc32_test
+LOCAL_SRC_FILES := sparse_crc32_test.cpp
+LOCAL_C_INCLUDES := $(NXP_CONFIG_TEST_INCLUDES)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_crc32_benchmark
+LOCAL_SRC_FILES := sparse_crc32_benchmark.cpp
+LOCAL_C_INCLUDES := $(NXP_CONFIG_TEST_INCLUDES)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_BENCHMARK)
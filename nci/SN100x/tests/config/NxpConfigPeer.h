@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The NXP config reader keeps its classes private to phNxpConfig.cpp, so the
+ * tests compile that file in and reach the internals through the friend
+ * class below instead of going through the GetInstance() singleton and its
+ * fixed /vendor paths.
+ */
+#pragma once
+
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "phNxpConfig.cpp"
+
+nci_log_level_t gLog_level;
+bool nfc_debug_enabled;
+
+class CNxpNfcConfigPeer {
+ public:
+  static CNxpNfcConfig* create() { return new CNxpNfcConfig(); }
+
+  static bool load(CNxpNfcConfig& rConfig, const char* name,
+                   bool bResetContent) {
+    return rConfig.readConfig(name, bResetContent);
+  }
+
+  static void setCachePath(CNxpNfcConfig& rConfig, const char* cachePath) {
+    rConfig.mCachePath = cachePath;
+  }
+
+  /* Loads |name| the way GetInstance() does, through the cache. */
+  static bool loadCached(CNxpNfcConfig& rConfig, const char* name) {
+    return rConfig.readConfigCached(name);
+  }
+
+  /* Loads |name| from the cache only; false if the cache does not match. */
+  static bool loadCache(CNxpNfcConfig& rConfig, const char* name) {
+    return rConfig.loadCache({name});
+  }
+
+  static unsigned long timeStamp(const CNxpNfcConfig& rConfig) {
+    return rConfig.m_timeStamp;
+  }
+
+  static void destroy(CNxpNfcConfig* pConfig) {
+    pConfig->clean();
+    delete pConfig;
+  }
+};
+
+/* Writes content to a fresh file in the temp directory; returns its path. */
+inline string writeTempConfig(const string& content) {
+  const char* tmp = getenv("TMPDIR");
+  string path = string(tmp ? tmp : "/data/local/tmp") + "/nxpcfg_XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd < 0) return string();
+  ssize_t written = write(fd, content.data(), content.size());
+  close(fd);
+  if (written != (ssize_t)content.size()) return string();
+  return path;
+}
+
+/* Directory holding the test binary and its data files. */
+inline string testDataDir() {
+  char path[PATH_MAX];
+  ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  if (len <= 0) return ".";
+  path[len] = '\0';
+  string dir(path);
+  return dir.substr(0, dir.rfind('/'));
+}
+
+/* One line per setting, in table order: NAME=num 0x.. or NAME=str <hex> */
+inline string dumpConfig(const CNxpNfcConfig& rConfig) {
+  string out;
+  for (const CNxpNfcParam* pParam : rConfig) {
+    out += *pParam;
+    if (pParam->str_len() > 0) {
+      out += "=str";
+      const unsigned char* p = (const unsigned char*)pParam->str_value();
+      for (size_t n = 0; n < pParam->str_len(); ++n)
+        out += StringPrintf(" %02x", p[n]);
+    } else {
+      out += StringPrintf("=num 0x%lx", pParam->numValue());
+    }
+    out += "\n";
+  }
+  return out;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "NxpConfigPeer.h"
+
+namespace {
+
+string settingName(int i) { return StringPrintf("NXP_SETTING_%04d", i); }
+
+/* Loads a config file with state.range(0) numeric settings. */
+CNxpNfcConfig* loadConfig(int count) {
+  string content;
+  for (int i = 0; i < count; ++i)
+    content += StringPrintf("%s=%d\n", settingName(i).c_str(), i);
+  string path = writeTempConfig(content);
+  CNxpNfcConfig* pConfig = CNxpNfcConfigPeer::create();
+  CNxpNfcConfigPeer::load(*pConfig, path.c_str(), true);
+  unlink(path.c_str());
+  return pConfig;
+}
+
+/* Lookup through the hashed snapshot, as GetNxpNumValue() does */
+void BM_SnapshotLookup(benchmark::State& state) {
+  const int count = state.range(0);
+  CNxpNfcConfig* pConfig = loadConfig(count);
+  vector<string> names;
+  for (int i = 0; i < count; ++i) names.push_back(settingName(i));
+  int i = 0;
+  for (auto _ : state) {
+    unsigned long value = 0;
+    benchmark::DoNotOptimize(
+        pConfig->getValue(names[i].c_str(), value));
+    if (++i == count) i = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+  CNxpNfcConfigPeer::destroy(pConfig);
+}
+BENCHMARK(BM_SnapshotLookup)->Arg(16)->Arg(64)->Arg(256)->Arg(1024);
+
+/* The sorted linear scan lookups used before the snapshot, for comparison */
+void BM_LinearLookup(benchmark::State& state) {
+  const int count = state.range(0);
+  CNxpNfcConfig* pConfig = loadConfig(count);
+  vector<string> names;
+  for (int i = 0; i < count; ++i) names.push_back(settingName(i));
+  int i = 0;
+  for (auto _ : state) {
+    const CNxpNfcParam* pFound = NULL;
+    const char* p_name = names[i].c_str();
+    for (const CNxpNfcParam* pParam : *pConfig) {
+      if (*pParam < p_name) continue;
+      if (*pParam == p_name) pFound = pParam;
+      break;
+    }
+    benchmark::DoNotOptimize(pFound);
+    if (++i == count) i = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+  CNxpNfcConfigPeer::destroy(pConfig);
+}
+BENCHMARK(BM_LinearLookup)->Arg(16)->Arg(64)->Arg(256)->Arg(1024);
+
+/* A config file the size of a full libnfc-nxp.conf: numeric settings and
+ * multi-line byte arrays with comments in between. */
+string bootConfig() {
+  string content;
+  for (int i = 0; i < 120; ++i) {
+    content += "###############################################\n";
+    content += StringPrintf("# setting %d\n", i);
+    if (i % 3 == 0) {
+      content += settingName(i) + "={20, 02, 2B, 0D,\n";
+      for (int line = 0; line < 4; ++line)
+        content += "        28, 01, 00, 21, 01, 00, 30, 01, 08,\n";
+      content += "        }\n";
+    } else {
+      content += StringPrintf("%s=0x%02X\n", settingName(i).c_str(), i);
+    }
+  }
+  return content;
+}
+
+/* Boot-time config load when the cache is missing or stale: parse the file
+ * and write the cache */
+void BM_BootLoadParse(benchmark::State& state) {
+  string source = writeTempConfig(bootConfig());
+  string cache = writeTempConfig("");
+  for (auto _ : state) {
+    unlink(cache.c_str());
+    CNxpNfcConfig* pConfig = CNxpNfcConfigPeer::create();
+    CNxpNfcConfigPeer::setCachePath(*pConfig, cache.c_str());
+    CNxpNfcConfigPeer::loadCached(*pConfig, source.c_str());
+    CNxpNfcConfigPeer::destroy(pConfig);
+  }
+  unlink(cache.c_str());
+  unlink(source.c_str());
+}
+BENCHMARK(BM_BootLoadParse);
+
+/* Boot-time config load from a valid cache */
+void BM_BootLoadCache(benchmark::State& state) {
+  string source = writeTempConfig(bootConfig());
+  string cache = writeTempConfig("");
+  unlink(cache.c_str());
+  CNxpNfcConfig* pWarm = CNxpNfcConfigPeer::create();
+  CNxpNfcConfigPeer::setCachePath(*pWarm, cache.c_str());
+  CNxpNfcConfigPeer::loadCached(*pWarm, source.c_str());
+  CNxpNfcConfigPeer::destroy(pWarm);
+  for (auto _ : state) {
+    CNxpNfcConfig* pConfig = CNxpNfcConfigPeer::create();
+    CNxpNfcConfigPeer::setCachePath(*pConfig, cache.c_str());
+    if (!CNxpNfcConfigPeer::loadCache(*pConfig, source.c_str()))
+      state.SkipWithError("cache not used");
+    CNxpNfcConfigPeer::destroy(pConfig);
+  }
+  unlink(cache.c_str());
+  unlink(source.c_str());
+}
+BENCHMARK(BM_BootLoadCache);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Feeds arbitrary bytes to the NXP config parser as a config file.
+ * corpus/ is the seed corpus:
+ *
+ *   sn100nfc_config_fuzzer corpus/
+ *
+ * Besides memory errors, the fuzzer aborts when the parsed table is not
+ * strictly sorted, when the snapshot disagrees with the table, or when
+ * merging the same file over itself changes the table.
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "NxpConfigPeer.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  static const string path = writeTempConfig("");
+  int fd = open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+  if (fd < 0) abort();
+  if (write(fd, data, size) != (ssize_t)size) abort();
+  close(fd);
+
+  CNxpNfcConfig* pConfig = CNxpNfcConfigPeer::create();
+  CNxpNfcConfigPeer::load(*pConfig, path.c_str(), true);
+  const string table = dumpConfig(*pConfig);
+
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = pConfig->snapshot();
+  if ((snap == nullptr) != pConfig->empty()) abort();
+  for (size_t n = 0; n < pConfig->size(); ++n) {
+    const CNxpNfcParam* pParam = (*pConfig)[n];
+    if (n > 0 && !(*(*pConfig)[n - 1] < *pParam)) abort();
+    const CNxpNfcParam* pFound = snap->find(pParam->c_str());
+    if (pFound == nullptr || *pFound != *pParam ||
+        pFound->numValue() != pParam->numValue() ||
+        pFound->str_len() != pParam->str_len())
+      abort();
+  }
+
+  CNxpNfcConfigPeer::load(*pConfig, path.c_str(), false);
+  if (dumpConfig(*pConfig) != table) abort();
+
+  CNxpNfcConfigPeer::destroy(pConfig);
+  return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "NxpConfigPeer.h"
+
+namespace {
+
+const char kBaseConfig[] =
+    "# base\n"
+    "NXP_DEFAULT_SE=0x02\n"
+    "NXP_NFC_CHIP=\"SN100\"\n"
+    "NXP_CORE_CONF={20, 02, 05, 01}\n"
+    "NXP_SWP_RD_START_TIMEOUT=10\n";
+
+class NxpConfigTest : public ::testing::Test {
+ protected:
+  void SetUp() override { mConfig = CNxpNfcConfigPeer::create(); }
+  void TearDown() override {
+    CNxpNfcConfigPeer::destroy(mConfig);
+    for (const string& path : mFiles) unlink(path.c_str());
+  }
+
+  bool load(const string& content, bool bResetContent) {
+    string path = writeTempConfig(content);
+    EXPECT_FALSE(path.empty());
+    mFiles.push_back(path);
+    return CNxpNfcConfigPeer::load(*mConfig, path.c_str(), bResetContent);
+  }
+
+  CNxpNfcConfig* mConfig;
+  vector<string> mFiles;
+};
+
+TEST_F(NxpConfigTest, NoSnapshotBeforeLoad) {
+  EXPECT_EQ(nullptr, mConfig->snapshot());
+  unsigned long value = 0;
+  EXPECT_FALSE(mConfig->getValue("NXP_DEFAULT_SE", value));
+}
+
+TEST_F(NxpConfigTest, LooksUpEveryKind) {
+  ASSERT_TRUE(load(kBaseConfig, true));
+
+  unsigned long num = 0;
+  EXPECT_TRUE(mConfig->getValue("NXP_DEFAULT_SE", num));
+  EXPECT_EQ(0x02u, num);
+  EXPECT_TRUE(mConfig->getValue("NXP_SWP_RD_START_TIMEOUT", num));
+  EXPECT_EQ(10u, num);
+
+  char str[16];
+  EXPECT_TRUE(mConfig->getValue("NXP_NFC_CHIP", str, sizeof(str)));
+  EXPECT_STREQ("SN100", str);
+
+  char bytes[8];
+  long len = 0;
+  EXPECT_TRUE(
+      mConfig->getValue("NXP_CORE_CONF", bytes, (long)sizeof(bytes), &len));
+  ASSERT_EQ(4, len);
+  EXPECT_EQ(0x20, bytes[0]);
+  EXPECT_EQ(0x01, bytes[3]);
+
+  EXPECT_FALSE(mConfig->getValue("NXP_NOT_THERE", num));
+  EXPECT_FALSE(mConfig->getValue("NXP_DEFAULT_S", num));
+}
+
+TEST_F(NxpConfigTest, OverlayReplacesSnapshot) {
+  ASSERT_TRUE(load(kBaseConfig, true));
+  shared_ptr<const CNxpNfcConfigSnapshot> before = mConfig->snapshot();
+
+  ASSERT_TRUE(load("NXP_EXTRA=7\n", false));
+  shared_ptr<const CNxpNfcConfigSnapshot> after = mConfig->snapshot();
+  ASSERT_NE(before, after);
+
+  // The old snapshot is immutable: it does not see the overlay
+  EXPECT_EQ(nullptr, before->find("NXP_EXTRA"));
+  ASSERT_NE(nullptr, after->find("NXP_EXTRA"));
+  EXPECT_EQ(7u, after->find("NXP_EXTRA")->numValue());
+  EXPECT_NE(nullptr, after->find("NXP_DEFAULT_SE"));
+}
+
+TEST_F(NxpConfigTest, ReloadKeepsHeldSnapshotAlive) {
+  ASSERT_TRUE(load(kBaseConfig, true));
+  shared_ptr<const CNxpNfcConfigSnapshot> held = mConfig->snapshot();
+  const CNxpNfcParam* pParam = held->find("NXP_NFC_CHIP");
+  ASSERT_NE(nullptr, pParam);
+
+  // A reset reload deletes the setting objects of the old table
+  ASSERT_TRUE(load("NXP_NFC_CHIP=\"OTHER\"\n", true));
+  EXPECT_STREQ("SN100", pParam->str_value());
+
+  char str[16];
+  EXPECT_TRUE(mConfig->getValue("NXP_NFC_CHIP", str, sizeof(str)));
+  EXPECT_STREQ("OTHER", str);
+  unsigned long num = 0;
+  EXPECT_FALSE(mConfig->getValue("NXP_DEFAULT_SE", num));
+}
+
+TEST_F(NxpConfigTest, CleanUnpublishes) {
+  ASSERT_TRUE(load(kBaseConfig, true));
+  mConfig->clean();
+  EXPECT_EQ(nullptr, mConfig->snapshot());
+}
+
+TEST_F(NxpConfigTest, MissingFileKeepsSnapshot) {
+  ASSERT_TRUE(load(kBaseConfig, true));
+  EXPECT_FALSE(CNxpNfcConfigPeer::load(*mConfig, "/nonexistent/x.conf", true));
+  EXPECT_NE(nullptr, mConfig->snapshot());
+}
+
+TEST_F(NxpConfigTest, LastDuplicateInFileWins) {
+  ASSERT_TRUE(load("B=1\nA=1\nB=2\nC=1\nB=3\n", true));
+  ASSERT_EQ(3u, mConfig->size());
+  unsigned long num = 0;
+  EXPECT_TRUE(mConfig->getValue("B", num));
+  EXPECT_EQ(3u, num);
+}
+
+TEST_F(NxpConfigTest, OverlayMergesSortedAndUnique) {
+  ASSERT_TRUE(load("D=1\nB=1\nF=1\n", true));
+  ASSERT_TRUE(load("E=2\nB=2\nA=2\nB=3\n", false));
+  ASSERT_TRUE(load("G=3\nA=3\n", false));
+
+  vector<string> names;
+  for (const CNxpNfcParam* pParam : *mConfig) names.push_back(*pParam);
+  EXPECT_EQ((vector<string>{"A", "B", "D", "E", "F", "G"}), names);
+
+  unsigned long num = 0;
+  EXPECT_TRUE(mConfig->getValue("A", num));
+  EXPECT_EQ(3u, num);
+  EXPECT_TRUE(mConfig->getValue("B", num));
+  EXPECT_EQ(3u, num);
+  EXPECT_TRUE(mConfig->getValue("D", num));
+  EXPECT_EQ(1u, num);
+}
+
+TEST_F(NxpConfigTest, EmptyOverlayKeepsSettings) {
+  ASSERT_TRUE(load(kBaseConfig, true));
+  EXPECT_TRUE(load("# nothing here\n", false));
+  EXPECT_EQ(4u, mConfig->size());
+}
+
+/* Every file in corpus/ must parse to the table recorded in expected/. The
+ * expected tables were produced by the byte-at-a-time fread() parser the
+ * mapped parser replaced. The same files seed sn100nfc_config_fuzzer. */
+TEST_F(NxpConfigTest, CorpusMatchesExpected) {
+  const string dir = testDataDir();
+  DIR* pDir = opendir((dir + "/corpus").c_str());
+  ASSERT_NE(nullptr, pDir) << dir << "/corpus";
+  int files = 0;
+  while (struct dirent* pEntry = readdir(pDir)) {
+    string name(pEntry->d_name);
+    if (name.size() < 5 || name.compare(name.size() - 5, 5, ".conf") != 0)
+      continue;
+    string base = name.substr(0, name.size() - 5);
+    ifstream expected(dir + "/expected/" + base + ".txt");
+    ASSERT_TRUE(expected.good()) << "no expected table for " << name;
+    stringstream want;
+    want << expected.rdbuf();
+
+    CNxpNfcConfig* pConfig = CNxpNfcConfigPeer::create();
+    CNxpNfcConfigPeer::load(*pConfig, (dir + "/corpus/" + name).c_str(),
+                            true);
+    EXPECT_EQ(want.str(), dumpConfig(*pConfig)) << name;
+    CNxpNfcConfigPeer::destroy(pConfig);
+    ++files;
+  }
+  closedir(pDir);
+  EXPECT_GT(files, 0);
+}
+
+class NxpConfigCacheTest : public NxpConfigTest {
+ protected:
+  void SetUp() override {
+    NxpConfigTest::SetUp();
+    mCachePath = writeTempConfig("");
+    unlink(mCachePath.c_str());
+    mFiles.push_back(mCachePath);
+    mSource = writeTempConfig(kBaseConfig);
+    mFiles.push_back(mSource);
+    CNxpNfcConfigPeer::setCachePath(*mConfig, mCachePath.c_str());
+  }
+
+  /* Runs a boot-time load on a fresh instance; returns its table. */
+  string bootLoad(bool* pFromCache) {
+    CNxpNfcConfig* pConfig = CNxpNfcConfigPeer::create();
+    CNxpNfcConfigPeer::setCachePath(*pConfig, mCachePath.c_str());
+    *pFromCache = CNxpNfcConfigPeer::loadCache(*pConfig, mSource.c_str());
+    if (!*pFromCache) CNxpNfcConfigPeer::loadCached(*pConfig, mSource.c_str());
+    string table = dumpConfig(*pConfig);
+    CNxpNfcConfigPeer::destroy(pConfig);
+    return table;
+  }
+
+  string mCachePath;
+  string mSource;
+};
+
+TEST_F(NxpConfigCacheTest, ParseWritesCacheThenCacheIsUsed) {
+  ASSERT_FALSE(CNxpNfcConfigPeer::loadCache(*mConfig, mSource.c_str()));
+  ASSERT_TRUE(CNxpNfcConfigPeer::loadCached(*mConfig, mSource.c_str()));
+  const string parsed = dumpConfig(*mConfig);
+  EXPECT_EQ(0, access(mCachePath.c_str(), F_OK));
+
+  bool fromCache = false;
+  EXPECT_EQ(parsed, bootLoad(&fromCache));
+  EXPECT_TRUE(fromCache);
+}
+
+TEST_F(NxpConfigCacheTest, CacheLoadPublishesSnapshot) {
+  ASSERT_TRUE(CNxpNfcConfigPeer::loadCached(*mConfig, mSource.c_str()));
+  CNxpNfcConfig* pConfig = CNxpNfcConfigPeer::create();
+  CNxpNfcConfigPeer::setCachePath(*pConfig, mCachePath.c_str());
+  ASSERT_TRUE(CNxpNfcConfigPeer::loadCache(*pConfig, mSource.c_str()));
+
+  char str[16];
+  EXPECT_TRUE(pConfig->getValue("NXP_NFC_CHIP", str, sizeof(str)));
+  EXPECT_STREQ("SN100", str);
+  EXPECT_EQ(CNxpNfcConfigPeer::timeStamp(*mConfig),
+            CNxpNfcConfigPeer::timeStamp(*pConfig));
+  CNxpNfcConfigPeer::destroy(pConfig);
+}
+
+TEST_F(NxpConfigCacheTest, EditedSourceIsParsedAgain) {
+  ASSERT_TRUE(CNxpNfcConfigPeer::loadCached(*mConfig, mSource.c_str()));
+
+  FILE* fp = fopen(mSource.c_str(), "a");
+  ASSERT_NE(nullptr, fp);
+  fputs("NXP_ADDED=1\n", fp);
+  fclose(fp);
+
+  bool fromCache = true;
+  string table = bootLoad(&fromCache);
+  EXPECT_FALSE(fromCache);
+  EXPECT_NE(string::npos, table.find("NXP_ADDED=num 0x1"));
+
+  // the parse rewrote the cache for the edited file
+  table = bootLoad(&fromCache);
+  EXPECT_TRUE(fromCache);
+  EXPECT_NE(string::npos, table.find("NXP_ADDED=num 0x1"));
+}
+
+TEST_F(NxpConfigCacheTest, CorruptCacheIsIgnored) {
+  ASSERT_TRUE(CNxpNfcConfigPeer::loadCached(*mConfig, mSource.c_str()));
+  const string parsed = dumpConfig(*mConfig);
+
+  FILE* fp = fopen(mCachePath.c_str(), "r+");
+  ASSERT_NE(nullptr, fp);
+  fseek(fp, -1, SEEK_END);
+  int c = fgetc(fp);
+  fseek(fp, -1, SEEK_END);
+  fputc(c ^ 0x5A, fp);
+  fclose(fp);
+
+  bool fromCache = true;
+  EXPECT_EQ(parsed, bootLoad(&fromCache));
+  EXPECT_FALSE(fromCache);
+}
+
+TEST_F(NxpConfigCacheTest, CacheOfOtherFileIsIgnored) {
+  ASSERT_TRUE(CNxpNfcConfigPeer::loadCached(*mConfig, mSource.c_str()));
+  string other = writeTempConfig("NXP_OTHER=1\n");
+  mFiles.push_back(other);
+  EXPECT_FALSE(CNxpNfcConfigPeer::loadCache(*mConfig, other.c_str()));
+}
+
+}  // namespace
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "sparse_crc32.cpp"
+
+namespace {
+
+void BM_Crc32Reference(benchmark::State& state) {
+  std::vector<uint8_t> data(state.range(0), 0x5A);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(sparse_crc32(0, data.data(), data.size()));
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc32Reference)->Arg(64)->Arg(1024)->Arg(16384)->Arg(262144);
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+void BM_Crc32Slice8(benchmark::State& state) {
+  std::vector<uint8_t> data(state.range(0), 0x5A);
+  crc32_slice8_init();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        crc32_slice8(~0U, data.data(), data.size()) ^ ~0U);
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc32Slice8)->Arg(64)->Arg(1024)->Arg(16384)->Arg(262144);
+#endif
+
+/* Whatever implementation the running CPU selects */
+void BM_Crc32Fast(benchmark::State& state) {
+  std::vector<uint8_t> data(state.range(0), 0x5A);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(sparse_crc32_fast(0, data.data(), data.size()));
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc32Fast)->Arg(64)->Arg(1024)->Arg(16384)->Arg(262144);
+
+}  // namespace
+
+BENCHMARK_MAIN();
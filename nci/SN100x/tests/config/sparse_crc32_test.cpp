@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Randomized equivalence of every sparse_crc32_fast() implementation with
+ * the byte-at-a-time sparse_crc32(). sparse_crc32.cpp is compiled in so the
+ * implementations the running CPU does not select are tested as well.
+ */
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "sparse_crc32.cpp"
+
+namespace {
+
+struct Impl {
+  const char* name;
+  crc32_impl_t fn;
+};
+
+std::vector<Impl> availableImpls() {
+  std::vector<Impl> impls = {{"bytes", crc32_bytes}};
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+  crc32_slice8_init();
+  impls.push_back({"slice8", crc32_slice8});
+#endif
+#if defined(__aarch64__)
+  if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+    impls.push_back({"armv8", crc32_armv8});
+#elif defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) &&
+      (ecx & bit_SSE4_1))
+    impls.push_back({"pclmul", crc32_pclmul});
+#endif
+  return impls;
+}
+
+uint32_t runImpl(const Impl& impl, uint32_t crc, const uint8_t* p,
+                 size_t size) {
+  return impl.fn(crc ^ ~0U, p, size) ^ ~0U;
+}
+
+TEST(SparseCrc32Test, KnownValues) {
+  const char check[] = "123456789";
+  EXPECT_EQ(0xCBF43926u, sparse_crc32(0, check, 9));
+  EXPECT_EQ(0xCBF43926u, sparse_crc32_fast(0, check, 9));
+  EXPECT_EQ(0u, sparse_crc32_fast(0, check, 0));
+  for (const Impl& impl : availableImpls())
+    EXPECT_EQ(0xCBF43926u, runImpl(impl, 0, (const uint8_t*)check, 9))
+        << impl.name;
+}
+
+/* Random lengths around every folding and slicing boundary, at every
+ * alignment, with random seeds */
+TEST(SparseCrc32Test, RandomBuffersMatchReference) {
+  std::mt19937 rng(20181017);
+  std::vector<uint8_t> data(4096 + 16);
+  for (uint8_t& b : data) b = rng();
+  const std::vector<Impl> impls = availableImpls();
+
+  for (int round = 0; round < 4000; ++round) {
+    size_t size;
+    if (round < 300)
+      size = round;
+    else
+      size = rng() % 4096;
+    const size_t offset = rng() % 16;
+    const uint32_t seed = (round & 1) ? rng() : 0;
+    const uint8_t* p = data.data() + offset;
+
+    const uint32_t want = sparse_crc32(seed, p, size);
+    EXPECT_EQ(want, sparse_crc32_fast(seed, p, size))
+        << "size " << size << " offset " << offset;
+    for (const Impl& impl : impls)
+      ASSERT_EQ(want, runImpl(impl, seed, p, size))
+          << impl.name << " size " << size << " offset " << offset;
+  }
+}
+
+/* Feeding a buffer in random pieces gives the CRC of the whole buffer */
+TEST(SparseCrc32Test, ChainedPiecesMatchWhole) {
+  std::mt19937 rng(42);
+  std::vector<uint8_t> data(10000);
+  for (uint8_t& b : data) b = rng();
+  const uint32_t want = sparse_crc32(0, data.data(), data.size());
+
+  for (int round = 0; round < 200; ++round) {
+    uint32_t crc = 0;
+    size_t pos = 0;
+    while (pos < data.size()) {
+      size_t piece = std::min<size_t>(rng() % 700, data.size() - pos);
+      crc = sparse_crc32_fast(crc, data.data() + pos, piece);
+      pos += piece;
+    }
+    ASSERT_EQ(want, crc) << "round " << round;
+  }
+}
+
+}  // namespace
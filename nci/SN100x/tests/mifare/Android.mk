@@ -0,0 +1,51 @@
+LOCAL_PATH := $(call my-dir)
+SN100X_VOB := vendor/nxp/opensource/commonsys/external/libnfc-nci/SN100x/src
+SN100X_LIBNFC := vendor/nxp/opensource/commonsys/external/libnfc-nci
+
+# The card model and the tests are shared with the other JNI library, see
+# tests/jni; here they run against the SN100x copy of the extension.
+# No -Werror: the extension sources are built without it in the library too.
+NQNFC_MIFARE_TESTS := ../../../tests/jni
+SN100X_EXTNS := ../../jni/extns/pn54x
+SN100X_MIFARE_SRC := \
+    $(NQNFC_MIFARE_TESTS)/SimulatedMifareClassic.cpp \
+    $(SN100X_EXTNS)/src/phNxpExtns.cpp \
+    $(SN100X_EXTNS)/src/mifare/phFriNfc_MifareStdMap.cpp \
+    $(SN100X_EXTNS)/src/mifare/phFriNfc_MifStdFormat.cpp \
+    $(SN100X_EXTNS)/src/mifare/phFriNfc_SmtCrdFmt.cpp \
+    $(SN100X_EXTNS)/src/mifare/phNxpExtns_MifareStd.cpp
+
+SN100X_MIFARE_INCLUDES := \
+    $(LOCAL_PATH)/$(NQNFC_MIFARE_TESTS) \
+    $(LOCAL_PATH)/../../jni \
+    $(LOCAL_PATH)/$(SN100X_EXTNS)/inc \
+    $(LOCAL_PATH)/$(SN100X_EXTNS)/src/common \
+    $(LOCAL_PATH)/$(SN100X_EXTNS)/src/log \
+    $(LOCAL_PATH)/$(SN100X_EXTNS)/src/mifare \
+    $(LOCAL_PATH)/$(SN100X_EXTNS)/src/utils \
+    $(SN100X_VOB)/include \
+    $(SN100X_VOB)/nfa/include \
+    $(SN100X_VOB)/nfc/include \
+    $(SN100X_VOB)/gki/ulinux \
+    $(SN100X_VOB)/gki/common \
+    $(SN100X_LIBNFC)/SN100x/utils/include
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_mifare_test
+LOCAL_SRC_FILES := $(NQNFC_MIFARE_TESTS)/MifareClassic_test.cpp \
+    $(SN100X_MIFARE_SRC)
+LOCAL_C_INCLUDES := $(SN100X_MIFARE_INCLUDES)
+LOCAL_SHARED_LIBRARIES := libbase libchrome liblog
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_mifare_benchmark
+LOCAL_SRC_FILES := $(NQNFC_MIFARE_TESTS)/MifareClassic_benchmark.cpp \
+    $(SN100X_MIFARE_SRC)
+LOCAL_C_INCLUDES := $(SN100X_MIFARE_INCLUDES)
+LOCAL_SHARED_LIBRARIES := libbase libchrome liblog
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter
+include $(BUILD_NATIVE_BENCHMARK)
@@ -0,0 +1,53 @@
+LOCAL_PATH := $(call my-dir)
+# PeerToPeer is the same in both JNI libraries; so are its test and
+# benchmark, built here against the SN100x copy
+NQNFC_P2P_TESTS := ../../../tests/jni
+SN100X_VOB := vendor/nxp/opensource/commonsys/external/libnfc-nci/SN100x/src
+
+SN100X_P2P_TEST_INCLUDES := \
+    $(LOCAL_PATH)/../../jni \
+    $(LOCAL_PATH)/$(NQNFC_P2P_TESTS) \
+    libnativehelper/include/nativehelper \
+    $(SN100X_VOB)/nfa/include \
+    $(SN100X_VOB)/nfc/include \
+    $(SN100X_VOB)/include \
+    $(SN100X_VOB)/gki/ulinux \
+    $(SN100X_VOB)/gki/common
+
+SN100X_P2P_TEST_LIBS := \
+    libbase \
+    libchrome \
+    libnativehelper \
+    libutils \
+    libsn100nfc-nci \
+    libsn100nfc_nci_jni
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_p2p_test
+LOCAL_SRC_FILES := $(NQNFC_P2P_TESTS)/PeerToPeer_test.cpp \
+    $(NQNFC_P2P_TESTS)/SimulatedLlcp.cpp
+LOCAL_C_INCLUDES := $(SN100X_P2P_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(SN100X_P2P_TEST_LIBS)
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+ifeq (true,$(TARGET_IS_64_BIT))
+LOCAL_MULTILIB := 64
+else
+LOCAL_MULTILIB := 32
+endif
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_p2p_benchmark
+LOCAL_SRC_FILES := $(NQNFC_P2P_TESTS)/PeerToPeer_benchmark.cpp \
+    $(NQNFC_P2P_TESTS)/SimulatedLlcp.cpp
+LOCAL_C_INCLUDES := $(SN100X_P2P_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(SN100X_P2P_TEST_LIBS)
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+ifeq (true,$(TARGET_IS_64_BIT))
+LOCAL_MULTILIB := 64
+else
+LOCAL_MULTILIB := 32
+endif
+include $(BUILD_NATIVE_BENCHMARK)
@@ -0,0 +1,60 @@
+LOCAL_PATH := $(call my-dir)
+SN100X_VOB := vendor/nxp/opensource/commonsys/external/libnfc-nci/SN100x/src
+SN100X_LIBNFC := vendor/nxp/opensource/commonsys/external/libnfc-nci
+
+SN100X_ROUTING_TEST_INCLUDES := \
+    $(LOCAL_PATH)/../../jni \
+    $(LOCAL_PATH)/../../jni/extns/pn54x/inc \
+    $(LOCAL_PATH)/../../jni/extns/pn54x/src/common \
+    $(LOCAL_PATH)/../../jni/extns/pn54x/src/utils \
+    $(SN100X_VOB)/nfa/include \
+    $(SN100X_VOB)/nfc/include \
+    $(SN100X_VOB)/include \
+    $(SN100X_VOB)/gki/ulinux \
+    $(SN100X_VOB)/gki/common \
+    $(SN100X_LIBNFC)/SN100x/utils/include
+
+SN100X_ROUTING_TEST_LIBS := \
+    libbase \
+    libchrome \
+    libnativehelper \
+    libsn100nfc-nci \
+    libsn100nfc_nci_jni
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_routing_benchmark
+LOCAL_SRC_FILES := RoutingManager_benchmark.cpp SimulatedNfaEe.cpp
+LOCAL_C_INCLUDES := $(SN100X_ROUTING_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(SN100X_ROUTING_TEST_LIBS)
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+ifeq (true,$(TARGET_IS_64_BIT))
+LOCAL_MULTILIB := 64
+else
+LOCAL_MULTILIB := 32
+endif
+include $(BUILD_NATIVE_BENCHMARK)
+
+# The planner test is shared with the other JNI library, see tests/jni
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_lmrtplanner_test
+LOCAL_SRC_FILES := ../../../tests/jni/LmrtPlanner_test.cpp \
+    ../../jni/LmrtPlanner.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../jni
+LOCAL_SHARED_LIBRARIES := libbase libchrome
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_hce_response_test
+LOCAL_SRC_FILES := HceStaticResponse_test.cpp SimulatedNfaEe.cpp
+LOCAL_C_INCLUDES := $(SN100X_ROUTING_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(SN100X_ROUTING_TEST_LIBS)
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+ifeq (true,$(TARGET_IS_64_BIT))
+LOCAL_MULTILIB := 64
+else
+LOCAL_MULTILIB := 32
+endif
+include $(BUILD_NATIVE_TEST)
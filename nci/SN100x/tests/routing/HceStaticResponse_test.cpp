@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <vector>
+
+#include "SimulatedNfaEe.h"
+
+namespace {
+std::mutex sFramesLock;
+std::vector<std::vector<uint8_t> > sFrames;
+
+std::vector<std::vector<uint8_t> > takeFrames() {
+  std::lock_guard<std::mutex> lock(sFramesLock);
+  std::vector<std::vector<uint8_t> > frames;
+  frames.swap(sFrames);
+  return frames;
+}
+}  // namespace
+
+// Interpose on the libsn100nfc-nci definition; collects what the stack
+// would have sent to the reader.
+tNFA_STATUS NFA_SendRawFrame(uint8_t* p_raw_data, uint16_t data_len,
+                             uint16_t presence_check_start_delay) {
+  std::lock_guard<std::mutex> lock(sFramesLock);
+  sFrames.emplace_back(p_raw_data, p_raw_data + data_len);
+  return NFA_STATUS_OK;
+}
+
+namespace {
+
+const uint8_t kTech = NFA_TECHNOLOGY_MASK_A;
+const std::vector<uint8_t> kAid = {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10};
+const std::vector<uint8_t> kOtherAid = {0xA0, 0x00, 0x00, 0x00, 0x04, 0x10,
+                                        0x10};
+const std::vector<uint8_t> kFci = {0x6F, 0x04, 0x84, 0x02, 0xA0, 0x00,
+                                   0x90, 0x00};
+const std::vector<uint8_t> kGpo = {0x80, 0xA8, 0x00, 0x00, 0x02,
+                                   0x83, 0x00, 0x00};
+const std::vector<uint8_t> kGpoResponse = {0x77, 0x02, 0x82, 0x00, 0x90, 0x00};
+const std::vector<uint8_t> kReadRecord = {0x00, 0xB2, 0x01, 0x0C, 0x00};
+
+std::vector<uint8_t> select(const std::vector<uint8_t>& aid) {
+  std::vector<uint8_t> cmd = {0x00, 0xA4, 0x04, 0x00, (uint8_t)aid.size()};
+  cmd.insert(cmd.end(), aid.begin(), aid.end());
+  cmd.push_back(0x00);
+  return cmd;
+}
+
+std::vector<uint8_t> fullMask(size_t len) {
+  return std::vector<uint8_t>(len, 0xFF);
+}
+
+bool setResponse(int owner, const std::vector<uint8_t>& aid,
+                 const std::vector<uint8_t>& command,
+                 const std::vector<uint8_t>& mask,
+                 const std::vector<uint8_t>& response) {
+  return RoutingManager::getInstance().setHceStaticResponse(
+      owner, aid.data(), aid.size(), command.data(), mask.data(),
+      command.size(), response.data(), response.size());
+}
+
+class HceStaticResponseTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    RoutingManager::getInstance().clearHceStaticResponses(-1);
+    RoutingManagerPeer::resetHceSession();
+    takeFrames();
+  }
+  void TearDown() override {
+    RoutingManager::getInstance().clearHceStaticResponses(-1);
+  }
+
+  bool send(const std::vector<uint8_t>& apdu) {
+    return RoutingManagerPeer::answerHceFromCache(kTech, apdu, mReplay);
+  }
+
+  std::vector<uint8_t> mReplay;
+};
+
+TEST_F(HceStaticResponseTest, RejectsMalformedEntries) {
+  std::vector<uint8_t> sel = select(kAid);
+  EXPECT_FALSE(setResponse(1, {}, sel, fullMask(sel.size()), kFci));
+  EXPECT_FALSE(setResponse(1, kAid, {0x00, 0xA4, 0x04}, fullMask(3), kFci));
+  EXPECT_FALSE(setResponse(1, kAid, sel, fullMask(sel.size()), {0x90}));
+  EXPECT_TRUE(setResponse(1, kAid, sel, fullMask(sel.size()), kFci));
+}
+
+TEST_F(HceStaticResponseTest, AnswersRegisteredCommandsFromTheStack) {
+  std::vector<uint8_t> sel = select(kAid);
+  ASSERT_TRUE(setResponse(1, kAid, sel, fullMask(sel.size()), kFci));
+  ASSERT_TRUE(setResponse(1, kAid, kGpo, fullMask(kGpo.size()), kGpoResponse));
+
+  EXPECT_TRUE(send(sel));
+  EXPECT_TRUE(send(kGpo));
+  std::vector<std::vector<uint8_t> > expected = {kFci, kGpoResponse};
+  EXPECT_EQ(expected, takeFrames());
+
+  // The first APDU Java sees carries the SELECT it has not seen yet
+  EXPECT_FALSE(send(kReadRecord));
+  EXPECT_EQ(sel, mReplay);
+  EXPECT_TRUE(takeFrames().empty());
+  // and only the first
+  EXPECT_FALSE(send(kReadRecord));
+  EXPECT_TRUE(mReplay.empty());
+}
+
+TEST_F(HceStaticResponseTest, ComparesOnlyMaskedBits) {
+  std::vector<uint8_t> mask = fullMask(kGpo.size());
+  mask[6] = mask[7] = 0x00;  // PDOL data may vary
+  ASSERT_TRUE(setResponse(1, kAid, kGpo, mask, kGpoResponse));
+  // Nothing cached for the SELECT, so Java answers it
+  EXPECT_FALSE(send(select(kAid)));
+  EXPECT_TRUE(mReplay.empty());
+
+  std::vector<uint8_t> gpo = kGpo;
+  gpo[6] = 0x12;
+  gpo[7] = 0x34;
+  EXPECT_TRUE(send(gpo));
+  gpo[5] = 0x84;
+  EXPECT_FALSE(send(gpo));
+  gpo.push_back(0x00);
+  EXPECT_FALSE(send(gpo));
+  EXPECT_EQ(std::vector<std::vector<uint8_t> >({kGpoResponse}), takeFrames());
+}
+
+TEST_F(HceStaticResponseTest, AnswersOnlyForTheSelectedAid) {
+  ASSERT_TRUE(setResponse(1, kAid, kGpo, fullMask(kGpo.size()), kGpoResponse));
+  EXPECT_FALSE(send(kGpo));  // nothing selected yet
+  EXPECT_FALSE(send(select(kOtherAid)));
+  EXPECT_FALSE(send(kGpo));
+  EXPECT_FALSE(send(select(kAid)));
+  EXPECT_TRUE(send(kGpo));
+  EXPECT_EQ(1u, takeFrames().size());
+}
+
+TEST_F(HceStaticResponseTest, ClearingAnOwnerInvalidatesItsEntries) {
+  std::vector<uint8_t> sel = select(kAid);
+  std::vector<uint8_t> otherSel = select(kOtherAid);
+  ASSERT_TRUE(setResponse(1, kAid, sel, fullMask(sel.size()), kFci));
+  ASSERT_TRUE(
+      setResponse(2, kOtherAid, otherSel, fullMask(otherSel.size()), kFci));
+  EXPECT_TRUE(send(sel));
+  takeFrames();
+
+  RoutingManager::getInstance().clearHceStaticResponses(1);
+  EXPECT_FALSE(send(sel));
+  // Java gets this SELECT itself, so nothing is replayed later
+  EXPECT_TRUE(mReplay.empty());
+  EXPECT_FALSE(send(kGpo));
+  EXPECT_TRUE(mReplay.empty());
+  EXPECT_TRUE(send(otherSel));
+
+  RoutingManager::getInstance().clearHceStaticResponses(-1);
+  EXPECT_FALSE(send(otherSel));
+  EXPECT_EQ(1u, takeFrames().size());
+}
+
+TEST_F(HceStaticResponseTest, NewOwnerOfAnAidReplacesTheOldOne) {
+  std::vector<uint8_t> sel = select(kAid);
+  ASSERT_TRUE(setResponse(1, kAid, sel, fullMask(sel.size()), kFci));
+  ASSERT_TRUE(setResponse(2, kAid, kGpo, fullMask(kGpo.size()), kGpoResponse));
+  EXPECT_FALSE(send(sel));
+  EXPECT_TRUE(send(kGpo));
+  EXPECT_EQ(std::vector<std::vector<uint8_t> >({kGpoResponse}), takeFrames());
+}
+
+TEST_F(HceStaticResponseTest, NfcFIsNeverAnswered) {
+  std::vector<uint8_t> sel = select(kAid);
+  ASSERT_TRUE(setResponse(1, kAid, sel, fullMask(sel.size()), kFci));
+  std::vector<uint8_t> replay;
+  EXPECT_FALSE(RoutingManagerPeer::answerHceFromCache(NFA_TECHNOLOGY_MASK_F,
+                                                      sel, replay));
+  EXPECT_TRUE(takeFrames().empty());
+}
+
+}  // namespace
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <vector>
+
+#include "SimulatedNfaEe.h"
+
+namespace {
+
+// Args: NCI round trip in us; 1 to route Nfc-F to another NFCEE than Nfc-A,
+// which doubles the default-routing entries
+void setUp(benchmark::State& state) {
+  SimulatedNfaEe::getInstance().setLatency(
+      std::chrono::microseconds(state.range(0)));
+  RoutingManagerPeer::setDefaultRoutes(0x00, state.range(1) ? 0x02 : 0x00, 0,
+                                       false);
+  RoutingManagerPeer::forgetDefaultRouting();
+  SimulatedNfaEe::getInstance().takeRequestCount();
+}
+
+void report(benchmark::State& state, uint32_t requests) {
+  state.counters["requests/op"] = benchmark::Counter(
+      requests, benchmark::Counter::kAvgIterations);
+}
+
+// HCE switched on and off again: only the entries that change are sent
+void BM_ToggleHostRouting(benchmark::State& state) {
+  RoutingManager& rm = RoutingManager::getInstance();
+  setUp(state);
+  for (auto _ : state) {
+    rm.enableRoutingToHost();
+    rm.commitRouting();
+    rm.disableRoutingToHost();
+    rm.commitRouting();
+  }
+  report(state, SimulatedNfaEe::getInstance().takeRequestCount());
+}
+BENCHMARK(BM_ToggleHostRouting)
+    ->Args({0, 0})->Args({0, 1})->Args({1000, 0})->Args({1000, 1})
+    ->UseRealTime();
+
+// Discovery restarted with host routing unchanged, as on every screen-state
+// change: only NFA_EeUpdateNow is left
+void BM_ReapplyHostRouting(benchmark::State& state) {
+  RoutingManager& rm = RoutingManager::getInstance();
+  setUp(state);
+  rm.enableRoutingToHost();
+  SimulatedNfaEe::getInstance().takeRequestCount();
+  for (auto _ : state) {
+    rm.enableRoutingToHost();
+    rm.commitRouting();
+  }
+  report(state, SimulatedNfaEe::getInstance().takeRequestCount());
+}
+BENCHMARK(BM_ReapplyHostRouting)
+    ->Args({0, 0})->Args({0, 1})->Args({1000, 0})->Args({1000, 1})
+    ->UseRealTime();
+
+// The same with the committed table dropped first, which is what every
+// call cost before routing was diffed
+void BM_RewriteHostRouting(benchmark::State& state) {
+  RoutingManager& rm = RoutingManager::getInstance();
+  setUp(state);
+  for (auto _ : state) {
+    RoutingManagerPeer::forgetDefaultRouting();
+    rm.enableRoutingToHost();
+    rm.commitRouting();
+  }
+  report(state, SimulatedNfaEe::getInstance().takeRequestCount());
+}
+BENCHMARK(BM_RewriteHostRouting)
+    ->Args({0, 0})->Args({0, 1})->Args({1000, 0})->Args({1000, 1})
+    ->UseRealTime();
+
+// count AIDs of 10 bytes routed to the host, packed the way
+// NfcService hands them to routeAids()
+std::vector<uint8_t> aidTable(int count) {
+  static const uint8_t kAidLen = 10;
+  std::vector<uint8_t> table;
+  for (int i = 0; i < count; i++) {
+    table.push_back(kAidLen);
+    for (uint8_t b = 0; b < kAidLen - 2; b++) table.push_back(0xA0 + b);
+    table.push_back((uint8_t)(i >> 8));
+    table.push_back((uint8_t)i);
+    table.push_back(SecureElement::DH_ID);  // route
+    table.push_back(0x11);                  // power: switch on, screen lock
+    table.push_back(0x00);                  // aidInfo
+  }
+  return table;
+}
+
+void aidArgs(benchmark::internal::Benchmark* b) {
+  for (int count : {50, 200, 500})
+    for (int latency : {0, 1000}) b->Args({count, latency});
+}
+
+// Args: AIDs in the set, round trip to the NFA task in us.  The simulated
+// table is large enough for every set.
+void BM_AddAidRoutingBatch(benchmark::State& state) {
+  RoutingManager& rm = RoutingManager::getInstance();
+  SimulatedNfaEe::getInstance().setLatency(
+      std::chrono::microseconds(state.range(1)));
+  std::vector<uint8_t> table = aidTable(state.range(0));
+  for (auto _ : state) {
+    if (!rm.addAidRoutingBatch(table.data(), table.size(), state.range(0))) {
+      state.SkipWithError("batch failed");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  SimulatedNfaEe::getInstance().takeRequestCount();
+}
+BENCHMARK(BM_AddAidRoutingBatch)->Apply(aidArgs)->UseRealTime();
+
+// The same set through addAidRouting(), one round trip per AID
+void BM_AddAidRoutingEach(benchmark::State& state) {
+  RoutingManager& rm = RoutingManager::getInstance();
+  SimulatedNfaEe::getInstance().setLatency(
+      std::chrono::microseconds(state.range(1)));
+  std::vector<uint8_t> table = aidTable(state.range(0));
+  for (auto _ : state) {
+    for (size_t offset = 0; offset < table.size();) {
+      uint8_t aidLen = table[offset];
+      rm.addAidRouting(&table[offset + 1], aidLen, table[offset + 1 + aidLen],
+                       table[offset + 3 + aidLen], table[offset + 2 + aidLen]);
+      offset += 1 + aidLen + 3;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  SimulatedNfaEe::getInstance().takeRequestCount();
+}
+BENCHMARK(BM_AddAidRoutingEach)->Apply(aidArgs)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
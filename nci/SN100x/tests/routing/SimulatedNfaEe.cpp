@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SimulatedNfaEe.h"
+
+#include <string.h>
+
+SimulatedNfaEe& SimulatedNfaEe::getInstance() {
+  static SimulatedNfaEe* sNfaEe = new SimulatedNfaEe();
+  return *sNfaEe;
+}
+
+SimulatedNfaEe::SimulatedNfaEe() : mLatency(0), mRequests(0) {
+  std::thread(&SimulatedNfaEe::run, this).detach();
+}
+
+void SimulatedNfaEe::setLatency(std::chrono::microseconds latency) {
+  std::lock_guard<std::mutex> lock(mLock);
+  mLatency = latency;
+}
+
+uint32_t SimulatedNfaEe::takeRequestCount() {
+  std::lock_guard<std::mutex> lock(mLock);
+  uint32_t requests = mRequests;
+  mRequests = 0;
+  return requests;
+}
+
+tNFA_STATUS SimulatedNfaEe::request(tNFA_EE_EVT answer) {
+  std::lock_guard<std::mutex> lock(mLock);
+  mRequests++;
+  mAnswers.emplace_back(answer, std::chrono::steady_clock::now() + mLatency);
+  mCond.notify_one();
+  return NFA_STATUS_OK;
+}
+
+void SimulatedNfaEe::run() {
+  for (;;) {
+    tNFA_EE_EVT event;
+    std::chrono::steady_clock::time_point due;
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+      mCond.wait(lock, [this] { return !mAnswers.empty(); });
+      event = mAnswers.front().first;
+      due = mAnswers.front().second;
+      mAnswers.pop_front();
+    }
+    std::this_thread::sleep_until(due);
+    tNFA_EE_CBACK_DATA data;
+    memset(&data, 0, sizeof(data));
+    data.status = NFA_STATUS_OK;
+    RoutingManagerPeer::deliver(event, &data);
+  }
+}
+
+// Interpose on the libsn100nfc-nci definitions.
+tNFA_STATUS NFA_EeSetDefaultTechRouting(
+    tNFA_HANDLE ee_handle, tNFA_TECHNOLOGY_MASK technologies_switch_on,
+    tNFA_TECHNOLOGY_MASK technologies_switch_off,
+    tNFA_TECHNOLOGY_MASK technologies_battery_off,
+    tNFA_TECHNOLOGY_MASK technologies_screen_lock,
+    tNFA_TECHNOLOGY_MASK technologies_screen_off,
+    tNFA_TECHNOLOGY_MASK technologies_screen_off_lock) {
+  return SimulatedNfaEe::getInstance().request(NFA_EE_SET_TECH_CFG_EVT);
+}
+
+tNFA_STATUS NFA_EeSetDefaultProtoRouting(
+    tNFA_HANDLE ee_handle, tNFA_PROTOCOL_MASK protocols_switch_on,
+    tNFA_PROTOCOL_MASK protocols_switch_off,
+    tNFA_PROTOCOL_MASK protocols_battery_off,
+    tNFA_PROTOCOL_MASK protocols_screen_lock,
+    tNFA_PROTOCOL_MASK protocols_screen_off,
+    tNFA_PROTOCOL_MASK protocols_screen_off_lock) {
+  return SimulatedNfaEe::getInstance().request(NFA_EE_SET_PROTO_CFG_EVT);
+}
+
+tNFA_STATUS NFA_EeAddAidRouting(tNFA_HANDLE ee_handle, uint8_t aid_len,
+                                uint8_t* p_aid, tNFA_EE_PWR_STATE power_state,
+                                uint8_t aidInfo) {
+  return SimulatedNfaEe::getInstance().request(NFA_EE_ADD_AID_EVT);
+}
+
+// room for any set the benchmarks route
+uint16_t NFA_GetRemainingAidTableSize() { return 0xFFFF; }
+
+tNFA_STATUS NFA_EeUpdateNow(void) {
+  return SimulatedNfaEe::getInstance().request(NFA_EE_UPDATED_EVT);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "RoutingManager.h"
+
+class RoutingManagerPeer {
+ public:
+  // deliver an NFA EE event the way the stack does, from another thread
+  static void deliver(tNFA_EE_EVT event, tNFA_EE_CBACK_DATA* data) {
+    RoutingManager::nfaEeCallback(event, data);
+  }
+  static void setDefaultRoutes(int defaultEe, int felicaRoute,
+                               tNFA_TECHNOLOGY_MASK seTechMask, bool scbr) {
+    RoutingManager& rm = RoutingManager::getInstance();
+    rm.mDefaultEe = defaultEe;
+    rm.mDefaultFelicaRoute = felicaRoute;
+    rm.mSeTechMask = seTechMask;
+    rm.mIsScbrSupported = scbr;
+  }
+  static void forgetDefaultRouting() {
+    RoutingManager::getInstance().forgetDefaultRouting();
+  }
+  static void resetHceSession() {
+    RoutingManager::getInstance().resetHceSession();
+  }
+  // run one complete APDU through the response cache; replay receives the
+  // SELECT Java must see in front of it, if any
+  static bool answerHceFromCache(uint8_t technology,
+                                 const std::vector<uint8_t>& data,
+                                 std::vector<uint8_t>& replay) {
+    std::unique_ptr<RoutingManager::HceApdu_t> apdu(
+        new RoutingManager::HceApdu_t());
+    apdu->technology = technology;
+    apdu->len = data.size();
+    apdu->arrivalUs = 0;
+    apdu->replayLen = 0;
+    memcpy(apdu->data, data.data(), data.size());
+    bool answered = RoutingManager::getInstance().answerHceFromCache(*apdu);
+    replay.assign(apdu->replay, apdu->replay + apdu->replayLen);
+    return answered;
+  }
+};
+
+// Stands in for the NFA EE API.  SimulatedNfaEe.cpp interposes on the
+// routing calls RoutingManager makes so that libsn100nfc_nci_jni sends its
+// requests here; each one is answered with its NFA EE event from the
+// simulator's own thread once the configured round-trip time has passed
+// since it was made.  Requests made back to back are answered back to back.
+class SimulatedNfaEe {
+ public:
+  static SimulatedNfaEe& getInstance();
+
+  void setLatency(std::chrono::microseconds latency);
+  // requests received since the last call
+  uint32_t takeRequestCount();
+
+  tNFA_STATUS request(tNFA_EE_EVT answer);
+
+ private:
+  SimulatedNfaEe();
+  void run();
+
+  std::mutex mLock;
+  std::condition_variable mCond;
+  std::deque<std::pair<tNFA_EE_EVT, std::chrono::steady_clock::time_point>>
+      mAnswers;
+  std::chrono::microseconds mLatency;
+  uint32_t mRequests;
+};
@@ -0,0 +1,50 @@
+LOCAL_PATH := $(call my-dir)
+SN100X_VOB := vendor/nxp/opensource/commonsys/external/libnfc-nci/SN100x/src
+SN100X_LIBNFC := vendor/nxp/opensource/commonsys/external/libnfc-nci
+
+SN100X_SE_TEST_INCLUDES := \
+    $(LOCAL_PATH)/../../jni \
+    $(LOCAL_PATH)/../../jni/extns/pn54x/inc \
+    $(LOCAL_PATH)/../../jni/extns/pn54x/src/common \
+    $(LOCAL_PATH)/../../jni/extns/pn54x/src/utils \
+    $(SN100X_VOB)/nfa/include \
+    $(SN100X_VOB)/nfc/include \
+    $(SN100X_VOB)/include \
+    $(SN100X_VOB)/gki/ulinux \
+    $(SN100X_VOB)/gki/common \
+    $(SN100X_LIBNFC)/SN100x/utils/include
+
+SN100X_SE_TEST_LIBS := \
+    libbase \
+    libchrome \
+    libnativehelper \
+    libsn100nfc-nci \
+    libsn100nfc_nci_jni
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_se_test
+LOCAL_SRC_FILES := SecureElement_test.cpp SimulatedEse.cpp
+LOCAL_C_INCLUDES := $(SN100X_SE_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(SN100X_SE_TEST_LIBS)
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+ifeq (true,$(TARGET_IS_64_BIT))
+LOCAL_MULTILIB := 64
+else
+LOCAL_MULTILIB := 32
+endif
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_se_benchmark
+LOCAL_SRC_FILES := SecureElement_benchmark.cpp SimulatedEse.cpp
+LOCAL_C_INCLUDES := $(SN100X_SE_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(SN100X_SE_TEST_LIBS)
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+ifeq (true,$(TARGET_IS_64_BIT))
+LOCAL_MULTILIB := 64
+else
+LOCAL_MULTILIB := 32
+endif
+include $(BUILD_NATIVE_BENCHMARK)
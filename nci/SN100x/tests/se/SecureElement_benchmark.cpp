@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "SimulatedEse.h"
+
+namespace {
+
+const uint8_t kSelect[] = {0x00, 0xA4, 0x04, 0x00, 0x07, 0xA0, 0x00,
+                           0x00, 0x00, 0x03, 0x10, 0x10, 0x00};
+
+// the Java wired-mode path: receive into the lent buffer, copy out only the
+// reported bytes
+void BM_TransceivePooled(benchmark::State& state) {
+  SecureElement& se = SecureElement::getInstance();
+  SimulatedEse::getInstance().setResponseLength(state.range(0));
+  std::vector<uint8_t> cmd(kSelect, kSelect + sizeof(kSelect));
+  std::vector<uint8_t> out;
+  for (auto _ : state) {
+    int32_t size = 0;
+    int32_t actual = 0;
+    uint8_t* rsp = se.acquireResponseBuffer(size);
+    se.transceive(cmd.data(), cmd.size(), rsp, size, actual, 1000);
+    out.assign(rsp, rsp + actual);
+    se.releaseResponseBuffer();
+  }
+  SimulatedEse::getInstance().takeCommands();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TransceivePooled)->Arg(2)->Arg(258)->Arg(4096)->UseRealTime();
+
+// the DwpChannel path: the caller owns the buffer and gets a copy
+void BM_TransceiveCallerBuffer(benchmark::State& state) {
+  SecureElement& se = SecureElement::getInstance();
+  SimulatedEse::getInstance().setResponseLength(state.range(0));
+  std::vector<uint8_t> cmd(kSelect, kSelect + sizeof(kSelect));
+  std::vector<uint8_t> rsp(0x8800);
+  for (auto _ : state) {
+    int32_t actual = 0;
+    se.transceive(cmd.data(), cmd.size(), rsp.data(), rsp.size(), actual,
+                  1000);
+    benchmark::DoNotOptimize(actual);
+  }
+  SimulatedEse::getInstance().takeCommands();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TransceiveCallerBuffer)
+    ->Arg(2)
+    ->Arg(258)
+    ->Arg(4096)
+    ->UseRealTime();
+
+// a provisioning script of n SELECTs, each expecting 90 00
+void BM_TransceiveScript(benchmark::State& state) {
+  SecureElement& se = SecureElement::getInstance();
+  SimulatedEse::getInstance().setResponseLength(2);
+  std::vector<uint8_t> script;
+  for (int i = 0; i < state.range(0); i++) {
+    script.push_back(0);
+    script.push_back(sizeof(kSelect));
+    script.insert(script.end(), kSelect, kSelect + sizeof(kSelect));
+    script.insert(script.end(), {0x90, 0x00, 0xFF, 0xFF});
+  }
+  std::vector<uint8_t> responses;
+  for (auto _ : state) {
+    se.transceiveScript(script.data(), script.size(), responses, 1000);
+  }
+  SimulatedEse::getInstance().takeCommands();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransceiveScript)->Arg(1)->Arg(16)->Arg(64)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "SimulatedEse.h"
+
+namespace {
+
+const int32_t kTimeout = 1000;
+
+// appends one script command: length, APDU, expected SW and SW mask
+void addCommand(std::vector<uint8_t>& script, std::vector<uint8_t> apdu,
+                uint16_t sw, uint16_t mask) {
+  script.push_back(apdu.size() >> 8);
+  script.push_back(apdu.size());
+  script.insert(script.end(), apdu.begin(), apdu.end());
+  script.insert(script.end(), {(uint8_t)(sw >> 8), (uint8_t)sw,
+                               (uint8_t)(mask >> 8), (uint8_t)mask});
+}
+
+// splits the encoded responses back into records
+std::vector<std::vector<uint8_t>> records(const std::vector<uint8_t>& blob) {
+  std::vector<std::vector<uint8_t>> out;
+  size_t pos = 0;
+  while (pos + 2 <= blob.size()) {
+    size_t len = (blob[pos] << 8) | blob[pos + 1];
+    pos += 2;
+    out.emplace_back(blob.begin() + pos, blob.begin() + pos + len);
+    pos += len;
+  }
+  EXPECT_EQ(blob.size(), pos);
+  return out;
+}
+
+// answers with the SW carried in the APDU's P1/P2
+std::vector<uint8_t> echoP1P2(const std::vector<uint8_t>& cmd) {
+  return {0xAA, cmd[2], cmd[3]};
+}
+
+class SecureElementScriptTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SimulatedEse::getInstance().setResponder(echoP1P2);
+    SimulatedEse::getInstance().takeCommands();
+  }
+  void TearDown() override { SimulatedEse::getInstance().setResponseLength(2); }
+
+  bool run(const std::vector<uint8_t>& script) {
+    return SecureElement::getInstance().transceiveScript(
+        script.data(), script.size(), mResponses, kTimeout);
+  }
+
+  std::vector<uint8_t> mResponses;
+};
+
+TEST_F(SecureElementScriptTest, RunsEveryCommandWhenAllSwMatch) {
+  std::vector<uint8_t> script;
+  addCommand(script, {0x00, 0xA4, 0x90, 0x00}, 0x9000, 0xFFFF);
+  addCommand(script, {0x80, 0xCA, 0x90, 0x00}, 0x9000, 0xFFFF);
+  addCommand(script, {0x80, 0xE2, 0x90, 0x00}, 0x9000, 0xFFFF);
+  EXPECT_TRUE(run(script));
+  EXPECT_EQ(3u, SimulatedEse::getInstance().takeCommands().size());
+  auto rsp = records(mResponses);
+  ASSERT_EQ(3u, rsp.size());
+  for (auto& r : rsp) EXPECT_EQ(std::vector<uint8_t>({0xAA, 0x90, 0x00}), r);
+}
+
+TEST_F(SecureElementScriptTest, StopsAndFailsOnFirstSwMismatch) {
+  std::vector<uint8_t> script;
+  addCommand(script, {0x00, 0xA4, 0x90, 0x00}, 0x9000, 0xFFFF);
+  addCommand(script, {0x80, 0xCA, 0x6A, 0x82}, 0x9000, 0xFFFF);
+  addCommand(script, {0x80, 0xE2, 0x90, 0x00}, 0x9000, 0xFFFF);
+  EXPECT_FALSE(run(script));
+
+  // the third command never reaches the eSE
+  auto sent = SimulatedEse::getInstance().takeCommands();
+  ASSERT_EQ(2u, sent.size());
+  EXPECT_EQ(0xCA, sent[1][1]);
+  auto rsp = records(mResponses);
+  ASSERT_EQ(2u, rsp.size());
+  EXPECT_EQ(std::vector<uint8_t>({0xAA, 0x6A, 0x82}), rsp[1]);
+}
+
+TEST_F(SecureElementScriptTest, MaskSelectsSwBitsToCompare) {
+  std::vector<uint8_t> script;
+  addCommand(script, {0x00, 0xC0, 0x61, 0x10}, 0x6100, 0xFF00);
+  addCommand(script, {0x00, 0xB0, 0x6A, 0x82}, 0x0000, 0x0000);
+  EXPECT_TRUE(run(script));
+  EXPECT_EQ(2u, records(mResponses).size());
+
+  script.clear();
+  addCommand(script, {0x00, 0xC0, 0x62, 0x10}, 0x6100, 0xFF00);
+  EXPECT_FALSE(run(script));
+}
+
+TEST_F(SecureElementScriptTest, ResponseWithoutSwIsAMismatch) {
+  SimulatedEse::getInstance().setResponder(
+      [](const std::vector<uint8_t>&) { return std::vector<uint8_t>{0x90}; });
+  std::vector<uint8_t> script;
+  addCommand(script, {0x00, 0xA4, 0x04, 0x00}, 0x9000, 0xFFFF);
+  EXPECT_FALSE(run(script));
+}
+
+TEST_F(SecureElementScriptTest, MalformedScriptSendsNothing) {
+  std::vector<uint8_t> script;
+  addCommand(script, {0x00, 0xA4, 0x90, 0x00}, 0x9000, 0xFFFF);
+  script.resize(script.size() - 1);
+  EXPECT_FALSE(run(script));
+  EXPECT_TRUE(SimulatedEse::getInstance().takeCommands().empty());
+
+  const uint8_t truncated[] = {0x00};
+  EXPECT_FALSE(SecureElement::getInstance().transceiveScript(
+      truncated, sizeof(truncated), mResponses, kTimeout));
+  EXPECT_TRUE(mResponses.empty());
+}
+
+TEST(SecureElementTransceiveTest, CallerBufferGetsOnlyTheResponse) {
+  SimulatedEse::getInstance().setResponseLength(258);
+  uint8_t cmd[] = {0x00, 0xB0, 0x00, 0x00, 0x00};
+  std::vector<uint8_t> rsp(0x8800, 0xEE);
+  int32_t actual = 0;
+  EXPECT_TRUE(SecureElement::getInstance().transceive(
+      cmd, sizeof(cmd), rsp.data(), rsp.size(), actual, kTimeout));
+  ASSERT_EQ(258, actual);
+  EXPECT_EQ(0x90, rsp[256]);
+  EXPECT_EQ(0x00, rsp[257]);
+  EXPECT_EQ(0xEE, rsp[258]);
+  SimulatedEse::getInstance().takeCommands();
+}
+
+}  // namespace
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SimulatedEse.h"
+
+SimulatedEse& SimulatedEse::getInstance() {
+  static SimulatedEse* sEse = new SimulatedEse();
+  return *sEse;
+}
+
+SimulatedEse::SimulatedEse()
+    : mResponse(NULL), mResponseMax(0), mPending(false) {
+  setResponseLength(2);
+  std::thread(&SimulatedEse::run, this).detach();
+}
+
+void SimulatedEse::setResponseLength(uint16_t len) {
+  setResponder([len](const std::vector<uint8_t>&) {
+    std::vector<uint8_t> rsp(len < 2 ? 2 : len);
+    for (size_t i = 0; i + 2 < rsp.size(); i++) rsp[i] = (uint8_t)i;
+    rsp[rsp.size() - 2] = 0x90;
+    rsp[rsp.size() - 1] = 0x00;
+    return rsp;
+  });
+}
+
+void SimulatedEse::setResponder(Responder responder) {
+  std::lock_guard<std::mutex> lock(mLock);
+  mResponder = responder;
+}
+
+std::vector<std::vector<uint8_t>> SimulatedEse::takeCommands() {
+  std::lock_guard<std::mutex> lock(mLock);
+  std::vector<std::vector<uint8_t>> commands;
+  commands.swap(mCommands);
+  return commands;
+}
+
+void SimulatedEse::send(const uint8_t* cmd, uint32_t cmdLen, uint8_t* rsp,
+                        uint32_t rspMax) {
+  std::lock_guard<std::mutex> lock(mLock);
+  mCommand.assign(cmd, cmd + cmdLen);
+  mResponse = rsp;
+  mResponseMax = rspMax;
+  mPending = true;
+  mCond.notify_one();
+}
+
+void SimulatedEse::run() {
+  for (;;) {
+    std::vector<uint8_t> rsp;
+    uint8_t* dst;
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+      mCond.wait(lock, [this] { return mPending; });
+      mPending = false;
+      mCommands.push_back(mCommand);
+      rsp = mResponder(mCommand);
+      if (rsp.size() > mResponseMax) rsp.resize(mResponseMax);
+      dst = mResponse;
+    }
+    memcpy(dst, rsp.data(), rsp.size());
+    SecureElementPeer::respond(NFA_STATUS_OK, rsp.size());
+  }
+}
+
+// Interposes on the libsn100nfc-nci definition.
+tNFA_STATUS NFA_HciSendApdu(tNFA_HANDLE handle, tNFA_HANDLE ee_handle,
+                            uint32_t cmd_size, uint8_t* p_data,
+                            uint32_t rsp_size, uint8_t* p_rsp_buf,
+                            uint32_t rsp_timeout) {
+  SimulatedEse::getInstance().send(p_data, cmd_size, p_rsp_buf, rsp_size);
+  return NFA_STATUS_OK;
+}
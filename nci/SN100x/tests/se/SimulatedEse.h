@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SecureElement.h"
+
+class SecureElementPeer {
+ public:
+  // deliver a response the way the HCI layer does, from another thread
+  static void respond(uint8_t status, uint16_t len) {
+    SecureElement& se = SecureElement::getInstance();
+    SyncEventGuard guard(se.mTransceiveEvent);
+    tNFA_HCI_EVT_DATA data;
+    memset(&data, 0, sizeof(data));
+    data.apdu_rcvd.status = status;
+    data.apdu_rcvd.apdu_len = len;
+    SecureElement::nfaHciCallback(NFA_HCI_RSP_APDU_RCVD_EVT, &data);
+  }
+};
+
+// Stands in for the eSE behind the NFCC.  SimulatedEse.cpp interposes on
+// NFA_HciSendApdu so that libsn100nfc_nci_jni sends its APDUs here; each
+// one is answered from the simulator's own thread, as the HCI layer would.
+class SimulatedEse {
+ public:
+  typedef std::function<std::vector<uint8_t>(const std::vector<uint8_t>&)>
+      Responder;
+
+  static SimulatedEse& getInstance();
+
+  // answer every APDU with len bytes ending in 90 00
+  void setResponseLength(uint16_t len);
+  void setResponder(Responder responder);
+  // APDUs received since the last call
+  std::vector<std::vector<uint8_t>> takeCommands();
+
+  void send(const uint8_t* cmd, uint32_t cmdLen, uint8_t* rsp,
+            uint32_t rspMax);
+
+ private:
+  SimulatedEse();
+  void run();
+
+  std::mutex mLock;
+  std::condition_variable mCond;
+  Responder mResponder;
+  std::vector<std::vector<uint8_t>> mCommands;
+  std::vector<uint8_t> mCommand;
+  uint8_t* mResponse;
+  uint32_t mResponseMax;
+  bool mPending;
+};
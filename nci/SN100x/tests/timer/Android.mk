@@ -0,0 +1,20 @@
+LOCAL_PATH := $(call my-dir)
+# the timer is the same in both JNI libraries; so are its tests, built here
+# against the SN100x copy
+NQNFC_TIMER_TESTS := ../../../tests/jni
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_timer_test
+LOCAL_SRC_FILES := $(NQNFC_TIMER_TESTS)/IntervalTimer_test.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../jni
+LOCAL_SHARED_LIBRARIES := libbase libchrome
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := sn100nfc_timer_benchmark
+LOCAL_SRC_FILES := $(NQNFC_TIMER_TESTS)/IntervalTimer_benchmark.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../jni
+LOCAL_SHARED_LIBRARIES := libbase libchrome
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_BENCHMARK)
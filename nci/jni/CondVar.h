@@ -80,6 +80,17 @@ class CondVar {
   *******************************************************************************/
   void notifyOne();
 
+  /*******************************************************************************
+  **
+  ** Function:        notifyAll
+  **
+  ** Description:     Unblock all waiting threads.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  void notifyAll();
+
  private:
   pthread_cond_t mCondition;
 };
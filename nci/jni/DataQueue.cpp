@@ -23,6 +23,7 @@
 #include <base/logging.h>
 
 using android::base::StringPrintf;
+
 /*******************************************************************************
 **
 ** Function:        DataQueue
@@ -32,7 +33,19 @@ using android::base::StringPrintf;
 ** Returns:         None.
 **
 *******************************************************************************/
-DataQueue::DataQueue() {}
+DataQueue::DataQueue(size_t capacity)
+    : mCapacity(kHeaderSize),
+      mBuffer(NULL),
+      mHead(0),
+      mTail(0),
+      mDropped(0),
+      mOversized(0),
+      mReadOffset(0) {
+  // a power of two lets the free-running positions wrap with a mask
+  while (mCapacity < capacity) mCapacity <<= 1;
+  // zeroed, so no header reads as ready before a producer publishes it
+  mBuffer = new uint32_t[mCapacity / kHeaderSize]();
+}
 
 /*******************************************************************************
 **
@@ -43,28 +56,76 @@ DataQueue::DataQueue() {}
 ** Returns:         None.
 **
 *******************************************************************************/
-DataQueue::~DataQueue() {
-  mMutex.lock();
-  while (mQueue.empty() == false) {
-    tHeader* header = mQueue.front();
-    mQueue.pop_front();
-    free(header);
-  }
-  mMutex.unlock();
-}
+DataQueue::~DataQueue() { delete[] mBuffer; }
 
 bool DataQueue::isEmpty() {
-  mMutex.lock();
-  bool retval = mQueue.empty();
-  mMutex.unlock();
-  return retval;
+  size_t head = mHead.load(std::memory_order_acquire);
+  return (__atomic_load_n(header(head), __ATOMIC_ACQUIRE) & kReady) == 0;
+}
+
+/*******************************************************************************
+**
+** Function:        copyIn
+**
+** Description:     Copy bytes into the ring at a free-running position,
+**                  wrapping around the end of the buffer.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void DataQueue::copyIn(size_t pos, const uint8_t* src, size_t len) {
+  uint8_t* ring = (uint8_t*)mBuffer;
+  size_t index = pos & (mCapacity - 1);
+  size_t first = mCapacity - index;
+  if (first > len) first = len;
+  memcpy(ring + index, src, first);
+  memcpy(ring, src + first, len - first);
+}
+
+/*******************************************************************************
+**
+** Function:        copyOut
+**
+** Description:     Copy bytes out of the ring from a free-running position,
+**                  wrapping around the end of the buffer.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void DataQueue::copyOut(size_t pos, uint8_t* dst, size_t len) const {
+  const uint8_t* ring = (const uint8_t*)mBuffer;
+  size_t index = pos & (mCapacity - 1);
+  size_t first = mCapacity - index;
+  if (first > len) first = len;
+  memcpy(dst, ring + index, first);
+  memcpy(dst + first, ring, len - first);
+}
+
+/*******************************************************************************
+**
+** Function:        clear
+**
+** Description:     Zero a consumed record so that a later header written
+**                  over its bytes is not seen as ready before it is published.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void DataQueue::clear(size_t pos, size_t len) {
+  uint8_t* ring = (uint8_t*)mBuffer;
+  size_t index = pos & (mCapacity - 1);
+  size_t first = mCapacity - index;
+  if (first > len) first = len;
+  memset(ring + index, 0, first);
+  memset(ring, 0, len - first);
 }
 
 /*******************************************************************************
 **
 ** Function:        enqueue
 **
-** Description:     Append data to the queue.
+** Description:     Append data to the queue.  Called from the SPI signal
+**                  handler, so it neither locks, allocates nor logs.
 **                  data: array of bytes
 **                  dataLen: length of the data.
 **
@@ -74,24 +135,28 @@ bool DataQueue::isEmpty() {
 bool DataQueue::enqueue(uint8_t* data, uint16_t dataLen) {
   if ((data == NULL) || (dataLen == 0)) return false;
 
-  mMutex.lock();
-
-  bool retval = false;
-  tHeader* header = (tHeader*)malloc(sizeof(tHeader) + dataLen);
-
-  if (header) {
-    memset(header, 0, sizeof(tHeader));
-    header->mDataLen = dataLen;
-    memcpy(header + 1, data, dataLen);
-
-    mQueue.push_back(header);
-
-    retval = true;
-  } else {
-    LOG(ERROR) << StringPrintf("DataQueue::enqueue: out of memory ?????");
+  size_t needed = recordSize(dataLen);
+  if (needed > mCapacity) {
+    // would never fit, even in an empty ring; reported apart from the
+    // records refused because the ring was momentarily full
+    mOversized.fetch_add(1, std::memory_order_relaxed);
+    return false;
   }
-  mMutex.unlock();
-  return retval;
+  size_t tail = mTail.load(std::memory_order_relaxed);
+  do {
+    size_t head = mHead.load(std::memory_order_acquire);
+    if (mCapacity - (tail - head) < needed) {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!mTail.compare_exchange_weak(tail, tail + needed,
+                                        std::memory_order_relaxed));
+
+  // the reserved record is ours alone; the consumer stops at its header
+  // until the ready bit is set
+  copyIn(tail + kHeaderSize, data, dataLen);
+  __atomic_store_n(header(tail), kReady | dataLen, __ATOMIC_RELEASE);
+  return true;
 }
 
 /*******************************************************************************
@@ -108,31 +173,48 @@ bool DataQueue::enqueue(uint8_t* data, uint16_t dataLen) {
 *******************************************************************************/
 bool DataQueue::dequeue(uint8_t* buffer, uint16_t bufferMaxLen,
                         uint16_t& actualLen) {
-  mMutex.lock();
-
-  tHeader* header = mQueue.front();
-  bool retval = false;
-
-  if (header && buffer && (bufferMaxLen > 0)) {
-    if (header->mDataLen <= bufferMaxLen) {
-      // caller's buffer is big enough to store all data
-      actualLen = header->mDataLen;
-      char* src = (char*)(header) + sizeof(tHeader) + header->mOffset;
-      memcpy(buffer, src, actualLen);
-
-      mQueue.pop_front();
-      free(header);
-    } else {
-      // caller's buffer is too small
-      actualLen = bufferMaxLen;
-      char* src = (char*)(header) + sizeof(tHeader) + header->mOffset;
-      memcpy(buffer, src, actualLen);
-      // adjust offset so the next dequeue() will get the remainder
-      header->mDataLen -= actualLen;
-      header->mOffset += actualLen;
-    }
-    retval = true;
+  if ((buffer == NULL) || (bufferMaxLen == 0)) return false;
+
+  mConsumerMutex.lock();
+
+  uint32_t dropped = mDropped.exchange(0, std::memory_order_relaxed);
+  if (dropped > 0) {
+    LOG(ERROR) << StringPrintf("DataQueue::dequeue: queue was full, dropped %u",
+                               dropped);
+  }
+  uint32_t oversized = mOversized.exchange(0, std::memory_order_relaxed);
+  if (oversized > 0) {
+    LOG(ERROR) << StringPrintf(
+        "DataQueue::dequeue: rejected %u records larger than the %zu byte "
+        "queue",
+        oversized, mCapacity - kHeaderSize);
+  }
+
+  size_t head = mHead.load(std::memory_order_relaxed);
+  uint32_t hdr = __atomic_load_n(header(head), __ATOMIC_ACQUIRE);
+  if ((hdr & kReady) == 0) {
+    // empty, or the front record is reserved but not yet published
+    mConsumerMutex.unlock();
+    return false;
+  }
+
+  uint16_t dataLen = (uint16_t)hdr;
+  uint16_t remaining = dataLen - mReadOffset;
+  size_t src = head + kHeaderSize + mReadOffset;
+
+  if (remaining <= bufferMaxLen) {
+    // caller's buffer is big enough to store the rest of the record
+    actualLen = remaining;
+    copyOut(src, buffer, actualLen);
+    mReadOffset = 0;
+    clear(head, recordSize(dataLen));
+    mHead.store(head + recordSize(dataLen), std::memory_order_release);
+  } else {
+    // caller's buffer is too small, the next dequeue() gets the remainder
+    actualLen = bufferMaxLen;
+    copyOut(src, buffer, actualLen);
+    mReadOffset += actualLen;
   }
-  mMutex.unlock();
-  return retval;
+  mConsumerMutex.unlock();
+  return true;
 }
@@ -16,11 +16,18 @@
 
 /*
  *  Store data bytes in a variable-size queue.
+ *
+ *  The queue is a fixed-capacity byte ring holding length-prefixed records,
+ *  so no memory is allocated per record. enqueue() is lock-free, safe for
+ *  several producers and async-signal-safe: a producer reserves its record
+ *  by advancing the tail and publishes it by setting the ready bit in the
+ *  record header. dequeue() callers are serialized among themselves and
+ *  never block a producer.
  */
 
 #pragma once
+#include <atomic>
 #include <cstdlib>
-#include <list>
 #include "Mutex.h"
 #include "NfcJniUtil.h"
 #include "gki.h"
@@ -32,11 +39,13 @@ class DataQueue {
   ** Function:        DataQueue
   **
   ** Description:     Initialize member variables.
+  **                  capacity: size of the ring in bytes, rounded up to a
+  **                  power of two; each record takes 2 extra bytes.
   **
   ** Returns:         None.
   **
   *******************************************************************************/
-  DataQueue();
+  explicit DataQueue(size_t capacity = kDefaultCapacity);
 
   /*******************************************************************************
   **
@@ -57,7 +66,9 @@ class DataQueue {
   **                  data: array of bytes
   **                  dataLen: length of the data.
   **
-  ** Returns:         True if ok.
+  ** Returns:         True if ok, false if the queue does not have room or
+  **                  the record is larger than the whole queue; the next
+  **                  dequeue() logs how many records were refused.
   **
   *******************************************************************************/
   bool enqueue(uint8_t* data, uint16_t dataLen);
@@ -67,6 +78,8 @@ class DataQueue {
   ** Function:        dequeue
   **
   ** Description:     Retrieve and remove data from the front of the queue.
+  **                  If the buffer is too small, the rest of the record is
+  **                  returned by the next call.
   **                  buffer: array to store the data.
   **                  bufferMaxLen: maximum size of the buffer.
   **                  actualLen: actual length of the data.
@@ -88,12 +101,35 @@ class DataQueue {
   bool isEmpty();
 
  private:
-  struct tHeader {
-    uint16_t mDataLen;  // number of octets of data
-    uint16_t mOffset;   // offset of the first octet of data
-  };
-  typedef std::list<tHeader*> Queue;
+  static const size_t kDefaultCapacity = 8192;
+  static const size_t kCacheLineSize = 64;
+  // record header: length in the low 16 bits, kReady once published
+  static const size_t kHeaderSize = sizeof(uint32_t);
+  static const uint32_t kReady = 0x80000000;
+
+  // records start on a header boundary so a header never wraps
+  static size_t recordSize(uint16_t dataLen) {
+    return kHeaderSize + ((dataLen + kHeaderSize - 1) & ~(kHeaderSize - 1));
+  }
+  uint32_t* header(size_t pos) const {
+    return mBuffer + ((pos & (mCapacity - 1)) / kHeaderSize);
+  }
+  void copyIn(size_t pos, const uint8_t* src, size_t len);
+  void copyOut(size_t pos, uint8_t* dst, size_t len) const;
+  void clear(size_t pos, size_t len);
+
+  size_t mCapacity;  // power of two, in bytes
+  uint32_t* mBuffer;
+  // free-running byte counters; head is owned by the consumer, tail is
+  // advanced by producers, each on its own cache line to avoid false sharing
+  alignas(kCacheLineSize) std::atomic<size_t> mHead;
+  alignas(kCacheLineSize) std::atomic<size_t> mTail;
+  std::atomic<uint32_t> mDropped;  // records refused since the last dequeue
+  std::atomic<uint32_t> mOversized;  // records that can never fit
+  alignas(kCacheLineSize) uint16_t mReadOffset;  // consumed part of front record
+  Mutex mConsumerMutex;
 
-  Queue mQueue;
-  Mutex mMutex;
+  friend class DataQueuePeer;
+  DataQueue(const DataQueue&) = delete;
+  DataQueue& operator=(const DataQueue&) = delete;
 };
@@ -37,78 +37,364 @@
  */
 
 #include "IntervalTimer.h"
+#include <pthread.h>
 #include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
 
 #include <android-base/stringprintf.h>
 #include <base/logging.h>
 
 using android::base::StringPrintf;
 
-IntervalTimer::IntervalTimer() {
-  mTimerId = 0;
-  mCb = NULL;
+/*
+ * Hierarchical timing wheel with a 1 ms tick, in the style of the classic
+ * kernel timer wheel.  Level 0 has 256 slots, one per tick; levels 1-3 have
+ * 64 slots each covering 2^8, 2^14 and 2^20 ticks, so timers up to ~18 hours
+ * ahead are placed in O(1).  Whenever level 0 wraps, the next slot of the
+ * level above is cascaded down.  The wheel thread sleeps until the next
+ * occupied level-0 slot or the next wrap, and not at all when nothing is
+ * armed.
+ */
+class TimerWheel {
+ public:
+  static TimerWheel& getInstance();
+
+  bool set(IntervalTimer* timer, int ms, IntervalTimer::TIMER_FUNC cb);
+  void kill(IntervalTimer* timer);
+  bool isArmed(IntervalTimer* timer);
+
+ private:
+  friend class TimerWheelPeer;
+  static const int kLevel0Bits = 8;
+  static const int kLevelNBits = 6;
+  static const int kLevel0Size = 1 << kLevel0Bits;
+  static const int kLevelNSize = 1 << kLevelNBits;
+  static const int kNumSlots = kLevel0Size + 3 * kLevelNSize;
+  static const uint64_t kMaxDelta =
+      (1ULL << (kLevel0Bits + 3 * kLevelNBits)) - 1;
+  // workers kept waiting when idle; extra workers exit after kWorkerIdleMs
+  static const int kPersistentWorkers = 4;
+  static const int kMaxWorkers = 16;
+  static const int kWorkerIdleMs = 1000;
+
+  struct Dispatch {
+    uint64_t id;
+    IntervalTimer* timer;
+    IntervalTimer::TIMER_FUNC cb;
+  };
+
+  TimerWheel();
+  uint64_t currentTick();
+  void link(IntervalTimer* timer);
+  void unlink(IntervalTimer* timer);
+  void disarm(IntervalTimer* timer);
+  void cascade(int level, int index);
+  void advance(uint64_t now);
+  void step();
+  uint64_t nextEventTick();
+  int nextLevel0Slot(int index);
+  void fire(IntervalTimer* timer);
+  void wheelLoop();
+  void workerLoop();
+  bool startThread(void* (*fn)(void*), const char* name);
+  static void* wheelThread(void*);
+  static void* workerThread(void*);
+
+  std::mutex mMutex;
+  std::condition_variable mWheelCond;
+  std::condition_variable mWorkCond;
+  std::chrono::steady_clock::time_point mEpoch;
+  uint64_t mNow;  // next tick to be processed
+  int mArmed;     // timers currently in the wheel
+  IntervalTimer* mSlots[kNumSlots];
+  uint64_t mLevel0Map[kLevel0Size / 64];  // occupied level-0 slots
+  bool mWheelStarted;
+
+  std::deque<Dispatch> mDispatch;
+  std::unordered_set<uint64_t> mPending;  // ids still allowed to run
+  uint64_t mNextId;
+  int mWorkers;
+  int mIdleWorkers;
+};
+
+const int TimerWheel::kMaxWorkers;
+const int TimerWheel::kWorkerIdleMs;
+
+TimerWheel& TimerWheel::getInstance() {
+  // never destroyed; timers may still be touched by static destructors
+  static TimerWheel* sWheel = new TimerWheel();
+  return *sWheel;
 }
 
-bool IntervalTimer::set(int ms, TIMER_FUNC cb) {
-  if (mTimerId == 0) {
-    if (cb == NULL) return false;
+TimerWheel::TimerWheel()
+    : mEpoch(std::chrono::steady_clock::now()),
+      mNow(0),
+      mArmed(0),
+      mWheelStarted(false),
+      mNextId(0),
+      mWorkers(0),
+      mIdleWorkers(0) {
+  memset(mSlots, 0, sizeof(mSlots));
+  memset(mLevel0Map, 0, sizeof(mLevel0Map));
+}
 
-    if (!create(cb)) return false;
+uint64_t TimerWheel::currentTick() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - mEpoch)
+      .count();
+}
+
+bool TimerWheel::startThread(void* (*fn)(void*), const char* name) {
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int ret = pthread_create(&thread, &attr, fn, this);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    LOG(ERROR) << StringPrintf("%s: fail create %s thread; error=%d",
+                               __func__, name, ret);
+    return false;
   }
-  if (cb != mCb) {
-    kill();
-    if (!create(cb)) return false;
+  pthread_setname_np(thread, name);
+  return true;
+}
+
+void* TimerWheel::wheelThread(void* arg) {
+  static_cast<TimerWheel*>(arg)->wheelLoop();
+  return NULL;
+}
+
+void* TimerWheel::workerThread(void* arg) {
+  static_cast<TimerWheel*>(arg)->workerLoop();
+  return NULL;
+}
+
+void TimerWheel::link(IntervalTimer* timer) {
+  uint64_t delta = (timer->mExpiry > mNow) ? timer->mExpiry - mNow : 0;
+  if (delta > kMaxDelta) {
+    delta = kMaxDelta;
+    timer->mExpiry = mNow + delta;
   }
+  int slot;
+  uint64_t expiry = timer->mExpiry;
+  if (delta < kLevel0Size) {
+    slot = (delta == 0 ? mNow : expiry) & (kLevel0Size - 1);
+    mLevel0Map[slot / 64] |= 1ULL << (slot % 64);
+  } else {
+    int level = 1;
+    while (delta >= (1ULL << (kLevel0Bits + level * kLevelNBits))) level++;
+    int shift = kLevel0Bits + (level - 1) * kLevelNBits;
+    slot = kLevel0Size + (level - 1) * kLevelNSize +
+           ((expiry >> shift) & (kLevelNSize - 1));
+  }
+  timer->mSlot = slot;
+  timer->mPrev = NULL;
+  timer->mNext = mSlots[slot];
+  if (mSlots[slot]) mSlots[slot]->mPrev = timer;
+  mSlots[slot] = timer;
+  mArmed++;
+}
 
-  int stat = 0;
-  struct itimerspec ts;
-  ts.it_value.tv_sec = ms / 1000;
-  ts.it_value.tv_nsec = (ms % 1000) * 1000000;
+void TimerWheel::unlink(IntervalTimer* timer) {
+  int slot = timer->mSlot;
+  if (timer->mPrev)
+    timer->mPrev->mNext = timer->mNext;
+  else
+    mSlots[slot] = timer->mNext;
+  if (timer->mNext) timer->mNext->mPrev = timer->mPrev;
+  if (slot < kLevel0Size && mSlots[slot] == NULL)
+    mLevel0Map[slot / 64] &= ~(1ULL << (slot % 64));
+  timer->mSlot = -1;
+  timer->mPrev = timer->mNext = NULL;
+  mArmed--;
+}
 
-  ts.it_interval.tv_sec = 0;
-  ts.it_interval.tv_nsec = 0;
+void TimerWheel::cascade(int level, int index) {
+  int slot = kLevel0Size + (level - 1) * kLevelNSize + index;
+  IntervalTimer* timer = mSlots[slot];
+  while (timer) {
+    IntervalTimer* next = timer->mNext;
+    unlink(timer);
+    link(timer);
+    timer = next;
+  }
+}
 
-  stat = timer_settime(mTimerId, 0, &ts, 0);
-  if (stat == -1) LOG(ERROR) << StringPrintf("fail set timer");
-  return stat == 0;
+void TimerWheel::fire(IntervalTimer* timer) {
+  unlink(timer);
+  Dispatch d = {++mNextId, timer, timer->mCb};
+  timer->mPendingId = d.id;
+  mPending.insert(d.id);
+  mDispatch.push_back(d);
+  // Callbacks may block (several wait on a SyncEvent or an NFA call), so an
+  // expiry normally does not wait behind a running callback: without an
+  // idle worker for it, it gets a new one, as it got its own thread with
+  // timer_create().  Past kMaxWorkers it waits for one to come free.
+  if (mDispatch.size() <= (size_t)mIdleWorkers) {
+    mWorkCond.notify_one();
+  } else if (mWorkers >= kMaxWorkers) {
+    LOG(ERROR) << StringPrintf(
+        "%s: all %d timer workers busy; %zu callbacks waiting", __func__,
+        mWorkers, mDispatch.size());
+  } else if (startThread(workerThread, "NfcTimerCb")) {
+    mWorkers++;
+  }
 }
 
-IntervalTimer::~IntervalTimer() { kill(); }
+void TimerWheel::step() {
+  int index = mNow & (kLevel0Size - 1);
+  if (index == 0) {
+    for (int level = 1; level <= 3; level++) {
+      int shift = kLevel0Bits + (level - 1) * kLevelNBits;
+      int levelIndex = (mNow >> shift) & (kLevelNSize - 1);
+      cascade(level, levelIndex);
+      if (levelIndex != 0) break;
+    }
+  }
+  while (mSlots[index]) fire(mSlots[index]);
+  mNow++;
+}
+
+int TimerWheel::nextLevel0Slot(int index) {
+  for (int word = index / 64; word < kLevel0Size / 64; word++) {
+    uint64_t bits = mLevel0Map[word];
+    if (word == index / 64) bits &= ~0ULL << (index % 64);
+    if (bits) return word * 64 + __builtin_ctzll(bits);
+  }
+  return -1;
+}
+
+void TimerWheel::advance(uint64_t now) {
+  while (mNow <= now) {
+    int index = mNow & (kLevel0Size - 1);
+    if (index != 0 && nextLevel0Slot(index) < 0) {
+      // nothing left in this rotation; jump to the next wrap
+      uint64_t wrap = (mNow | (kLevel0Size - 1)) + 1;
+      mNow = (wrap <= now + 1) ? wrap : now + 1;
+      continue;
+    }
+    step();
+  }
+}
+
+uint64_t TimerWheel::nextEventTick() {
+  int index = mNow & (kLevel0Size - 1);
+  int slot = (index == 0) ? -1 : nextLevel0Slot(index);
+  if (index == 0) return mNow;  // a cascade is due
+  if (slot >= 0) return mNow + (slot - index);
+  return (mNow | (kLevel0Size - 1)) + 1;
+}
+
+void TimerWheel::wheelLoop() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  for (;;) {
+    advance(currentTick());
+    if (mArmed == 0)
+      mWheelCond.wait(lock);
+    else
+      mWheelCond.wait_until(
+          lock, mEpoch + std::chrono::milliseconds(nextEventTick()));
+  }
+}
+
+void TimerWheel::workerLoop() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  for (;;) {
+    while (mDispatch.empty()) {
+      mIdleWorkers++;
+      std::cv_status status = mWorkCond.wait_for(
+          lock, std::chrono::milliseconds(kWorkerIdleMs));
+      mIdleWorkers--;
+      if (status == std::cv_status::timeout && mDispatch.empty() &&
+          mWorkers > kPersistentWorkers) {
+        mWorkers--;
+        return;
+      }
+    }
+    Dispatch d = mDispatch.front();
+    mDispatch.pop_front();
+    if (mPending.erase(d.id) == 0) continue;  // killed before it ran
+
+    lock.unlock();
+    union sigval value;
+    value.sival_ptr = d.timer;
+    d.cb(value);
+    lock.lock();
+  }
+}
 
-void IntervalTimer::kill() {
-  if (mTimerId == 0) return;
+bool TimerWheel::set(IntervalTimer* timer, int ms,
+                     IntervalTimer::TIMER_FUNC cb) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (!mWheelStarted) {
+    if (!startThread(wheelThread, "NfcTimer")) return false;
+    mWheelStarted = true;
+  }
+  disarm(timer);
+  timer->mCb = cb;
+  // as with timer_settime(), a zero interval only disarms the timer
+  if (ms == 0) return true;
 
-  timer_delete(mTimerId);
-  mTimerId = 0;
-  mCb = NULL;
+  uint64_t now = currentTick();
+  if (mArmed == 0) mNow = now;  // wheel is empty; no need to replay idle time
+  // the current tick is already partly elapsed; round up so the timer never
+  // fires early
+  timer->mExpiry = now + ms + 1;
+  link(timer);
+  mWheelCond.notify_one();
+  return true;
 }
 
+void TimerWheel::disarm(IntervalTimer* timer) {
+  if (timer->mSlot >= 0) unlink(timer);
+  if (timer->mPendingId != 0) {
+    mPending.erase(timer->mPendingId);
+    timer->mPendingId = 0;
+  }
+}
+
+void TimerWheel::kill(IntervalTimer* timer) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  disarm(timer);
+  timer->mCb = NULL;
+}
+
+bool TimerWheel::isArmed(IntervalTimer* timer) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return timer->mSlot >= 0;
+}
+
+IntervalTimer::IntervalTimer()
+    : mCb(NULL),
+      mExpiry(0),
+      mSlot(-1),
+      mPrev(NULL),
+      mNext(NULL),
+      mPendingId(0) {}
+
+bool IntervalTimer::set(int ms, TIMER_FUNC cb) {
+  if ((cb == NULL) || (ms < 0)) return false;
+
+  bool stat = TimerWheel::getInstance().set(this, ms, cb);
+  if (!stat) LOG(ERROR) << StringPrintf("fail set timer");
+  return stat;
+}
+
+IntervalTimer::~IntervalTimer() { kill(); }
+
+void IntervalTimer::kill() { TimerWheel::getInstance().kill(this); }
+
 bool IntervalTimer::create(TIMER_FUNC cb) {
-  struct sigevent se;
-  memset(&se, 0, sizeof(struct sigevent));
-  int stat = 0;
-
-  /*
-   * Set the sigevent structure to cause the signal to be
-   * delivered by creating a new thread.
-   */
-  se.sigev_notify = SIGEV_THREAD;
-  se.sigev_value.sival_ptr = &mTimerId;
-  se.sigev_notify_function = cb;
-  se.sigev_notify_attributes = NULL;
+  kill();
   mCb = cb;
-  stat = timer_create(CLOCK_MONOTONIC, &se, &mTimerId);
-  if (stat == -1) LOG(ERROR) << StringPrintf("fail create timer");
-  return stat == 0;
+  return true;
 }
 
 bool IntervalTimer::isRunning(void) {
-  if (mTimerId == 0) return false;
-
-  int stat = 0;
-  struct itimerspec ts;
-
-  stat = timer_gettime(mTimerId, &ts);
-  if (stat != 0) return false;
-  return ((ts.it_value.tv_sec > 0 || ts.it_value.tv_nsec > 0) ? true : false);
+  return TimerWheel::getInstance().isArmed(this);
 }
@@ -38,8 +38,20 @@
  *
  ******************************************************************************/
 #pragma once
+#include <signal.h>
+#include <stdint.h>
 #include <time.h>
 
+class TimerWheel;
+
+/*
+ * One-shot timer.  All timers are served by a single timing-wheel thread and
+ * their callbacks run on a pool of persistent worker threads, so an expiry
+ * does not normally create a thread.  A callback may block: an expiry that
+ * finds every worker busy starts another one, up to a fixed limit, which
+ * exits once idle.  set() with 0 ms disarms the timer.  The callback
+ * argument carries the timer in sival_ptr.
+ */
 class IntervalTimer {
  public:
   typedef void (*TIMER_FUNC)(union sigval);
@@ -53,6 +65,12 @@ class IntervalTimer {
                          // running(curTime > 0)
 
  private:
-  timer_t mTimerId;
+  friend class TimerWheel;
+
   TIMER_FUNC mCb;
+  uint64_t mExpiry;      // wheel tick at which the timer fires
+  int mSlot;             // wheel slot holding the timer; -1 if not armed
+  IntervalTimer* mPrev;  // neighbours in the slot list
+  IntervalTimer* mNext;
+  uint64_t mPendingId;  // expiry queued for a worker; 0 if none
 };
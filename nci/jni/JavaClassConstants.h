@@ -53,6 +53,7 @@ extern jmethodID gCachedNfcManagerNotifyUiccStatusEvent;
  */
 extern jmethodID gCachedNfcManagerNotifyHostEmuActivated;
 extern jmethodID gCachedNfcManagerNotifyHostEmuData;
+extern jmethodID gCachedNfcManagerNotifyHostEmuReplay;
 #if (NXP_EXTNS == TRUE)
 #if (NXP_NFCC_HCE_F == TRUE)
 extern jmethodID gCachedNfcManagerNotifyT3tConfigure;
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *  Run upcalls into the NFC service on one JVM-attached thread.
+ */
+
+#include "JniEventDispatcher.h"
+#include <android-base/stringprintf.h>
+#include <base/logging.h>
+
+using android::base::StringPrintf;
+
+/*******************************************************************************
+**
+** Function:        JniEventDispatcher
+**
+** Description:     Initialize member variables.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+JniEventDispatcher::JniEventDispatcher() : mVm(NULL), mStarted(false) {}
+
+/*******************************************************************************
+**
+** Function:        getInstance
+**
+** Description:     Get the singleton of this object.
+**
+** Returns:         Reference to this object.
+**
+*******************************************************************************/
+JniEventDispatcher& JniEventDispatcher::getInstance() {
+  // never destroyed; the thread may still be running at exit
+  static JniEventDispatcher* sDispatcher = new JniEventDispatcher();
+  return *sDispatcher;
+}
+
+/*******************************************************************************
+**
+** Function:        start
+**
+** Description:     Start the dispatcher thread.
+**
+** Returns:         True if the thread is running.
+**
+*******************************************************************************/
+bool JniEventDispatcher::start(JavaVM* vm) {
+  SyncEventGuard guard(mQueueEvent);
+  if (mStarted) return true;
+  mVm = vm;
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int ret = pthread_create(&mThread, &attr, dispatchThread, this);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    LOG(ERROR) << StringPrintf("%s: fail create thread; error=%d", __func__,
+                               ret);
+    return false;
+  }
+  pthread_setname_np(mThread, "nfc_jni_events");
+  mStarted = true;
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function:        post
+**
+** Description:     Queue an upcall and return at once.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void JniEventDispatcher::post(const Event_t& event) {
+  {
+    SyncEventGuard guard(mQueueEvent);
+    if (mStarted) {
+      mQueue.push_back(event);
+      mQueueEvent.notifyOne();
+      return;
+    }
+  }
+  runInline(event);
+}
+
+/*******************************************************************************
+**
+** Function:        run
+**
+** Description:     Run an upcall on the dispatcher thread and wait for it.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void JniEventDispatcher::run(const Event_t& event) {
+  SyncEvent done;
+  bool finished = false;
+  bool queued = false;
+  {
+    SyncEventGuard guard(mQueueEvent);
+    if (mStarted && !pthread_equal(pthread_self(), mThread)) {
+      mQueue.push_back([&event, &done, &finished](JNIEnv* e) {
+        event(e);
+        SyncEventGuard doneGuard(done);
+        finished = true;
+        done.notifyOne();
+      });
+      mQueueEvent.notifyOne();
+      queued = true;
+    }
+  }
+  if (!queued) {
+    runInline(event);
+    return;
+  }
+  SyncEventGuard doneGuard(done);
+  while (!finished) done.wait();
+}
+
+/*******************************************************************************
+**
+** Function:        runInline
+**
+** Description:     Run an upcall on the calling thread, attaching it to the
+**                  JVM only if it is not attached already.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void JniEventDispatcher::runInline(const Event_t& event) {
+  if (mVm == NULL) {
+    LOG(ERROR) << StringPrintf("%s: no JVM; event dropped", __func__);
+    return;
+  }
+  JNIEnv* e = NULL;
+  if (mVm->GetEnv((void**)&e, JNI_VERSION_1_6) == JNI_OK) {
+    event(e);
+    return;
+  }
+  ScopedAttach attach(mVm, &e);
+  if (e == NULL) {
+    LOG(ERROR) << StringPrintf("%s: jni env is null", __func__);
+    return;
+  }
+  event(e);
+}
+
+void* JniEventDispatcher::dispatchThread(void* arg) {
+  static_cast<JniEventDispatcher*>(arg)->dispatchLoop();
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function:        dispatchLoop
+**
+** Description:     Run queued upcalls in order, attached to the JVM for the
+**                  life of the thread.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void JniEventDispatcher::dispatchLoop() {
+  JNIEnv* e = NULL;
+  ScopedAttach attach(mVm, &e);
+  if (e == NULL) {
+    LOG(ERROR) << StringPrintf("%s: jni env is null", __func__);
+    return;
+  }
+  for (;;) {
+    Event_t event;
+    {
+      SyncEventGuard guard(mQueueEvent);
+      while (mQueue.empty()) mQueueEvent.wait();
+      event.swap(mQueue.front());
+      mQueue.pop_front();
+    }
+    event(e);
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: upcall left an exception", __func__);
+    }
+  }
+}
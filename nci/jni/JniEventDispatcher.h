@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *  Run upcalls into the NFC service on one JVM-attached thread.
+ *
+ *  Stack and timer callbacks used to attach and detach their own thread for
+ *  every event.  The dispatcher thread attaches once and runs every upcall
+ *  in submission order, so events posted by different callbacks reach Java
+ *  in the order they were raised.
+ */
+
+#pragma once
+#include <pthread.h>
+#include <deque>
+#include <functional>
+#include "NfcJniUtil.h"
+#include "SyncEvent.h"
+
+class JniEventDispatcher {
+ public:
+  typedef std::function<void(JNIEnv*)> Event_t;
+
+  /*******************************************************************************
+  **
+  ** Function:        getInstance
+  **
+  ** Description:     Get the singleton of this object.
+  **
+  ** Returns:         Reference to this object.
+  **
+  *******************************************************************************/
+  static JniEventDispatcher& getInstance();
+
+  /*******************************************************************************
+  **
+  ** Function:        start
+  **
+  ** Description:     Start the dispatcher thread.  It lives for the rest of
+  **                  the process; later calls do nothing.
+  **                  vm: JVM to attach to.
+  **
+  ** Returns:         True if the thread is running.
+  **
+  *******************************************************************************/
+  bool start(JavaVM* vm);
+
+  /*******************************************************************************
+  **
+  ** Function:        post
+  **
+  ** Description:     Queue an upcall and return at once.  The event must
+  **                  carry copies of everything it uses.
+  **                  event: Upcall to run.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  void post(const Event_t& event);
+
+  /*******************************************************************************
+  **
+  ** Function:        run
+  **
+  ** Description:     Run an upcall on the dispatcher thread and wait for it,
+  **                  for callers whose state must not change until Java has
+  **                  been told.  Runs inline on the dispatcher thread itself.
+  **                  event: Upcall to run.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  void run(const Event_t& event);
+
+ private:
+  JniEventDispatcher();
+
+  static void* dispatchThread(void* arg);
+  void dispatchLoop();
+  void runInline(const Event_t& event);
+
+  JavaVM* mVm;
+  pthread_t mThread;
+  bool mStarted;
+  // Protected by mQueueEvent
+  std::deque<Event_t> mQueue;
+  SyncEvent mQueueEvent;
+};
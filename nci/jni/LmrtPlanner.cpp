@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *  Size a candidate listen mode routing table before it is sent to the
+ *  controller.
+ */
+
+#include "LmrtPlanner.h"
+#include <android-base/stringprintf.h>
+#include <base/logging.h>
+#include <algorithm>
+
+using android::base::StringPrintf;
+
+extern bool nfc_debug_enabled;
+
+namespace {
+// AID_MATCHING_ modes, see AidRoutingManager.java
+const int AID_MATCHING_EXACT_ONLY = 0x00;
+const int AID_MATCHING_PREFIX_ONLY = 0x02;
+const int AID_MATCHING_EXACT_OR_SUBSET_OR_PREFIX = 0x03;
+}  // namespace
+
+/*******************************************************************************
+**
+** Function:        LmrtPlanner
+**
+** Description:     Initialize member variables.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+LmrtPlanner::LmrtPlanner(int matchingMode)
+    : mMatchingMode(matchingMode), mFixedLen(0), mDropped(0) {}
+
+/*******************************************************************************
+**
+** Function:        addAid
+**
+** Description:     Add a candidate AID entry.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void LmrtPlanner::addAid(const uint8_t* aid, uint8_t aidLen, uint8_t route,
+                         uint8_t power, uint8_t aidInfo, int priority) {
+  Entry entry;
+  entry.aid.assign(aid, aid + aidLen);
+  entry.route = route;
+  entry.power = power;
+  entry.aidInfo = aidInfo;
+  entry.priority = priority;
+  mEntries.push_back(entry);
+}
+
+/*******************************************************************************
+**
+** Function:        encodedSize
+**
+** Description:     Size of the table if every candidate were sent as is.
+**
+** Returns:         Size in bytes.
+**
+*******************************************************************************/
+uint32_t LmrtPlanner::encodedSize() const {
+  uint32_t size = mFixedLen;
+  for (const Entry& entry : mEntries) size += entry.aid.size() + ENTRY_HDR_LEN;
+  return size;
+}
+
+/*******************************************************************************
+**
+** Function:        isPrefix
+**
+** Description:     Whether the controller matches this entry as a prefix.
+**
+** Returns:         True if it does.
+**
+*******************************************************************************/
+bool LmrtPlanner::isPrefix(const Entry& entry) const {
+  if (mMatchingMode == AID_MATCHING_PREFIX_ONLY) return true;
+  return (mMatchingMode != AID_MATCHING_EXACT_ONLY) &&
+         (entry.aidInfo & AID_QUAL_PREFIX);
+}
+
+/*******************************************************************************
+**
+** Function:        isSubset
+**
+** Description:     Whether the controller matches this entry as a subset.
+**
+** Returns:         True if it does.
+**
+*******************************************************************************/
+bool LmrtPlanner::isSubset(const Entry& entry) const {
+  return (mMatchingMode == AID_MATCHING_EXACT_OR_SUBSET_OR_PREFIX) &&
+         (entry.aidInfo & AID_QUAL_SUBSET);
+}
+
+/*******************************************************************************
+**
+** Function:        startsWith
+**
+** Description:     Whether prefix is a leading part of aid.
+**
+** Returns:         True if it is.
+**
+*******************************************************************************/
+bool LmrtPlanner::startsWith(const std::vector<uint8_t>& aid,
+                             const std::vector<uint8_t>& prefix) {
+  return (prefix.size() <= aid.size()) &&
+         std::equal(prefix.begin(), prefix.end(), aid.begin());
+}
+
+/*******************************************************************************
+**
+** Function:        covers
+**
+** Description:     Whether every AID that inner matches is also matched by
+**                  outer and sent to the same place.
+**
+** Returns:         True if inner adds nothing to outer.
+**
+*******************************************************************************/
+bool LmrtPlanner::covers(const Entry& outer, const Entry& inner) const {
+  if ((outer.route != inner.route) || (outer.power != inner.power))
+    return false;
+  bool exact = (inner.aid == outer.aid) ||
+               (isPrefix(outer) && startsWith(inner.aid, outer.aid)) ||
+               (isSubset(outer) && startsWith(outer.aid, inner.aid));
+  if (!exact) return false;
+  if (isPrefix(inner) &&
+      !(isPrefix(outer) && startsWith(inner.aid, outer.aid)))
+    return false;
+  if (isSubset(inner) &&
+      !(isSubset(outer) && startsWith(outer.aid, inner.aid)))
+    return false;
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function:        plan
+**
+** Description:     Choose the AID entries to send.
+**
+** Returns:         Encoded size of the planned table.
+**
+*******************************************************************************/
+uint32_t LmrtPlanner::plan(uint32_t capacity, uint32_t maxAids,
+                           std::vector<uint32_t>& kept) const {
+  static const char fn[] = "LmrtPlanner::plan";
+  const uint32_t count = mEntries.size();
+  std::vector<bool> folded(count, false);
+  std::vector<uint32_t> owner(count);
+  std::vector<int> priority(count);
+
+  // Fold entries another entry already covers.  An entry stays if an entry
+  // for a different route overlaps it, since the controller then needs the
+  // longer match to pick the right destination.
+  for (uint32_t jj = 0; jj < count; jj++) {
+    owner[jj] = jj;
+    priority[jj] = mEntries[jj].priority;
+    const Entry& inner = mEntries[jj];
+    bool conflict = false;
+    for (uint32_t kk = 0; (kk < count) && !conflict; kk++) {
+      const Entry& other = mEntries[kk];
+      conflict = ((other.route != inner.route) ||
+                  (other.power != inner.power)) &&
+                 (startsWith(inner.aid, other.aid) ||
+                  startsWith(other.aid, inner.aid));
+    }
+    if (conflict) continue;
+    for (uint32_t ii = 0; ii < count; ii++) {
+      if (ii == jj || !covers(mEntries[ii], inner)) continue;
+      // Of two identical entries, keep the first
+      if (covers(inner, mEntries[ii]) && (jj < ii)) continue;
+      folded[jj] = true;
+      break;
+    }
+  }
+  for (uint32_t jj = 0; jj < count; jj++) {
+    if (!folded[jj]) continue;
+    for (uint32_t ii = 0; ii < count; ii++) {
+      if (!folded[ii] && covers(mEntries[ii], mEntries[jj])) {
+        owner[jj] = ii;
+        break;
+      }
+    }
+    if (owner[jj] == jj) {
+      folded[jj] = false;
+      continue;
+    }
+    // The entry that replaces it is worth at least as much
+    priority[owner[jj]] = std::max(priority[owner[jj]], priority[jj]);
+  }
+
+  // Rank what is left: priority first, then the smaller entry, then the AID
+  // itself, so the same inputs always give the same table.
+  std::vector<uint32_t> order;
+  for (uint32_t jj = 0; jj < count; jj++)
+    if (!folded[jj]) order.push_back(jj);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    const Entry& ea = mEntries[a];
+    const Entry& eb = mEntries[b];
+    if (priority[a] != priority[b]) return priority[a] > priority[b];
+    if (ea.aid.size() != eb.aid.size()) return ea.aid.size() < eb.aid.size();
+    if (ea.aid != eb.aid) return ea.aid < eb.aid;
+    return a < b;
+  });
+
+  std::vector<bool> chosen(count, false);
+  uint32_t size = mFixedLen, aids = 0;
+  for (uint32_t jj : order) {
+    uint32_t len = mEntries[jj].aid.size() + ENTRY_HDR_LEN;
+    if ((size + len > capacity) || ((maxAids != 0) && (aids >= maxAids)))
+      continue;
+    chosen[jj] = true;
+    size += len;
+    aids++;
+  }
+
+  kept.clear();
+  mDropped = 0;
+  for (uint32_t jj = 0; jj < count; jj++) {
+    if (chosen[jj])
+      kept.push_back(jj);
+    else if (!chosen[owner[jj]])
+      mDropped++;
+  }
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: %u candidates, %u sent, %u dropped; %u of %u bytes", fn, count,
+      (uint32_t)kept.size(), mDropped, size, capacity);
+  return size;
+}
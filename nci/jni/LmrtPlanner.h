@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ *  Size a candidate listen mode routing table before it is sent to the
+ *  controller.
+ *
+ *  The planner works on plain data only; it never talks to the stack, so
+ *  a plan can be computed as often as the routing inputs change.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+class LmrtPlanner {
+ public:
+  // Encoded NCI entry header: TYPE + LENGTH + ROUTE + POWER
+  static const uint32_t ENTRY_HDR_LEN = 4;
+  // aidInfo qualifiers, see RegisteredAidCache.java
+  static const uint8_t AID_QUAL_PREFIX = 0x10;
+  static const uint8_t AID_QUAL_SUBSET = 0x20;
+
+  /*******************************************************************************
+  **
+  ** Function:        LmrtPlanner
+  **
+  ** Description:     Initialize member variables.
+  **                  matchingMode: AID_MATCHING_ mode of the controller,
+  **                  see RoutingManager.h.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  explicit LmrtPlanner(int matchingMode);
+
+  /*******************************************************************************
+  **
+  ** Function:        addAid
+  **
+  ** Description:     Add a candidate AID entry.
+  **                  aid: AID without the '*' or '#' suffix.
+  **                  aidLen: Length of aid.
+  **                  route, power, aidInfo: As for NFA_EeAddAidRouting().
+  **                  priority: Higher values are dropped last.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  void addAid(const uint8_t* aid, uint8_t aidLen, uint8_t route, uint8_t power,
+              uint8_t aidInfo, int priority);
+
+  /*******************************************************************************
+  **
+  ** Function:        addTech, addProto, addSystemCode
+  **
+  ** Description:     Account for a technology, protocol or system code entry
+  **                  that shares the table with the AIDs.  These are never
+  **                  dropped.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  void addTech() { mFixedLen += ENTRY_HDR_LEN + 1; }
+  void addProto() { mFixedLen += ENTRY_HDR_LEN + 1; }
+  void addSystemCode() { mFixedLen += ENTRY_HDR_LEN + 2; }
+
+  /*******************************************************************************
+  **
+  ** Function:        encodedSize
+  **
+  ** Description:     Size of the table if every candidate were sent as is.
+  **
+  ** Returns:         Size in bytes.
+  **
+  *******************************************************************************/
+  uint32_t encodedSize() const;
+
+  /*******************************************************************************
+  **
+  ** Function:        plan
+  **
+  ** Description:     Choose the AID entries to send.  Entries whose matches
+  **                  are already covered by a prefix or subset entry for the
+  **                  same route and power are folded into it.  If the rest
+  **                  still does not fit, the lowest priority entries are
+  **                  dropped; the outcome depends only on the inputs.
+  **                  capacity: Table size in bytes.
+  **                  maxAids: Maximum number of AID entries; 0 for no limit.
+  **                  kept: Receives the indices (in addAid() order) of the
+  **                        entries to send, in ascending order.
+  **
+  ** Returns:         Encoded size of the planned table.
+  **
+  *******************************************************************************/
+  uint32_t plan(uint32_t capacity, uint32_t maxAids,
+                std::vector<uint32_t>& kept) const;
+
+  /*******************************************************************************
+  **
+  ** Function:        droppedCount
+  **
+  ** Description:     Number of entries the last plan() had to drop to fit.
+  **                  Entries folded into another entry are not counted.
+  **
+  ** Returns:         Count of dropped entries.
+  **
+  *******************************************************************************/
+  uint32_t droppedCount() const { return mDropped; }
+
+ private:
+  struct Entry {
+    std::vector<uint8_t> aid;
+    uint8_t route;
+    uint8_t power;
+    uint8_t aidInfo;
+    int priority;
+  };
+
+  bool isPrefix(const Entry& entry) const;
+  bool isSubset(const Entry& entry) const;
+  bool covers(const Entry& outer, const Entry& inner) const;
+  static bool startsWith(const std::vector<uint8_t>& aid,
+                         const std::vector<uint8_t>& prefix);
+
+  int mMatchingMode;
+  uint32_t mFixedLen;
+  std::vector<Entry> mEntries;
+  mutable uint32_t mDropped;
+};
@@ -128,6 +128,60 @@ static jboolean nativeLlcpSocket_doSend(JNIEnv* e, jobject o, jbyteArray data) {
   return stat ? JNI_TRUE : JNI_FALSE;
 }
 
+/*******************************************************************************
+**
+** Function:        nativeLlcpSocket_doSendQueued
+**
+** Description:     Queue data for sending to the peer without waiting for the
+**                  link.
+**                  e: JVM environment.
+**                  o: Java object.
+**                  data: Buffer of data.
+**                  maxChunk: Max length of each I-PDU; 0 for the peer's MIU.
+**
+** Returns:         True if ok.
+**
+*******************************************************************************/
+static jboolean nativeLlcpSocket_doSendQueued(JNIEnv* e, jobject o,
+                                              jbyteArray data, jint maxChunk) {
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", __func__);
+
+  ScopedByteArrayRO bytes(e, data);
+  if (bytes.get() == NULL) return JNI_FALSE;  // NullPointerException thrown
+  if ((maxChunk < 0) || (maxChunk > 0xFFFF)) maxChunk = 0;
+
+  PeerToPeer::tJNI_HANDLE jniHandle =
+      (PeerToPeer::tJNI_HANDLE)nfc_jni_get_nfc_socket_handle(e, o);
+  bool stat = PeerToPeer::getInstance().sendQueued(
+      jniHandle, reinterpret_cast<const uint8_t*>(bytes.get()), bytes.size(),
+      (uint16_t)maxChunk);
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", __func__);
+  return stat ? JNI_TRUE : JNI_FALSE;
+}
+
+/*******************************************************************************
+**
+** Function:        nativeLlcpSocket_doFlush
+**
+** Description:     Wait until all queued data was handed to the stack.
+**                  e: JVM environment.
+**                  o: Java object.
+**
+** Returns:         True if all queued data was sent.
+**
+*******************************************************************************/
+static jboolean nativeLlcpSocket_doFlush(JNIEnv* e, jobject o) {
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", __func__);
+
+  PeerToPeer::tJNI_HANDLE jniHandle =
+      (PeerToPeer::tJNI_HANDLE)nfc_jni_get_nfc_socket_handle(e, o);
+  bool stat = PeerToPeer::getInstance().flush(jniHandle);
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", __func__);
+  return stat ? JNI_TRUE : JNI_FALSE;
+}
+
 /*******************************************************************************
 **
 ** Function:        nativeLlcpSocket_doReceive
@@ -164,6 +218,62 @@ static jint nativeLlcpSocket_doReceive(JNIEnv* e, jobject o,
   return retval;
 }
 
+/*******************************************************************************
+**
+** Function:        nativeLlcpSocket_doReceiveBatch
+**
+** Description:     Receive all queued SDUs from peer in one call.
+**                  e: JVM environment.
+**                  o: Java object.
+**                  origBuffer: Buffer to put received data, SDUs back to back.
+**                  sduLengths: Receives the length of each SDU.
+**
+** Returns:         Number of SDUs received, or -1 on failure.  Throws
+**                  IllegalArgumentException if sduLengths is empty.
+**
+*******************************************************************************/
+static jint nativeLlcpSocket_doReceiveBatch(JNIEnv* e, jobject o,
+                                            jbyteArray origBuffer,
+                                            jintArray sduLengths) {
+  static const uint16_t kMaxSdusPerCall = 64;
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", __func__);
+
+  ScopedByteArrayRW bytes(e, origBuffer);
+  if (bytes.get() == NULL) return -1;  // NullPointerException already thrown
+  if (sduLengths == NULL) {
+    jniThrowNullPointerException(e, NULL);
+    return -1;
+  }
+
+  PeerToPeer::tJNI_HANDLE jniHandle =
+      (PeerToPeer::tJNI_HANDLE)nfc_jni_get_nfc_socket_handle(e, o);
+  uint16_t lengths[kMaxSdusPerCall];
+  jint maxSdus = e->GetArrayLength(sduLengths);
+  if (maxSdus == 0) {
+    // no room for even one SDU; not a link failure
+    jniThrowException(e, "java/lang/IllegalArgumentException",
+                      "sduLengths is empty");
+    return -1;
+  }
+  if (maxSdus > kMaxSdusPerCall) maxSdus = kMaxSdusPerCall;
+  uint16_t numSdus = 0;
+  bool stat = PeerToPeer::getInstance().receiveBatch(
+      jniHandle, reinterpret_cast<uint8_t*>(&bytes[0]), bytes.size(), lengths,
+      (uint16_t)maxSdus, numSdus);
+
+  jint retval = -1;
+  if (stat && (numSdus > 0)) {
+    jint sizes[kMaxSdusPerCall];
+    for (uint16_t i = 0; i < numSdus; i++) sizes[i] = lengths[i];
+    e->SetIntArrayRegion(sduLengths, 0, numSdus, sizes);
+    retval = numSdus;
+  }
+
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: exit; sdus=%d", __func__, retval);
+  return retval;
+}
+
 /*******************************************************************************
 **
 ** Function:        nativeLlcpSocket_doGetRemoteSocketMIU
@@ -219,7 +329,10 @@ static JNINativeMethod gMethods[] = {
      (void*)nativeLlcpSocket_doConnectBy},
     {"doClose", "()Z", (void*)nativeLlcpSocket_doClose},
     {"doSend", "([B)Z", (void*)nativeLlcpSocket_doSend},
+    {"doSendQueued", "([BI)Z", (void*)nativeLlcpSocket_doSendQueued},
+    {"doFlush", "()Z", (void*)nativeLlcpSocket_doFlush},
     {"doReceive", "([B)I", (void*)nativeLlcpSocket_doReceive},
+    {"doReceiveBatch", "([B[I)I", (void*)nativeLlcpSocket_doReceiveBatch},
     {"doGetRemoteSocketMiu", "()I",
      (void*)nativeLlcpSocket_doGetRemoteSocketMIU},
     {"doGetRemoteSocketRw", "()I", (void*)nativeLlcpSocket_doGetRemoteSocketRW},
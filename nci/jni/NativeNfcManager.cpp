@@ -31,10 +31,12 @@
 #include <nativehelper/ScopedUtfChars.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdio.h>
 #include <sys/time.h>
 #include "HciEventManager.h"
 #include "HciRFParams.h"
 #include "JavaClassConstants.h"
+#include "JniEventDispatcher.h"
 #include "NfcAdaptation.h"
 #include "NfcJniUtil.h"
 #include "NfcTag.h"
@@ -217,6 +219,7 @@ jmethodID gCachedNfcManagerNotifySeListenActivated;
 jmethodID gCachedNfcManagerNotifySeListenDeactivated;
 jmethodID gCachedNfcManagerNotifyHostEmuActivated;
 jmethodID gCachedNfcManagerNotifyHostEmuData;
+jmethodID gCachedNfcManagerNotifyHostEmuReplay;
 jmethodID gCachedNfcManagerNotifyHostEmuDeactivated;
 jmethodID gCachedNfcManagerNotifyRfFieldActivated;
 jmethodID gCachedNfcManagerNotifyRfFieldDeactivated;
@@ -1524,6 +1527,7 @@ static void nfaConnectionCallback(uint8_t connEvent,
 
     memset(nat, 0, sizeof(*nat));
     e->GetJavaVM(&(nat->vm));
+    JniEventDispatcher::getInstance().start(nat->vm);
     nat->env_version = e->GetVersion();
     nat->manager = e->NewGlobalRef(o);
 
@@ -1569,6 +1573,9 @@ static void nfaConnectionCallback(uint8_t connEvent,
     gCachedNfcManagerNotifyHostEmuData =
         e->GetMethodID(cls.get(), "notifyHostEmuData", "(I[B)V");
 
+    gCachedNfcManagerNotifyHostEmuReplay =
+        e->GetMethodID(cls.get(), "notifyHostEmuReplay", "(I[B)V");
+
     gCachedNfcManagerNotifyHostEmuDeactivated =
         e->GetMethodID(cls.get(), "notifyHostEmuDeactivated", "(I)V");
 
@@ -1712,21 +1719,15 @@ static void nfaConnectionCallback(uint8_t connEvent,
           SecureElement::getInstance().notifyRfFieldEvent(
               eventData->rf_field.rf_field_status == NFA_DM_RF_FIELD_ON);
           struct nfc_jni_native_data* nat = getNative(NULL, NULL);
-          JNIEnv* e = NULL;
-          ScopedAttach attach(nat->vm, &e);
-          if (e == NULL) {
-            LOG(ERROR) << StringPrintf("jni env is null");
-            return;
-          }
-          if (eventData->rf_field.rf_field_status == NFA_DM_RF_FIELD_ON) {
+          bool fieldOn =
+              (eventData->rf_field.rf_field_status == NFA_DM_RF_FIELD_ON);
+          if (fieldOn) {
             if (!pTransactionController->transactionAttempt(
                     TRANSACTION_REQUESTOR(RF_FIELD_EVT))) {
               DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
                   "%s: RF field on evnt Not allowing to set", __FUNCTION__);
             }
             sRfFieldOff = false;
-            e->CallVoidMethod(nat->manager,
-                              android::gCachedNfcManagerNotifyRfFieldActivated);
           } else {
             /*In case of if Field On is not received before activation, consider
              NFA_ACTIVATED_EVENT for
@@ -1741,10 +1742,17 @@ static void nfaConnectionCallback(uint8_t connEvent,
                   TRANSACTION_REQUESTOR(RF_FIELD_EVT));
             }
             sRfFieldOff = true;
+          }
+          JniEventDispatcher::getInstance().post([nat, fieldOn](JNIEnv* e) {
             e->CallVoidMethod(
                 nat->manager,
-                android::gCachedNfcManagerNotifyRfFieldDeactivated);
-          }
+                fieldOn ? android::gCachedNfcManagerNotifyRfFieldActivated
+                        : android::gCachedNfcManagerNotifyRfFieldDeactivated);
+            if (e->ExceptionCheck()) {
+              e->ExceptionClear();
+              LOG(ERROR) << StringPrintf("fail notify");
+            }
+          });
         }
         break;
 
@@ -1975,6 +1983,111 @@ static void nfaConnectionCallback(uint8_t connEvent,
     return result;
   }
 
+#if (NXP_EXTNS == TRUE)
+  /*******************************************************************************
+  **
+  ** Function:        nfcManager_routeAids
+  **
+  ** Description:     Route a set of AIDs in one call.
+  **                  e: JVM environment.
+  **                  table: Packed entries, each
+  **                         aidLen | aid | route | power | aidInfo.
+  **                  count: Number of entries in table.
+  **
+  ** Returns:         True if every AID was routed.
+  **
+  *******************************************************************************/
+  static jboolean nfcManager_routeAids(JNIEnv * e, jobject, jbyteArray table,
+                                       jint count) {
+    ScopedByteArrayRO bytes(e, table);
+    if (bytes.get() == NULL) return JNI_FALSE;  // NullPointerException thrown
+    if (count <= 0) return JNI_TRUE;
+    std::vector<uint8_t> entries(
+        reinterpret_cast<const uint8_t*>(bytes.get()),
+        reinterpret_cast<const uint8_t*>(bytes.get()) + bytes.size());
+
+    if (nfcFL.nfccFL._NFC_NXP_STAT_DUAL_UICC_WO_EXT_SWITCH) {
+      // Same UICC slot mapping as nfcManager_routeAid()
+      size_t offset = 0;
+      for (jint xx = 0; (xx < count) && (offset < entries.size()); xx++) {
+        size_t routeOffset = offset + 1 + entries[offset];
+        if (routeOffset >= entries.size()) break;
+        uint8_t& route = entries[routeOffset];
+        if (route == 2 || route == 4)  // UICC or UICC2 HANDLE
+          route = (sCurrentSelectedUICCSlot != 0x02) ? 0x02 : 0x04;
+        offset = routeOffset + 3;
+      }
+    }
+    if (((nfcFL.chipType == pn548C2) || (nfcFL.chipType == pn551)) &&
+        pTransactionController->getCurTransactionRequestor() ==
+            TRANSACTION_REQUESTOR(RF_FIELD_EVT)) {
+      pTransactionController->transactionEnd(
+          TRANSACTION_REQUESTOR(RF_FIELD_EVT));
+    }
+    return RoutingManager::getInstance().addAidRoutingBatch(
+               entries.data(), entries.size(), count)
+               ? JNI_TRUE
+               : JNI_FALSE;
+  }
+#endif
+
+  /*******************************************************************************
+  **
+  ** Function:        nfcManager_setHceStaticResponse
+  **
+  ** Description:     Register a fixed response the stack answers an HCE
+  **                  command with, without calling Java.
+  **                  e: JVM environment.
+  **                  owner: Id of the registering service.
+  **                  aid: AID the command is valid for.
+  **                  command: Command to match.
+  **                  mask: Bits of command to compare; same length.
+  **                  response: Response including status word.
+  **
+  ** Returns:         True if registered.
+  **
+  *******************************************************************************/
+  static jboolean nfcManager_setHceStaticResponse(
+      JNIEnv * e, jobject, jint owner, jbyteArray aid, jbyteArray command,
+      jbyteArray mask, jbyteArray response) {
+    ScopedByteArrayRO aidBytes(e, aid);
+    ScopedByteArrayRO commandBytes(e, command);
+    ScopedByteArrayRO maskBytes(e, mask);
+    ScopedByteArrayRO responseBytes(e, response);
+    if ((aidBytes.get() == NULL) || (commandBytes.get() == NULL) ||
+        (maskBytes.get() == NULL) || (responseBytes.get() == NULL))
+      return JNI_FALSE;  // NullPointerException thrown
+    if ((aidBytes.size() > 0xFF) ||
+        (maskBytes.size() != commandBytes.size()))
+      return JNI_FALSE;
+    return RoutingManager::getInstance().setHceStaticResponse(
+               owner, reinterpret_cast<const uint8_t*>(aidBytes.get()),
+               aidBytes.size(),
+               reinterpret_cast<const uint8_t*>(commandBytes.get()),
+               reinterpret_cast<const uint8_t*>(maskBytes.get()),
+               commandBytes.size(),
+               reinterpret_cast<const uint8_t*>(responseBytes.get()),
+               responseBytes.size())
+               ? JNI_TRUE
+               : JNI_FALSE;
+  }
+
+  /*******************************************************************************
+  **
+  ** Function:        nfcManager_clearHceStaticResponses
+  **
+  ** Description:     Drop the fixed HCE responses of a service.
+  **                  e: JVM environment.
+  **                  owner: Id of the service; negative for all services.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  static void nfcManager_clearHceStaticResponses(JNIEnv*, jobject,
+                                                 jint owner) {
+    RoutingManager::getInstance().clearHceStaticResponses(owner);
+  }
+
   /*******************************************************************************
   **
   ** Function:        nfcManager_unrouteAid
@@ -2713,7 +2826,6 @@ static void nfcManager_doEnableDtaMode (JNIEnv* /* e */, jobject /* o */)
    **
    *******************************************************************************/
   void requestFwDownload() {
-    JNIEnv* e = NULL;
     uint8_t fwDnldRequest = false;
     int status = NFA_STATUS_OK;
 
@@ -2723,19 +2835,16 @@ static void nfcManager_doEnableDtaMode (JNIEnv* /* e */, jobject /* o */)
         "Enter: %s fwDnldRequest = %d", __func__, fwDnldRequest);
     if (status == NFA_STATUS_OK) {
       if (fwDnldRequest == true) {
-        ScopedAttach attach(RoutingManager::getInstance().mNativeData->vm, &e);
-        if (e == NULL) {
-          LOG(ERROR) << StringPrintf("Exit:%s jni env is null", __func__);
-          return;
-        }
-        if (nfcFL.nfccFL._NFCC_SPI_FW_DOWNLOAD_SYNC) {
-          e->CallVoidMethod(gNativeData->manager,
-                            android::gCachedNfcManagerNotifyFwDwnldRequested);
-        }
-        if (e->ExceptionCheck()) {
-          e->ExceptionClear();
-          LOG(ERROR) << StringPrintf("Exit:%s fail notify", __func__);
-        }
+        JniEventDispatcher::getInstance().post([](JNIEnv* e) {
+          if (nfcFL.nfccFL._NFCC_SPI_FW_DOWNLOAD_SYNC) {
+            e->CallVoidMethod(gNativeData->manager,
+                              android::gCachedNfcManagerNotifyFwDwnldRequested);
+          }
+          if (e->ExceptionCheck()) {
+            e->ExceptionClear();
+            LOG(ERROR) << StringPrintf("Exit:requestFwDownload fail notify");
+          }
+        });
 
       } else {
         LOG(ERROR) << StringPrintf("Exit:%s Firmware download request:%d ",
@@ -4587,6 +4696,11 @@ static void nfcManager_doFactoryReset(JNIEnv*, jobject) {
 
     NfcAdaptation& theInstance = NfcAdaptation::GetInstance();
     theInstance.Dump(fd);
+
+    uint32_t hits = 0, misses = 0;
+    EXTNS_MfcGetCacheStats(&hits, &misses);
+    dprintf(fd, "MIFARE Classic layout cache: %u hits, %u misses\n", hits,
+            misses);
   }
 
   /*******************************************************************************
@@ -5060,8 +5174,18 @@ static void nfcManager_doFactoryReset(JNIEnv*, jobject) {
 
     {"sendRawFrame", "([B)Z", (void*)nfcManager_sendRawFrame},
 
+    {"setHceStaticResponse", "(I[B[B[B[B)Z",
+     (void*)nfcManager_setHceStaticResponse},
+
+    {"clearHceStaticResponses", "(I)V",
+     (void*)nfcManager_clearHceStaticResponses},
+
     {"doRouteAid", "([BIII)Z", (void*)nfcManager_routeAid},
 
+#if (NXP_EXTNS == TRUE)
+    {"routeAids", "([BI)Z", (void*)nfcManager_routeAids},
+#endif
+
     {"doUnrouteAid", "([B)Z", (void*)nfcManager_unrouteAid},
 
     {"doSetRoutingEntry", "(IIII)Z", (void*)nfcManager_setRoutingEntry},
@@ -7851,29 +7975,25 @@ bool update_transaction_stat(const char * req_handle, transaction_state_t req_st
     }
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", __func__);
     struct nfc_jni_native_data* nat = getNative(NULL, NULL);
-    JNIEnv* e;
-    ScopedAttach attach(nat->vm, &e);
-    if (e == NULL) {
-      LOG(ERROR) << StringPrintf("jni env is null");
-      return;
-    }
+    int uiccStat;
     if (dualUiccInfo.uiccActivStat == 0x00) /*No UICC Detected*/
     {
-      e->CallVoidMethod(nat->manager,
-                        android::gCachedNfcManagerNotifyUiccStatusEvent,
-                        UICC_CONNECTED_0);
+      uiccStat = UICC_CONNECTED_0;
     } else if ((dualUiccInfo.uiccActivStat == 0x01) ||
                (dualUiccInfo.uiccActivStat == 0x02)) /*One UICC Detected*/
     {
-      e->CallVoidMethod(nat->manager,
-                        android::gCachedNfcManagerNotifyUiccStatusEvent,
-                        UICC_CONNECTED_1);
+      uiccStat = UICC_CONNECTED_1;
     } else if (dualUiccInfo.uiccActivStat == 0x03) /*Two UICC Detected*/
     {
+      uiccStat = UICC_CONNECTED_2;
+    } else {
+      return;
+    }
+    JniEventDispatcher::getInstance().post([nat, uiccStat](JNIEnv* e) {
       e->CallVoidMethod(nat->manager,
                         android::gCachedNfcManagerNotifyUiccStatusEvent,
-                        UICC_CONNECTED_2);
-    }
+                        uiccStat);
+    });
   }
 
   static int nfcManager_staticDualUicc_Precondition(int uiccSlot) {
@@ -36,8 +36,10 @@
 #include "NfcJniUtil.h"
 #include "NfcTag.h"
 #include "Pn544Interop.h"
+#include "PresenceCheckScheduler.h"
 #include "TransactionController.h"
 #include "ndef_utils.h"
+#include "nfc_config.h"
 #include "nfa_api.h"
 #include "nfa_rw_api.h"
 #include "nfc_brcm_defs.h"
@@ -106,6 +108,15 @@ static bool sCheckNdefCapable = false;  // whether tag has NDEF capability
 static tNFA_HANDLE sNdefTypeHandlerHandle = NFA_HANDLE_INVALID;
 tNFA_INTF_TYPE sCurrentRfInterface = NFA_INTERFACE_ISO_DEP;
 static std::basic_string<uint8_t> sRxDataBuffer;
+static std::basic_string<uint8_t> sTxDataBuffer;
+// Allocation accounting for the transceive path; a steady-state APDU
+// exchange should only ever bump javaArrays.
+static struct {
+  uint32_t calls;
+  uint32_t rxGrowths;   // sRxDataBuffer had to reallocate
+  uint32_t txGrowths;   // sTxDataBuffer had to reallocate
+  uint32_t javaArrays;  // response byte[] handed back to the service
+} sTransceiveStats;
 static tNFA_STATUS sRxDataStatus = NFA_STATUS_OK;
 static bool sWaitingForTransceive = false;
 static bool sTransceiveRfTimeout = false;
@@ -156,6 +167,8 @@ static bool setNdefDetectionTimeoutIfTagAbsent(JNIEnv* e, jobject o,
                                                tNFC_PROTOCOL protocol);
 static void setNdefDetectionTimeout();
 static jboolean nativeNfcTag_doPresenceCheck(JNIEnv*, jobject);
+static jboolean doPresenceCheckRf(int handle);
+static uint32_t presenceCheckWindowMs(int handle);
 #if (NXP_EXTNS == TRUE)
 uint8_t key1[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 uint8_t key2[6] = {0xD3, 0xF7, 0xD3, 0xF7, 0xD3, 0xF7};
@@ -1434,8 +1447,11 @@ void nativeNfcTag_doTransceiveStatus(tNFA_STATUS status, uint8_t* buf,
     return;
   }
   sRxDataStatus = status;
-  if (sRxDataStatus == NFA_STATUS_OK || sRxDataStatus == NFC_STATUS_CONTINUE)
+  if (sRxDataStatus == NFA_STATUS_OK || sRxDataStatus == NFC_STATUS_CONTINUE) {
+    size_t capacity = sRxDataBuffer.capacity();
     sRxDataBuffer.append(buf, bufLen);
+    if (sRxDataBuffer.capacity() != capacity) sTransceiveStats.rxGrowths++;
+  }
 
   if (sRxDataStatus == NFA_STATUS_OK) sTransceiveEvent.notifyOne();
 }
@@ -1451,6 +1467,29 @@ void nativeNfcTag_notifyRfTimeout() {
   sTransceiveEvent.notifyOne();
 }
 
+/*******************************************************************************
+**
+** Function:        nativeNfcTag_reserveTransceiveBuffers
+**
+** Description:     Size the reusable command and response buffers for the
+**                  largest ISO-DEP frame the controller is configured for, so
+**                  that exchanges within that limit do not reallocate.
+**                  Capacity is kept across sessions.
+**
+** Returns:         None
+**
+*******************************************************************************/
+static void nativeNfcTag_reserveTransceiveBuffers() {
+  static size_t sReserved = 0;
+  if (sReserved != 0) return;
+
+  sReserved = NfcConfig::getUnsigned(NAME_ISO_DEP_MAX_TRANSCEIVE, 261);
+  sRxDataBuffer.reserve(sReserved);
+  sTxDataBuffer.reserve(sReserved);
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: reserved %zu bytes", __func__, sReserved);
+}
+
 /*******************************************************************************
 **
 ** Function:        nativeNfcTag_doTransceive
@@ -1501,11 +1540,26 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
 
   NfcTag& natTag = NfcTag::getInstance();
 
-  // get input buffer and length from java call
-  ScopedByteArrayRO bytes(e, data);
-  uint8_t* buf = const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(
-      &bytes[0]));  // TODO: API bug; NFA_SendRawFrame should take const*!
-  size_t bufLen = bytes.size();
+  if (data == NULL) {
+    jniThrowNullPointerException(e, NULL);
+    return NULL;
+  }
+
+  // copy the command into the reusable buffer rather than pinning the java
+  // array for the whole exchange
+  nativeNfcTag_reserveTransceiveBuffers();
+  uint32_t rxGrowths = sTransceiveStats.rxGrowths;
+  uint32_t txGrowths = sTransceiveStats.txGrowths;
+  uint32_t javaArrays = sTransceiveStats.javaArrays;
+  sTransceiveStats.calls++;
+
+  size_t bufLen = e->GetArrayLength(data);
+  size_t capacity = sTxDataBuffer.capacity();
+  sTxDataBuffer.resize(bufLen);
+  if (sTxDataBuffer.capacity() != capacity) sTransceiveStats.txGrowths++;
+  e->GetByteArrayRegion(data, 0, bufLen,
+                        reinterpret_cast<jbyte*>(&sTxDataBuffer[0]));
+  uint8_t* buf = &sTxDataBuffer[0];
 
   if (statusTargetLost) {
     targetLost = e->GetIntArrayElements(statusTargetLost, 0);
@@ -1566,6 +1620,9 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
         natTag.isT2tNackResponse(sRxDataBuffer.data(), sRxDataBuffer.size())) {
       isNack = true;
     }
+    // the tag answered, so a presence check right now would tell nothing new
+    if (!isNack && (sRxDataBuffer.size() > 0))
+      PresenceCheckScheduler::getInstance().notePresent();
 
     if (sRxDataBuffer.size() > 0) {
       if (isNack) {
@@ -1587,6 +1644,7 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
         if (transDataLen != 0) {
           result.reset(e->NewByteArray(transDataLen));
           if (result.get() != NULL) {
+            sTransceiveStats.javaArrays++;
             e->SetByteArrayRegion(result.get(), 0, transDataLen,
                                   (const jbyte*)transData);
           } else
@@ -1597,6 +1655,7 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
         // marshall data to java for return
         result.reset(e->NewByteArray(sRxDataBuffer.size()));
         if (result.get() != NULL) {
+          sTransceiveStats.javaArrays++;
           e->SetByteArrayRegion(result.get(), 0, sRxDataBuffer.size(),
                                 (const jbyte*)sRxDataBuffer.data());
         } else
@@ -1615,7 +1674,14 @@ static jbyteArray nativeNfcTag_doTransceive(JNIEnv* e, jobject o,
     sSwitchBackTimer.set(1500, switchBackTimerProc);
   }
 #endif
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", __func__);
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: exit; allocs rx=%u tx=%u java=%u; totals calls=%u rx=%u tx=%u "
+      "java=%u",
+      __func__, sTransceiveStats.rxGrowths - rxGrowths,
+      sTransceiveStats.txGrowths - txGrowths,
+      sTransceiveStats.javaArrays - javaArrays, sTransceiveStats.calls,
+      sTransceiveStats.rxGrowths, sTransceiveStats.txGrowths,
+      sTransceiveStats.javaArrays);
   return result.release();
 }
 
@@ -1905,6 +1971,7 @@ TheEnd:
 *******************************************************************************/
 void nativeNfcTag_resetPresenceCheck() {
   sIsTagPresent = true;
+  PresenceCheckScheduler::getInstance().reset();
   NfcTag::getInstance().mCashbeeDetected = false;
   NfcTag::getInstance().mEzLinkTypeTag = false;
   MfcResetPresenceCheckStatus();
@@ -1939,11 +2006,8 @@ void nativeNfcTag_doPresenceCheckResult(tNFA_STATUS status) {
 *******************************************************************************/
 static jboolean nativeNfcTag_doPresenceCheck(JNIEnv*, jobject) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", __func__);
-  tNFA_STATUS status = NFA_STATUS_OK;
-  jboolean isPresent = JNI_FALSE;
   uint8_t* uid;
   uint32_t uid_len;
-  bool result;
   NfcTag::getInstance().getTypeATagUID(&uid, &uid_len);
   int handle = sCurrentConnectedHandle;
 
@@ -1981,6 +2045,53 @@ static jboolean nativeNfcTag_doPresenceCheck(JNIEnv*, jobject) {
     return JNI_FALSE;
   }
 
+  // Skip the RF exchange if the tag answered recently, and share a check
+  // that is already on the air
+  return PresenceCheckScheduler::getInstance().check(
+             presenceCheckWindowMs(handle),
+             [handle]() { return doPresenceCheckRf(handle) == JNI_TRUE; })
+             ? JNI_TRUE
+             : JNI_FALSE;
+}
+
+/*******************************************************************************
+**
+** Function:        presenceCheckWindowMs
+**
+** Description:     How long an answer from the tag proves it is present.
+**                  Technologies whose presence check disturbs the tag get a
+**                  longer window.
+**                  handle: Handle of the connected tag.
+**
+** Returns:         Window in milliseconds.
+**
+*******************************************************************************/
+static uint32_t presenceCheckWindowMs(int handle) {
+  // Kovio is checked by deactivating it
+  if (sCurrentConnectedTargetProtocol == TARGET_TYPE_KOVIO_BARCODE) return 1000;
+  // MIFARE Classic is checked by replaying the authentication
+  if (sCurrentConnectedTargetProtocol == NFC_PROTOCOL_MIFARE) return 500;
+  // ISO-DEP uses a proprietary check that holds the transaction lock
+  if (NfcTag::getInstance().mTechLibNfcTypes[handle] == NFA_PROTOCOL_ISO_DEP)
+    return 250;
+  return 125;
+}
+
+/*******************************************************************************
+**
+** Function:        doPresenceCheckRf
+**
+** Description:     Check over RF if the tag is in the RF field.
+**                  handle: Handle of the connected tag.
+**
+** Returns:         True if tag is in RF field.
+**
+*******************************************************************************/
+static jboolean doPresenceCheckRf(int handle) {
+  tNFA_STATUS status = NFA_STATUS_OK;
+  jboolean isPresent = JNI_FALSE;
+  bool result;
+
   /*Presence check for Kovio - RF Deactive command with type Discovery*/
   DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: handle=%d", __func__, handle);
@@ -2666,6 +2777,7 @@ static JNINativeMethod gMethods[] = {
 *******************************************************************************/
 int register_com_android_nfc_NativeNfcTag(JNIEnv* e) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", __func__);
+  if (!NfcTag::cacheJavaIds(e, gNativeNfcTagClassName)) return JNI_ERR;
   return jniRegisterNativeMethods(e, gNativeNfcTagClassName, gMethods,
                                   NELEM(gMethods));
 }
@@ -19,6 +19,7 @@
 #include <log/log.h>
 #include "JavaClassConstants.h"
 #include "NfcJniUtil.h"
+#include "PeerToPeer.h"
 #include <nativehelper/JNIHelp.h>
 
 using android::base::StringPrintf;
@@ -76,6 +77,7 @@ static JNINativeMethod gMethods[] = {
 **
 *******************************************************************************/
 int register_com_android_nfc_NativeP2pDevice(JNIEnv* e) {
+  if (!PeerToPeer::cacheJavaIds(e, gNativeP2pDeviceClassName)) return JNI_ERR;
   return jniRegisterNativeMethods(e, gNativeP2pDeviceClassName, gMethods,
                                   NELEM(gMethods));
 }
@@ -644,8 +644,6 @@ static jbyteArray nativeNfcSecureElement_doGetAtr(JNIEnv* e, jobject,
 static jbyteArray nativeNfcSecureElement_doTransceive(JNIEnv* e, jobject,
                                                       jint handle,
                                                       jbyteArray data) {
-  const int32_t recvBufferMaxSize = 0x8800;  // 1024; 34k
-  uint8_t recvBuffer[recvBufferMaxSize];
   int32_t recvBufferActualSize = 0;
   eTransceiveStatus tranStatus = TRANSCEIVE_STATUS_FAILED;
 
@@ -653,10 +651,15 @@ static jbyteArray nativeNfcSecureElement_doTransceive(JNIEnv* e, jobject,
 #if (NXP_EXTNS == TRUE)
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
       "%s: enter; handle=0x%X; buf len=%zu", __func__, handle, bytes.size());
-  tranStatus = SecureElement::getInstance().transceive(
-      reinterpret_cast<uint8_t*>(&bytes[0]), bytes.size(), recvBuffer,
-      recvBufferMaxSize, recvBufferActualSize, WIRED_MODE_TRANSCEIVE_TIMEOUT);
+  SecureElement& se = SecureElement::getInstance();
+  int32_t recvBufferMaxSize = 0;
+  uint8_t* recvBuffer = se.acquireResponseBuffer(recvBufferMaxSize);
+  tranStatus = se.transceive(reinterpret_cast<uint8_t*>(&bytes[0]),
+                             bytes.size(), recvBuffer, recvBufferMaxSize,
+                             recvBufferActualSize,
+                             WIRED_MODE_TRANSCEIVE_TIMEOUT);
   if (tranStatus == TRANSCEIVE_STATUS_MAX_WTX_REACHED) {
+    se.releaseResponseBuffer();
     LOG(ERROR) << StringPrintf("%s: Wired Mode Max WTX count reached",
                                __FUNCTION__);
     jbyteArray result = e->NewByteArray(0);
@@ -669,11 +672,12 @@ static jbyteArray nativeNfcSecureElement_doTransceive(JNIEnv* e, jobject,
   if (result != NULL) {
     e->SetByteArrayRegion(result, 0, recvBufferActualSize, (jbyte*)recvBuffer);
   }
+  se.releaseResponseBuffer();
   if (nfcFL.nfcNxpEse &&
       nfcFL.eseFL._NFCC_ESE_UICC_CONCURRENT_ACCESS_PROTECTION &&
-      (SecureElement::getInstance().mIsWiredModeBlocked == true)) {
+      (se.mIsWiredModeBlocked == true)) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("APDU Transceive CE wait");
-    SecureElement::getInstance().startThread(0x01);
+    se.startThread(0x01);
   }
   DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: exit: recv len=%d", __func__, recvBufferActualSize);
@@ -684,6 +688,64 @@ static jbyteArray nativeNfcSecureElement_doTransceive(JNIEnv* e, jobject,
 #endif
 }
 
+/*******************************************************************************
+**
+** Function:        nativeNfcSecureElement_doTransceiveScript
+**
+** Description:     Send a script of APDUs to the secure element in one call;
+**                  see SecureElement::transceiveScript() for the encoding.
+**                  e: JVM environment.
+**                  o: Java object.
+**                  handle: Secure element's handle.
+**                  script: Encoded commands.
+**
+** Returns:         Encoded responses, or NULL if a command failed or its
+**                  status word did not match.
+**
+*******************************************************************************/
+static jbyteArray nativeNfcSecureElement_doTransceiveScript(JNIEnv* e, jobject,
+                                                            jint handle,
+                                                            jbyteArray script) {
+#if (NXP_EXTNS == TRUE)
+  ScopedByteArrayRO bytes(e, script);
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: enter; handle=0x%X; script len=%zu", __func__, handle, bytes.size());
+  SecureElement& se = SecureElement::getInstance();
+  std::vector<uint8_t> responses;
+  eTransceiveStatus tranStatus = se.transceiveScript(
+      reinterpret_cast<const uint8_t*>(&bytes[0]), bytes.size(), responses,
+      WIRED_MODE_TRANSCEIVE_TIMEOUT);
+  if (tranStatus == TRANSCEIVE_STATUS_MAX_WTX_REACHED) {
+    LOG(ERROR) << StringPrintf("%s: Wired Mode Max WTX count reached",
+                               __func__);
+    nativeNfcSecureElement_doResetSecureElement(e, NULL, handle);
+  }
+
+  // copy results back to java
+  jbyteArray result = NULL;
+  if (tranStatus == TRANSCEIVE_STATUS_OK) {
+    result = e->NewByteArray(responses.size());
+    if (result != NULL) {
+      e->SetByteArrayRegion(result, 0, responses.size(),
+                            (const jbyte*)responses.data());
+    }
+  }
+  if (nfcFL.nfcNxpEse &&
+      nfcFL.eseFL._NFCC_ESE_UICC_CONCURRENT_ACCESS_PROTECTION &&
+      (se.mIsWiredModeBlocked == true)) {
+    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("APDU Transceive CE wait");
+    se.startThread(0x01);
+  }
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: exit: responses len=%zu", __func__, responses.size());
+  return result;
+#else
+  (void)handle;
+  (void)script;
+  return e->NewByteArray(0);
+#endif
+}
+
 /*****************************************************************************
 **
 ** Description:     JNI functions
@@ -704,6 +766,8 @@ static JNINativeMethod gMethods[] = {
     {"doNativeeSEChipResetSecureElement", "()Z",
      (void*)nativeNfcSecureElement_doeSEChipResetSecureElement},
     {"doTransceive", "(I[B)[B", (void*)nativeNfcSecureElement_doTransceive},
+    {"doTransceiveScript", "(I[B)[B",
+     (void*)nativeNfcSecureElement_doTransceiveScript},
     {"doNativeGetAtr", "(I)[B", (void*)nativeNfcSecureElement_doGetAtr},
 };
 
@@ -43,6 +43,8 @@ class NfcTag {
   enum ActivationState { Idle, Sleep, Active };
   static const int MAX_NUM_TECHNOLOGY =
       11;  // max number of technologies supported by one or more tags
+  // Layout version of the descriptor; see NativeNfcTag.decodeDescriptor()
+  static const uint8_t TAG_DESCRIPTOR_VERSION = 1;
   int mTechList[MAX_NUM_TECHNOLOGY];  // array of NFC technologies according to
                                       // NFC service
   int mTechHandles[MAX_NUM_TECHNOLOGY];  // array of tag handles according to
@@ -83,6 +85,20 @@ class NfcTag {
   *******************************************************************************/
   static NfcTag& getInstance();
 
+  /*******************************************************************************
+  **
+  ** Function:        cacheJavaIds
+  **
+  ** Description:     Resolve the NativeNfcTag class, constructor and fields
+  **                  once, so tag discovery does not look them up again.
+  **                  e: JVM environment.
+  **                  className: Name of the Java NativeNfcTag class.
+  **
+  ** Returns:         True if everything was found.
+  **
+  *******************************************************************************/
+  static bool cacheJavaIds(JNIEnv* e, const char* className);
+
   /*******************************************************************************
   **
   ** Function:        initialize
@@ -493,6 +509,12 @@ class NfcTag {
   struct timespec mLastKovioTime;  // time of last Kovio tag activation
   uint8_t mLastKovioUid[NFC_KOVIO_MAX_LEN];  // uid of last Kovio tag activated
   bool mIsDynamicTagId;  // whether the tag has dynamic tag ID
+  // Tag data for the Java object, kept across the notifications of a
+  // multi-protocol tag; the vectors keep their capacity between tags
+  std::vector<uint8_t> mTechPollBytes[MAX_NUM_TECHNOLOGY];
+  std::vector<uint8_t> mTechActBytes[MAX_NUM_TECHNOLOGY];
+  std::vector<uint8_t> mUid;
+  std::vector<uint8_t> mTagDescriptor;
   bool mIsFelicaLite;
   tNFA_RW_PRES_CHK_OPTION mPresenceCheckAlgorithm;
 
@@ -545,8 +567,8 @@ class NfcTag {
   **
   ** Function:        createNativeNfcTag
   **
-  ** Description:     Create a brand new Java NativeNfcTag object;
-  **                  fill the objects's member variables with data;
+  ** Description:     Pack the tag into a descriptor;
+  **                  create a brand new Java NativeNfcTag object holding it;
   **                  notify NFC service;
   **                  activationData: data from activation.
   **
@@ -557,95 +579,56 @@ class NfcTag {
 
   /*******************************************************************************
   **
-  ** Function:        fillNativeNfcTagMembers1
-  **
-  ** Description:     Fill NativeNfcTag's members: mProtocols, mTechList,
-  *mTechHandles, mTechLibNfcTypes.
-  **                  e: JVM environment.
-  **                  tag_cls: Java NativeNfcTag class.
-  **                  tag: Java NativeNfcTag object.
-  **
-  ** Returns:         None
-  **
-  *******************************************************************************/
-  void fillNativeNfcTagMembers1(JNIEnv* e, jclass tag_cls, jobject tag);
-
-  /*******************************************************************************
-  **
-  ** Function:        fillNativeNfcTagMembers2
+  ** Function:        fillTechPollBytes
   **
-  ** Description:     Fill NativeNfcTag's members: mConnectedTechIndex or
-  *mConnectedTechnology.
-  **                  The original Google's implementation is in
-  *set_target_pollBytes(
-  **                  in com_android_nfc_NativeNfcTag.cpp;
-  **                  e: JVM environment.
-  **                  tag_cls: Java NativeNfcTag class.
-  **                  tag: Java NativeNfcTag object.
+  ** Description:     Record the poll bytes of every technology added by this
+  **                  activation; they become NativeNfcTag's mTechPollBytes.
   **                  activationData: data from activation.
   **
   ** Returns:         None
   **
   *******************************************************************************/
-  void fillNativeNfcTagMembers2(JNIEnv* e, jclass tag_cls, jobject tag,
-                                tNFA_ACTIVATED& activationData);
+  void fillTechPollBytes(tNFA_ACTIVATED& activationData);
 
   /*******************************************************************************
   **
-  ** Function:        fillNativeNfcTagMembers3
+  ** Function:        fillTechActBytes
   **
-  ** Description:     Fill NativeNfcTag's members: mTechPollBytes.
-  **                  The original Google's implementation is in
-  *set_target_pollBytes(
-  **                  in com_android_nfc_NativeNfcTag.cpp;
-  **                  e: JVM environment.
-  **                  tag_cls: Java NativeNfcTag class.
-  **                  tag: Java NativeNfcTag object.
+  ** Description:     Record the activation bytes of every technology added by
+  **                  this activation; they become NativeNfcTag's
+  **                  mTechActBytes.
   **                  activationData: data from activation.
   **
   ** Returns:         None
   **
   *******************************************************************************/
-  void fillNativeNfcTagMembers3(JNIEnv* e, jclass tag_cls, jobject tag,
-                                tNFA_ACTIVATED& activationData);
+  void fillTechActBytes(tNFA_ACTIVATED& activationData);
 
   /*******************************************************************************
   **
-  ** Function:        fillNativeNfcTagMembers4
+  ** Function:        fillUid
   **
-  ** Description:     Fill NativeNfcTag's members: mTechActBytes.
-  **                  The original Google's implementation is in
-  *set_target_activationBytes()
-  **                  in com_android_nfc_NativeNfcTag.cpp;
-  **                  e: JVM environment.
-  **                  tag_cls: Java NativeNfcTag class.
-  **                  tag: Java NativeNfcTag object.
+  ** Description:     Record the UID of the first technology; it becomes
+  **                  NativeNfcTag's mUid.
   **                  activationData: data from activation.
   **
   ** Returns:         None
   **
   *******************************************************************************/
-  void fillNativeNfcTagMembers4(JNIEnv* e, jclass tag_cls, jobject tag,
-                                tNFA_ACTIVATED& activationData);
+  void fillUid(tNFA_ACTIVATED& activationData);
 
   /*******************************************************************************
   **
-  ** Function:        fillNativeNfcTagMembers5
+  ** Function:        buildTagDescriptor
   **
-  ** Description:     Fill NativeNfcTag's members: mUid.
-  **                  The original Google's implementation is in
-  *nfc_jni_Discovery_notification_callback()
-  **                  in com_android_nfc_NativeNfcManager.cpp;
-  **                  e: JVM environment.
-  **                  tag_cls: Java NativeNfcTag class.
-  **                  tag: Java NativeNfcTag object.
-  **                  activationData: data from activation.
+  ** Description:     Pack the technologies, handles, types, poll bytes,
+  **                  activation bytes and UID of the tag into
+  **                  mTagDescriptor, which NativeNfcTag decodes on first use.
   **
   ** Returns:         None
   **
   *******************************************************************************/
-  void fillNativeNfcTagMembers5(JNIEnv* e, jclass tag_cls, jobject tag,
-                                tNFA_ACTIVATED& activationData);
+  void buildTagDescriptor();
 
   /*******************************************************************************
   **
@@ -20,7 +20,10 @@
 #pragma once
 #include <utils/RefBase.h>
 #include <utils/StrongPointer.h>
+#include <deque>
+#include <memory>
 #include <string>
+#include <vector>
 #include "NfcJniUtil.h"
 #include "SyncEvent.h"
 #include "nfa_p2p_api.h"
@@ -28,7 +31,7 @@
 class P2pServer;
 class P2pClient;
 class NfaConn;
-#define MAX_NFA_CONNS_PER_SERVER 5
+struct P2pHandleIndex;
 
 /*****************************************************************************
 **
@@ -74,6 +77,21 @@ class PeerToPeer {
   *******************************************************************************/
   static PeerToPeer& getInstance();
 
+  /*******************************************************************************
+  **
+  ** Function:        cacheJavaIds
+  **
+  ** Description:     Resolve the NativeP2pDevice class, constructor and
+  **                  fields once, so LLCP activation does not look them up
+  **                  again.
+  **                  e: JVM environment.
+  **                  className: Name of the Java NativeP2pDevice class.
+  **
+  ** Returns:         True if everything was found.
+  **
+  *******************************************************************************/
+  static bool cacheJavaIds(JNIEnv* e, const char* className);
+
   /*******************************************************************************
   **
   ** Function:        initialize
@@ -223,6 +241,40 @@ class PeerToPeer {
   *******************************************************************************/
   bool send(tJNI_HANDLE jniHandle, uint8_t* buffer, uint16_t bufferLen);
 
+  /*******************************************************************************
+  **
+  ** Function:        sendQueued
+  **
+  ** Description:     Queue data for a connection's sender thread and return
+  **                  without waiting for the link.  The data is split into
+  **                  chunks of at most the peer's MIU and maxChunk.  Blocks
+  **                  only while the peer's receive window worth of chunks is
+  **                  already queued.
+  **                  jniHandle: Handle of connection.
+  **                  buffer: Buffer of data.
+  **                  bufferLen: Length of data.
+  **                  maxChunk: Max length of each chunk; 0 for the peer's MIU.
+  **
+  ** Returns:         True if ok; false if the connection is gone or an
+  **                  earlier queued send failed.
+  **
+  *******************************************************************************/
+  bool sendQueued(tJNI_HANDLE jniHandle, const uint8_t* buffer,
+                  uint32_t bufferLen, uint16_t maxChunk);
+
+  /*******************************************************************************
+  **
+  ** Function:        flush
+  **
+  ** Description:     Wait until all data queued by sendQueued() was handed
+  **                  to the stack.
+  **                  jniHandle: Handle of connection.
+  **
+  ** Returns:         True if every queued chunk was sent.
+  **
+  *******************************************************************************/
+  bool flush(tJNI_HANDLE jniHandle);
+
   /*******************************************************************************
   **
   ** Function:        receive
@@ -239,6 +291,28 @@ class PeerToPeer {
   bool receive(tJNI_HANDLE jniHandle, uint8_t* buffer, uint16_t bufferLen,
                uint16_t& actualLen);
 
+  /*******************************************************************************
+  **
+  ** Function:        receiveBatch
+  **
+  ** Description:     Receive all SDUs queued for a connection in one call.
+  **                  Blocks until at least one SDU is available, then keeps
+  **                  reading while the stack reports more data, there is room
+  **                  for a whole SDU of local MIU size, and sduLengths is not
+  **                  full.  SDUs are stored back to back in buffer.
+  **                  jniHandle: Handle of connection.
+  **                  buffer: Buffer to store data.
+  **                  bufferLen: Max length of buffer.
+  **                  sduLengths: Receives the length of each SDU.
+  **                  maxSdus: Number of entries in sduLengths.
+  **                  numSdus: Number of SDUs received.
+  **
+  ** Returns:         True if ok.
+  **
+  *******************************************************************************/
+  bool receiveBatch(tJNI_HANDLE jniHandle, uint8_t* buffer, uint32_t bufferLen,
+                    uint16_t* sduLengths, uint16_t maxSdus, uint16_t& numSdus);
+
   /*******************************************************************************
   **
   ** Function:        disconnectConnOriented
@@ -373,7 +447,7 @@ class PeerToPeer {
                                 tNFA_P2P_EVT_DATA* eventData);
 
  private:
-  static const int sMax = 10;
+  friend class PeerToPeerPeer;
   static PeerToPeer sP2p;
 
   // Variables below only accessed from a single thread
@@ -388,8 +462,15 @@ class PeerToPeer {
   // A note on locking order: mMutex in PeerToPeer is *ALWAYS*
   // locked before any locks / guards in P2pServer / P2pClient
   Mutex mMutex;
-  android::sp<P2pServer> mServers[sMax];
-  android::sp<P2pClient> mClients[sMax];
+  std::vector<android::sp<P2pServer>> mServers;
+  std::vector<android::sp<P2pClient>> mClients;
+
+  // Handle lookup tables over mServers and mClients, protected by
+  // mIndexMutex.  Changed under mMutex as well, one object at a time, so
+  // lookups never need mMutex.  NFA handles of indexed objects are changed
+  // only through setNfaHandle(), which re-keys them.
+  Mutex mIndexMutex;
+  std::unique_ptr<P2pHandleIndex> mIndex;
 
   // Synchronization variables
   SyncEvent mSetTechEvent;  // completion event for NFA_SetP2pListenTech()
@@ -415,6 +496,127 @@ class PeerToPeer {
   static void ndefTypeCallback(tNFA_NDEF_EVT event,
                                tNFA_NDEF_EVT_DATA* evetnData);
 
+  /*******************************************************************************
+  **
+  ** Function:        indexServerLocked
+  **
+  ** Description:     Add a new server to the handle lookup tables.
+  **                  Assumes mMutex is already held.
+  **                  server: Server to add.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void indexServerLocked(const android::sp<P2pServer>& server);
+
+  /*******************************************************************************
+  **
+  ** Function:        unindexServerLocked
+  **
+  ** Description:     Remove a server and all its connections from the handle
+  **                  lookup tables.
+  **                  Assumes mMutex is already held.
+  **                  server: Server to remove.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void unindexServerLocked(const android::sp<P2pServer>& server);
+
+  /*******************************************************************************
+  **
+  ** Function:        indexClientLocked
+  **
+  ** Description:     Add a new client and its connection to the handle lookup
+  **                  tables.
+  **                  Assumes mMutex is already held.
+  **                  client: Client to add.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void indexClientLocked(const android::sp<P2pClient>& client);
+
+  /*******************************************************************************
+  **
+  ** Function:        unindexClientLocked
+  **
+  ** Description:     Remove a client and its connection from the handle lookup
+  **                  tables.
+  **                  Assumes mMutex is already held.
+  **                  client: Client to remove.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void unindexClientLocked(const android::sp<P2pClient>& client);
+
+  /*******************************************************************************
+  **
+  ** Function:        indexConnLocked
+  **
+  ** Description:     Add a new server connection to the handle lookup tables.
+  **                  Assumes mMutex is already held.
+  **                  conn: Connection to add.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void indexConnLocked(const android::sp<NfaConn>& conn);
+
+  /*******************************************************************************
+  **
+  ** Function:        unindexConnLocked
+  **
+  ** Description:     Remove a server connection from the handle lookup tables.
+  **                  Assumes mMutex is already held.
+  **                  conn: Connection to remove.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void unindexConnLocked(const android::sp<NfaConn>& conn);
+
+  /*******************************************************************************
+  **
+  ** Function:        setNfaHandleLocked
+  **
+  ** Description:     Change the NFA handle of a server, client or connection
+  **                  and re-key only that object in the handle lookup tables.
+  **                  Every change to an NFA handle of an indexed object goes
+  **                  through here.  Objects that were already removed are not
+  **                  added back.
+  **                  Assumes mMutex is already held.
+  **                  object: Server, client or connection to change.
+  **                  value: New handle.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void setNfaHandleLocked(const android::sp<P2pServer>& server,
+                          tNFA_HANDLE value);
+  void setNfaHandleLocked(const android::sp<P2pClient>& client,
+                          tNFA_HANDLE value);
+  void setNfaHandleLocked(const android::sp<NfaConn>& conn, tNFA_HANDLE value);
+
+  /*******************************************************************************
+  **
+  ** Function:        setNfaHandle
+  **
+  ** Description:     Lock mMutex and change the NFA handle of a server, client
+  **                  or connection.
+  **                  object: Server, client or connection to change.
+  **                  value: New handle.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  template <typename T>
+  void setNfaHandle(const android::sp<T>& object, tNFA_HANDLE value) {
+    AutoMutex mutex(mMutex);
+    setNfaHandleLocked(object, value);
+  }
+
   /*******************************************************************************
   **
   ** Function:        findServer
@@ -425,19 +627,19 @@ class PeerToPeer {
   ** Returns:         PeerToPeer object.
   **
   *******************************************************************************/
-  android::sp<P2pServer> findServerLocked(tNFA_HANDLE nfaP2pServerHandle);
+  android::sp<P2pServer> findServer(tNFA_HANDLE nfaP2pServerHandle);
 
   /*******************************************************************************
   **
   ** Function:        findServer
   **
   ** Description:     Find a PeerToPeer object by connection handle.
-  **                  serviceName: service name.
+  **                  jniHandle: JNI handle.
   **
   ** Returns:         PeerToPeer object.
   **
   *******************************************************************************/
-  android::sp<P2pServer> findServerLocked(tJNI_HANDLE jniHandle);
+  android::sp<P2pServer> findServer(tJNI_HANDLE jniHandle);
 
   /*******************************************************************************
   **
@@ -449,7 +651,7 @@ class PeerToPeer {
   ** Returns:         PeerToPeer object.
   **
   *******************************************************************************/
-  android::sp<P2pServer> findServerLocked(const char* serviceName);
+  android::sp<P2pServer> findServer(const char* serviceName);
 
   /*******************************************************************************
   **
@@ -514,18 +716,6 @@ class PeerToPeer {
   *******************************************************************************/
   android::sp<P2pClient> findClient(tJNI_HANDLE jniHandle);
 
-  /*******************************************************************************
-  **
-  ** Function:        findClientCon
-  **
-  ** Description:     Find a PeerToPeer object with a client connection handle.
-  **                  nfaConnHandle: Connection handle.
-  **
-  ** Returns:         PeerToPeer object.
-  **
-  *******************************************************************************/
-  android::sp<P2pClient> findClientCon(tNFA_HANDLE nfaConnHandle);
-
   /*******************************************************************************
   **
   ** Function:        findConnection
@@ -570,6 +760,12 @@ class NfaConn : public android::RefBase {
   SyncEvent mCongEvent;           // event for congestion
   SyncEvent mDisconnectingEvent;  // event for disconnecting
 
+  // Variables below protected by mTxEvent
+  std::deque<std::vector<uint8_t>> mTxQueue;  // chunks waiting for the stack
+  bool mTxBusy;    // sender thread is running
+  bool mTxFailed;  // a queued chunk could not be sent
+  SyncEvent mTxEvent;  // event for the outbound queue
+
   /*******************************************************************************
   **
   ** Function:        NfaConn
@@ -627,7 +823,7 @@ class P2pServer : public android::RefBase {
   **
   ** Description:     Accept a peer's request to connect.
   **                  serverJniHandle: Server's handle.
-  **                  connJniHandle: Connection handle.
+  **                  connection: Connection from allocateConnection().
   **                  maxInfoUnit: Maximum information unit.
   **                  recvWindow: Receive window size.
   **
@@ -635,14 +831,16 @@ class P2pServer : public android::RefBase {
   **
   *******************************************************************************/
   bool accept(PeerToPeer::tJNI_HANDLE serverJniHandle,
-              PeerToPeer::tJNI_HANDLE connJniHandle, int maxInfoUnit,
+              const android::sp<NfaConn>& connection, int maxInfoUnit,
               int recvWindow);
 
   /*******************************************************************************
   **
   ** Function:        unblockAll
   **
-  ** Description:     Unblocks all server connections
+  ** Description:     Unblocks all server connections; the caller invalidates
+  **                  their NFA handles first through
+  **                  PeerToPeer::setNfaHandleLocked().
   **
   ** Returns:         True if ok.
   **
@@ -685,10 +883,17 @@ class P2pServer : public android::RefBase {
   *******************************************************************************/
   bool removeServerConnection(PeerToPeer::tJNI_HANDLE jniHandle);
 
- private:
-  Mutex mMutex;
-  // mServerConn is protected by mMutex
-  android::sp<NfaConn> mServerConn[MAX_NFA_CONNS_PER_SERVER];
+  /*******************************************************************************
+  **
+  ** Function:        getConnections
+  **
+  ** Description:     Append all server connections to a list.
+  **                  conns: List to append to.
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void getConnections(std::vector<android::sp<NfaConn>>& conns);
 
   /*******************************************************************************
   **
@@ -698,10 +903,14 @@ class P2pServer : public android::RefBase {
   **                  jniHandle: JNI connection handle.
   **
   ** Returns:         Allocated connection object
-  **                  NULL if the maximum number of connections was reached
   **
   *******************************************************************************/
   android::sp<NfaConn> allocateConnection(PeerToPeer::tJNI_HANDLE jniHandle);
+
+ private:
+  Mutex mMutex;
+  // mServerConn is protected by mMutex
+  std::vector<android::sp<NfaConn>> mServerConn;
 };
 
 /*****************************************************************************
@@ -34,6 +34,7 @@
 #include "DataQueue.h"
 #include "HciEventManager.h"
 #include "JavaClassConstants.h"
+#include "JniEventDispatcher.h"
 #include "PeerToPeer.h"
 #include "PowerSwitch.h"
 #include "TransactionController.h"
@@ -1100,86 +1101,50 @@ void SecureElement::notifyTransactionListenersOfAid(const uint8_t* aidBuffer,
     return;
   }
 
-  JNIEnv* e = NULL;
-  ScopedAttach attach(mNativeData->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("%s: jni env is null", fn);
-    return;
-  }
-
-  const uint16_t tlvMaxLen = aidBufferLen + 10;
-  uint8_t* tlv = new uint8_t[tlvMaxLen];
-  if (tlv == NULL) {
-    LOG(ERROR) << StringPrintf("%s: fail allocate tlv", fn);
-    return;
-  }
-
-  memcpy(tlv, aidBuffer, aidBufferLen);
-  uint16_t tlvActualLen = aidBufferLen;
-
-  ScopedLocalRef<jobject> tlvJavaArray(e, e->NewByteArray(tlvActualLen));
-  if (tlvJavaArray.get() == NULL) {
-    LOG(ERROR) << StringPrintf("%s: fail allocate array", fn);
-    goto TheEnd;
-  }
+  // The stack owns the buffers; the upcall runs later on its own copies
+  std::vector<uint8_t> aid(aidBuffer, aidBuffer + aidBufferLen);
+  std::vector<uint8_t> data;
+  if (dataBufferLen > 0) data.assign(dataBuffer, dataBuffer + dataBufferLen);
 
-  e->SetByteArrayRegion((jbyteArray)tlvJavaArray.get(), 0, tlvActualLen,
-                        (jbyte*)tlv);
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: fail fill array", fn);
-    goto TheEnd;
-  }
-
-  if (dataBufferLen > 0) {
-    const uint32_t dataTlvMaxLen = dataBufferLen + 10;
-    uint8_t* datatlv = new uint8_t[dataTlvMaxLen];
-    if (datatlv == NULL) {
-      LOG(ERROR) << StringPrintf("%s: fail allocate tlv", fn);
-      return;
-    }
-
-    memcpy(datatlv, dataBuffer, dataBufferLen);
-    uint16_t dataTlvActualLen = dataBufferLen;
-
-    ScopedLocalRef<jobject> dataTlvJavaArray(e,
-                                             e->NewByteArray(dataTlvActualLen));
-    if (dataTlvJavaArray.get() == NULL) {
+  JniEventDispatcher::getInstance().post([this, aid, data,
+                                          evtSrc](JNIEnv* e) {
+    ScopedLocalRef<jobject> tlvJavaArray(e, e->NewByteArray(aid.size()));
+    if (tlvJavaArray.get() == NULL) {
       LOG(ERROR) << StringPrintf("%s: fail allocate array", fn);
-      goto Clean;
+      return;
     }
-
-    e->SetByteArrayRegion((jbyteArray)dataTlvJavaArray.get(), 0,
-                          dataTlvActualLen, (jbyte*)datatlv);
+    e->SetByteArrayRegion((jbyteArray)tlvJavaArray.get(), 0, aid.size(),
+                          (const jbyte*)&aid[0]);
     if (e->ExceptionCheck()) {
       e->ExceptionClear();
       LOG(ERROR) << StringPrintf("%s: fail fill array", fn);
-      goto Clean;
+      return;
     }
 
-    e->CallVoidMethod(mNativeData->manager,
-                      android::gCachedNfcManagerNotifyTransactionListeners,
-                      tlvJavaArray.get(), dataTlvJavaArray.get(), evtSrc);
-    if (e->ExceptionCheck()) {
-      e->ExceptionClear();
-      LOG(ERROR) << StringPrintf("%s: fail notify", fn);
-      goto Clean;
+    ScopedLocalRef<jobject> dataTlvJavaArray(e, NULL);
+    if (!data.empty()) {
+      dataTlvJavaArray.reset(e->NewByteArray(data.size()));
+      if (dataTlvJavaArray.get() == NULL) {
+        LOG(ERROR) << StringPrintf("%s: fail allocate array", fn);
+        return;
+      }
+      e->SetByteArrayRegion((jbyteArray)dataTlvJavaArray.get(), 0,
+                            data.size(), (const jbyte*)&data[0]);
+      if (e->ExceptionCheck()) {
+        e->ExceptionClear();
+        LOG(ERROR) << StringPrintf("%s: fail fill array", fn);
+        return;
+      }
     }
 
-  Clean:
-    delete[] datatlv;
-  } else {
     e->CallVoidMethod(mNativeData->manager,
                       android::gCachedNfcManagerNotifyTransactionListeners,
-                      tlvJavaArray.get(), NULL, evtSrc);
+                      tlvJavaArray.get(), dataTlvJavaArray.get(), evtSrc);
     if (e->ExceptionCheck()) {
       e->ExceptionClear();
       LOG(ERROR) << StringPrintf("%s: fail notify", fn);
-      goto TheEnd;
     }
-  }
-TheEnd:
-  delete[] tlv;
+  });
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
 }
 
@@ -1199,23 +1164,16 @@ void SecureElement::notifyConnectivityListeners(uint8_t evtSrc) {
   DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: enter; evtSrc =%u", fn, evtSrc);
 
-  JNIEnv* e = NULL;
-  ScopedAttach attach(mNativeData->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("%s: jni env is null", fn);
-    return;
-  }
-
-  e->CallVoidMethod(mNativeData->manager,
-                    android::gCachedNfcManagerNotifyConnectivityListeners,
-                    evtSrc);
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: fail notify", fn);
-    goto TheEnd;
-  }
+  JniEventDispatcher::getInstance().post([this, evtSrc](JNIEnv* e) {
+    e->CallVoidMethod(mNativeData->manager,
+                      android::gCachedNfcManagerNotifyConnectivityListeners,
+                      evtSrc);
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: fail notify", fn);
+    }
+  });
 
-TheEnd:
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
 }
 
@@ -1234,23 +1192,16 @@ void SecureElement::notifyEmvcoMultiCardDetectedListeners() {
       "SecureElement::notifyEmvcoMultiCardDetectedListeners";
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", fn);
 
-  JNIEnv* e = NULL;
-  ScopedAttach attach(mNativeData->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("%s: jni env is null", fn);
-    return;
-  }
-
-  e->CallVoidMethod(
-      mNativeData->manager,
-      android::gCachedNfcManagerNotifyEmvcoMultiCardDetectedListeners);
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: fail notify", fn);
-    goto TheEnd;
-  }
+  JniEventDispatcher::getInstance().post([this](JNIEnv* e) {
+    e->CallVoidMethod(
+        mNativeData->manager,
+        android::gCachedNfcManagerNotifyEmvcoMultiCardDetectedListeners);
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: fail notify", fn);
+    }
+  });
 
-TheEnd:
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
 }
 
@@ -1556,6 +1507,132 @@ bool SecureElement::disconnectEE(jint seID) {
   return true;
 }
 
+#if (NXP_EXTNS == TRUE)
+/*******************************************************************************
+**
+** Function:        transceiveScript
+**
+** Description:     Send a script of APDUs to the secure element in one call.
+**                  Each command in the script is encoded as a 2-byte
+**                  big-endian length, the APDU, a 2-byte expected status
+**                  word and a 2-byte status word mask (0x0000 accepts any
+**                  response).  For every command executed, the response
+**                  is appended to responses as a 2-byte big-endian length
+**                  followed by the response bytes.  Execution stops after
+**                  the first command that fails or whose status word does
+**                  not match.
+**                  script: Encoded commands.
+**                  scriptSize: Length of script.
+**                  responses: Receives the encoded responses.
+**                  timeoutMillisec: Timeout of each command in millisecond.
+**
+** Returns:         TRANSCEIVE_STATUS_OK if the script was well formed and
+**                  every command succeeded with a matching status word;
+**                  otherwise the status of the command that stopped the
+**                  script, or TRANSCEIVE_STATUS_FAILED.
+**
+*******************************************************************************/
+eTransceiveStatus SecureElement::transceiveScript(
+    const uint8_t* script, int32_t scriptSize, std::vector<uint8_t>& responses,
+    int32_t timeoutMillisec) {
+  static const char fn[] = "SecureElement::transceiveScript";
+  eTransceiveStatus tranStatus = TRANSCEIVE_STATUS_OK;
+  int32_t recvBufferMaxSize = 0;
+  int32_t numCommands = 0;
+  int32_t offset = 0;
+
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: enter; scriptSize=%d", fn, scriptSize);
+  responses.clear();
+  uint8_t* recvBuffer = acquireResponseBuffer(recvBufferMaxSize);
+  while (offset < scriptSize) {
+    if (scriptSize - offset < 2) {
+      LOG(ERROR) << StringPrintf("%s: truncated command header", fn);
+      tranStatus = TRANSCEIVE_STATUS_FAILED;
+      break;
+    }
+    int32_t cmdLen = (script[offset] << 8) | script[offset + 1];
+    offset += 2;
+    if (cmdLen == 0 || scriptSize - offset < cmdLen + 4) {
+      LOG(ERROR) << StringPrintf("%s: bad command %d; len=%d", fn, numCommands,
+                                 cmdLen);
+      tranStatus = TRANSCEIVE_STATUS_FAILED;
+      break;
+    }
+    const uint8_t* cmd = script + offset;
+    offset += cmdLen;
+    uint16_t expectedSw = (script[offset] << 8) | script[offset + 1];
+    uint16_t swMask = (script[offset + 2] << 8) | script[offset + 3];
+    offset += 4;
+
+    int32_t recvBufferActualSize = 0;
+    tranStatus = transceive(const_cast<uint8_t*>(cmd), cmdLen, recvBuffer,
+                            recvBufferMaxSize, recvBufferActualSize,
+                            timeoutMillisec);
+    numCommands++;
+    if (tranStatus != TRANSCEIVE_STATUS_OK) recvBufferActualSize = 0;
+    responses.push_back((uint8_t)(recvBufferActualSize >> 8));
+    responses.push_back((uint8_t)recvBufferActualSize);
+    responses.insert(responses.end(), recvBuffer,
+                     recvBuffer + recvBufferActualSize);
+    if (tranStatus != TRANSCEIVE_STATUS_OK) break;
+
+    if (swMask != 0) {
+      bool swMatch = false;
+      if (recvBufferActualSize >= 2) {
+        uint16_t sw = (recvBuffer[recvBufferActualSize - 2] << 8) |
+                      recvBuffer[recvBufferActualSize - 1];
+        swMatch = ((sw & swMask) == (expectedSw & swMask));
+      }
+      if (!swMatch) {
+        LOG(ERROR) << StringPrintf(
+            "%s: command %d; SW does not match 0x%04X/0x%04X", fn,
+            numCommands - 1, expectedSw, swMask);
+        tranStatus = TRANSCEIVE_STATUS_FAILED;
+        break;
+      }
+    }
+  }
+  releaseResponseBuffer();
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: exit; tranStatus: %d; commands: %d; response size: %zu", fn,
+      tranStatus, numCommands, responses.size());
+  return tranStatus;
+}
+#endif
+
+/*******************************************************************************
+**
+** Function:        acquireResponseBuffer
+**
+** Description:     Lock and return the buffer that wired-mode APDU
+**                  responses are received into.  It is allocated once and
+**                  is not cleared between uses; only the bytes reported by
+**                  transceive() are valid.
+**                  bufferSize: Receives the size of the buffer.
+**
+** Returns:         Response buffer; release with releaseResponseBuffer().
+**
+*******************************************************************************/
+uint8_t* SecureElement::acquireResponseBuffer(int32_t& bufferSize) {
+  mResponseBufferMutex.lock();
+  if (!mResponseBuffer) mResponseBuffer.reset(new uint8_t[MAX_RESPONSE_SIZE]);
+  bufferSize = MAX_RESPONSE_SIZE;
+  return mResponseBuffer.get();
+}
+
+/*******************************************************************************
+**
+** Function:        releaseResponseBuffer
+**
+** Description:     Unlock the buffer returned by acquireResponseBuffer().
+**
+** Returns:         None
+**
+*******************************************************************************/
+void SecureElement::releaseResponseBuffer() { mResponseBufferMutex.unlock(); }
+
 /*******************************************************************************
 **
 ** Function:        transceive
@@ -1652,7 +1729,6 @@ bool SecureElement::transceive(uint8_t* xmitBuffer, int32_t xmitBufferSize,
   {
     SyncEventGuard guard(mTransceiveEvent);
     mActualResponseSize = 0;
-    memset(recvBuffer, 0, recvBufferMaxSize);
 #if (NXP_EXTNS == TRUE)
     if (nfcFL.nfcNxpEse) {
       struct timeval start_timer, end_timer;
@@ -1946,18 +2022,11 @@ void SecureElement::notifyListenModeState(bool isActivated) {
   DLOG_IF(INFO, nfc_debug_enabled)
       << StringPrintf("%s: enter; listen mode active=%u", fn, isActivated);
 
-  JNIEnv* e = NULL;
   if (mNativeData == NULL) {
     LOG(ERROR) << StringPrintf("%s: mNativeData is null", fn);
     return;
   }
 
-  ScopedAttach attach(mNativeData->vm, &e);
-  if (e == NULL) {
-    LOG(ERROR) << StringPrintf("%s: jni env is null", fn);
-    return;
-  }
-
   mActivatedInListenMode = isActivated;
 #if (NXP_EXTNS == TRUE)
   if (nfcFL.nfcNxpEse) {
@@ -1976,7 +2045,7 @@ void SecureElement::notifyListenModeState(bool isActivated) {
     }
   }
 #endif
-  if (mNativeData != NULL) {
+  JniEventDispatcher::getInstance().post([this, isActivated](JNIEnv* e) {
     if (isActivated) {
       e->CallVoidMethod(mNativeData->manager,
                         android::gCachedNfcManagerNotifySeListenActivated);
@@ -1984,12 +2053,11 @@ void SecureElement::notifyListenModeState(bool isActivated) {
       e->CallVoidMethod(mNativeData->manager,
                         android::gCachedNfcManagerNotifySeListenDeactivated);
     }
-  }
-
-  if (e->ExceptionCheck()) {
-    e->ExceptionClear();
-    LOG(ERROR) << StringPrintf("%s: fail notify", fn);
-  }
+    if (e->ExceptionCheck()) {
+      e->ExceptionClear();
+      LOG(ERROR) << StringPrintf("%s: fail notify", fn);
+    }
+  });
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", fn);
 }
@@ -4179,19 +4247,14 @@ bool SecureElement::enableDwp(void) {
 }
 
 void spi_prio_signal_handler(int signum, siginfo_t* info, void* unused) {
-  DLOG_IF(INFO, nfc_debug_enabled)
-      << StringPrintf("%s: Inside the Signal Handler %d\n", __func__, SIG_NFC);
+  // runs in signal context: no logging here, the handler thread logs each
+  // event as it dequeues it
   if (nfcFL.chipType == pn557) {
-    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
-        "%s: for pn557/pn81T, signal_handler not supported. Returning\n",
-        __func__);
     return;
   }
 
   uint16_t usEvent = 0;
   if (signum == SIG_NFC) {
-    DLOG_IF(INFO, nfc_debug_enabled)
-        << StringPrintf("%s: Signal is SIG_NFC\n", __func__);
     if (nfcFL.eseFL._ESE_SVDD_SYNC || nfcFL.eseFL._ESE_JCOP_DWNLD_PROTECTION ||
         nfcFL.nfccFL._NFCC_SPI_FW_DOWNLOAD_SYNC ||
         nfcFL.eseFL._ESE_DWP_SPI_SYNC_ENABLE) {
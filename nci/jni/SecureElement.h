@@ -37,6 +37,8 @@
  *  controller.
  */
 #pragma once
+#include <memory>
+#include <vector>
 #include "DataQueue.h"
 #include "IntervalTimer.h"
 #include "NfcJniUtil.h"
@@ -327,6 +329,62 @@ class SecureElement {
                   int32_t& recvBufferActualSize, int32_t timeoutMillisec);
 #endif
 
+#if (NXP_EXTNS == TRUE)
+  /*******************************************************************************
+  **
+  ** Function:        transceiveScript
+  **
+  ** Description:     Send a script of APDUs to the secure element in one call.
+  **                  Each command in the script is encoded as a 2-byte
+  **                  big-endian length, the APDU, a 2-byte expected status
+  **                  word and a 2-byte status word mask (0x0000 accepts any
+  **                  response).  For every command executed, the response
+  **                  is appended to responses as a 2-byte big-endian length
+  **                  followed by the response bytes.  Execution stops after
+  **                  the first command that fails or whose status word does
+  **                  not match.
+  **                  script: Encoded commands.
+  **                  scriptSize: Length of script.
+  **                  responses: Receives the encoded responses.
+  **                  timeoutMillisec: Timeout of each command in millisecond.
+  **
+  ** Returns:         TRANSCEIVE_STATUS_OK if the script was well formed and
+  **                  every command succeeded with a matching status word;
+  **                  otherwise the status of the command that stopped the
+  **                  script, or TRANSCEIVE_STATUS_FAILED.
+  **
+  *******************************************************************************/
+  eTransceiveStatus transceiveScript(const uint8_t* script, int32_t scriptSize,
+                                     std::vector<uint8_t>& responses,
+                                     int32_t timeoutMillisec);
+#endif
+
+  /*******************************************************************************
+  **
+  ** Function:        acquireResponseBuffer
+  **
+  ** Description:     Lock and return the buffer that wired-mode APDU
+  **                  responses are received into.  It is allocated once and
+  **                  is not cleared between uses; only the bytes reported by
+  **                  transceive() are valid.
+  **                  bufferSize: Receives the size of the buffer.
+  **
+  ** Returns:         Response buffer; release with releaseResponseBuffer().
+  **
+  *******************************************************************************/
+  uint8_t* acquireResponseBuffer(int32_t& bufferSize);
+
+  /*******************************************************************************
+  **
+  ** Function:        releaseResponseBuffer
+  **
+  ** Description:     Unlock the buffer returned by acquireResponseBuffer().
+  **
+  ** Returns:         None
+  **
+  *******************************************************************************/
+  void releaseResponseBuffer();
+
   void notifyModeSet(tNFA_HANDLE eeHandle, bool success,
                      tNFA_EE_STATUS eeStatus);
 
@@ -814,6 +872,8 @@ class SecureElement {
   RouteSelection mCurrentRouteSelection;
   int mActualResponseSize;  // number of bytes in the response received from
                             // secure element
+  std::unique_ptr<uint8_t[]> mResponseBuffer;  // see acquireResponseBuffer()
+  Mutex mResponseBufferMutex;
   int mAtrInfolen;
   uint8_t mAtrStatus;
   bool mUseOberthurWarmReset;         // whether to use warm-reset command
@@ -83,6 +83,17 @@ class SyncEvent {
   *******************************************************************************/
   void notifyOne() { mCondVar.notifyOne(); }
 
+  /*******************************************************************************
+  **
+  ** Function:        notifyAll
+  **
+  ** Description:     Notify all blocked threads that the event has occured.
+  **
+  ** Returns:         None.
+  **
+  *******************************************************************************/
+  void notifyAll() { mCondVar.notifyAll(); }
+
   /*******************************************************************************
   **
   ** Function:        end
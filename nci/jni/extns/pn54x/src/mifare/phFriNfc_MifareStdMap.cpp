@@ -99,6 +99,26 @@ static NFCSTATUS phFriNfc_MifStd_H_WrSectorTrailorBlock(
     phFriNfc_NdefMap_t* NdefMap);
 static NFCSTATUS phFriNfc_MifStd_H_ProWrSectorTrailor(
     phFriNfc_NdefMap_t* NdefMap);
+static uint8_t phFriNfc_MifStd_H_PlanRdSect(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_RdSect(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_RdSectBlk(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_ProRdSect(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_ChkRdSectTLV(phFriNfc_NdefMap_t* NdefMap,
+                                                uint16_t ReadBytes,
+                                                uint16_t* Offset,
+                                                uint16_t* Length);
+static NFCSTATUS phFriNfc_MifStd_H_AuthNdefSect(phFriNfc_NdefMap_t* NdefMap,
+                                                uint8_t BlockNo);
+static NFCSTATUS phFriNfc_MifStd_H_WrSect(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_WrSectBlk(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_ProWrSectRd(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_PlanWrSect(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_ProWrSect(phFriNfc_NdefMap_t* NdefMap);
+static NFCSTATUS phFriNfc_MifStd_H_ChkNdefAidDone(phFriNfc_NdefMap_t* NdefMap);
+static uint8_t phFriNfc_MifStd_H_CacheGetMad(phFriNfc_NdefMap_t* NdefMap);
+static void phFriNfc_MifStd_H_CachePutMad(const phFriNfc_NdefMap_t* NdefMap);
+static uint8_t phFriNfc_MifStd_H_CacheGetAcs(phFriNfc_NdefMap_t* NdefMap);
+static void phFriNfc_MifStd_H_CachePutAcs(const phFriNfc_NdefMap_t* NdefMap);
 static NFCSTATUS phFriNfc_MapTool_ChkSpcVer(const phFriNfc_NdefMap_t* NdefMap,
                                             uint8_t VersionIndex)
     __attribute__((unused));
@@ -130,6 +150,32 @@ static NFCSTATUS phFriNfc_MapTool_ChkSpcVer(const phFriNfc_NdefMap_t* NdefMap,
 
 #define PH_FRINFC_NDEFMAP_MFUL_VAL0 0
 
+/* Layout learnt from one card, kept across activations of that card */
+typedef struct phFriNfc_MifStd_CacheEntry {
+  /* UID of the card, UidLength is 0 if the entry is free */
+  uint8_t Uid[PHNFC_MAX_UID_LENGTH];
+  uint8_t UidLength;
+  uint8_t Sak;
+  /* Stamp of the last lookup, the oldest entry is replaced first */
+  uint32_t LastUse;
+  /* aid array as filled from the MAD */
+  uint8_t MadValid;
+  uint8_t aid[PH_FRINFC_NDEFMAP_MIFARESTD_TOTALNO_BLK];
+  /* Access bytes 6 to 9 of each sector trailer */
+  uint8_t AcsValid[PH_FRINFC_MIFARESTD4K_TOTAL_SECTOR];
+  uint8_t AcsBytes[PH_FRINFC_MIFARESTD4K_TOTAL_SECTOR]
+                  [PH_FRINFC_MIFARESTD_CACHE_ACS_BYTES];
+} phFriNfc_MifStd_CacheEntry_t;
+
+static phFriNfc_MifStd_CacheEntry_t
+    gMifStdCache[PH_FRINFC_MIFARESTD_CACHE_ENTRIES];
+static uint32_t gMifStdCacheClock = 0;
+static uint32_t gMifStdCacheHits = 0;
+static uint32_t gMifStdCacheMisses = 0;
+
+static phFriNfc_MifStd_CacheEntry_t* phFriNfc_MifStd_H_CacheFind(
+    const phFriNfc_NdefMap_t* NdefMap, uint8_t Create);
+
 /******************************************************************************
  * Function         phFriNfc_MapTool_SetCardState
  *
@@ -377,6 +423,14 @@ NFCSTATUS phFriNfc_MifareStdMap_ChkNdef(phFriNfc_NdefMap_t* NdefMap) {
         (NdefMap->StdMifareContainer.currentBlock != 65) &&
         (NdefMap->StdMifareContainer.currentBlock != 66)) {
       status = PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_INVALID_PARAMETER);
+    } else if ((NdefMap->StdMifareContainer.currentBlock == 0) &&
+               (phFriNfc_MifStd_H_CacheGetMad(NdefMap) ==
+                PH_FRINFC_MIFARESTD_FLAG1)) {
+      /* The MAD of this card is already known, go straight to the
+         first NDEF sector */
+      NdefMap->CardState = PH_NDEFMAP_CARD_STATE_INITIALIZED;
+      NdefMap->StdMifareContainer.ChkNdefFlag = PH_FRINFC_MIFARESTD_FLAG1;
+      status = phFriNfc_MifStd_H_ChkNdefAidDone(NdefMap);
     } else if (NdefMap->StdMifareContainer.AuthDone == 0) {
       /*  Block 0 contains Manufacturer information and
           also other informaton. So go for block 1 which
@@ -475,19 +529,33 @@ NFCSTATUS phFriNfc_MifareStdMap_RdNdef(phFriNfc_NdefMap_t* NdefMap,
             (NdefMap->PrevOperation == PH_FRINFC_NDEFMAP_WRITE_OPE))
                ? PH_FRINFC_NDEFMAP_SEEK_BEGIN
                : Offset);
-      status = phFriNfc_MifStd_H_BlkChk(NdefMap);
-      if (status == NFCSTATUS_SUCCESS) {
+      if ((NdefMap->Offset == PH_FRINFC_NDEFMAP_SEEK_BEGIN) &&
+          (phFriNfc_MifStd_H_PlanRdSect(NdefMap) ==
+           NdefMap->StdMifareContainer.NoOfNdefCompBlocks) &&
+          (NdefMap->StdMifareContainer.RdSectCount !=
+           PH_FRINFC_MIFARESTD_VAL0)) {
+        /* The NDEF sectors are known from check NDEF, so read them a
+           sector at a time and look for the TLV in what was read */
         NdefMap->ApduBuffer = PacketData;
-
-        /* Read Operation in Progress */
+        NdefMap->StdMifareContainer.ReadNdefFlag = PH_FRINFC_MIFARESTD_FLAG0;
         NdefMap->StdMifareContainer.ReadWriteCompleteFlag =
             PH_FRINFC_MIFARESTD_FLAG0;
+        status = phFriNfc_MifStd_H_RdSect(NdefMap);
+      } else {
+        status = phFriNfc_MifStd_H_BlkChk(NdefMap);
+        if (status == NFCSTATUS_SUCCESS) {
+          NdefMap->ApduBuffer = PacketData;
 
-        /* Check Authentication Flag */
-        status =
-            ((NdefMap->StdMifareContainer.AuthDone == PH_FRINFC_MIFARESTD_FLAG1)
-                 ? phFriNfc_MifStd_H_RdABlock(NdefMap)
-                 : phFriNfc_MifStd_H_AuthSector(NdefMap));
+          /* Read Operation in Progress */
+          NdefMap->StdMifareContainer.ReadWriteCompleteFlag =
+              PH_FRINFC_MIFARESTD_FLAG0;
+
+          /* Check Authentication Flag */
+          status = ((NdefMap->StdMifareContainer.AuthDone ==
+                     PH_FRINFC_MIFARESTD_FLAG1)
+                        ? phFriNfc_MifStd_H_RdABlock(NdefMap)
+                        : phFriNfc_MifStd_H_AuthSector(NdefMap));
+        }
       }
     }
   }
@@ -573,23 +641,40 @@ NFCSTATUS phFriNfc_MifareStdMap_WrNdef(phFriNfc_NdefMap_t* NdefMap,
                ? PH_FRINFC_NDEFMAP_SEEK_BEGIN
                : Offset);
       NdefMap->StdMifareContainer.AuthDone = PH_FRINFC_MIFARESTD_FLAG0;
-      status = phFriNfc_MifStd_H_BlkChk(NdefMap);
-      NdefMap->StdMifareContainer.ReadWriteCompleteFlag =
-          PH_FRINFC_MIFARESTD_FLAG0;
-      if (status == NFCSTATUS_SUCCESS) {
-        if (NdefMap->StdMifareContainer.PollFlag == PH_FRINFC_MIFARESTD_FLAG1) {
-          /* if poll flag is set then call disconnect because the authentication
-              has failed so reactivation of card is required */
-          status = phFriNfc_MifStd_H_CallDisCon(NdefMap);
-        }
-        /* Check Authentication Flag */
-        else if (NdefMap->StdMifareContainer.AuthDone ==
-                 PH_FRINFC_MIFARESTD_FLAG1) {
-          status = ((NdefMap->Offset == PH_FRINFC_NDEFMAP_SEEK_BEGIN)
-                        ? phFriNfc_MifStd_H_RdBeforeWr(NdefMap)
-                        : phFriNfc_MifStd_H_WrABlock(NdefMap));
-        } else {
-          status = phFriNfc_MifStd_H_AuthSector(NdefMap);
+      if ((NdefMap->Offset == PH_FRINFC_NDEFMAP_SEEK_BEGIN) &&
+          (phFriNfc_MifStd_H_PlanRdSect(NdefMap) ==
+           NdefMap->StdMifareContainer.NoOfNdefCompBlocks) &&
+          (NdefMap->StdMifareContainer.RdSectCount !=
+           PH_FRINFC_MIFARESTD_VAL0)) {
+        /* The NDEF sectors are known from check NDEF, so find the NDEF TLV,
+           build the final image of every block and write each block once */
+        NdefMap->StdMifareContainer.ReadWriteCompleteFlag =
+            PH_FRINFC_MIFARESTD_FLAG0;
+        NdefMap->StdMifareContainer.WrSectCount = PH_FRINFC_MIFARESTD_VAL0;
+        NdefMap->StdMifareContainer.WrSectIndex = PH_FRINFC_MIFARESTD_VAL0;
+        NdefMap->StdMifareContainer.WrSectZeroCount = PH_FRINFC_MIFARESTD_VAL0;
+        status = phFriNfc_MifStd_H_WrSect(NdefMap);
+      } else {
+        status = phFriNfc_MifStd_H_BlkChk(NdefMap);
+        NdefMap->StdMifareContainer.ReadWriteCompleteFlag =
+            PH_FRINFC_MIFARESTD_FLAG0;
+        if (status == NFCSTATUS_SUCCESS) {
+          if (NdefMap->StdMifareContainer.PollFlag ==
+              PH_FRINFC_MIFARESTD_FLAG1) {
+            /* if poll flag is set then call disconnect because the
+                authentication has failed so reactivation of card is
+                required */
+            status = phFriNfc_MifStd_H_CallDisCon(NdefMap);
+          }
+          /* Check Authentication Flag */
+          else if (NdefMap->StdMifareContainer.AuthDone ==
+                   PH_FRINFC_MIFARESTD_FLAG1) {
+            status = ((NdefMap->Offset == PH_FRINFC_NDEFMAP_SEEK_BEGIN)
+                          ? phFriNfc_MifStd_H_RdBeforeWr(NdefMap)
+                          : phFriNfc_MifStd_H_WrABlock(NdefMap));
+          } else {
+            status = phFriNfc_MifStd_H_AuthSector(NdefMap);
+          }
         }
       }
     }
@@ -891,6 +976,43 @@ void phFriNfc_MifareStdMap_Process(void* Context, NFCSTATUS Status) {
         }
         break;
 
+      case PH_FRINFC_NDEFMAP_STATE_RD_SECT_AUTH:
+        NdefMap->StdMifareContainer.AuthDone = PH_FRINFC_MIFARESTD_FLAG1;
+        Status = phFriNfc_MifStd_H_RdSectBlk(NdefMap);
+        CRFlag = (uint8_t)((Status != NFCSTATUS_PENDING)
+                               ? PH_FRINFC_MIFARESTD_FLAG1
+                               : PH_FRINFC_MIFARESTD_FLAG0);
+        break;
+
+      case PH_FRINFC_NDEFMAP_STATE_RD_SECT:
+        Status = phFriNfc_MifStd_H_ProRdSect(NdefMap);
+        CRFlag = (uint8_t)((Status != NFCSTATUS_PENDING)
+                               ? PH_FRINFC_MIFARESTD_FLAG1
+                               : PH_FRINFC_MIFARESTD_FLAG0);
+        break;
+
+      case PH_FRINFC_NDEFMAP_STATE_WR_SECT_AUTH:
+        NdefMap->StdMifareContainer.AuthDone = PH_FRINFC_MIFARESTD_FLAG1;
+        Status = phFriNfc_MifStd_H_WrSectBlk(NdefMap);
+        CRFlag = (uint8_t)((Status != NFCSTATUS_PENDING)
+                               ? PH_FRINFC_MIFARESTD_FLAG1
+                               : PH_FRINFC_MIFARESTD_FLAG0);
+        break;
+
+      case PH_FRINFC_NDEFMAP_STATE_WR_SECT_RD:
+        Status = phFriNfc_MifStd_H_ProWrSectRd(NdefMap);
+        CRFlag = (uint8_t)((Status != NFCSTATUS_PENDING)
+                               ? PH_FRINFC_MIFARESTD_FLAG1
+                               : PH_FRINFC_MIFARESTD_FLAG0);
+        break;
+
+      case PH_FRINFC_NDEFMAP_STATE_WR_SECT:
+        Status = phFriNfc_MifStd_H_ProWrSect(NdefMap);
+        CRFlag = (uint8_t)((Status != NFCSTATUS_PENDING)
+                               ? PH_FRINFC_MIFARESTD_FLAG1
+                               : PH_FRINFC_MIFARESTD_FLAG0);
+        break;
+
       default:
         Status =
             PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_INVALID_DEVICE_REQUEST);
@@ -991,6 +1113,564 @@ static NFCSTATUS phFriNfc_MifStd_H_RdABlock(phFriNfc_NdefMap_t* NdefMap) {
   return status;
 }
 
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_PlanRdSect
+ *
+ * Description      This function lists the data blocks of the NDEF compliant
+ *                  sectors found by check NDEF, skipping the MAD sectors and
+ *                  the sector trailers.
+ *
+ * Returns          Number of blocks listed.
+ *
+ ******************************************************************************/
+static uint8_t phFriNfc_MifStd_H_PlanRdSect(phFriNfc_NdefMap_t* NdefMap) {
+  uint8_t SectorID = 0, TotalSectors = 0, FirstBlock = 0, NoOfBlocks = 0;
+  uint8_t BlockIndex = 0, Count = 0;
+
+  TotalSectors =
+      ((NdefMap->CardType == PH_FRINFC_NDEFMAP_MIFARE_STD_1K_CARD)
+           ? PH_FRINFC_MIFARESTD1K_TOTAL_SECTOR
+           : ((NdefMap->CardType == PH_FRINFC_NDEFMAP_MIFARE_STD_2K_CARD)
+                  ? PH_FRINFC_MIFARESTD2K_TOTAL_SECTOR
+                  : PH_FRINFC_MIFARESTD4K_TOTAL_SECTOR));
+
+  for (SectorID = PH_FRINFC_MIFARESTD_SECTOR_NO1; SectorID < TotalSectors;
+       SectorID++) {
+    if ((SectorID == PH_FRINFC_MIFARESTD_SECTOR_NO16) ||
+        (NdefMap->StdMifareContainer.aid[SectorID] !=
+         PH_FRINFC_MIFARESTD_NDEF_COMP)) {
+      continue;
+    }
+    /* Sectors 32 to 39 have 16 blocks, the others 4; the last block of a
+       sector is its trailer */
+    if (SectorID >= PH_FRINFC_MIFARESTD_SECTOR_NO32) {
+      FirstBlock = (uint8_t)(PH_FRINFC_MIFARESTD4K_BLK128 +
+                             ((SectorID - PH_FRINFC_MIFARESTD_SECTOR_NO32) *
+                              PH_FRINFC_MIFARESTD_SECTOR_BLOCKS));
+      NoOfBlocks = PH_FRINFC_MIFARESTD_BLK15;
+    } else {
+      FirstBlock = (uint8_t)(SectorID * PH_FRINFC_MIFARESTD_BLK4);
+      NoOfBlocks = PH_FRINFC_MIFARESTD_MAD_BLK3;
+    }
+    for (BlockIndex = 0; BlockIndex < NoOfBlocks; BlockIndex++) {
+      NdefMap->StdMifareContainer.RdSectBlocks[Count] =
+          (uint8_t)(FirstBlock + BlockIndex);
+      Count++;
+    }
+  }
+
+  NdefMap->StdMifareContainer.RdSectCount = Count;
+  NdefMap->StdMifareContainer.RdSectIndex = PH_FRINFC_MIFARESTD_VAL0;
+  NdefMap->StdMifareContainer.RdSectNeed = PH_FRINFC_MIFARESTD_VAL0;
+
+  return Count;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_RdSect
+ *
+ * Description      This function starts on the next planned block. The first
+ *                  block of each sector is preceded by the one authentication
+ *                  that covers the whole sector.
+ *
+ * Returns          This function return NFCSTATUS_PENDING in case of success
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_RdSect(phFriNfc_NdefMap_t* NdefMap) {
+  NFCSTATUS Result = NFCSTATUS_PENDING;
+  uint8_t Index = NdefMap->StdMifareContainer.RdSectIndex;
+  uint8_t BlockNo = NdefMap->StdMifareContainer.RdSectBlocks[Index];
+
+  NdefMap->StdMifareContainer.currentBlock = BlockNo;
+
+  if ((Index != PH_FRINFC_MIFARESTD_VAL0) &&
+      (phFriNfc_MifStd_H_GetSect(BlockNo) ==
+       phFriNfc_MifStd_H_GetSect(
+           NdefMap->StdMifareContainer.RdSectBlocks[Index - 1]))) {
+    /* Same sector as the last block: still authenticated */
+    Result = phFriNfc_MifStd_H_RdSectBlk(NdefMap);
+  } else {
+    NdefMap->State = PH_FRINFC_NDEFMAP_STATE_RD_SECT_AUTH;
+    Result = phFriNfc_MifStd_H_AuthNdefSect(NdefMap, BlockNo);
+  }
+
+  return Result;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_AuthNdefSect
+ *
+ * Description      This function authenticates the sector of the given block
+ *                  with the NDEF sector key A, for the sector-batched read
+ *                  and write. The caller sets the state to return to.
+ *
+ * Returns          This function return NFCSTATUS_PENDING in case of success
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_AuthNdefSect(phFriNfc_NdefMap_t* NdefMap,
+                                                uint8_t BlockNo) {
+  uint8_t KeyIndex = 0;
+
+  NdefMap->StdMifareContainer.AuthDone = PH_FRINFC_MIFARESTD_FLAG0;
+  NdefMap->MapCompletionInfo.CompletionRoutine = phFriNfc_MifareStdMap_Process;
+  NdefMap->MapCompletionInfo.Context = NdefMap;
+  NdefMap->Cmd.MfCmd = phHal_eMifareAuthentA;
+
+  /* NDEF sectors use key A 0xD3, 0xF7, 0xD3, 0xF7, 0xD3, 0xF7 */
+  NdefMap->SendRecvBuf[PH_FRINFC_MIFARESTD_VAL0] = BlockNo;
+  for (KeyIndex = PH_FRINFC_MIFARESTD_VAL1;
+       KeyIndex <= PH_FRINFC_MIFARESTD_KEY_LEN; KeyIndex++) {
+    NdefMap->SendRecvBuf[KeyIndex] =
+        (uint8_t)((KeyIndex & PH_FRINFC_MIFARESTD_VAL1)
+                      ? PH_FRINFC_NDEFMAP_MIFARESTD_AUTH_NDEFSECT1
+                      : PH_FRINFC_NDEFMAP_MIFARESTD_AUTH_NDEFSECT2);
+  }
+
+  NdefMap->SendLength = MIFARE_AUTHENTICATE_CMD_LENGTH;
+  *NdefMap->SendRecvLength = NdefMap->TempReceiveLength;
+  /* Call the Overlapped HAL Transceive function */
+  return phFriNfc_ExtnsTransceive(NdefMap->pTransceiveInfo, NdefMap->Cmd,
+                                  NdefMap->SendRecvBuf, NdefMap->SendLength,
+                                  NdefMap->SendRecvLength);
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_RdSectBlk
+ *
+ * Description      This function reads the current block of an authenticated
+ *                  sector for the sector-batched read.
+ *
+ * Returns          This function return NFCSTATUS_PENDING in case of success
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_RdSectBlk(phFriNfc_NdefMap_t* NdefMap) {
+  NdefMap->State = PH_FRINFC_NDEFMAP_STATE_RD_SECT;
+
+  return phFriNfc_MifStd_H_Rd16Bytes(NdefMap,
+                                     NdefMap->StdMifareContainer.currentBlock);
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_ProRdSect
+ *
+ * Description      This function stores a block read by the sector-batched
+ *                  read. Once the NDEF TLV is complete, its value is copied
+ *                  to the user buffer; until then the next block is read.
+ *
+ * Returns          This function return NFCSTATUS_SUCCESS when the read is
+ *                  complete, NFCSTATUS_PENDING if a block was requested.
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_ProRdSect(phFriNfc_NdefMap_t* NdefMap) {
+  NFCSTATUS Result = NFCSTATUS_PENDING;
+  uint16_t ReadBytes = 0, Offset = 0, Length = 0;
+
+  if (*NdefMap->SendRecvLength != PH_FRINFC_MIFARESTD_BYTES_READ) {
+    Result =
+        PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_INVALID_RECEIVE_LENGTH);
+  } else {
+    ReadBytes = (uint16_t)(NdefMap->StdMifareContainer.RdSectIndex *
+                           PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+    memcpy(&NdefMap->StdMifareContainer.RdSectBuf[ReadBytes],
+           NdefMap->SendRecvBuf, PH_FRINFC_MIFARESTD_BYTES_READ);
+    ReadBytes += PH_FRINFC_MIFARESTD_BYTES_READ;
+    NdefMap->StdMifareContainer.RdSectIndex++;
+
+    /* Nothing to parse until the TLV value is all there */
+    if (ReadBytes >= NdefMap->StdMifareContainer.RdSectNeed) {
+      Result =
+          phFriNfc_MifStd_H_ChkRdSectTLV(NdefMap, ReadBytes, &Offset, &Length);
+    }
+
+    if (Result == NFCSTATUS_SUCCESS) {
+      if (Length > NdefMap->ApduBufferSize) {
+        Length = (uint16_t)NdefMap->ApduBufferSize;
+      }
+      memcpy(NdefMap->ApduBuffer,
+             &NdefMap->StdMifareContainer.RdSectBuf[Offset], Length);
+      NdefMap->ApduBuffIndex = Length;
+      *NdefMap->NumOfBytesRead = Length;
+      NdefMap->TLVStruct.BytesRemainLinTLV = PH_FRINFC_MIFARESTD_VAL0;
+      NdefMap->StdMifareContainer.ReadWriteCompleteFlag =
+          PH_FRINFC_MIFARESTD_FLAG1;
+    } else if (Result == NFCSTATUS_PENDING) {
+      Result = ((NdefMap->StdMifareContainer.RdSectIndex <
+                 NdefMap->StdMifareContainer.RdSectCount)
+                    ? phFriNfc_MifStd_H_RdSect(NdefMap)
+                    : PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP,
+                                 NFCSTATUS_EOF_NDEF_CONTAINER_REACHED));
+    }
+  }
+
+  return Result;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_ChkRdSectTLV
+ *
+ * Description      This function looks for the NDEF TLV in the bytes read so
+ *                  far, skipping NULL, lock, memory and proprietary TLVs.
+ *                  Once its header is read, its block and byte are recorded
+ *                  in TLVStruct. If not all of its value is there,
+ *                  RdSectNeed is set to the bytes still to be reached.
+ *
+ * Returns          This function return NFCSTATUS_SUCCESS with Offset and
+ *                  Length of the NDEF message if it was all read,
+ *                  NFCSTATUS_PENDING if more blocks are needed.
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_ChkRdSectTLV(phFriNfc_NdefMap_t* NdefMap,
+                                                uint16_t ReadBytes,
+                                                uint16_t* Offset,
+                                                uint16_t* Length) {
+  NFCSTATUS Result = NFCSTATUS_PENDING;
+  const uint8_t* Buffer = NdefMap->StdMifareContainer.RdSectBuf;
+  uint32_t Index = 0, HeaderLen = 0, ValueLen = 0, End = 0;
+  uint32_t CardBytes = ((uint32_t)NdefMap->StdMifareContainer.RdSectCount *
+                        PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+
+  while ((Result == NFCSTATUS_PENDING) && (Index < ReadBytes)) {
+    if (Buffer[Index] == PH_FRINFC_MIFARESTD_NULLTLV_T) {
+      Index++;
+      continue;
+    }
+    if (Buffer[Index] == PH_FRINFC_MIFARESTD_TERMTLV_T) {
+      /* No NDEF TLV before the terminator */
+      Result = PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_NO_NDEF_SUPPORT);
+      break;
+    }
+    /* Length (L) takes 1 byte, or 3 bytes after a 0xFF */
+    if ((Index + PH_FRINFC_MIFARESTD_VAL1) >= ReadBytes) {
+      break;
+    }
+    if (Buffer[Index + PH_FRINFC_MIFARESTD_VAL1] ==
+        PH_FRINFC_MIFARESTD_NDEFTLV_L) {
+      if ((Index + PH_FRINFC_MIFARESTD_VAL3) >= ReadBytes) {
+        break;
+      }
+      HeaderLen = PH_FRINFC_MIFARESTD_VAL4;
+      ValueLen = (((uint32_t)Buffer[Index + PH_FRINFC_MIFARESTD_VAL2]
+                   << PH_FRINFC_MIFARESTD_LEFTSHIFT8) |
+                  Buffer[Index + PH_FRINFC_MIFARESTD_VAL3]);
+    } else {
+      HeaderLen = PH_FRINFC_MIFARESTD_VAL2;
+      ValueLen = Buffer[Index + PH_FRINFC_MIFARESTD_VAL1];
+    }
+    if (Buffer[Index] == PH_FRINFC_MIFARESTD_NDEFTLV_T) {
+      NdefMap->TLVStruct.NdefTLVBlock =
+          NdefMap->StdMifareContainer
+              .RdSectBlocks[Index / PH_FRINFC_MIFARESTD_BLOCK_BYTES];
+      NdefMap->TLVStruct.NdefTLVByte =
+          (uint16_t)(Index % PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+      NdefMap->TLVStruct.NdefTLVFoundFlag = PH_FRINFC_MIFARESTD_FLAG1;
+    }
+    End = Index + HeaderLen + ValueLen;
+    if (End > CardBytes) {
+      /* The TLV runs past the last NDEF sector */
+      Result = PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP,
+                          NFCSTATUS_EOF_NDEF_CONTAINER_REACHED);
+    } else if (Buffer[Index] != PH_FRINFC_MIFARESTD_NDEFTLV_T) {
+      Index = End;
+    } else if (End > ReadBytes) {
+      NdefMap->StdMifareContainer.RdSectNeed = (uint16_t)End;
+      break;
+    } else {
+      *Offset = (uint16_t)(Index + HeaderLen);
+      *Length = (uint16_t)ValueLen;
+      Result = NFCSTATUS_SUCCESS;
+    }
+  }
+
+  return Result;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_WrSect
+ *
+ * Description      This function starts on the next block of the
+ *                  sector-batched write: a read of the planned blocks while
+ *                  the NDEF TLV is being located, a write once the block
+ *                  images are built. Moving to another sector costs one
+ *                  authentication.
+ *
+ * Returns          This function return NFCSTATUS_PENDING in case of success
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_WrSect(phFriNfc_NdefMap_t* NdefMap) {
+  NFCSTATUS Result = NFCSTATUS_PENDING;
+  uint8_t Index =
+      ((NdefMap->StdMifareContainer.WrSectCount == PH_FRINFC_MIFARESTD_VAL0)
+           ? NdefMap->StdMifareContainer.RdSectIndex
+           : NdefMap->StdMifareContainer
+                 .WrSectOrder[NdefMap->StdMifareContainer.WrSectIndex]);
+  uint8_t BlockNo = NdefMap->StdMifareContainer.RdSectBlocks[Index];
+
+  if ((NdefMap->StdMifareContainer.AuthDone == PH_FRINFC_MIFARESTD_FLAG1) &&
+      (phFriNfc_MifStd_H_GetSect(BlockNo) ==
+       phFriNfc_MifStd_H_GetSect(NdefMap->StdMifareContainer.currentBlock))) {
+    /* Same sector as the last block: still authenticated */
+    NdefMap->StdMifareContainer.currentBlock = BlockNo;
+    Result = phFriNfc_MifStd_H_WrSectBlk(NdefMap);
+  } else {
+    NdefMap->StdMifareContainer.currentBlock = BlockNo;
+    NdefMap->State = PH_FRINFC_NDEFMAP_STATE_WR_SECT_AUTH;
+    Result = phFriNfc_MifStd_H_AuthNdefSect(NdefMap, BlockNo);
+  }
+
+  return Result;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_WrSectBlk
+ *
+ * Description      This function reads or writes the current block of an
+ *                  authenticated sector for the sector-batched write.
+ *
+ * Returns          This function return NFCSTATUS_PENDING in case of success
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_WrSectBlk(phFriNfc_NdefMap_t* NdefMap) {
+  NFCSTATUS Result = NFCSTATUS_PENDING;
+  uint16_t Offset = 0;
+
+  if (NdefMap->StdMifareContainer.WrSectCount == PH_FRINFC_MIFARESTD_VAL0) {
+    NdefMap->State = PH_FRINFC_NDEFMAP_STATE_WR_SECT_RD;
+    Result = phFriNfc_MifStd_H_Rd16Bytes(
+        NdefMap, NdefMap->StdMifareContainer.currentBlock);
+  } else {
+    NdefMap->State = PH_FRINFC_NDEFMAP_STATE_WR_SECT;
+    NdefMap->MapCompletionInfo.CompletionRoutine =
+        phFriNfc_MifareStdMap_Process;
+    NdefMap->MapCompletionInfo.Context = NdefMap;
+    NdefMap->SendRecvBuf[PH_FRINFC_MIFARESTD_VAL0] =
+        NdefMap->StdMifareContainer.currentBlock;
+    if (NdefMap->StdMifareContainer.WrSectIndex <
+        NdefMap->StdMifareContainer.WrSectZeroCount) {
+      /* Header block with a zero TLV length */
+      Offset = (uint16_t)(NdefMap->StdMifareContainer.WrSectIndex *
+                          PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+      memcpy(&NdefMap->SendRecvBuf[PH_FRINFC_MIFARESTD_VAL1],
+             &NdefMap->StdMifareContainer.WrSectZeroBuf[Offset],
+             PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+    } else {
+      Offset = (uint16_t)(NdefMap->StdMifareContainer
+                              .WrSectOrder[NdefMap->StdMifareContainer
+                                               .WrSectIndex] *
+                          PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+      memcpy(&NdefMap->SendRecvBuf[PH_FRINFC_MIFARESTD_VAL1],
+             &NdefMap->StdMifareContainer.RdSectBuf[Offset],
+             PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+    }
+    NdefMap->SendLength = MIFARE_MAX_SEND_BUF_TO_WRITE;
+    NdefMap->Cmd.MfCmd = phHal_eMifareWrite16;
+    *NdefMap->SendRecvLength = NdefMap->TempReceiveLength;
+
+    /* Call the Overlapped HAL Transceive function */
+    Result = phFriNfc_ExtnsTransceive(NdefMap->pTransceiveInfo, NdefMap->Cmd,
+                                      NdefMap->SendRecvBuf, NdefMap->SendLength,
+                                      NdefMap->SendRecvLength);
+  }
+
+  return Result;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_ProWrSectRd
+ *
+ * Description      This function stores a block read while the NDEF TLV is
+ *                  located for the sector-batched write. Once the TLV header
+ *                  is found the writes are planned; until then the next
+ *                  block is read.
+ *
+ * Returns          This function return NFCSTATUS_PENDING in case of success
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_ProWrSectRd(phFriNfc_NdefMap_t* NdefMap) {
+  NFCSTATUS Result = NFCSTATUS_PENDING;
+  uint16_t ReadBytes = 0, Offset = 0, Length = 0;
+
+  if (*NdefMap->SendRecvLength != PH_FRINFC_MIFARESTD_BYTES_READ) {
+    Result =
+        PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_INVALID_RECEIVE_LENGTH);
+  } else {
+    ReadBytes = (uint16_t)(NdefMap->StdMifareContainer.RdSectIndex *
+                           PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+    memcpy(&NdefMap->StdMifareContainer.RdSectBuf[ReadBytes],
+           NdefMap->SendRecvBuf, PH_FRINFC_MIFARESTD_BYTES_READ);
+    ReadBytes += PH_FRINFC_MIFARESTD_BYTES_READ;
+    NdefMap->StdMifareContainer.RdSectIndex++;
+
+    /* Only the position of the old NDEF TLV matters, not its value */
+    Result =
+        phFriNfc_MifStd_H_ChkRdSectTLV(NdefMap, ReadBytes, &Offset, &Length);
+    if (NdefMap->TLVStruct.NdefTLVFoundFlag == PH_FRINFC_MIFARESTD_FLAG1) {
+      Result = phFriNfc_MifStd_H_PlanWrSect(NdefMap);
+      if (Result == NFCSTATUS_SUCCESS) {
+        Result = phFriNfc_MifStd_H_WrSect(NdefMap);
+      }
+    } else if (Result == NFCSTATUS_PENDING) {
+      Result = ((NdefMap->StdMifareContainer.RdSectIndex <
+                 NdefMap->StdMifareContainer.RdSectCount)
+                    ? phFriNfc_MifStd_H_WrSect(NdefMap)
+                    : PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP,
+                                 NFCSTATUS_EOF_NDEF_CONTAINER_REACHED));
+    }
+  }
+
+  return Result;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_PlanWrSect
+ *
+ * Description      This function builds the final image of every block the
+ *                  new NDEF TLV touches: the bytes before the old TLV are
+ *                  kept, then come the TLV header, the message, a terminator
+ *                  TLV if there is room, and zero padding to the end of the
+ *                  last block. Unless the whole TLV fits in one block, the
+ *                  header blocks are first written with a zero TLV length,
+ *                  then the message blocks, and the header blocks with the
+ *                  real length last. A torn write thus leaves an empty
+ *                  message rather than a length over stale data.
+ *
+ * Returns          This function return NFCSTATUS_SUCCESS in case of success
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_PlanWrSect(phFriNfc_NdefMap_t* NdefMap) {
+  NFCSTATUS Result = NFCSTATUS_SUCCESS;
+  uint8_t* Buffer = NdefMap->StdMifareContainer.RdSectBuf;
+  uint32_t Length = NdefMap->ApduBufferSize;
+  uint32_t Index = 0, End = 0, CardBytes = 0, Header = 0;
+  uint8_t FirstBlock = 0, LastBlock = 0, HeaderBlock = 0, BlockIndex = 0,
+          Count = 0;
+
+  CardBytes = ((uint32_t)NdefMap->StdMifareContainer.RdSectCount *
+               PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+  while ((FirstBlock < NdefMap->StdMifareContainer.RdSectIndex) &&
+         (NdefMap->StdMifareContainer.RdSectBlocks[FirstBlock] !=
+          NdefMap->TLVStruct.NdefTLVBlock)) {
+    FirstBlock++;
+  }
+  Index = ((uint32_t)FirstBlock * PH_FRINFC_MIFARESTD_BLOCK_BYTES) +
+          NdefMap->TLVStruct.NdefTLVByte;
+  End = Index + Length +
+        ((Length < PH_FRINFC_MIFARESTD_NDEFTLV_L) ? PH_FRINFC_MIFARESTD_VAL2
+                                                  : PH_FRINFC_MIFARESTD_VAL4);
+
+  if (End > CardBytes) {
+    Result = PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP,
+                        NFCSTATUS_EOF_NDEF_CONTAINER_REACHED);
+  } else {
+    Header = Index;
+    Buffer[Index++] = PH_FRINFC_MIFARESTD_NDEFTLV_T;
+    if (Length < PH_FRINFC_MIFARESTD_NDEFTLV_L) {
+      Buffer[Index++] = (uint8_t)Length;
+    } else {
+      Buffer[Index++] = PH_FRINFC_MIFARESTD_NDEFTLV_L;
+      Buffer[Index++] = (uint8_t)(Length >> PH_FRINFC_MIFARESTD_RIGHTSHIFT8);
+      Buffer[Index++] = (uint8_t)(Length & PH_FRINFC_MIFARESTD_MASK_FF);
+    }
+    HeaderBlock =
+        (uint8_t)((Index - PH_FRINFC_MIFARESTD_VAL1) /
+                  PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+    memcpy(&Buffer[Index], NdefMap->ApduBuffer, Length);
+    if (End < CardBytes) {
+      Buffer[End++] = PH_FRINFC_MIFARESTD_TERMTLV_T;
+    }
+    LastBlock =
+        (uint8_t)((End - PH_FRINFC_MIFARESTD_VAL1) /
+                  PH_FRINFC_MIFARESTD_BLOCK_BYTES);
+    Index = ((uint32_t)LastBlock + PH_FRINFC_MIFARESTD_VAL1) *
+            PH_FRINFC_MIFARESTD_BLOCK_BYTES;
+    memset(&Buffer[End], PH_FRINFC_MIFARESTD_NULLTLV_T, (Index - End));
+
+    if (LastBlock != FirstBlock) {
+      /* Header blocks as "03 00 [00 00]": an empty NDEF message */
+      Index = (uint32_t)FirstBlock * PH_FRINFC_MIFARESTD_BLOCK_BYTES;
+      End = ((uint32_t)HeaderBlock + PH_FRINFC_MIFARESTD_VAL1) *
+            PH_FRINFC_MIFARESTD_BLOCK_BYTES;
+      memcpy(NdefMap->StdMifareContainer.WrSectZeroBuf, &Buffer[Index],
+             (End - Index));
+      Header -= Index;
+      memset(&NdefMap->StdMifareContainer
+                  .WrSectZeroBuf[Header + PH_FRINFC_MIFARESTD_VAL1],
+             PH_FRINFC_MIFARESTD_VAL0,
+             (End - Index - Header - PH_FRINFC_MIFARESTD_VAL1));
+      for (BlockIndex = FirstBlock; BlockIndex <= HeaderBlock; BlockIndex++) {
+        NdefMap->StdMifareContainer.WrSectOrder[Count] = BlockIndex;
+        Count++;
+      }
+      NdefMap->StdMifareContainer.WrSectZeroCount = Count;
+    }
+    for (BlockIndex = (uint8_t)(HeaderBlock + PH_FRINFC_MIFARESTD_VAL1);
+         BlockIndex <= LastBlock; BlockIndex++) {
+      NdefMap->StdMifareContainer.WrSectOrder[Count] = BlockIndex;
+      Count++;
+    }
+    /* Real length last; a header block the zero image left as it is, is
+       not written again */
+    BlockIndex = (uint8_t)(HeaderBlock + PH_FRINFC_MIFARESTD_VAL1);
+    while (BlockIndex-- > FirstBlock) {
+      Index = (uint32_t)BlockIndex * PH_FRINFC_MIFARESTD_BLOCK_BYTES;
+      if ((LastBlock == FirstBlock) ||
+          (memcmp(&Buffer[Index],
+                  &NdefMap->StdMifareContainer.WrSectZeroBuf
+                       [(BlockIndex - FirstBlock) *
+                        PH_FRINFC_MIFARESTD_BLOCK_BYTES],
+                  PH_FRINFC_MIFARESTD_BLOCK_BYTES) != 0)) {
+        NdefMap->StdMifareContainer.WrSectOrder[Count] = BlockIndex;
+        Count++;
+      }
+    }
+    NdefMap->StdMifareContainer.WrSectCount = Count;
+    NdefMap->StdMifareContainer.WrSectIndex = PH_FRINFC_MIFARESTD_VAL0;
+  }
+
+  return Result;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_ProWrSect
+ *
+ * Description      This function moves the sector-batched write on to the
+ *                  next planned block, or completes it after the block
+ *                  holding the TLV length.
+ *
+ * Returns          This function return NFCSTATUS_SUCCESS when the write is
+ *                  complete, NFCSTATUS_PENDING if a block was requested.
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_ProWrSect(phFriNfc_NdefMap_t* NdefMap) {
+  NFCSTATUS Result = NFCSTATUS_SUCCESS;
+
+  NdefMap->StdMifareContainer.WrSectIndex++;
+  if (NdefMap->StdMifareContainer.WrSectIndex <
+      NdefMap->StdMifareContainer.WrSectCount) {
+    Result = phFriNfc_MifStd_H_WrSect(NdefMap);
+  } else {
+    NdefMap->ApduBuffIndex = (uint16_t)NdefMap->ApduBufferSize;
+    *NdefMap->WrNdefPacketLength = NdefMap->ApduBuffIndex;
+    NdefMap->StdMifareContainer.ReadWriteCompleteFlag =
+        PH_FRINFC_MIFARESTD_FLAG1;
+    NdefMap->CardState =
+        (uint8_t)((NdefMap->CardState == PH_NDEFMAP_CARD_STATE_INITIALIZED)
+                      ? PH_NDEFMAP_CARD_STATE_READ_WRITE
+                      : NdefMap->CardState);
+  }
+
+  return Result;
+}
+
 /******************************************************************************
  * Function         phFriNfc_MifStd_H_WrABlock
  *
@@ -2810,11 +3490,6 @@ static NFCSTATUS phFriNfc_MifStd_H_ChkRemainTLVs(phFriNfc_NdefMap_t* NdefMap,
                                                NdefMap->SendRecvBuf[TempLength])
                : Result);
 
-      Result =
-          ((NdefMap->TLVStruct.NdefTLVFoundFlag == PH_FRINFC_MIFARESTD_FLAG1)
-               ? 1
-               : Result);
-
       /* Check the length field is less than or
          equal to 0xFF if yes enter below statement
          else enter else if*/
@@ -2911,9 +3586,11 @@ static NFCSTATUS phFriNfc_MifStd_H_ChkRemainTLVs(phFriNfc_NdefMap_t* NdefMap,
         Result = PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_INVALID_PARAMETER);
         *CRFlag = PH_FRINFC_MIFARESTD_FLAG1;
       } else {
-        NdefMap->StdMifareContainer.remainingSize -= PH_FRINFC_MIFARESTD_VAL2;
+        /* The whole 4 byte header: T, 0xFF and the two length bytes */
+        NdefMap->StdMifareContainer.remainingSize -= PH_FRINFC_MIFARESTD_VAL4;
         if (NdefMap->TLVStruct.NdefTLVFoundFlag == PH_FRINFC_MIFARESTD_FLAG1) {
           NdefMap->TLVStruct.BytesRemainLinTLV = ShiftLength;
+          Result = phFriNfc_MapTool_SetCardState(NdefMap, ShiftLength);
           if (NdefMap->TLVStruct.BytesRemainLinTLV >
               NdefMap->StdMifareContainer.remainingSize) {
             Result = PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_INVALID_FORMAT);
@@ -3142,25 +3819,44 @@ static NFCSTATUS phFriNfc_MifStd_H_ProChkNdef(phFriNfc_NdefMap_t* NdefMap) {
 
   if (NdefMap->StdMifareContainer.aidCompleteFlag ==
       PH_FRINFC_MIFARESTD_FLAG1) {
-    NdefMap->StdMifareContainer.ChkNdefCompleteFlag = PH_FRINFC_MIFARESTD_FLAG1;
-    /*  The check for NDEF compliant information is now over for
-        the Mifare 1K card.
-        Update(decrement) the NoOfNdefCompBlocks as much required,
-        depending on the NDEF compliant information found */
-    /* Check the Sectors are Ndef Compliant */
-    phFriNfc_MifStd_H_ChkNdefCmpltSects(NdefMap);
-    if ((NdefMap->StdMifareContainer.NoOfNdefCompBlocks == 0) ||
-        (NdefMap->StdMifareContainer.NoOfNdefCompBlocks > 255)) {
-      Result = PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_NO_NDEF_SUPPORT);
-    } else {
-      NdefMap->StdMifareContainer.aidCompleteFlag = PH_FRINFC_MIFARESTD_FLAG0;
-      NdefMap->StdMifareContainer.NFCforumSectFlag = PH_FRINFC_MIFARESTD_FLAG0;
-      NdefMap->StdMifareContainer.currentBlock = PH_FRINFC_MIFARESTD_BLK4;
-      Result = phFriNfc_MifStd_H_BlkChk(NdefMap);
-      Result = ((Result != NFCSTATUS_SUCCESS)
-                    ? Result
-                    : phFriNfc_MifStd_H_AuthSector(NdefMap));
-    }
+    Result = phFriNfc_MifStd_H_ChkNdefAidDone(NdefMap);
+  }
+
+  return Result;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_ChkNdefAidDone
+ *
+ * Description      This function counts the NDEF compliant blocks once the
+ *                  aid array is complete and starts on the first NDEF sector.
+ *
+ * Returns          This function return NFCSTATUS_PENDING in case of success
+ *                  In case of failure returns other failure value.
+ *
+ ******************************************************************************/
+static NFCSTATUS phFriNfc_MifStd_H_ChkNdefAidDone(phFriNfc_NdefMap_t* NdefMap) {
+  NFCSTATUS Result = NFCSTATUS_SUCCESS;
+
+  NdefMap->StdMifareContainer.ChkNdefCompleteFlag = PH_FRINFC_MIFARESTD_FLAG1;
+  /*  The check for NDEF compliant information is now over for
+      the Mifare 1K card.
+      Update(decrement) the NoOfNdefCompBlocks as much required,
+      depending on the NDEF compliant information found */
+  /* Check the Sectors are Ndef Compliant */
+  phFriNfc_MifStd_H_ChkNdefCmpltSects(NdefMap);
+  if ((NdefMap->StdMifareContainer.NoOfNdefCompBlocks == 0) ||
+      (NdefMap->StdMifareContainer.NoOfNdefCompBlocks > 255)) {
+    Result = PHNFCSTVAL(CID_FRI_NFC_NDEF_MAP, NFCSTATUS_NO_NDEF_SUPPORT);
+  } else {
+    phFriNfc_MifStd_H_CachePutMad(NdefMap);
+    NdefMap->StdMifareContainer.aidCompleteFlag = PH_FRINFC_MIFARESTD_FLAG0;
+    NdefMap->StdMifareContainer.NFCforumSectFlag = PH_FRINFC_MIFARESTD_FLAG0;
+    NdefMap->StdMifareContainer.currentBlock = PH_FRINFC_MIFARESTD_BLK4;
+    Result = phFriNfc_MifStd_H_BlkChk(NdefMap);
+    Result = ((Result != NFCSTATUS_SUCCESS)
+                  ? Result
+                  : phFriNfc_MifStd_H_AuthSector(NdefMap));
   }
 
   return Result;
@@ -3185,7 +3881,13 @@ static NFCSTATUS phFriNfc_MifStd_H_ProAuth(phFriNfc_NdefMap_t* NdefMap) {
   } else {
     NdefMap->StdMifareContainer.AuthDone = 1;
     NdefMap->StdMifareContainer.ReadAcsBitFlag = 1;
-    Result = phFriNfc_MifStd_H_RdAcsBit(NdefMap);
+    if (phFriNfc_MifStd_H_CacheGetAcs(NdefMap) == PH_FRINFC_MIFARESTD_FLAG1) {
+      /* Trailer already known, process it as if it had just been read */
+      NdefMap->State = PH_FRINFC_NDEFMAP_STATE_RD_ACS_BIT;
+      Result = phFriNfc_MifStd_H_ProAcsBits(NdefMap);
+    } else {
+      Result = phFriNfc_MifStd_H_RdAcsBit(NdefMap);
+    }
   }
 
   return Result;
@@ -3235,6 +3937,7 @@ static NFCSTATUS phFriNfc_MifStd_H_ProAcsBits(phFriNfc_NdefMap_t* NdefMap) {
   if (*NdefMap->SendRecvLength == PH_FRINFC_MIFARESTD_BYTES_READ) {
     if (NdefMap->StdMifareContainer.ReadAcsBitFlag ==
         PH_FRINFC_MIFARESTD_FLAG1) {
+      phFriNfc_MifStd_H_CachePutAcs(NdefMap);
       /* check for the correct access bits */
       Result = phFriNfc_MifStd_H_ChkAcsBit(NdefMap);
 
@@ -5073,6 +5776,219 @@ static NFCSTATUS phFriNfc_MifStd_H_ProWrSectorTrailor(
   return status;
 }
 
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_CacheFind
+ *
+ * Description      This function looks up the cache entry of the card in the
+ *                  field. If Create is set and there is none, the free or
+ *                  least recently used entry is taken over for the card.
+ *
+ * Returns          Pointer to the entry, NULL if there is none or if the card
+ *                  has no fixed UID.
+ *
+ ******************************************************************************/
+static phFriNfc_MifStd_CacheEntry_t* phFriNfc_MifStd_H_CacheFind(
+    const phFriNfc_NdefMap_t* NdefMap, uint8_t Create) {
+  const phNfc_sIso14443AInfo_t* Info = NULL;
+  phFriNfc_MifStd_CacheEntry_t* Entry = NULL;
+  uint8_t index = 0;
+
+  if ((NdefMap == NULL) || (NdefMap->psRemoteDevInfo == NULL)) {
+    return NULL;
+  }
+  Info = &NdefMap->psRemoteDevInfo->RemoteDevInfo.Iso14443A_Info;
+  /* A random NFCID1 (4 bytes starting with 0x08) changes on every
+     activation, so it can not identify the card */
+  if ((Info->UidLength == PH_FRINFC_MIFARESTD_VAL0) ||
+      (Info->UidLength > PHNFC_MAX_UID_LENGTH) ||
+      ((Info->UidLength == PH_FRINFC_MIFARESTD_VAL4) &&
+       (Info->Uid[PH_FRINFC_MIFARESTD_VAL0] == PH_FRINFC_MIFARESTD_VAL8))) {
+    return NULL;
+  }
+
+  for (index = 0; index < PH_FRINFC_MIFARESTD_CACHE_ENTRIES; index++) {
+    if ((gMifStdCache[index].UidLength == Info->UidLength) &&
+        (gMifStdCache[index].Sak == Info->Sak) &&
+        (memcmp(gMifStdCache[index].Uid, Info->Uid, Info->UidLength) == 0)) {
+      Entry = &gMifStdCache[index];
+      break;
+    }
+  }
+
+  if ((Entry == NULL) && (Create == PH_FRINFC_MIFARESTD_FLAG1)) {
+    /* Free entries have LastUse 0 and are taken first */
+    Entry = &gMifStdCache[0];
+    for (index = 1; index < PH_FRINFC_MIFARESTD_CACHE_ENTRIES; index++) {
+      if (gMifStdCache[index].LastUse < Entry->LastUse) {
+        Entry = &gMifStdCache[index];
+      }
+    }
+    memset(Entry, 0, sizeof(phFriNfc_MifStd_CacheEntry_t));
+    memcpy(Entry->Uid, Info->Uid, Info->UidLength);
+    Entry->UidLength = Info->UidLength;
+    Entry->Sak = Info->Sak;
+  }
+
+  if (Entry != NULL) {
+    Entry->LastUse = ++gMifStdCacheClock;
+  }
+
+  return Entry;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_CacheGetMad
+ *
+ * Description      This function fills the aid array from the cache, so that
+ *                  check NDEF does not read the MAD again.
+ *
+ * Returns          PH_FRINFC_MIFARESTD_FLAG1 if the aid array was filled.
+ *
+ ******************************************************************************/
+static uint8_t phFriNfc_MifStd_H_CacheGetMad(phFriNfc_NdefMap_t* NdefMap) {
+  uint8_t Found = PH_FRINFC_MIFARESTD_FLAG0;
+  phFriNfc_MifStd_CacheEntry_t* Entry =
+      phFriNfc_MifStd_H_CacheFind(NdefMap, PH_FRINFC_MIFARESTD_FLAG0);
+
+  if ((Entry != NULL) && (Entry->MadValid == PH_FRINFC_MIFARESTD_FLAG1)) {
+    memcpy(NdefMap->StdMifareContainer.aid, Entry->aid, sizeof(Entry->aid));
+    Found = PH_FRINFC_MIFARESTD_FLAG1;
+    gMifStdCacheHits++;
+  } else {
+    gMifStdCacheMisses++;
+  }
+
+  return Found;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_CachePutMad
+ *
+ * Description      This function stores the aid array read from the MAD.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phFriNfc_MifStd_H_CachePutMad(const phFriNfc_NdefMap_t* NdefMap) {
+  phFriNfc_MifStd_CacheEntry_t* Entry =
+      phFriNfc_MifStd_H_CacheFind(NdefMap, PH_FRINFC_MIFARESTD_FLAG1);
+
+  if (Entry != NULL) {
+    memcpy(Entry->aid, NdefMap->StdMifareContainer.aid, sizeof(Entry->aid));
+    Entry->MadValid = PH_FRINFC_MIFARESTD_FLAG1;
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_CacheGetAcs
+ *
+ * Description      This function puts the cached access bytes of the trailer
+ *                  of the current sector in the receive buffer, as a trailer
+ *                  read would have.
+ *
+ * Returns          PH_FRINFC_MIFARESTD_FLAG1 if the trailer need not be read.
+ *
+ ******************************************************************************/
+static uint8_t phFriNfc_MifStd_H_CacheGetAcs(phFriNfc_NdefMap_t* NdefMap) {
+  uint8_t Found = PH_FRINFC_MIFARESTD_FLAG0;
+  uint8_t SectorID =
+      phFriNfc_MifStd_H_GetSect(NdefMap->StdMifareContainer.currentBlock);
+  phFriNfc_MifStd_CacheEntry_t* Entry = NULL;
+
+  /* Convert to read only rewrites the trailers as it goes */
+  if (NdefMap->StdMifareContainer.ReadOnlySectorIndex !=
+      PH_FRINFC_MIFARESTD_VAL0) {
+    return Found;
+  }
+
+  Entry = phFriNfc_MifStd_H_CacheFind(NdefMap, PH_FRINFC_MIFARESTD_FLAG0);
+  if ((Entry != NULL) && (SectorID < PH_FRINFC_MIFARESTD4K_TOTAL_SECTOR) &&
+      (Entry->AcsValid[SectorID] == PH_FRINFC_MIFARESTD_FLAG1)) {
+    memcpy(&NdefMap->SendRecvBuf[PH_FRINFC_MIFARESTD_VAL6],
+           Entry->AcsBytes[SectorID], PH_FRINFC_MIFARESTD_CACHE_ACS_BYTES);
+    *NdefMap->SendRecvLength = PH_FRINFC_MIFARESTD_BYTES_READ;
+    Found = PH_FRINFC_MIFARESTD_FLAG1;
+    gMifStdCacheHits++;
+  } else {
+    gMifStdCacheMisses++;
+  }
+
+  return Found;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifStd_H_CachePutAcs
+ *
+ * Description      This function stores the access bytes of the sector
+ *                  trailer just read for the current sector.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phFriNfc_MifStd_H_CachePutAcs(const phFriNfc_NdefMap_t* NdefMap) {
+  uint8_t SectorID =
+      phFriNfc_MifStd_H_GetSect(NdefMap->StdMifareContainer.currentBlock);
+  phFriNfc_MifStd_CacheEntry_t* Entry = NULL;
+
+  if ((NdefMap->StdMifareContainer.ReadOnlySectorIndex ==
+       PH_FRINFC_MIFARESTD_VAL0) &&
+      (SectorID < PH_FRINFC_MIFARESTD4K_TOTAL_SECTOR)) {
+    Entry = phFriNfc_MifStd_H_CacheFind(NdefMap, PH_FRINFC_MIFARESTD_FLAG1);
+  }
+  if (Entry != NULL) {
+    memcpy(Entry->AcsBytes[SectorID],
+           &NdefMap->SendRecvBuf[PH_FRINFC_MIFARESTD_VAL6],
+           PH_FRINFC_MIFARESTD_CACHE_ACS_BYTES);
+    Entry->AcsValid[SectorID] = PH_FRINFC_MIFARESTD_FLAG1;
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifareStdMap_InvalidateCache
+ *
+ * Description      This function drops the cached layout of the card in the
+ *                  field. It is called before the MAD or the sector trailers
+ *                  of the card may change.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void phFriNfc_MifareStdMap_InvalidateCache(const phFriNfc_NdefMap_t* NdefMap) {
+  phFriNfc_MifStd_CacheEntry_t* Entry =
+      phFriNfc_MifStd_H_CacheFind(NdefMap, PH_FRINFC_MIFARESTD_FLAG0);
+
+  if (Entry != NULL) {
+    memset(Entry, 0, sizeof(phFriNfc_MifStd_CacheEntry_t));
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * Function         phFriNfc_MifareStdMap_GetCacheStats
+ *
+ * Description      This function returns how many MAD and sector trailer
+ *                  lookups were answered from the layout cache, and how many
+ *                  had to go to the card.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void phFriNfc_MifareStdMap_GetCacheStats(uint32_t* Hits, uint32_t* Misses) {
+  if (Hits != NULL) {
+    *Hits = gMifStdCacheHits;
+  }
+  if (Misses != NULL) {
+    *Misses = gMifStdCacheMisses;
+  }
+
+  return;
+}
+
 /******************************************************************************
  * Function         phFriNfc_MifStd_H_ProWrSectorTrailor
  *
@@ -76,6 +76,16 @@
   16 /* Convert to ReadOnly in progress */
 #define PH_FRINFC_NDEFMAP_STATE_WRITE_SEC \
   17 /* Convert to ReadOnly in progress */
+#define PH_FRINFC_NDEFMAP_STATE_RD_SECT_AUTH \
+  18 /* Sector-batched read: authenticate in progress */
+#define PH_FRINFC_NDEFMAP_STATE_RD_SECT \
+  19 /* Sector-batched read: block read in progress */
+#define PH_FRINFC_NDEFMAP_STATE_WR_SECT_AUTH \
+  20 /* Sector-batched write: authenticate in progress */
+#define PH_FRINFC_NDEFMAP_STATE_WR_SECT_RD \
+  21 /* Sector-batched write: NDEF TLV block read in progress */
+#define PH_FRINFC_NDEFMAP_STATE_WR_SECT \
+  22 /* Sector-batched write: block write in progress */
 
 /* Mifare Standard - NDEF Compliant Flags */
 #define PH_FRINFC_MIFARESTD_NDEF_COMP 0     /* Sector is NDEF Compliant */
@@ -224,6 +234,8 @@
 #define PH_FRINFC_MIFARESTD_GPB_RD_WR_VAL 0x00 /* GPB Read Write value */
 #define PH_FRINFC_MIFARESTD_KEY_LEN 0x06       /* MIFARE Std key length */
 #define PH_FRINFC_MIFARESTD_DEFAULT_KEY 0xFF   /* MIFARE Std Default Key */
+#define PH_FRINFC_MIFARESTD_CACHE_ENTRIES 4    /* Cards in the layout cache */
+#define PH_FRINFC_MIFARESTD_CACHE_ACS_BYTES 4  /* Trailer bytes 6 to 9 */
 
 NFCSTATUS phFriNfc_MifareStdMap_H_Reset(phFriNfc_NdefMap_t* NdefMap);
 NFCSTATUS phFriNfc_MifareStdMap_RdNdef(phFriNfc_NdefMap_t* NdefMap,
@@ -244,4 +256,7 @@ NFCSTATUS
 phFriNfc_MifareStdMap_ConvertToReadOnly(phFriNfc_NdefMap_t* NdefMap,
                                         const uint8_t* ScrtKeyB);
 
+void phFriNfc_MifareStdMap_InvalidateCache(const phFriNfc_NdefMap_t* NdefMap);
+void phFriNfc_MifareStdMap_GetCacheStats(uint32_t* Hits, uint32_t* Misses);
+
 #endif /* PHFRINFC_MIFARESTDMAP_H */
@@ -22,49 +22,36 @@
 #include <phNfcStatus.h>
 #include <phNfcTypes.h>
 #include <phNxpLog.h>
+#include "IntervalTimer.h"
 
 using android::base::StringPrintf;
 
-STATIC NFCSTATUS
-phFriNfc_MifareStd_CreateTimer(phFriNfc_MifareStdTimer_t* TimerInfo);
+/* Only one MIFARE operation is outstanding at a time, so every
+ * phFriNfc_MifareStdTimer_t shares this timer. */
+static IntervalTimer sMifareStdTimer;
+
 /*******************************************************************************
 **
 ** Function        phFriNfc_MifareStd_StartTimer
 **
 ** Description     Start timer for Mifare related events
-**                 TimerInfo structure contains timer id ,
+**                 TimerInfo structure contains timer,
 **                 timeout value and callback function.
-**                 Timerid is initially zero for first time.
+**                 Timer is initially NULL for first time.
 **                 It will be set to proper value inside this function.
 ** Returns:        NFCSTATUS_SUCCESS  -  timer started successfully
 **                 NFCSTATUS_FAILED   -  otherwise
 *******************************************************************************/
 NFCSTATUS phFriNfc_MifareStd_StartTimer(phFriNfc_MifareStdTimer_t* TimerInfo) {
-  NFCSTATUS status = NFCSTATUS_SUCCESS;
-  int stat = 0;
-  struct itimerspec ts;
-  if (TimerInfo->mTimerId == 0) {
-    if (TimerInfo->mCb == 0) {
-      return NFCSTATUS_FAILED;
-    }
-
-    if (phFriNfc_MifareStd_CreateTimer(TimerInfo) != NFCSTATUS_SUCCESS)
-      return NFCSTATUS_FAILED;
+  if (TimerInfo->mCb == 0) {
+    return NFCSTATUS_FAILED;
   }
+  TimerInfo->mTimer = &sMifareStdTimer;
 
-  ts.it_value.tv_sec = (TimerInfo->mtimeout) / 1000;
-  ts.it_value.tv_nsec = (TimerInfo->mtimeout % 1000) * 1000000;
-
-  ts.it_interval.tv_sec = 0;
-  ts.it_interval.tv_nsec = 0;
-
-  stat = timer_settime(TimerInfo->mTimerId, 0, &ts, 0);
-  if (stat == 0) {
-    status = NFCSTATUS_SUCCESS;
-    return status;
+  if (TimerInfo->mTimer->set(TimerInfo->mtimeout, TimerInfo->mCb)) {
+    return NFCSTATUS_SUCCESS;
   } else {
-    status = NFCSTATUS_FAILED;
-    return status;
+    return NFCSTATUS_FAILED;
   }
 }
 
@@ -80,50 +67,15 @@ NFCSTATUS phFriNfc_MifareStd_StartTimer(phFriNfc_MifareStdTimer_t* TimerInfo) {
 *******************************************************************************/
 NFCSTATUS phFriNfc_MifareStd_StopTimer(phFriNfc_MifareStdTimer_t* TimerInfo) {
   NFCSTATUS status = NFCSTATUS_SUCCESS;
-  if (TimerInfo->mTimerId == 0) {
+  if (TimerInfo->mTimer == NULL) {
     LOG(ERROR) << StringPrintf(
-        " phFriNfc_MifareStd_CreateTimer() failed to stop timer  ");
+        " phFriNfc_MifareStd_StopTimer() failed to stop timer  ");
     status = NFCSTATUS_FAILED;
     return status;
   }
 
-  timer_delete(TimerInfo->mTimerId);
-  TimerInfo->mTimerId = 0;
+  TimerInfo->mTimer->kill();
+  TimerInfo->mTimer = NULL;
   TimerInfo->mCb = NULL;
   return status;
 }
-
-/*******************************************************************************
-**
-** Function         phFriNfc_MifareStd_CreateTimer
-**
-** Description      Create  a mifare timer
-**
-**
-** Returns:         NFCSTATUS_SUCCESS  -  timer created successfully
-**                  NFCSTATUS_FAILED   -  otherwise
-*******************************************************************************/
-STATIC NFCSTATUS
-phFriNfc_MifareStd_CreateTimer(phFriNfc_MifareStdTimer_t* TimerInfo) {
-  NFCSTATUS status = NFCSTATUS_SUCCESS;
-  struct sigevent se;
-  memset(&se, 0, sizeof(struct sigevent));
-  int stat = 0;
-  /*
-   * Set the sigevent structure to cause the signal to be
-   * delivered by creating a new thread.
-   */
-  se.sigev_notify = SIGEV_THREAD;
-  se.sigev_value.sival_ptr = &(TimerInfo)->mTimerId;
-  se.sigev_notify_function = TimerInfo->mCb;
-  se.sigev_notify_attributes = NULL;
-  stat = timer_create(CLOCK_MONOTONIC, &se, &(TimerInfo)->mTimerId);
-  if (stat == 0) {
-    LOG(ERROR) << StringPrintf(
-        " phFriNfc_MifareStd_CreateTimer() Timer created successfully ");
-    return status;
-  } else {
-    status = NFCSTATUS_FAILED;
-    return status;
-  }
-}
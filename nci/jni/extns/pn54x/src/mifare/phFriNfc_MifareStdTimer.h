@@ -26,10 +26,12 @@
 
 typedef void (*TIMER_FUNC)(union sigval);
 
+class IntervalTimer;
+
 typedef struct phFriNfc_MifareStdTimer {
-  timer_t mTimerId;   // timer id which will be assigned by create timer
-  TIMER_FUNC mCb;     // callback function for timeout
-  uint32_t mtimeout;  // timeout value in ms.
+  IntervalTimer* mTimer;  // timer assigned by phFriNfc_MifareStd_StartTimer
+  TIMER_FUNC mCb;         // callback function for timeout
+  uint32_t mtimeout;      // timeout value in ms.
 } phFriNfc_MifareStdTimer_t;
 
 NFCSTATUS phFriNfc_MifareStd_StartTimer(phFriNfc_MifareStdTimer_t* timer);
@@ -206,6 +206,31 @@ typedef struct phFriNfc_MifareStdCont {
   uint8_t SectorTrailerBlockNo;
   /* Secret key B to given by the application */
   uint8_t UserScrtKeyB[6];
+  /* Data blocks of the NDEF compliant sectors, in the order the sector-batched
+     read fetches them; shared with the sector-batched write */
+  uint8_t RdSectBlocks[PH_FRINFC_NDEFMAP_MIFARESTD_4KNDEF_COMPBLOCK];
+  /* Number of blocks in RdSectBlocks */
+  uint8_t RdSectCount;
+  /* Index in RdSectBlocks of the block being read */
+  uint8_t RdSectIndex;
+  /* Bytes that must be read before the NDEF TLV is complete, 0 while the TLV
+     header has not been read */
+  uint16_t RdSectNeed;
+  /* Blocks read so far by the sector-batched read, back to back; the
+     sector-batched write builds the final block images here */
+  uint8_t RdSectBuf[PH_FRINFC_NDEFMAP_MIFARESTD_4KNDEF_COMPBLOCK *
+                    PH_FRINFC_NDEFMAP_MIFARESTD_RDWR_SIZE];
+  /* Indices in RdSectBlocks of the blocks to write, in write order; the
+     blocks holding the NDEF TLV header appear twice */
+  uint8_t WrSectOrder[PH_FRINFC_NDEFMAP_MIFARESTD_4KNDEF_COMPBLOCK + 4];
+  /* Number of blocks in WrSectOrder, 0 while the NDEF TLV is being located */
+  uint8_t WrSectCount;
+  /* Index in WrSectOrder of the block being written */
+  uint8_t WrSectIndex;
+  /* Number of leading WrSectOrder entries written from WrSectZeroBuf */
+  uint8_t WrSectZeroCount;
+  /* Blocks holding the NDEF TLV header, with the TLV length zeroed */
+  uint8_t WrSectZeroBuf[2 * PH_FRINFC_NDEFMAP_MIFARESTD_RDWR_SIZE];
 } phFriNfc_MifareStdCont_t;
 
 /*
@@ -40,6 +40,10 @@ pthread_mutex_t SharedDataMutex = PTHREAD_MUTEX_INITIALIZER;
 uint8_t current_key[6] = {0};
 phNci_mfc_auth_cmd_t gAuthCmdBuf;
 phFriNfc_MifareStdTimer_t mTimerInfo;
+/* NULL: frames go through NFA */
+STATIC const phNxpExtns_MfcTransport_t* gpMfcTransport = NULL;
+/* Frames sent to the tag, for counting the round trips of an operation */
+STATIC uint32_t gMfcFrameCount = 0;
 
 STATIC NFCSTATUS phNciNfc_SendMfReq(phNciNfc_TransceiveInfo_t tTranscvInfo,
                                     uint8_t* buff, uint16_t* buffSz);
@@ -550,6 +554,8 @@ STATIC void Mfc_SetRdOnly_Completion_Routine(void* NdefCtxt, NFCSTATUS status) {
   (void)NdefCtxt;
   tNFA_CONN_EVT_DATA conn_evt_data;
   LOG(ERROR) << StringPrintf("%s status = 0x%x", __func__, status);
+  /* Trailers read on the way may have been cached before being rewritten */
+  phFriNfc_MifareStdMap_InvalidateCache(NdefMap);
   conn_evt_data.status = status;
   (*gphNxpExtns_Context.p_conn_cback)(NFA_SET_TAG_RO_EVT, &conn_evt_data);
 
@@ -601,6 +607,7 @@ NFCSTATUS Mfc_SetReadOnly(uint8_t* secrtkey, uint8_t len) {
     status = NFCSTATUS_SUCCESS;
     goto Mfc_SetRdOnly;
   } else {
+    phFriNfc_MifareStdMap_InvalidateCache(NdefMap);
     status = phFriNfc_MifareStdMap_ConvertToReadOnly(NdefMap, mif_secrete_key);
   }
   if (NFCSTATUS_PENDING == status) {
@@ -772,6 +779,7 @@ NFCSTATUS Mfc_WriteNdef(uint8_t* p_data, uint32_t len) {
     NdefInfo.psUpperNdefMsg->length = len;
 
     NdefInfo.AppWrLength = len;
+    phFriNfc_MifareStdMap_InvalidateCache(NdefMap);
     NdefMap->CompletionRoutine[2].CompletionRoutine =
         Mfc_WriteNdef_Completion_Routine;
     if (0 == len) {
@@ -888,6 +896,7 @@ NFCSTATUS Mfc_FormatNdef(uint8_t* secretkey, uint8_t len) {
     goto Mfc_FormatEnd;
   }
   NdefSmtCrdFmt->pTransceiveInfo = NdefMap->pTransceiveInfo;
+  phFriNfc_MifareStdMap_InvalidateCache(NdefMap);
 
   gphNxpExtns_Context.CallBackMifare = phFriNfc_MfStd_Process;
   gphNxpExtns_Context.CallBackCtxt = NdefSmtCrdFmt;
@@ -941,6 +950,10 @@ Mfc_FormatEnd:
 NFCSTATUS phNxNciExtns_MifareStd_Reconnect(void) {
   tNFA_STATUS status;
 
+  if (gpMfcTransport != NULL) {
+    return gpMfcTransport->reconnect();
+  }
+
   EXTNS_SetDeactivateFlag(true);
   if (NFA_STATUS_OK !=
       (status = NFA_Deactivate(true))) /* deactivate to sleep state */
@@ -1030,6 +1043,8 @@ NFCSTATUS Mfc_Transceive(uint8_t* p_data, uint32_t len) {
                                       NdefMap->SendRecvLength);
   } else if (p_data[0] == 0xA0) {
     EXTNS_SetCallBackFlag(false);
+    /* The block may be a MAD block or a sector trailer */
+    phFriNfc_MifareStdMap_InvalidateCache(NdefMap);
     NdefMap->Cmd.MfCmd = phNfc_eMifareWrite16;
     gphNxpExtns_Context.RawWriteCallBack = true;
 
@@ -1096,9 +1111,15 @@ NFCSTATUS Mfc_Transceive(uint8_t* p_data, uint32_t len) {
 *******************************************************************************/
 STATIC NFCSTATUS nativeNfcExtns_doTransceive(uint8_t* buff, uint16_t buffSz) {
   NFCSTATUS wStatus = NFCSTATUS_PENDING;
-  tNFA_STATUS status =
-      NFA_SendRawFrame(buff, buffSz, NFA_DM_DEFAULT_PRESENCE_CHECK_START_DELAY);
+  tNFA_STATUS status;
 
+  gMfcFrameCount++;
+  if (gpMfcTransport != NULL) {
+    return gpMfcTransport->sendRaw(buff, buffSz);
+  }
+
+  status =
+      NFA_SendRawFrame(buff, buffSz, NFA_DM_DEFAULT_PRESENCE_CHECK_START_DELAY);
   if (status != NFA_STATUS_OK) {
     LOG(ERROR) << StringPrintf("%s: fail send; error=%d", __func__, status);
     wStatus = NFCSTATUS_FAILED;
@@ -1107,6 +1128,49 @@ STATIC NFCSTATUS nativeNfcExtns_doTransceive(uint8_t* buff, uint16_t buffSz) {
   return wStatus;
 }
 
+/*******************************************************************************
+**
+** Function         Mfc_SetTransport
+**
+** Description      Route the frames of the MIFARE Classic stack through
+**                  pTransport instead of NFA, or back to NFA if it is NULL.
+**                  Only call it while no operation is in progress.
+**
+** Returns          void
+**
+*******************************************************************************/
+void Mfc_SetTransport(const phNxpExtns_MfcTransport_t* pTransport) {
+  gpMfcTransport = pTransport;
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: %s", __func__, (pTransport != NULL) ? "set" : "NFA");
+}
+
+/*******************************************************************************
+**
+** Function         Mfc_GetFrameCount
+**
+** Description      Number of frames sent to the tag so far. The difference
+**                  across an operation is its number of round trips.
+**
+** Returns          Frame count
+**
+*******************************************************************************/
+uint32_t Mfc_GetFrameCount(void) { return gMfcFrameCount; }
+
+/*******************************************************************************
+**
+** Function         Mfc_GetCacheStats
+**
+** Description      Number of MAD and sector trailer lookups answered from
+**                  the layout cache (hits) and read from the tag (misses).
+**
+** Returns          void
+**
+*******************************************************************************/
+void Mfc_GetCacheStats(uint32_t* hits, uint32_t* misses) {
+  phFriNfc_MifareStdMap_GetCacheStats(hits, misses);
+}
+
 /*******************************************************************************
 **
 ** Function          phNciNfc_RecvMfResp
@@ -1361,6 +1425,10 @@ NFCSTATUS Mfc_RecvPacket(uint8_t* buff, uint8_t buffSz) {
     }
 
   } else {
+    /* A first half the card refused ends the command: the second half must
+     * not go out with whatever answer comes next */
+    gphNxpExtns_Context.writecmdFlag = false;
+    gphNxpExtns_Context.incrdecflag = false;
     if (gphNxpExtns_Context.CallBackMifare != NULL) {
       if ((gphNxpExtns_Context.incrdecstatusflag == true) && status == 0xB2) {
         gphNxpExtns_Context.incrdecstatusflag = false;
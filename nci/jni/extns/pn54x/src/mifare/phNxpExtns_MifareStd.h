@@ -216,6 +216,17 @@ typedef struct phNxpExtns_Context {
   uint8_t incrdecstatusflag;
 } phNxpExtns_Context_t;
 
+/*
+ * Link to the tag used by the MIFARE Classic stack. sendRaw sends one frame
+ * and the response is handed to Mfc_RecvPacket(); reconnect puts the tag to
+ * sleep and selects it again, then calls Mfc_ActivateCback(). Without one,
+ * frames go through NFA.
+ */
+typedef struct phNxpExtns_MfcTransport {
+  NFCSTATUS (*sendRaw)(uint8_t* buff, uint16_t buffSz);
+  NFCSTATUS (*reconnect)(void);
+} phNxpExtns_MfcTransport_t;
+
 NFCSTATUS phFriNfc_ExtnsTransceive(phNfc_sTransceiveInfo_t* pTransceiveInfo,
                                    phNfc_uCmdList_t Cmd, uint8_t* SendRecvBuf,
                                    uint16_t SendLength,
@@ -233,5 +244,8 @@ void Mfc_ActivateCback(void);
 NFCSTATUS Mfc_RecvPacket(uint8_t* buff, uint8_t buffSz);
 NFCSTATUS phNxNciExtns_MifareStd_Reconnect(void);
 NFCSTATUS Mfc_PresenceCheck(void);
+void Mfc_SetTransport(const phNxpExtns_MfcTransport_t* pTransport);
+uint32_t Mfc_GetFrameCount(void);
+void Mfc_GetCacheStats(uint32_t* hits, uint32_t* misses);
 
 #endif /* _PHNXPEXTNS_MFCRF_H_ */
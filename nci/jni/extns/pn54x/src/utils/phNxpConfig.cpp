@@ -51,16 +51,24 @@
 #define LOG_TAG "pn54x"
 
 #include <phNxpConfig.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
-#include <list>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/stringprintf.h>
 #include <base/logging.h>
 #include <phNxpLog.h>
 #include <cutils/properties.h>
+#include "phNxpConfigCache.h"
 #include "sparse_crc32.h"
 
 using android::base::StringPrintf;
@@ -96,6 +104,7 @@ const char tr_config_timestamp_path[] =
     "/data/vendor/nfc/libnfc-nxpTransitConfigState.bin";
 const char config_timestamp_path[] =
     "/data/vendor/nfc/libnfc-nxpConfigState.bin";
+const char config_cache_path[] = "/data/vendor/nfc/libnfc-nxpConfigCache.bin";
 const char default_nxp_config_path[] = "/vendor/etc/libnfc-nxp.conf";
 const char nxp_rf_config_path[] = "/system/vendor/libnfc-nxp_RF.conf";
 
@@ -154,35 +163,65 @@ typedef enum
 
 namespace {
 
-size_t readConfigFile(const char* fileName, uint8_t** p_data) {
-  FILE* fd = fopen(fileName, "rb");
-  if (fd == nullptr) return 0;
-
-  fseek(fd, 0L, SEEK_END);
-  const size_t file_size = ftell(fd);
-  rewind(fd);
+/* Read-only view of a whole config file. The file is memory-mapped so the
+ * parser can tokenize it in place; if mapping fails the file is read into a
+ * heap buffer instead. */
+class ConfigFileMap {
+ public:
+  explicit ConfigFileMap(const char* fileName)
+      : m_data(nullptr), m_size(0), m_mapped(false) {
+    int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
 
-  uint8_t* buffer = new uint8_t[file_size];
-  if(buffer == NULL)
-  {
-    return 0;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) &&
+        file_stat.st_size > 0) {
+      const size_t file_size = file_stat.st_size;
+      void* addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        madvise(addr, file_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const uint8_t*>(addr);
+        m_size = file_size;
+        m_mapped = true;
+      } else {
+        uint8_t* buffer = new uint8_t[file_size];
+        if (pread(fd, buffer, file_size, 0) == (ssize_t)file_size) {
+          m_data = buffer;
+          m_size = file_size;
+        } else {
+          delete[] buffer;
+        }
+      }
+    }
+    close(fd);
   }
-  size_t read = fread(buffer, file_size, 1, fd);
-  fclose(fd);
 
-  if (read == 1) {
-    *p_data = buffer;
-    return file_size;
+  ~ConfigFileMap() {
+    if (m_data == nullptr) return;
+    if (m_mapped)
+      munmap(const_cast<uint8_t*>(m_data), m_size);
+    else
+      delete[] m_data;
   }
 
-  return 0;
-}
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+ private:
+  ConfigFileMap(const ConfigFileMap&) = delete;
+  ConfigFileMap& operator=(const ConfigFileMap&) = delete;
+
+  const uint8_t* m_data;
+  size_t m_size;
+  bool m_mapped;
+};
 
 }  // namespace
 
 using namespace ::std;
 
 void readOptionalConfig(const char* optional);
+string optionalConfigPath(const char* optional);
 void findConfigFilePathFromTransportConfigPaths(const string& configName, string& filePath);
 
 class CNxpNfcParam : public string {
@@ -190,6 +229,8 @@ class CNxpNfcParam : public string {
   CNxpNfcParam();
   CNxpNfcParam(const char* name, const string& value);
   CNxpNfcParam(const char* name, unsigned long value);
+  CNxpNfcParam(const char* name, size_t nameLen, const string& value);
+  CNxpNfcParam(const char* name, size_t nameLen, unsigned long value);
   virtual ~CNxpNfcParam();
   unsigned long numValue() const { return m_numValue; }
   const char* str_value() const { return m_str_value.c_str(); }
@@ -200,6 +241,27 @@ class CNxpNfcParam : public string {
   unsigned long m_numValue;
 };
 
+/* Immutable, hash-indexed copy of the merged settings. A new snapshot is
+ * published each time a config file is (re)loaded; readers keep the one they
+ * obtained alive for the duration of the lookup, so no lock is needed. */
+class CNxpNfcConfigSnapshot {
+ public:
+  explicit CNxpNfcConfigSnapshot(const vector<const CNxpNfcParam*>& params);
+  const CNxpNfcParam* find(const char* p_name) const;
+
+ private:
+  struct NameHash {
+    size_t operator()(const char* p_name) const;
+  };
+  struct NameEqual {
+    bool operator()(const char* a, const char* b) const {
+      return strcmp(a, b) == 0;
+    }
+  };
+  vector<CNxpNfcParam> m_params;
+  unordered_map<const char*, const CNxpNfcParam*, NameHash, NameEqual> m_index;
+};
+
 class CNxpNfcConfig : public vector<const CNxpNfcParam*> {
  public:
   virtual ~CNxpNfcConfig();
@@ -213,7 +275,9 @@ class CNxpNfcConfig : public vector<const CNxpNfcParam*> {
   bool getValue(const char* name, unsigned long& rValue) const;
   bool getValue(const char* name, unsigned short& rValue) const;
   bool getValue(const char* name, char* pValue, long len, long* readlen) const;
-  const CNxpNfcParam* find(const char* p_name) const;
+  shared_ptr<const CNxpNfcConfigSnapshot> snapshot() const {
+    return atomic_load(&mSnapshot);
+  }
   void readNxpTransitConfig(const char* fileName) const;
   void readNxpRFConfig(const char* fileName) const;
   void clean();
@@ -221,19 +285,24 @@ class CNxpNfcConfig : public vector<const CNxpNfcParam*> {
  private:
   CNxpNfcConfig();
   bool readConfig(const char* name, bool bResetContent);
+  bool loadCache(const vector<string>& sources);
+  void saveCache();
   int file_exist (const char* filename);
   int getconfiguration_id (char * config_file);
-  void moveFromList();
-  void moveToList();
-  void add(const CNxpNfcParam* pParam);
+  void add(vector<const CNxpNfcParam*>& parsed, const CNxpNfcParam* pParam);
+  void merge(vector<const CNxpNfcParam*>& overlay);
+  void purge();
+  void publish();
   void dump();
   bool isAllowed(const char* name);
-  list<const CNxpNfcParam*> m_list;
   bool mValidFile;
   bool mDynamConfig;
   uint32_t config_crc32_;
   uint32_t config_crc32_rf_;
   uint32_t config_crc32_tr_;
+  shared_ptr<const CNxpNfcConfigSnapshot> mSnapshot;
+  // files read since the last reset, in order, recorded for the cache
+  vector<phNxpConfigCacheSource> m_sources;
 
   string mCurrentFile;
 
@@ -595,8 +664,8 @@ void findConfigFilePathFromTransportConfigPaths(const string& configName,
 **
 ** Function:    CNxpNfcConfig::readConfig()
 **
-** Description: read Config settings and parse them into a linked list
-**              move the element from linked list to a array at the end
+** Description: read Config settings and parse them into a flat array,
+**              then merge the array over the current settings
 **
 ** Returns:     1, if there are any config data, 0 otherwise
 **
@@ -612,9 +681,12 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
     END_LINE
   };
 
-  uint8_t* p_config = nullptr;
-  size_t config_size = readConfigFile(name, &p_config);
+  ConfigFileMap configFile(name);
+  const uint8_t* p_config = configFile.data();
+  const size_t config_size = configFile.size();
+  if (bResetContent) m_sources.clear();
   if (p_config == nullptr) {
+    m_sources.push_back({name, false, 0});
     LOG(ERROR) << StringPrintf("%s Cannot open config file %s\n", __func__,
                                name);
     if (bResetContent) {
@@ -625,10 +697,14 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
     return false;
   }
 
-  string token;
+  // the token is a span of the mapped file, only values are copied out
+  const char* token = nullptr;
+  size_t tokenLen = 0;
   string strValue;
+  strValue.reserve(256);
   unsigned long numValue = 0;
   CNxpNfcParam* pParam = NULL;
+  vector<const CNxpNfcParam*> parsed;
   int i = 0;
   int base = 0;
   char c;
@@ -636,26 +712,25 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
   state = BEGIN_LINE;
   mCurrentFile = name;
 
+  const uint32_t crc32 =
+      sparse_crc32_fast(0, (const void*)p_config, config_size);
+  m_sources.push_back({name, true, crc32});
   if(mDynamConfig)
-    config_crc32_ = sparse_crc32(0,(const void *)p_config, config_size);
+    config_crc32_ = crc32;
   else {
       if (strcmp(default_nxp_config_path, name) == 0) {
-        config_crc32_ = sparse_crc32(0,(const void *)p_config, config_size);
+        config_crc32_ = crc32;
       }
   }
   if (strcmp(nxp_rf_config_path, name) == 0) {
-    config_crc32_rf_ = sparse_crc32(0, (const void *)p_config, config_size);
+    config_crc32_rf_ = crc32;
   }
   if (strcmp(transit_config_path, name) == 0) {
-    config_crc32_tr_ = sparse_crc32(0, (const void *)p_config, config_size);
+    config_crc32_tr_ = crc32;
   }
   mValidFile = true;
-  if (size() > 0) {
-    if (bResetContent)
-      clean();
-    else
-      moveToList();
-  }
+  if (bResetContent) purge();
+  const auto parseStart = chrono::steady_clock::now();
 
   for (size_t offset = 0; offset != config_size; ++offset) {
     c = p_config[offset];
@@ -665,18 +740,17 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
           state = END_LINE;
         else if (isPrintable(c)) {
           i = 0;
-          token.erase();
+          token = reinterpret_cast<const char*>(p_config + offset);
+          tokenLen = 1;
           strValue.erase();
           state = TOKEN;
-          token.push_back(c);
         }
         break;
       case TOKEN:
         if (c == '=') {
-          token.push_back('\0');
           state = BEGIN_QUOTE;
         } else if (isPrintable(c))
-          token.push_back(c);
+          ++tokenLen;
         else
           state = END_LINE;
         break;
@@ -758,10 +832,10 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
             while (n-- > 0) strValue.push_back(((numValue >> (n * 8)) & 0xFF));
           }
           if (strValue.length() > 0)
-            pParam = new CNxpNfcParam(token.c_str(), strValue);
+            pParam = new CNxpNfcParam(token, tokenLen, strValue);
           else
-            pParam = new CNxpNfcParam(token.c_str(), numValue);
-          add(pParam);
+            pParam = new CNxpNfcParam(token, tokenLen, numValue);
+          add(parsed, pParam);
           strValue.erase();
           numValue = 0;
         }
@@ -770,8 +844,8 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
         if (c == '"') {
           strValue.push_back('\0');
           state = END_LINE;
-          pParam = new CNxpNfcParam(token.c_str(), strValue);
-          add(pParam);
+          pParam = new CNxpNfcParam(token, tokenLen, strValue);
+          add(parsed, pParam);
         } else if (isPrintable(c))
           strValue.push_back(c);
         break;
@@ -783,9 +857,14 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
     }
   }
 
-  delete[] p_config;
-
-  moveFromList();
+  merge(parsed);
+  publish();
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s parsed %s in %lld us, %zu settings", __func__, name,
+      (long long)chrono::duration_cast<chrono::microseconds>(
+          chrono::steady_clock::now() - parseStart)
+          .count(),
+      size());
   return size() > 0;
 }
 
@@ -798,7 +877,13 @@ bool CNxpNfcConfig::readConfig(const char* name, bool bResetContent) {
 ** Returns:     none
 **
 *******************************************************************************/
-CNxpNfcConfig::CNxpNfcConfig() : mValidFile(true), mDynamConfig(true), state(0) {}
+CNxpNfcConfig::CNxpNfcConfig()
+    : mValidFile(true),
+      mDynamConfig(true),
+      config_crc32_(0),
+      config_crc32_rf_(0),
+      config_crc32_tr_(0),
+      state(0) {}
 
 /*******************************************************************************
 **
@@ -844,6 +929,7 @@ CNxpNfcConfig& CNxpNfcConfig::GetInstance ()
 
   if (theInstance.size() == 0 && theInstance.mValidFile) {
     string strPath;
+    const auto loadStart = chrono::steady_clock::now();
     if (alternative_config_path[0] != '\0') {
       strPath.assign(alternative_config_path);
       strPath += config_name;
@@ -858,7 +944,10 @@ CNxpNfcConfig& CNxpNfcConfig::GetInstance ()
     {
         ALOGI("default config file exists = %s, dynamic selection disabled", strPath.c_str());
         theInstance.mDynamConfig = false;
-        theInstance.readConfig(strPath.c_str(), true);
+        if (!theInstance.loadCache({strPath})) {
+          theInstance.readConfig(strPath.c_str(), true);
+          theInstance.saveCache();
+        }
         /*
          * if libnfc-nxp.conf exists then dynamic selection will
          * be turned off by default we will not have this file.
@@ -873,16 +962,115 @@ CNxpNfcConfig& CNxpNfcConfig::GetInstance ()
        findConfigFilePathFromTransportConfigPaths(config_name_default, strPath);
     }
     ALOGI("config file used = %s\n", strPath.c_str());
+#if (NXP_EXTNS == TRUE)
+    const vector<string> sources = {strPath, optionalConfigPath("brcm"),
+                                    transit_config_path, nxp_rf_config_path};
+#else
+    const vector<string> sources = {strPath};
+#endif
+    if (theInstance.loadCache(sources)) {
+      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+          "%s config loaded from cache in %lld us", __func__,
+          (long long)chrono::duration_cast<chrono::microseconds>(
+              chrono::steady_clock::now() - loadStart)
+              .count());
+      return theInstance;
+    }
     theInstance.readConfig (strPath.c_str (), true);
 #if (NXP_EXTNS == TRUE)
     readOptionalConfig("brcm");
     theInstance.readNxpTransitConfig(transit_config_path);
     theInstance.readNxpRFConfig(nxp_rf_config_path);
 #endif
+    theInstance.saveCache();
+    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+        "%s config parsed in %lld us", __func__,
+        (long long)chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - loadStart)
+            .count());
   }
   return theInstance;
 }
 
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::loadCache()
+**
+** Description: load the parsed setting table from the binary cache if it was
+**              built from exactly |sources| and none of them has changed
+**
+** Returns:     true if the setting table was loaded from the cache
+**
+*******************************************************************************/
+bool CNxpNfcConfig::loadCache(const vector<string>& sources) {
+  phNxpConfigCacheImage image;
+  if (!phNxpConfigCache_Read(config_cache_path, image)) return false;
+  if (image.sources.size() != sources.size()) return false;
+
+  for (size_t n = 0; n < sources.size(); ++n) {
+    const phNxpConfigCacheSource& src = image.sources[n];
+    if (src.path != sources[n]) return false;
+    ConfigFileMap configFile(src.path.c_str());
+    if ((configFile.data() != nullptr) != src.present) return false;
+    if (src.present && sparse_crc32_fast(0, configFile.data(),
+                                         configFile.size()) != src.crc32) {
+      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+          "%s %s modified, ignoring cache", __func__, src.path.c_str());
+      return false;
+    }
+  }
+
+  // entries were written from the sorted table, so they are still sorted
+  purge();
+  reserve(image.entries.size());
+  for (const phNxpConfigCacheEntry& entry : image.entries) {
+    if (entry.isString)
+      push_back(new CNxpNfcParam(entry.name.c_str(), entry.strValue));
+    else
+      push_back(new CNxpNfcParam(entry.name.c_str(),
+                                 (unsigned long)entry.numValue));
+  }
+  config_crc32_ = image.config_crc32;
+  config_crc32_rf_ = image.config_crc32_rf;
+  config_crc32_tr_ = image.config_crc32_tr;
+  m_sources.swap(image.sources);
+  mValidFile = true;
+  publish();
+  return size() > 0;
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::saveCache()
+**
+** Description: write the current setting table to the binary cache
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNxpNfcConfig::saveCache() {
+  if (!mValidFile || empty()) return;
+
+  phNxpConfigCacheImage image;
+  image.config_crc32 = config_crc32_;
+  image.config_crc32_rf = config_crc32_rf_;
+  image.config_crc32_tr = config_crc32_tr_;
+  image.sources = m_sources;
+  image.entries.reserve(size());
+  for (const CNxpNfcParam* pParam : *this) {
+    phNxpConfigCacheEntry entry;
+    entry.name = *pParam;
+    entry.isString = pParam->str_len() > 0;
+    entry.numValue = pParam->numValue();
+    entry.strValue.assign(pParam->str_value(), pParam->str_len());
+    image.entries.push_back(entry);
+  }
+  if (!phNxpConfigCache_Write(config_cache_path, image)) {
+    LOG(ERROR) << StringPrintf("%s Unable to write file '%s'", __func__,
+                               config_cache_path);
+  }
+}
+
 /*******************************************************************************
 **
 ** Function:    CNxpNfcConfig::getValue()
@@ -894,7 +1082,8 @@ CNxpNfcConfig& CNxpNfcConfig::GetInstance ()
 **
 *******************************************************************************/
 bool CNxpNfcConfig::getValue(const char* name, char* pValue, size_t len) const {
-  const CNxpNfcParam* pParam = find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
   if (pParam == NULL) return false;
 
   if (pParam->str_len() > 0) {
@@ -907,7 +1096,8 @@ bool CNxpNfcConfig::getValue(const char* name, char* pValue, size_t len) const {
 
 bool CNxpNfcConfig::getValue(const char* name, char* pValue, long len,
                              long* readlen) const {
-  const CNxpNfcParam* pParam = find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
   if (pParam == NULL) return false;
 
   if (pParam->str_len() > 0) {
@@ -935,7 +1125,8 @@ bool CNxpNfcConfig::getValue(const char* name, char* pValue, long len,
 **
 *******************************************************************************/
 bool CNxpNfcConfig::getValue(const char* name, unsigned long& rValue) const {
-  const CNxpNfcParam* pParam = find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
   if (pParam == NULL) return false;
 
   if (pParam->str_len() == 0) {
@@ -956,7 +1147,8 @@ bool CNxpNfcConfig::getValue(const char* name, unsigned long& rValue) const {
 **
 *******************************************************************************/
 bool CNxpNfcConfig::getValue(const char* name, unsigned short& rValue) const {
-  const CNxpNfcParam* pParam = find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
   if (pParam == NULL) return false;
 
   if (pParam->str_len() == 0) {
@@ -968,34 +1160,83 @@ bool CNxpNfcConfig::getValue(const char* name, unsigned short& rValue) const {
 
 /*******************************************************************************
 **
-** Function:    CNxpNfcConfig::find()
+** Function:    CNxpNfcConfigSnapshot::CNxpNfcConfigSnapshot()
 **
-** Description: search if a setting exist in the setting array
+** Description: copy the merged settings and build the name index
 **
-** Returns:     pointer to the setting object
+** Returns:     none
 **
 *******************************************************************************/
-const CNxpNfcParam* CNxpNfcConfig::find(const char* p_name) const {
-  if (size() == 0) return NULL;
+CNxpNfcConfigSnapshot::CNxpNfcConfigSnapshot(
+    const vector<const CNxpNfcParam*>& params) {
+  // reserve up front so the index keys never dangle on reallocation
+  m_params.reserve(params.size());
+  m_index.reserve(params.size());
+  for (const CNxpNfcParam* pParam : params) {
+    m_params.push_back(*pParam);
+    const CNxpNfcParam& rParam = m_params.back();
+    m_index[rParam.c_str()] = &rParam;
+  }
+}
 
-  for (const_iterator it = begin(), itEnd = end(); it != itEnd; ++it) {
-    if (**it < p_name) {
-      continue;
-    } else if (**it == p_name) {
-      if ((*it)->str_len() > 0) {
-        DLOG_IF(INFO, gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)
-            << StringPrintf("%s found %s=%s\n", __func__, p_name,
-                            (*it)->str_value());
-      } else {
-        DLOG_IF(INFO, gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)
-            << StringPrintf("%s found %s=(0x%lx)\n", __func__, p_name,
-                            (*it)->numValue());
-      }
-      return *it;
-    } else
-      break;
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfigSnapshot::NameHash::operator()
+**
+** Description: FNV-1a hash of a setting name
+**
+** Returns:     hash value
+**
+*******************************************************************************/
+size_t CNxpNfcConfigSnapshot::NameHash::operator()(const char* p_name) const {
+  size_t hash = 2166136261u;
+  while (*p_name) {
+    hash ^= (unsigned char)*p_name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfigSnapshot::find()
+**
+** Description: search if a setting exist in the snapshot
+**
+** Returns:     pointer to the setting object, valid while the snapshot is held
+**
+*******************************************************************************/
+const CNxpNfcParam* CNxpNfcConfigSnapshot::find(const char* p_name) const {
+  auto it = m_index.find(p_name);
+  if (it == m_index.end()) return NULL;
+
+  const CNxpNfcParam* pParam = it->second;
+  if (pParam->str_len() > 0) {
+    DLOG_IF(INFO, gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)
+        << StringPrintf("%s found %s=%s\n", __func__, p_name,
+                        pParam->str_value());
+  } else {
+    DLOG_IF(INFO, gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)
+        << StringPrintf("%s found %s=(0x%lx)\n", __func__, p_name,
+                        pParam->numValue());
   }
-  return NULL;
+  return pParam;
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::publish()
+**
+** Description: atomically replace the snapshot seen by readers with the
+**              current content of the setting array
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNxpNfcConfig::publish() {
+  shared_ptr<const CNxpNfcConfigSnapshot> snap;
+  if (size() > 0) snap = make_shared<const CNxpNfcConfigSnapshot>(*this);
+  atomic_store(&mSnapshot, snap);
 }
 
 /*******************************************************************************
@@ -1040,48 +1281,95 @@ void CNxpNfcConfig::readNxpRFConfig(const char* fileName) const {
 void CNxpNfcConfig::clean() {
   if (size() == 0) return;
 
+  purge();
+  publish();
+}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::purge()
+**
+** Description: delete the setting objects without touching the published
+**              snapshot, so a reload never exposes an empty config to readers
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNxpNfcConfig::purge() {
   for (iterator it = begin(), itEnd = end(); it != itEnd; ++it) delete *it;
   clear();
 }
 
 /*******************************************************************************
 **
-** Function:    CNxpNfcConfig::Add()
+** Function:    CNxpNfcConfig::add()
 **
-** Description: add a setting object to the list
+** Description: append a setting object parsed from the current file
 **
 ** Returns:     none
 **
 *******************************************************************************/
-void CNxpNfcConfig::add(const CNxpNfcParam* pParam) {
-  if (m_list.size() == 0) {
-    m_list.push_back(pParam);
-    return;
-  }
+void CNxpNfcConfig::add(vector<const CNxpNfcParam*>& parsed,
+                        const CNxpNfcParam* pParam) {
   if ((mCurrentFile.find("nxpTransit") != std::string::npos) &&
       !isAllowed(pParam->c_str())) {
     DLOG_IF(INFO, nfc_debug_enabled)
         << StringPrintf("%s Token restricted. Returning", __func__);
+    delete pParam;
     return;
   }
-  for (list<const CNxpNfcParam*>::iterator it = m_list.begin(),
-                                           itEnd = m_list.end();
-       it != itEnd; ++it) {
-    if (**it < pParam->c_str()) continue;
-    if (**it == pParam->c_str())
-      m_list.insert(m_list.erase(it), pParam);
-    else
-      m_list.insert(it, pParam);
+  parsed.push_back(pParam);
+}
 
-    return;
+/*******************************************************************************
+**
+** Function:    CNxpNfcConfig::merge()
+**
+** Description: sort the settings parsed from one file and merge them into the
+**              setting array in a single pass. Precedence, lowest first:
+**              previously loaded files, then earlier lines of this file, then
+**              later lines of this file.
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNxpNfcConfig::merge(vector<const CNxpNfcParam*>& overlay) {
+  if (overlay.empty()) return;
+
+  auto byName = [](const CNxpNfcParam* a, const CNxpNfcParam* b) {
+    return *a < *b;
+  };
+  // stable sort keeps file order among duplicates; keep the last of each run
+  stable_sort(overlay.begin(), overlay.end(), byName);
+  size_t unique = 0;
+  for (size_t n = 0; n < overlay.size(); ++n) {
+    if (unique > 0 && *overlay[unique - 1] == *overlay[n]) {
+      delete overlay[unique - 1];
+      overlay[unique - 1] = overlay[n];
+    } else {
+      overlay[unique++] = overlay[n];
+    }
+  }
+  overlay.resize(unique);
+
+  vector<const CNxpNfcParam*> merged;
+  merged.reserve(size() + overlay.size());
+  iterator base = begin(), baseEnd = end();
+  for (const CNxpNfcParam* pParam : overlay) {
+    while (base != baseEnd && **base < *pParam) merged.push_back(*base++);
+    if (base != baseEnd && **base == *pParam) delete *base++;
+    merged.push_back(pParam);
   }
-  m_list.push_back(pParam);
+  merged.insert(merged.end(), base, baseEnd);
+  swap(merged);
+  overlay.clear();
 }
+
 /*******************************************************************************
 **
 ** Function:    CNxpNfcConfig::dump()
 **
-** Description: prints all elements in the list
+** Description: prints all elements in the setting array
 **
 ** Returns:     none
 **
@@ -1089,9 +1377,7 @@ void CNxpNfcConfig::add(const CNxpNfcParam* pParam) {
 void CNxpNfcConfig::dump() {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s Enter", __func__);
 
-  for (list<const CNxpNfcParam*>::iterator it = m_list.begin(),
-                                           itEnd = m_list.end();
-       it != itEnd; ++it) {
+  for (const_iterator it = begin(), itEnd = end(); it != itEnd; ++it) {
     if ((*it)->str_len() > 0)
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
           "%s %s \t= %s", __func__, (*it)->c_str(), (*it)->str_value());
@@ -1110,59 +1396,21 @@ void CNxpNfcConfig::dump() {
 **
 *******************************************************************************/
 bool CNxpNfcConfig::isAllowed(const char* name) {
-  string token(name);
   bool stat = false;
-  if ((token.find("P2P_LISTEN_TECH_MASK") != std::string::npos) ||
-      (token.find("HOST_LISTEN_TECH_MASK") != std::string::npos) ||
-      (token.find("UICC_LISTEN_TECH_MASK") != std::string::npos) ||
-      (token.find("NXP_ESE_LISTEN_TECH_MASK") != std::string::npos) ||
-      (token.find("POLLING_TECH_MASK") != std::string::npos) ||
-      (token.find("NXP_RF_CONF_BLK") != std::string::npos) ||
-      (token.find("NXP_CN_TRANSIT_BLK_NUM_CHECK_ENABLE") !=
-       std::string::npos) ||
-      (token.find("NXP_FWD_FUNCTIONALITY_ENABLE") != std::string::npos))
+  if ((strstr(name, "P2P_LISTEN_TECH_MASK") != NULL) ||
+      (strstr(name, "HOST_LISTEN_TECH_MASK") != NULL) ||
+      (strstr(name, "UICC_LISTEN_TECH_MASK") != NULL) ||
+      (strstr(name, "NXP_ESE_LISTEN_TECH_MASK") != NULL) ||
+      (strstr(name, "POLLING_TECH_MASK") != NULL) ||
+      (strstr(name, "NXP_RF_CONF_BLK") != NULL) ||
+      (strstr(name, "NXP_CN_TRANSIT_BLK_NUM_CHECK_ENABLE") != NULL) ||
+      (strstr(name, "NXP_FWD_FUNCTIONALITY_ENABLE") != NULL))
 
   {
     stat = true;
   }
   return stat;
 }
-/*******************************************************************************
-**
-** Function:    CNxpNfcConfig::moveFromList()
-**
-** Description: move the setting object from list to array
-**
-** Returns:     none
-**
-*******************************************************************************/
-void CNxpNfcConfig::moveFromList() {
-  if (m_list.size() == 0) return;
-
-  for (list<const CNxpNfcParam*>::iterator it = m_list.begin(),
-                                           itEnd = m_list.end();
-       it != itEnd; ++it)
-    push_back(*it);
-  m_list.clear();
-}
-
-/*******************************************************************************
-**
-** Function:    CNxpNfcConfig::moveToList()
-**
-** Description: move the setting object from array to list
-**
-** Returns:     none
-**
-*******************************************************************************/
-void CNxpNfcConfig::moveToList() {
-  if (m_list.size() != 0) m_list.clear();
-
-  for (iterator it = begin(), itEnd = end(); it != itEnd; ++it)
-    m_list.push_back(*it);
-  clear();
-}
-
 bool CNxpNfcConfig::isModified() {
   FILE* fd = fopen(config_timestamp_path, "r+");
   if (fd == nullptr) {
@@ -1291,6 +1539,32 @@ CNxpNfcParam::CNxpNfcParam(const char* name, const string& value)
 CNxpNfcParam::CNxpNfcParam(const char* name, unsigned long value)
     : string(name), m_numValue(value) {}
 
+/*******************************************************************************
+**
+** Function:    CNxpNfcParam::CNxpNfcParam()
+**
+** Description: class constructor taking a name that is not NUL-terminated
+**
+** Returns:     none
+**
+*******************************************************************************/
+CNxpNfcParam::CNxpNfcParam(const char* name, size_t nameLen,
+                           const string& value)
+    : string(name, nameLen), m_str_value(value), m_numValue(0) {}
+
+/*******************************************************************************
+**
+** Function:    CNxpNfcParam::CNxpNfcParam()
+**
+** Description: class constructor taking a name that is not NUL-terminated
+**
+** Returns:     none
+**
+*******************************************************************************/
+CNxpNfcParam::CNxpNfcParam(const char* name, size_t nameLen,
+                           unsigned long value)
+    : string(name, nameLen), m_numValue(value) {}
+
 /*******************************************************************************
 **
 ** Function:    readOptionalConfig()
@@ -1301,6 +1575,20 @@ CNxpNfcParam::CNxpNfcParam(const char* name, unsigned long value)
 **
 *******************************************************************************/
 void readOptionalConfig(const char* extra) {
+  CNxpNfcConfig::GetInstance().readConfig(optionalConfigPath(extra).c_str(),
+                                          false);
+}
+
+/*******************************************************************************
+**
+** Function:    optionalConfigPath()
+**
+** Description: resolve the path of an optional conf file
+**
+** Returns:     path of the optional conf file
+**
+*******************************************************************************/
+string optionalConfigPath(const char* extra) {
   string strPath;
   string configName(extra_config_base);
   configName += extra;
@@ -1312,8 +1600,7 @@ void readOptionalConfig(const char* extra) {
   } else {
     findConfigFilePathFromTransportConfigPaths(configName, strPath);
   }
-
-  CNxpNfcConfig::GetInstance().readConfig(strPath.c_str(), false);
+  return strPath;
 }
 
 /*******************************************************************************
@@ -1369,7 +1656,8 @@ int GetNxpNumValue(const char* name, void* pValue, unsigned long len) {
   if (!pValue) return false;
 
   CNxpNfcConfig& rConfig = CNxpNfcConfig::GetInstance();
-  const CNxpNfcParam* pParam = rConfig.find(name);
+  shared_ptr<const CNxpNfcConfigSnapshot> snap = rConfig.snapshot();
+  const CNxpNfcParam* pParam = snap ? snap->find(name) : NULL;
 
   if (pParam == NULL) return false;
 
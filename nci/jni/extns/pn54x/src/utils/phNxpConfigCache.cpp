@@ -0,0 +1,225 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2018 NXP Semiconductors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "phNxpConfigCache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sparse_crc32.h"
+
+namespace {
+
+// magic, version + source count, entry count, payload length, payload CRC32
+// and the three config CRC32 values
+const size_t kHeaderSize = 8 * sizeof(uint32_t);
+
+void putU8(std::string& out, uint8_t v) { out.push_back((char)v); }
+
+void putU16(std::string& out, uint16_t v) {
+  putU8(out, v & 0xFF);
+  putU8(out, v >> 8);
+}
+
+void putU32(std::string& out, uint32_t v) {
+  putU16(out, v & 0xFFFF);
+  putU16(out, v >> 16);
+}
+
+void putU64(std::string& out, uint64_t v) {
+  putU32(out, (uint32_t)v);
+  putU32(out, (uint32_t)(v >> 32));
+}
+
+class Reader {
+ public:
+  Reader(const uint8_t* data, size_t size) : mPos(data), mEnd(data + size) {}
+
+  bool u8(uint8_t& v) {
+    if (mEnd - mPos < 1) return false;
+    v = *mPos++;
+    return true;
+  }
+  bool u16(uint16_t& v) {
+    uint8_t lo, hi;
+    if (!u8(lo) || !u8(hi)) return false;
+    v = lo | (hi << 8);
+    return true;
+  }
+  bool u32(uint32_t& v) {
+    uint16_t lo, hi;
+    if (!u16(lo) || !u16(hi)) return false;
+    v = lo | ((uint32_t)hi << 16);
+    return true;
+  }
+  bool u64(uint64_t& v) {
+    uint32_t lo, hi;
+    if (!u32(lo) || !u32(hi)) return false;
+    v = lo | ((uint64_t)hi << 32);
+    return true;
+  }
+  bool bytes(std::string& v, size_t len) {
+    if ((size_t)(mEnd - mPos) < len) return false;
+    v.assign((const char*)mPos, len);
+    mPos += len;
+    return true;
+  }
+  bool atEnd() const { return mPos == mEnd; }
+
+ private:
+  const uint8_t* mPos;
+  const uint8_t* mEnd;
+};
+
+}  // namespace
+
+/*******************************************************************************
+**
+** Function:    phNxpConfigCache_Write()
+**
+** Description: serialize the config table and replace the cache file
+**
+** Returns:     true if the cache file was written
+**
+*******************************************************************************/
+bool phNxpConfigCache_Write(const char* path,
+                            const phNxpConfigCacheImage& image) {
+  std::string payload;
+  for (const phNxpConfigCacheSource& src : image.sources) {
+    putU32(payload, src.crc32);
+    putU8(payload, src.present ? 1 : 0);
+    putU16(payload, src.path.size());
+    payload += src.path;
+  }
+  for (const phNxpConfigCacheEntry& entry : image.entries) {
+    putU16(payload, entry.name.size());
+    putU8(payload, entry.isString ? 1 : 0);
+    putU64(payload, entry.numValue);
+    putU32(payload, entry.strValue.size());
+    payload += entry.name;
+    payload += entry.strValue;
+  }
+
+  std::string out;
+  out.reserve(kHeaderSize + payload.size());
+  putU32(out, NXP_CONFIG_CACHE_MAGIC);
+  putU16(out, NXP_CONFIG_CACHE_VERSION);
+  putU16(out, image.sources.size());
+  putU32(out, image.entries.size());
+  putU32(out, payload.size());
+  putU32(out, sparse_crc32_fast(0, payload.data(), payload.size()));
+  putU32(out, image.config_crc32);
+  putU32(out, image.config_crc32_rf);
+  putU32(out, image.config_crc32_tr);
+  out += payload;
+
+  // write a sibling file and rename it so readers never see a partial cache
+  std::string tmpPath(path);
+  tmpPath += ".tmp";
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                S_IRUSR | S_IWUSR);
+  if (fd < 0) return false;
+  const char* p = out.data();
+  size_t remaining = out.size();
+  while (remaining > 0) {
+    ssize_t written = write(fd, p, remaining);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) {
+      close(fd);
+      unlink(tmpPath.c_str());
+      return false;
+    }
+    p += written;
+    remaining -= written;
+  }
+  close(fd);
+  if (rename(tmpPath.c_str(), path) != 0) {
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function:    phNxpConfigCache_Read()
+**
+** Description: read and decode the cache file
+**
+** Returns:     true if the cache file is complete and consistent
+**
+*******************************************************************************/
+bool phNxpConfigCache_Read(const char* path, phNxpConfigCacheImage& image) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) ||
+      (size_t)file_stat.st_size < kHeaderSize) {
+    close(fd);
+    return false;
+  }
+  std::vector<uint8_t> data(file_stat.st_size);
+  ssize_t got = read(fd, data.data(), data.size());
+  close(fd);
+  if (got != (ssize_t)data.size()) return false;
+
+  Reader header(data.data(), kHeaderSize);
+  uint32_t magic, entryCount, payloadLen, payloadCrc;
+  uint16_t version, sourceCount;
+  header.u32(magic);
+  header.u16(version);
+  header.u16(sourceCount);
+  header.u32(entryCount);
+  header.u32(payloadLen);
+  header.u32(payloadCrc);
+  header.u32(image.config_crc32);
+  header.u32(image.config_crc32_rf);
+  header.u32(image.config_crc32_tr);
+  if (magic != NXP_CONFIG_CACHE_MAGIC || version != NXP_CONFIG_CACHE_VERSION ||
+      payloadLen != data.size() - kHeaderSize)
+    return false;
+  const uint8_t* payload = data.data() + kHeaderSize;
+  if (sparse_crc32_fast(0, payload, payloadLen) != payloadCrc) return false;
+
+  Reader in(payload, payloadLen);
+  image.sources.assign(sourceCount, phNxpConfigCacheSource());
+  for (phNxpConfigCacheSource& src : image.sources) {
+    uint8_t present;
+    uint16_t pathLen;
+    if (!in.u32(src.crc32) || !in.u8(present) || !in.u16(pathLen) ||
+        !in.bytes(src.path, pathLen))
+      return false;
+    src.present = present != 0;
+  }
+  image.entries.assign(entryCount, phNxpConfigCacheEntry());
+  for (phNxpConfigCacheEntry& entry : image.entries) {
+    uint16_t nameLen;
+    uint8_t isString;
+    uint32_t strLen;
+    if (!in.u16(nameLen) || !in.u8(isString) || !in.u64(entry.numValue) ||
+        !in.u32(strLen) || !in.bytes(entry.name, nameLen) ||
+        !in.bytes(entry.strValue, strLen))
+      return false;
+    entry.isString = isString != 0;
+  }
+  return in.atEnd();
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2018 NXP Semiconductors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Binary cache of the parsed and merged NXP config table.
+ *
+ * Layout (all integers little endian):
+ *   header   magic, version, source count, entry count, payload length,
+ *            payload CRC32 and the three config CRC32 values
+ *   sources  per file: CRC32, present flag, path length, path
+ *   entries  per setting: name length, string flag, numeric value,
+ *            string length, name, string value
+ *
+ * The cache is only trusted when every source file still has the recorded
+ * presence and CRC32, so any edit of a config file falls back to parsing.
+ */
+#ifndef _PHNXPCONFIGCACHE_H_
+#define _PHNXPCONFIGCACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define NXP_CONFIG_CACHE_MAGIC 0x4343584EU /* "NXCC" */
+#define NXP_CONFIG_CACHE_VERSION 1
+
+struct phNxpConfigCacheSource {
+  std::string path;
+  bool present;
+  uint32_t crc32;
+};
+
+struct phNxpConfigCacheEntry {
+  std::string name;
+  bool isString;
+  uint64_t numValue;
+  std::string strValue;
+};
+
+struct phNxpConfigCacheImage {
+  uint32_t config_crc32;
+  uint32_t config_crc32_rf;
+  uint32_t config_crc32_tr;
+  std::vector<phNxpConfigCacheSource> sources;
+  std::vector<phNxpConfigCacheEntry> entries;
+};
+
+/* Serialize |image| and atomically replace the cache file at |path|. */
+bool phNxpConfigCache_Write(const char* path,
+                            const phNxpConfigCacheImage& image);
+
+/* Load the cache file at |path| with a single read and decode it into
+ * |image|. Returns false if the file is missing, truncated, of another
+ * version or fails its payload CRC32. */
+bool phNxpConfigCache_Read(const char* path, phNxpConfigCacheImage& image);
+
+#endif /* _PHNXPCONFIGCACHE_H_ */
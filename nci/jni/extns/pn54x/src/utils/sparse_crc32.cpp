@@ -43,7 +43,20 @@
  */
 
 /* Code taken from FreeBSD 8 */
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+#if defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
 
 static uint32_t crc32_tab[] = {
     0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
@@ -105,3 +118,198 @@ uint32_t sparse_crc32(uint32_t crc_in, const void* buf, size_t size) {
   while (size--) crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
   return crc ^ ~0U;
 }
+
+/*
+ * Faster equivalents of sparse_crc32(). sparse_crc32_fast() picks the best
+ * implementation for the running CPU once and then always uses it:
+ *   - ARMv8 CRC32 instructions (AArch64, HWCAP_CRC32)
+ *   - PCLMULQDQ folding (x86 with SSE4.1 and PCLMUL). The SSE4.2 crc32
+ *     instruction is not usable here, it implements the Castagnoli
+ *     polynomial rather than the IEEE one used by this file.
+ *   - slice-by-8 tables everywhere else
+ */
+
+typedef uint32_t (*crc32_impl_t)(uint32_t crc, const uint8_t* p, size_t size);
+
+/* All implementations below work on the inverted CRC register. */
+static uint32_t crc32_bytes(uint32_t crc, const uint8_t* p, size_t size) {
+  while (size--) crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+static uint32_t crc32_slice8_tab[8][256];
+
+static void crc32_slice8_init(void) {
+  for (int n = 0; n < 256; n++) crc32_slice8_tab[0][n] = crc32_tab[n];
+  for (int k = 1; k < 8; k++) {
+    for (int n = 0; n < 256; n++) {
+      uint32_t c = crc32_slice8_tab[k - 1][n];
+      crc32_slice8_tab[k][n] = crc32_tab[c & 0xFF] ^ (c >> 8);
+    }
+  }
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t* p, size_t size) {
+  const uint32_t(*t)[256] = crc32_slice8_tab;
+
+  while (size > 0 && ((uintptr_t)p & 7) != 0) {
+    crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    size--;
+  }
+  while (size >= 8) {
+    uint32_t lo, hi;
+    memcpy(&lo, p, sizeof(lo));
+    memcpy(&hi, p + 4, sizeof(hi));
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+          t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    p += 8;
+    size -= 8;
+  }
+  return crc32_bytes(crc, p, size);
+}
+#endif
+
+#if defined(__aarch64__)
+__attribute__((target("crc"))) static uint32_t crc32_armv8(uint32_t crc,
+                                                           const uint8_t* p,
+                                                           size_t size) {
+  while (size > 0 && ((uintptr_t)p & 7) != 0) {
+    crc = __crc32b(crc, *p++);
+    size--;
+  }
+  while (size >= 8) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    crc = __crc32d(crc, v);
+    p += 8;
+    size -= 8;
+  }
+  while (size--) crc = __crc32b(crc, *p++);
+  return crc;
+}
+#elif defined(__x86_64__) || defined(__i386__)
+/*
+ * Folding constants for the reflected IEEE polynomial, from "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Intel).
+ */
+alignas(16) static const uint64_t crc32_k1k2[] = {0x0154442bd4, 0x01c6e41596};
+alignas(16) static const uint64_t crc32_k3k4[] = {0x01751997d0, 0x00ccaa009e};
+alignas(16) static const uint64_t crc32_k5k0[] = {0x0163cd6124, 0x0000000000};
+alignas(16) static const uint64_t crc32_poly[] = {0x01db710641, 0x01f7011641};
+
+/* Folds the largest multiple of 16 bytes, at least 64, of |p|. */
+__attribute__((target("sse4.1,pclmul"))) static uint32_t crc32_pclmul_fold(
+    uint32_t crc, const uint8_t* p, size_t size) {
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+  x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+  x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+  x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+  x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+  x0 = _mm_load_si128((const __m128i*)crc32_k1k2);
+  p += 64;
+  size -= 64;
+
+  /* fold 4 x 128 bits in parallel */
+  while (size >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    y5 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+    y6 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+    y7 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+    y8 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+    p += 64;
+    size -= 64;
+  }
+
+  /* fold into 128 bits */
+  x0 = _mm_load_si128((const __m128i*)crc32_k3k4);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  /* fold the remaining 128-bit blocks */
+  while (size >= 16) {
+    x2 = _mm_loadu_si128((const __m128i*)p);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    p += 16;
+    size -= 16;
+  }
+
+  /* fold 128 bits to 64 bits */
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_srli_si128(x1, 8);
+  x1 = _mm_xor_si128(x1, x2);
+  x0 = _mm_loadl_epi64((const __m128i*)crc32_k5k0);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /* Barrett reduction to 32 bits */
+  x0 = _mm_load_si128((const __m128i*)crc32_poly);
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return _mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t* p, size_t size) {
+  if (size >= 64) {
+    size_t chunk = size & ~(size_t)15;
+    crc = crc32_pclmul_fold(crc, p, chunk);
+    p += chunk;
+    size -= chunk;
+  }
+  return crc32_slice8(crc, p, size);
+}
+#endif
+
+static crc32_impl_t crc32_select_impl(void) {
+#if defined(__aarch64__)
+  if (getauxval(AT_HWCAP) & HWCAP_CRC32) return crc32_armv8;
+#endif
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+  crc32_slice8_init();
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) &&
+      (ecx & bit_SSE4_1))
+    return crc32_pclmul;
+#endif
+  return crc32_slice8;
+#else
+  return crc32_bytes;
+#endif
+}
+
+uint32_t sparse_crc32_fast(uint32_t crc_in, const void* buf, size_t size) {
+  static const crc32_impl_t impl = crc32_select_impl();
+
+  return impl(crc_in ^ ~0U, (const uint8_t*)buf, size) ^ ~0U;
+}
@@ -17,8 +17,14 @@
 #ifndef _LIBSPARSE_SPARSE_CRC32_H_
 #define _LIBSPARSE_SPARSE_CRC32_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
+/* Byte-at-a-time reference implementation. */
 uint32_t sparse_crc32(uint32_t crc, const void* buf, size_t size);
 
+/* Same CRC-32 as sparse_crc32(), computed with the CPU CRC32/carry-less
+ * multiply instructions when available, slice-by-8 tables otherwise. */
+uint32_t sparse_crc32_fast(uint32_t crc, const void* buf, size_t size);
+
 #endif
@@ -64,6 +64,22 @@ public class NativeLlcpSocket implements DeviceHost.LlcpSocket {
         }
     }
 
+    private native boolean doSendQueued(byte[] data, int maxChunk);
+    @Override
+    public void sendQueued(byte[] data, int maxChunk) throws IOException {
+        if (!doSendQueued(data, maxChunk)) {
+            throw new IOException();
+        }
+    }
+
+    private native boolean doFlush();
+    @Override
+    public void flush() throws IOException {
+        if (!doFlush()) {
+            throw new IOException();
+        }
+    }
+
     private native int doReceive(byte[] recvBuff);
     @Override
     public int receive(byte[] recvBuff) throws IOException {
@@ -74,6 +90,16 @@ public class NativeLlcpSocket implements DeviceHost.LlcpSocket {
         return receiveLength;
     }
 
+    private native int doReceiveBatch(byte[] recvBuff, int[] sduLengths);
+    @Override
+    public int receiveBatch(byte[] recvBuff, int[] sduLengths) throws IOException {
+        int sduCount = doReceiveBatch(recvBuff, sduLengths);
+        if (sduCount == -1) {
+            throw new IOException();
+        }
+        return sduCount;
+    }
+
     private native int doGetRemoteSocketMiu();
     @Override
     public int getRemoteMiu() { return doGetRemoteSocketMiu(); }
@@ -142,6 +142,13 @@ public class NativeNfcManager implements DeviceHost {
     @Override
     public native boolean sendRawFrame(byte[] data);
 
+    @Override
+    public native boolean setHceStaticResponse(int owner, byte[] aid, byte[] command,
+            byte[] mask, byte[] response);
+
+    @Override
+    public native void clearHceStaticResponses(int owner);
+
     public native boolean doClearRoutingEntry(int type );
 
     @Override
@@ -158,6 +165,9 @@ public class NativeNfcManager implements DeviceHost {
     @Override
     public native boolean routeAid(byte[] aid, int route, int aidInfo, int powerState);
 
+    @Override
+    public native boolean routeAids(byte[] aidTable, int count);
+
 
     @Override
     public native boolean unrouteAid(byte[] aid);
@@ -576,6 +586,10 @@ public class NativeNfcManager implements DeviceHost {
         mListener.onHostCardEmulationData(technology, data);
     }
 
+    private void notifyHostEmuReplay(int technology, byte[] data) {
+        mListener.onHostCardEmulationReplay(technology, data);
+    }
+
     private void notifyHostEmuDeactivated(int technology) {
         mListener.onHostCardEmulationDeactivated(technology);
     }
@@ -81,5 +81,13 @@ public class NativeNfcSecureElement {
     private native byte[] doNativeGetAtr(int handle);
     private native boolean doNativeResetSecureElement(int handle);
     public native byte[] doTransceive(int handle, byte[] data);
+    /**
+     * Sends a script of APDUs in one call. Each command is a 2-byte big-endian
+     * length, the APDU, then a 2-byte expected SW and a 2-byte SW mask (0 to
+     * accept any SW). Returns one 2-byte length + response record per
+     * command, or null if a command failed or its SW did not match, in which
+     * case the rest of the script was not sent.
+     */
+    public native byte[] doTransceiveScript(int handle, byte[] script);
 
 }
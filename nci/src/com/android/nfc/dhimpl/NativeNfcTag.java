@@ -35,6 +35,8 @@ import android.nfc.tech.TagTechnology;
 import android.os.Bundle;
 import android.util.Log;
 
+import java.util.Arrays;
+
 /**
  * Native interface to the NFC tag functions
  */
@@ -51,6 +53,11 @@ public class NativeNfcTag implements TagEndpoint {
     private byte[][] mTechActBytes;
     private byte[] mUid;
 
+    // Tag data packed by NfcTag::buildTagDescriptor(); decoded into the
+    // fields above on first use, then dropped
+    private byte[] mDescriptor;
+    private static final int DESCRIPTOR_VERSION = 1;
+
     // mConnectedHandle stores the *real* libnfc handle
     // that we're connected to.
     private int mConnectedHandle;
@@ -149,8 +156,61 @@ public class NativeNfcTag implements TagEndpoint {
         }
     }
 
+    private synchronized void decodeDescriptor() {
+        byte[] d = mDescriptor;
+        if (d == null) return;
+        mDescriptor = null;
+        if (!isValidDescriptor(d)) {
+            Log.e(TAG, "Malformed tag descriptor");
+            d = new byte[] {DESCRIPTOR_VERSION, 0, 0};
+        }
+        int pos = 1;
+        int count = d[pos++] & 0xFF;
+        int len = d[pos++] & 0xFF;
+        mUid = Arrays.copyOfRange(d, pos, pos + len);
+        pos += len;
+        mTechList = new int[count];
+        mTechHandles = new int[count];
+        mTechLibNfcTypes = new int[count];
+        mTechPollBytes = new byte[count][];
+        mTechActBytes = new byte[count][];
+        for (int i = 0; i < count; i++) {
+            mTechList[i] = d[pos++] & 0xFF;
+            mTechHandles[i] = d[pos++] & 0xFF;
+            mTechLibNfcTypes[i] = d[pos++] & 0xFF;
+            len = d[pos++] & 0xFF;
+            mTechPollBytes[i] = Arrays.copyOfRange(d, pos, pos + len);
+            pos += len;
+            len = d[pos++] & 0xFF;
+            mTechActBytes[i] = Arrays.copyOfRange(d, pos, pos + len);
+            pos += len;
+        }
+    }
+
+    /**
+     * Walks the descriptor without decoding it; true if it has a known
+     * version and every length stays within the array.
+     */
+    private static boolean isValidDescriptor(byte[] d) {
+        if (d.length < 3 || d[0] != DESCRIPTOR_VERSION) return false;
+        int count = d[1] & 0xFF;
+        int pos = 3 + (d[2] & 0xFF);
+        for (int i = 0; i < count; i++) {
+            // tech, handle, type and the poll length
+            pos += 4;
+            if (pos > d.length) return false;
+            pos += d[pos - 1] & 0xFF;
+            // the activation length
+            pos += 1;
+            if (pos > d.length) return false;
+            pos += d[pos - 1] & 0xFF;
+        }
+        return pos == d.length;
+    }
+
     private native int doConnect(int handle);
     public synchronized int connectWithStatus(int technology) {
+        decodeDescriptor();
         if (mWatchdog != null) {
             mWatchdog.pause();
         }
@@ -418,6 +478,7 @@ public class NativeNfcTag implements TagEndpoint {
     native boolean doIsIsoDepNdefFormatable(byte[] poll, byte[] act);
     @Override
     public synchronized boolean isNdefFormatable() {
+        decodeDescriptor();
         // Let native code decide whether the currently activated tag
         // is formatable.  Although the name of the JNI function refers
         // to ISO-DEP, the JNI function checks all tag types.
@@ -427,6 +488,7 @@ public class NativeNfcTag implements TagEndpoint {
 
     @Override
     public int getHandle() {
+        decodeDescriptor();
         // This is just a handle for the clients; it can simply use the first
         // technology handle we have.
         if (mTechHandles.length > 0) {
@@ -438,11 +500,13 @@ public class NativeNfcTag implements TagEndpoint {
 
     @Override
     public byte[] getUid() {
+        decodeDescriptor();
         return mUid;
     }
 
     @Override
     public int[] getTechList() {
+        decodeDescriptor();
         return mTechList;
     }
 
@@ -451,6 +515,7 @@ public class NativeNfcTag implements TagEndpoint {
     }
 
     private int getConnectedLibNfcType() {
+        decodeDescriptor();
         if (mConnectedTechIndex != -1 && mConnectedTechIndex < mTechLibNfcTypes.length) {
             return mTechLibNfcTypes[mConnectedTechIndex];
         } else {
@@ -460,6 +525,7 @@ public class NativeNfcTag implements TagEndpoint {
 
     @Override
     public int getConnectedTechnology() {
+        decodeDescriptor();
         if (mConnectedTechIndex != -1 && mConnectedTechIndex < mTechList.length) {
             return mTechList[mConnectedTechIndex];
         } else {
@@ -472,6 +538,7 @@ public class NativeNfcTag implements TagEndpoint {
     }
 
     private void addTechnology(int tech, int handle, int libnfctype) {
+        decodeDescriptor();
             int[] mNewTechList = new int[mTechList.length + 1];
             System.arraycopy(mTechList, 0, mNewTechList, 0, mTechList.length);
             mNewTechList[mTechList.length] = tech;
@@ -569,6 +636,7 @@ public class NativeNfcTag implements TagEndpoint {
     }
 
     private int getTechIndex(int tech) {
+      decodeDescriptor();
       int techIndex = -1;
       for (int i = 0; i < mTechList.length; i++) {
           if (mTechList[i] == tech) {
@@ -580,6 +648,7 @@ public class NativeNfcTag implements TagEndpoint {
     }
 
     private boolean hasTech(int tech) {
+      decodeDescriptor();
       boolean hasTech = false;
       for (int i = 0; i < mTechList.length; i++) {
           if (mTechList[i] == tech) {
@@ -591,6 +660,7 @@ public class NativeNfcTag implements TagEndpoint {
     }
 
     private boolean hasTechOnHandle(int tech, int handle) {
+      decodeDescriptor();
       boolean hasTech = false;
       for (int i = 0; i < mTechList.length; i++) {
           if (mTechList[i] == tech && mTechHandles[i] == handle) {
@@ -657,6 +727,7 @@ public class NativeNfcTag implements TagEndpoint {
 
     @Override
     public Bundle[] getTechExtras() {
+        decodeDescriptor();
         synchronized (this) {
             if (mTechExtras != null) return mTechExtras;
             mTechExtras = new Bundle[mTechList.length];
@@ -761,6 +832,7 @@ public class NativeNfcTag implements TagEndpoint {
 
     @Override
     public NdefMessage findAndReadNdef() {
+        decodeDescriptor();
         // Try to find NDEF on any of the technologies.
         int[] technologies = getTechList();
         int[] handles = mTechHandles;
@@ -0,0 +1,133 @@
+LOCAL_PATH := $(call my-dir)
+NQNFC_JNI := ../../jni
+NQNFC_VOB := vendor/nxp/opensource/commonsys/external/libnfc-nci/src
+
+NQNFC_TEST_INCLUDES := \
+    $(LOCAL_PATH)/$(NQNFC_JNI) \
+    libnativehelper/include/nativehelper \
+    $(NQNFC_VOB)/include \
+    $(NQNFC_VOB)/nfa/include \
+    $(NQNFC_VOB)/nfc/include \
+    $(NQNFC_VOB)/gki/ulinux \
+    $(NQNFC_VOB)/gki/common
+
+NQNFC_TEST_LIBS := \
+    libbase \
+    libchrome \
+    libnativehelper
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_dataqueue_test
+LOCAL_SRC_FILES := DataQueue_test.cpp $(NQNFC_JNI)/Mutex.cpp
+LOCAL_C_INCLUDES := $(NQNFC_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NQNFC_TEST_LIBS)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_dataqueue_benchmark
+LOCAL_SRC_FILES := DataQueue_benchmark.cpp $(NQNFC_JNI)/Mutex.cpp
+LOCAL_C_INCLUDES := $(NQNFC_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NQNFC_TEST_LIBS)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_BENCHMARK)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_timer_test
+LOCAL_SRC_FILES := IntervalTimer_test.cpp
+LOCAL_C_INCLUDES := $(NQNFC_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NQNFC_TEST_LIBS)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_timer_benchmark
+LOCAL_SRC_FILES := IntervalTimer_benchmark.cpp
+LOCAL_C_INCLUDES := $(NQNFC_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NQNFC_TEST_LIBS)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_NATIVE_BENCHMARK)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_p2p_test
+LOCAL_SRC_FILES := PeerToPeer_test.cpp SimulatedLlcp.cpp
+LOCAL_C_INCLUDES := $(NQNFC_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NQNFC_TEST_LIBS) libutils libnqnfc-nci \
+    libnqnfc_nci_jni
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+ifeq (true,$(TARGET_IS_64_BIT))
+LOCAL_MULTILIB := 64
+else
+LOCAL_MULTILIB := 32
+endif
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_p2p_benchmark
+LOCAL_SRC_FILES := PeerToPeer_benchmark.cpp SimulatedLlcp.cpp
+LOCAL_C_INCLUDES := $(NQNFC_TEST_INCLUDES)
+LOCAL_SHARED_LIBRARIES := $(NQNFC_TEST_LIBS) libutils libnqnfc-nci \
+    libnqnfc_nci_jni
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+ifeq (true,$(TARGET_IS_64_BIT))
+LOCAL_MULTILIB := 64
+else
+LOCAL_MULTILIB := 32
+endif
+include $(BUILD_NATIVE_BENCHMARK)
+
+# LmrtPlanner works on plain data only, so it is tested on the host
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_lmrtplanner_test
+LOCAL_SRC_FILES := LmrtPlanner_test.cpp $(NQNFC_JNI)/LmrtPlanner.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/$(NQNFC_JNI)
+LOCAL_SHARED_LIBRARIES := libbase libchrome
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter -Werror
+include $(BUILD_HOST_NATIVE_TEST)
+
+# The MIFARE Classic extension is built into these from source, with
+# SimulatedMifareClassic in place of the NFCC and the NFA calls below it.
+# No -Werror: the extension sources are built without it in the library too.
+NQNFC_EXTNS := $(NQNFC_JNI)/extns/pn54x
+NQNFC_MIFARE_SRC := \
+    SimulatedMifareClassic.cpp \
+    $(NQNFC_EXTNS)/src/phNxpExtns.cpp \
+    $(NQNFC_EXTNS)/src/mifare/phFriNfc_MifareStdMap.cpp \
+    $(NQNFC_EXTNS)/src/mifare/phFriNfc_MifareStdTimer.cpp \
+    $(NQNFC_EXTNS)/src/mifare/phFriNfc_MifStdFormat.cpp \
+    $(NQNFC_EXTNS)/src/mifare/phFriNfc_SmtCrdFmt.cpp \
+    $(NQNFC_EXTNS)/src/mifare/phNxpExtns_MifareStd.cpp \
+    $(NQNFC_JNI)/IntervalTimer.cpp
+
+NQNFC_MIFARE_INCLUDES := \
+    $(LOCAL_PATH)/$(NQNFC_JNI) \
+    $(LOCAL_PATH)/$(NQNFC_EXTNS)/inc \
+    $(LOCAL_PATH)/$(NQNFC_EXTNS)/src/common \
+    $(LOCAL_PATH)/$(NQNFC_EXTNS)/src/log \
+    $(LOCAL_PATH)/$(NQNFC_EXTNS)/src/mifare \
+    $(LOCAL_PATH)/$(NQNFC_EXTNS)/src/utils \
+    $(NQNFC_VOB)/include \
+    $(NQNFC_VOB)/nfa/include \
+    $(NQNFC_VOB)/nfc/include \
+    $(NQNFC_VOB)/gki/ulinux \
+    $(NQNFC_VOB)/gki/common
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_mifare_test
+LOCAL_SRC_FILES := MifareClassic_test.cpp $(NQNFC_MIFARE_SRC)
+LOCAL_C_INCLUDES := $(NQNFC_MIFARE_INCLUDES)
+LOCAL_SHARED_LIBRARIES := libbase libchrome liblog
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := nqnfc_mifare_benchmark
+LOCAL_SRC_FILES := MifareClassic_benchmark.cpp $(NQNFC_MIFARE_SRC)
+LOCAL_C_INCLUDES := $(NQNFC_MIFARE_INCLUDES)
+LOCAL_SHARED_LIBRARIES := libbase libchrome liblog
+LOCAL_CFLAGS += -DNXP_EXTNS=TRUE
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter
+include $(BUILD_NATIVE_BENCHMARK)
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <thread>
+#include <vector>
+
+#include "DataQueue.cpp"
+
+namespace {
+
+// one thread enqueues and dequeues: the cost of a record round trip
+void BM_EnqueueDequeue(benchmark::State& state) {
+  DataQueue q;
+  std::vector<uint8_t> in(state.range(0), 0x5A);
+  std::vector<uint8_t> out(in.size());
+  uint16_t len = 0;
+  for (auto _ : state) {
+    q.enqueue(in.data(), in.size());
+    q.dequeue(out.data(), out.size(), len);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * in.size());
+}
+BENCHMARK(BM_EnqueueDequeue)->Arg(2)->Arg(64)->Arg(1024)->Arg(8188);
+
+// producer threads fill the queue while the benchmark thread drains it, as
+// the SPI signal handler and its event thread do; the queue holds every
+// record so this measures contention rather than the drop path
+void BM_ProducerConsumer(benchmark::State& state) {
+  const int producers = state.range(0);
+  const int kRecords = 10000;
+  uint8_t out[2];
+  uint16_t len = 0;
+  int64_t delivered = 0;
+  int64_t offered = 0;
+  for (auto _ : state) {
+    DataQueue q(producers * kRecords * 8);
+    std::atomic<int> running(producers);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+      threads.emplace_back([&] {
+        uint8_t rec[2] = {0x12, 0x34};
+        for (int i = 0; i < kRecords; i++) q.enqueue(rec, sizeof(rec));
+        running--;
+      });
+    }
+    while (running > 0 || !q.isEmpty()) {
+      if (q.dequeue(out, sizeof(out), len)) delivered++;
+    }
+    for (auto& t : threads) t.join();
+    offered += producers * kRecords;
+  }
+  state.SetItemsProcessed(delivered);
+  state.counters["delivered"] =
+      benchmark::Counter((double)delivered / offered);
+}
+BENCHMARK(BM_ProducerConsumer)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "DataQueue.cpp"
+
+class DataQueuePeer {
+ public:
+  static uint32_t dropped(DataQueue& q) { return q.mDropped.load(); }
+  static uint32_t oversized(DataQueue& q) { return q.mOversized.load(); }
+  static size_t capacity(DataQueue& q) { return q.mCapacity; }
+};
+
+namespace {
+
+TEST(DataQueueTest, RoundTrip) {
+  DataQueue q;
+  uint8_t in[3] = {1, 2, 3};
+  uint8_t out[8];
+  uint16_t len = 0;
+  EXPECT_TRUE(q.isEmpty());
+  ASSERT_TRUE(q.enqueue(in, sizeof(in)));
+  EXPECT_FALSE(q.isEmpty());
+  ASSERT_TRUE(q.dequeue(out, sizeof(out), len));
+  EXPECT_EQ(sizeof(in), len);
+  EXPECT_EQ(0, memcmp(in, out, len));
+  EXPECT_TRUE(q.isEmpty());
+  EXPECT_FALSE(q.dequeue(out, sizeof(out), len));
+}
+
+TEST(DataQueueTest, SplitsRecordAcrossSmallBuffers) {
+  DataQueue q;
+  uint8_t in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  uint8_t out[4];
+  uint16_t len = 0;
+  ASSERT_TRUE(q.enqueue(in, sizeof(in)));
+  std::vector<uint8_t> got;
+  while (q.dequeue(out, sizeof(out), len))
+    got.insert(got.end(), out, out + len);
+  EXPECT_EQ(std::vector<uint8_t>(in, in + sizeof(in)), got);
+}
+
+TEST(DataQueueTest, RecordFillingWholeQueueIsAccepted) {
+  DataQueue q(64);
+  std::vector<uint8_t> in(DataQueuePeer::capacity(q) - sizeof(uint32_t), 0xA5);
+  std::vector<uint8_t> out(in.size());
+  uint16_t len = 0;
+  ASSERT_TRUE(q.enqueue(in.data(), in.size()));
+  ASSERT_TRUE(q.dequeue(out.data(), out.size(), len));
+  EXPECT_EQ(in, out);
+}
+
+TEST(DataQueueTest, OversizedRecordIsRejectedAndReported) {
+  DataQueue q(64);
+  std::vector<uint8_t> big(DataQueuePeer::capacity(q), 0x5A);
+  uint8_t small[2] = {0xAB, 0xCD};
+  uint8_t out[2];
+  uint16_t len = 0;
+  EXPECT_FALSE(q.enqueue(big.data(), big.size()));
+  EXPECT_EQ(1u, DataQueuePeer::oversized(q));
+  EXPECT_EQ(0u, DataQueuePeer::dropped(q));
+  EXPECT_TRUE(q.isEmpty());
+
+  // the rejected record leaves no trace in the ring
+  ASSERT_TRUE(q.enqueue(small, sizeof(small)));
+  ASSERT_TRUE(q.dequeue(out, sizeof(out), len));
+  EXPECT_EQ(0, memcmp(small, out, sizeof(small)));
+  EXPECT_EQ(0u, DataQueuePeer::oversized(q));
+}
+
+TEST(DataQueueTest, DefaultQueueRejectsRecordsOverItsCapacity) {
+  DataQueue q;
+  std::vector<uint8_t> big(DataQueuePeer::capacity(q) + 1, 0);
+  EXPECT_FALSE(q.enqueue(big.data(), big.size()));
+  EXPECT_EQ(1u, DataQueuePeer::oversized(q));
+}
+
+TEST(DataQueueTest, FullQueueCountsDrops) {
+  DataQueue q(64);
+  uint8_t in[12] = {0};
+  int accepted = 0;
+  for (int i = 0; i < 8; i++) accepted += q.enqueue(in, sizeof(in));
+  EXPECT_EQ(4, accepted);
+  EXPECT_EQ(4u, DataQueuePeer::dropped(q));
+  EXPECT_EQ(0u, DataQueuePeer::oversized(q));
+}
+
+TEST(DataQueueTest, ConcurrentProducersLoseNothingButDrops) {
+  const int kProducers = 4;
+  const uint16_t kPerProducer = 20000;
+  DataQueue q(1024);
+  std::vector<uint32_t> received(kProducers, 0);
+  std::vector<uint16_t> last(kProducers, 0);
+  std::atomic<int> accepted(0);
+  std::atomic<int> running(kProducers);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&, p] {
+      for (uint16_t i = 1; i <= kPerProducer; i++) {
+        uint8_t rec[3] = {(uint8_t)p, (uint8_t)(i >> 8), (uint8_t)i};
+        if (q.enqueue(rec, sizeof(rec))) accepted++;
+      }
+      running--;
+    });
+  }
+
+  uint8_t out[3];
+  uint16_t len = 0;
+  while (running > 0 || !q.isEmpty()) {
+    if (!q.dequeue(out, sizeof(out), len)) continue;
+    ASSERT_EQ(3, len);
+    ASSERT_LT(out[0], kProducers);
+    uint16_t seq = (out[1] << 8) | out[2];
+    // each producer's records come out in order
+    ASSERT_GT(seq, last[out[0]]);
+    last[out[0]] = seq;
+    received[out[0]]++;
+  }
+  for (auto& t : producers) t.join();
+
+  uint32_t total = 0;
+  for (uint32_t r : received) total += r;
+  EXPECT_EQ((uint32_t)accepted.load(), total);
+}
+
+}  // namespace
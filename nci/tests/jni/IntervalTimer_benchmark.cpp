@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "IntervalTimer.cpp"
+
+namespace {
+
+void noopCallback(union sigval) {}
+
+// arming and disarming with n other timers spread over the wheel: the cost
+// every guard timer pays on the NFC paths
+void BM_SetKill(benchmark::State& state) {
+  std::vector<IntervalTimer> background(state.range(0));
+  for (size_t i = 0; i < background.size(); i++)
+    background[i].set(1000 + i * 97 % 60000, noopCallback);
+  IntervalTimer timer;
+  int ms = 1;
+  for (auto _ : state) {
+    timer.set(ms, noopCallback);
+    timer.kill();
+    ms = ms * 7 % 5000 + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetKill)->Arg(0)->Arg(64)->Arg(4096);
+
+// re-arming a running timer, as presence-check and guard timers do
+void BM_Rearm(benchmark::State& state) {
+  IntervalTimer timer;
+  for (auto _ : state) timer.set(1000, noopCallback);
+  timer.kill();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Rearm);
+
+std::mutex gLock;
+std::condition_variable gCond;
+int gFired;
+
+void signalCallback(union sigval) {
+  std::lock_guard<std::mutex> lock(gLock);
+  gFired++;
+  gCond.notify_one();
+}
+
+// from set() to the callback running on a worker, for n timers expiring
+// together; reports how late the last callback ran
+void BM_ExpiryToCallback(benchmark::State& state) {
+  const int n = state.range(0);
+  const int kDelayMs = 2;
+  std::vector<IntervalTimer> timers(n);
+  double lateMs = 0;
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lock(gLock);
+      gFired = 0;
+    }
+    for (auto& t : timers) t.set(kDelayMs, signalCallback);
+    std::unique_lock<std::mutex> lock(gLock);
+    gCond.wait(lock, [n] { return gFired == n; });
+    lateMs += std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count() -
+              kDelayMs;
+  }
+  state.counters["late_ms"] = lateMs / state.iterations();
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_ExpiryToCallback)->Arg(1)->Arg(16)->Arg(256)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
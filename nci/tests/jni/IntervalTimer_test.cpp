@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "IntervalTimer.cpp"
+
+class TimerWheelPeer {
+ public:
+  static int maxWorkers() { return TimerWheel::kMaxWorkers; }
+  static int workers() {
+    TimerWheel& wheel = TimerWheel::getInstance();
+    std::lock_guard<std::mutex> lock(wheel.mMutex);
+    return wheel.mWorkers;
+  }
+};
+
+namespace {
+
+const int kNumTimers = 40;
+IntervalTimer gTimers[kNumTimers];
+std::atomic<int> gFired[kNumTimers];
+
+int indexOf(union sigval value) {
+  return static_cast<IntervalTimer*>(value.sival_ptr) - gTimers;
+}
+
+void countCallback(union sigval value) { gFired[indexOf(value)]++; }
+
+// callbacks that block until released, like those waiting on an NFA event
+std::mutex gGateLock;
+std::condition_variable gGateCond;
+bool gGateOpen;
+std::atomic<int> gBlocked;
+std::atomic<int> gMaxBlocked;
+
+void blockingCallback(union sigval value) {
+  int blocked = ++gBlocked;
+  int peak = gMaxBlocked;
+  while (blocked > peak && !gMaxBlocked.compare_exchange_weak(peak, blocked))
+    ;
+  {
+    std::unique_lock<std::mutex> lock(gGateLock);
+    gGateCond.wait(lock, [] { return gGateOpen; });
+  }
+  gBlocked--;
+  countCallback(value);
+}
+
+bool waitFor(std::function<bool()> done, int ms) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  while (!done()) {
+    if (std::chrono::steady_clock::now() > end) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+class IntervalTimerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    for (int i = 0; i < kNumTimers; i++) {
+      gTimers[i].kill();
+      gFired[i] = 0;
+    }
+    gGateOpen = false;
+    gBlocked = 0;
+    gMaxBlocked = 0;
+  }
+  void TearDown() override {
+    {
+      std::lock_guard<std::mutex> lock(gGateLock);
+      gGateOpen = true;
+    }
+    gGateCond.notify_all();
+    for (int i = 0; i < kNumTimers; i++) gTimers[i].kill();
+    // let released callbacks finish before the next test closes the gate
+    EXPECT_TRUE(waitFor([] { return gBlocked == 0; }, 2000));
+  }
+};
+
+TEST_F(IntervalTimerTest, FiresOnceNotEarly) {
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(gTimers[0].set(20, countCallback));
+  EXPECT_TRUE(gTimers[0].isRunning());
+  ASSERT_TRUE(waitFor([] { return gFired[0] == 1; }, 1000));
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(20));
+  EXPECT_FALSE(gTimers[0].isRunning());
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(1, gFired[0]);
+}
+
+TEST_F(IntervalTimerTest, SetZeroDisarms) {
+  ASSERT_TRUE(gTimers[0].set(30, countCallback));
+  ASSERT_TRUE(gTimers[0].set(0, countCallback));
+  EXPECT_FALSE(gTimers[0].isRunning());
+
+  // a timer that was never armed does not fire either
+  ASSERT_TRUE(gTimers[1].set(0, countCallback));
+  EXPECT_FALSE(gTimers[1].isRunning());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(80));
+  EXPECT_EQ(0, gFired[0]);
+  EXPECT_EQ(0, gFired[1]);
+
+  // and it can be armed again afterwards
+  ASSERT_TRUE(gTimers[0].set(1, countCallback));
+  EXPECT_TRUE(waitFor([] { return gFired[0] == 1; }, 1000));
+}
+
+TEST_F(IntervalTimerTest, RejectsNegativeIntervalAndNullCallback) {
+  EXPECT_FALSE(gTimers[0].set(-1, countCallback));
+  EXPECT_FALSE(gTimers[0].set(10, NULL));
+  EXPECT_FALSE(gTimers[0].isRunning());
+}
+
+TEST_F(IntervalTimerTest, KillAndRearm) {
+  ASSERT_TRUE(gTimers[0].set(20, countCallback));
+  gTimers[0].kill();
+  ASSERT_TRUE(gTimers[1].set(500, countCallback));
+  ASSERT_TRUE(gTimers[1].set(5, countCallback));
+  ASSERT_TRUE(waitFor([] { return gFired[1] == 1; }, 1000));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(0, gFired[0]);
+  EXPECT_EQ(1, gFired[1]);
+}
+
+TEST_F(IntervalTimerTest, FarTimerCascadesDown) {
+  // beyond level 0, so it is placed in level 1 and cascaded
+  ASSERT_TRUE(gTimers[0].set(300, countCallback));
+  ASSERT_TRUE(gTimers[1].set(10, countCallback));
+  ASSERT_TRUE(waitFor([] { return gFired[1] == 1; }, 1000));
+  EXPECT_EQ(0, gFired[0]);
+  ASSERT_TRUE(waitFor([] { return gFired[0] == 1; }, 2000));
+}
+
+TEST_F(IntervalTimerTest, BlockedCallbackDoesNotDelayOthers) {
+  ASSERT_TRUE(gTimers[0].set(1, blockingCallback));
+  ASSERT_TRUE(waitFor([] { return gBlocked == 1; }, 1000));
+  ASSERT_TRUE(gTimers[1].set(1, countCallback));
+  EXPECT_TRUE(waitFor([] { return gFired[1] == 1; }, 1000));
+}
+
+TEST_F(IntervalTimerTest, WorkerCountIsCapped) {
+  const int cap = TimerWheelPeer::maxWorkers();
+  ASSERT_LT(cap, kNumTimers);
+  for (int i = 0; i < kNumTimers; i++)
+    ASSERT_TRUE(gTimers[i].set(1, blockingCallback));
+
+  // every worker ends up blocked and the rest of the expiries queue
+  ASSERT_TRUE(waitFor([cap] { return gBlocked == cap; }, 2000));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(cap, gMaxBlocked);
+  EXPECT_LE(TimerWheelPeer::workers(), cap);
+
+  {
+    std::lock_guard<std::mutex> lock(gGateLock);
+    gGateOpen = true;
+  }
+  gGateCond.notify_all();
+  ASSERT_TRUE(waitFor(
+      [] {
+        for (int i = 0; i < kNumTimers; i++)
+          if (gFired[i] != 1) return false;
+        return true;
+      },
+      2000));
+}
+
+}  // namespace
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "LmrtPlanner.h"
+
+bool nfc_debug_enabled = false;
+
+namespace {
+
+// AID_MATCHING_ modes, see AidRoutingManager.java
+const int EXACT_ONLY = 0x00;
+const int EXACT_OR_PREFIX = 0x01;
+const int PREFIX_ONLY = 0x02;
+const int EXACT_OR_SUBSET_OR_PREFIX = 0x03;
+
+const uint8_t HOST = 0x00;
+const uint8_t ESE = 0x01;
+const uint8_t POWER = 0x11;
+const uint8_t EXACT = 0x00;
+const uint8_t PREFIX = LmrtPlanner::AID_QUAL_PREFIX;
+const uint8_t SUBSET = LmrtPlanner::AID_QUAL_SUBSET;
+
+const std::vector<uint8_t> kPpse = {0x32, 0x50, 0x41, 0x59, 0x2E};
+const std::vector<uint8_t> kVisa = {0xA0, 0x00, 0x00, 0x00, 0x03};
+const std::vector<uint8_t> kVisaCredit = {0xA0, 0x00, 0x00, 0x00,
+                                          0x03, 0x10, 0x10};
+const std::vector<uint8_t> kVisaDebit = {0xA0, 0x00, 0x00, 0x00,
+                                         0x03, 0x20, 0x10};
+const std::vector<uint8_t> kMaster = {0xA0, 0x00, 0x00, 0x00, 0x04};
+
+void add(LmrtPlanner& planner, const std::vector<uint8_t>& aid, uint8_t route,
+         uint8_t aidInfo, int priority = 0) {
+  planner.addAid(aid.data(), aid.size(), route, POWER, aidInfo, priority);
+}
+
+std::vector<uint32_t> plan(const LmrtPlanner& planner, uint32_t capacity,
+                           uint32_t maxAids = 0) {
+  std::vector<uint32_t> kept;
+  planner.plan(capacity, maxAids, kept);
+  return kept;
+}
+
+uint32_t entryLen(const std::vector<uint8_t>& aid) {
+  return aid.size() + LmrtPlanner::ENTRY_HDR_LEN;
+}
+
+TEST(LmrtPlannerTest, FoldsEntryCoveredByPrefix) {
+  LmrtPlanner planner(EXACT_OR_PREFIX);
+  add(planner, kVisaCredit, HOST, EXACT);
+  add(planner, kVisa, HOST, PREFIX);
+  EXPECT_EQ(entryLen(kVisaCredit) + entryLen(kVisa), planner.encodedSize());
+  std::vector<uint32_t> kept;
+  EXPECT_EQ(entryLen(kVisa), planner.plan(UINT32_MAX, 0, kept));
+  EXPECT_EQ(std::vector<uint32_t>({1}), kept);
+  EXPECT_EQ(0u, planner.droppedCount());
+}
+
+TEST(LmrtPlannerTest, PrefixOnlyModeTreatsEveryEntryAsPrefix) {
+  LmrtPlanner planner(PREFIX_ONLY);
+  add(planner, kVisaCredit, HOST, EXACT);
+  add(planner, kVisa, HOST, EXACT);
+  EXPECT_EQ(std::vector<uint32_t>({1}), plan(planner, UINT32_MAX));
+}
+
+TEST(LmrtPlannerTest, ExactOnlyModeNeverFoldsDistinctAids) {
+  LmrtPlanner planner(EXACT_ONLY);
+  add(planner, kVisaCredit, HOST, EXACT);
+  add(planner, kVisa, HOST, PREFIX);
+  EXPECT_EQ(std::vector<uint32_t>({0, 1}), plan(planner, UINT32_MAX));
+}
+
+TEST(LmrtPlannerTest, FoldsEntryCoveredBySubset) {
+  LmrtPlanner planner(EXACT_OR_SUBSET_OR_PREFIX);
+  add(planner, kVisaCredit, HOST, SUBSET);
+  add(planner, kVisa, HOST, EXACT);
+  EXPECT_EQ(std::vector<uint32_t>({0}), plan(planner, UINT32_MAX));
+}
+
+TEST(LmrtPlannerTest, PrefixEntryIsNotFoldedIntoExactEntry) {
+  LmrtPlanner planner(EXACT_OR_PREFIX);
+  add(planner, kVisa, HOST, EXACT);
+  add(planner, kVisa, HOST, PREFIX);
+  EXPECT_EQ(std::vector<uint32_t>({1}), plan(planner, UINT32_MAX));
+}
+
+TEST(LmrtPlannerTest, KeepsFirstOfIdenticalEntries) {
+  LmrtPlanner planner(EXACT_OR_PREFIX);
+  add(planner, kPpse, HOST, EXACT);
+  add(planner, kVisa, HOST, EXACT);
+  add(planner, kPpse, HOST, EXACT);
+  EXPECT_EQ(std::vector<uint32_t>({0, 1}), plan(planner, UINT32_MAX));
+}
+
+TEST(LmrtPlannerTest, DoesNotFoldAcrossRoutes) {
+  LmrtPlanner planner(EXACT_OR_PREFIX);
+  add(planner, kVisa, HOST, PREFIX);
+  add(planner, kVisaCredit, ESE, EXACT);
+  add(planner, kVisaDebit, HOST, EXACT);
+  // The eSE entry needs the longer match; the debit entry still folds
+  EXPECT_EQ(std::vector<uint32_t>({0, 1}), plan(planner, UINT32_MAX));
+}
+
+TEST(LmrtPlannerTest, DropsLowestPriorityFirst) {
+  LmrtPlanner planner(EXACT_OR_PREFIX);
+  add(planner, kPpse, HOST, EXACT, 1);
+  add(planner, kVisa, HOST, EXACT, 3);
+  add(planner, kMaster, HOST, EXACT, 2);
+  std::vector<uint32_t> kept;
+  planner.plan(entryLen(kVisa) + entryLen(kMaster), 0, kept);
+  EXPECT_EQ(std::vector<uint32_t>({1, 2}), kept);
+  EXPECT_EQ(1u, planner.droppedCount());
+}
+
+TEST(LmrtPlannerTest, DropOrderDoesNotDependOnInsertionOrder) {
+  // Equal priorities: the shorter entry wins, then the lower AID
+  const std::vector<std::vector<uint8_t> > aids = {kVisaCredit, kMaster,
+                                                   kPpse, kVisa};
+  const uint32_t capacity = entryLen(kPpse) + entryLen(kVisa);
+  std::vector<std::vector<uint8_t> > expected = {kPpse, kVisa};
+  for (uint32_t shift = 0; shift < aids.size(); shift++) {
+    LmrtPlanner planner(EXACT_ONLY);
+    std::vector<std::vector<uint8_t> > order;
+    for (uint32_t xx = 0; xx < aids.size(); xx++)
+      order.push_back(aids[(xx + shift) % aids.size()]);
+    for (auto& aid : order) add(planner, aid, HOST, EXACT);
+    std::vector<std::vector<uint8_t> > got;
+    for (uint32_t idx : plan(planner, capacity)) got.push_back(order[idx]);
+    std::sort(got.begin(), got.end());
+    EXPECT_EQ(expected, got) << "shift " << shift;
+    EXPECT_EQ(2u, planner.droppedCount());
+  }
+}
+
+TEST(LmrtPlannerTest, FoldedEntryLendsItsPriority) {
+  LmrtPlanner planner(EXACT_OR_PREFIX);
+  add(planner, kVisa, HOST, PREFIX, 0);
+  add(planner, kVisaCredit, HOST, EXACT, 10);
+  add(planner, kMaster, HOST, EXACT, 5);
+  std::vector<uint32_t> kept;
+  planner.plan(entryLen(kVisa), 0, kept);
+  EXPECT_EQ(std::vector<uint32_t>({0}), kept);
+  // The credit entry is still served through the prefix
+  EXPECT_EQ(1u, planner.droppedCount());
+}
+
+TEST(LmrtPlannerTest, FoldedEntryIsDroppedWithItsOwner) {
+  LmrtPlanner planner(EXACT_OR_PREFIX);
+  add(planner, kVisa, HOST, PREFIX, 0);
+  add(planner, kVisaCredit, HOST, EXACT, 0);
+  add(planner, kMaster, HOST, EXACT, 5);
+  EXPECT_EQ(std::vector<uint32_t>({2}), plan(planner, entryLen(kMaster)));
+  EXPECT_EQ(2u, planner.droppedCount());
+}
+
+TEST(LmrtPlannerTest, HonoursMaxAids) {
+  LmrtPlanner planner(EXACT_ONLY);
+  add(planner, kPpse, HOST, EXACT, 1);
+  add(planner, kVisa, HOST, EXACT, 3);
+  add(planner, kMaster, HOST, EXACT, 2);
+  EXPECT_EQ(std::vector<uint32_t>({1}), plan(planner, UINT32_MAX, 1));
+  EXPECT_EQ(2u, planner.droppedCount());
+}
+
+TEST(LmrtPlannerTest, FixedEntriesTakeTableSpace) {
+  const uint32_t capacity = entryLen(kVisa) + entryLen(kMaster);
+  LmrtPlanner planner(EXACT_ONLY);
+  add(planner, kVisa, HOST, EXACT, 2);
+  add(planner, kMaster, HOST, EXACT, 1);
+  EXPECT_EQ(std::vector<uint32_t>({0, 1}), plan(planner, capacity));
+
+  planner.addTech();
+  planner.addProto();
+  planner.addSystemCode();
+  const uint32_t fixed = 2 * (LmrtPlanner::ENTRY_HDR_LEN + 1) +
+                         (LmrtPlanner::ENTRY_HDR_LEN + 2);
+  EXPECT_EQ(fixed + capacity, planner.encodedSize());
+  std::vector<uint32_t> kept;
+  EXPECT_EQ(fixed + entryLen(kVisa),
+            planner.plan(fixed + entryLen(kVisa), 0, kept));
+  EXPECT_EQ(std::vector<uint32_t>({0}), kept);
+  EXPECT_EQ(1u, planner.droppedCount());
+}
+
+TEST(LmrtPlannerTest, FixedEntriesAloneCanFillTheTable) {
+  LmrtPlanner planner(EXACT_ONLY);
+  add(planner, kVisa, HOST, EXACT);
+  planner.addTech();
+  std::vector<uint32_t> kept;
+  EXPECT_EQ(LmrtPlanner::ENTRY_HDR_LEN + 1,
+            planner.plan(LmrtPlanner::ENTRY_HDR_LEN + 1, 0, kept));
+  EXPECT_TRUE(kept.empty());
+  EXPECT_EQ(1u, planner.droppedCount());
+}
+
+}  // namespace
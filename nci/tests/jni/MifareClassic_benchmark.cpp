@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <vector>
+
+#include <phNxpExtns.h>
+
+#include "SimulatedMifareClassic.h"
+
+namespace {
+
+typedef SimulatedMifareClassic Card;
+
+// Time one frame takes on the air and through the NFCC on a real reader
+const int kFrameUs = 2000;
+
+std::vector<uint8_t> ndefTlv(size_t len) {
+  std::vector<uint8_t> tlv = {0x03};
+  if (len < 0xFF) {
+    tlv.push_back((uint8_t)len);
+  } else {
+    tlv.push_back(0xFF);
+    tlv.push_back((uint8_t)(len >> 8));
+    tlv.push_back((uint8_t)len);
+  }
+  tlv.insert(tlv.end(), len, 0x5A);
+  tlv.push_back(0xFE);
+  return tlv;
+}
+
+// Args: message length, card type, latency of one frame in us.
+Card& setUp(benchmark::State& state) {
+  Card& card = Card::getInstance();
+  card.reset((Card::Type)state.range(1));
+  card.layoutNfcForum(ndefTlv(state.range(0)));
+  card.present();
+  if (card.run([] { return EXTNS_MfcCheckNDef(); }) != NFA_STATUS_OK)
+    state.SkipWithError("check NDEF failed");
+  card.setLatency(std::chrono::microseconds(state.range(2)));
+  card.clearCounters();
+  return card;
+}
+
+void report(benchmark::State& state, Card& card) {
+  state.counters["frames/op"] =
+      benchmark::Counter(card.frames(), benchmark::Counter::kAvgIterations);
+  state.counters["writes/op"] =
+      benchmark::Counter(card.writes(), benchmark::Counter::kAvgIterations);
+  card.setLatency(std::chrono::microseconds(0));
+}
+
+// A tag seen for the first time: every iteration is a card of its own.
+void BM_CheckNdefNewCard(benchmark::State& state) {
+  Card& card = setUp(state);
+  uint32_t frames = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    frames += card.frames();
+    card.reset((Card::Type)state.range(1));
+    card.layoutNfcForum(ndefTlv(state.range(0)));
+    card.setLatency(std::chrono::microseconds(state.range(2)));
+    card.present();
+    state.ResumeTiming();
+    if (card.run([] { return EXTNS_MfcCheckNDef(); }) != NFA_STATUS_OK) {
+      state.SkipWithError("check NDEF failed");
+      break;
+    }
+  }
+  frames += card.frames();
+  state.counters["frames/op"] =
+      benchmark::Counter(frames, benchmark::Counter::kAvgIterations);
+  card.setLatency(std::chrono::microseconds(0));
+}
+
+// The same tag tapped again
+void BM_CheckNdef(benchmark::State& state) {
+  Card& card = setUp(state);
+  for (auto _ : state) {
+    card.present();
+    if (card.run([] { return EXTNS_MfcCheckNDef(); }) != NFA_STATUS_OK) {
+      state.SkipWithError("check NDEF failed");
+      break;
+    }
+  }
+  report(state, card);
+}
+
+void BM_ReadNdef(benchmark::State& state) {
+  Card& card = setUp(state);
+  for (auto _ : state) {
+    if (card.run([] { return EXTNS_MfcReadNDef(); }) != NFA_STATUS_OK) {
+      state.SkipWithError("read NDEF failed");
+      break;
+    }
+  }
+  report(state, card);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_WriteNdef(benchmark::State& state) {
+  Card& card = setUp(state);
+  std::vector<uint8_t> msg(state.range(0), 0xA5);
+  for (auto _ : state) {
+    if (card.run([&msg] {
+          return EXTNS_MfcWriteNDef(msg.data(), msg.size());
+        }) != NFA_STATUS_OK) {
+      state.SkipWithError("write NDEF failed");
+      break;
+    }
+  }
+  report(state, card);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// What a writer app does: write, then check and read the message back.
+void BM_RoundTrip(benchmark::State& state) {
+  Card& card = setUp(state);
+  std::vector<uint8_t> msg(state.range(0), 0x3C);
+  for (auto _ : state) {
+    if (card.run([&msg] {
+          return EXTNS_MfcWriteNDef(msg.data(), msg.size());
+        }) != NFA_STATUS_OK ||
+        card.run([] { return EXTNS_MfcCheckNDef(); }) != NFA_STATUS_OK ||
+        card.run([] { return EXTNS_MfcReadNDef(); }) != NFA_STATUS_OK) {
+      state.SkipWithError("round trip failed");
+      break;
+    }
+  }
+  report(state, card);
+}
+
+void Args(benchmark::internal::Benchmark* b) {
+  for (int latency : {0, kFrameUs}) {
+    for (int len : {16, 200, 700}) b->Args({len, Card::MIFARE_1K, latency});
+    b->Args({3000, Card::MIFARE_4K, latency});
+  }
+}
+
+BENCHMARK(BM_CheckNdefNewCard)->Apply(Args)->UseRealTime();
+BENCHMARK(BM_CheckNdef)->Apply(Args)->UseRealTime();
+BENCHMARK(BM_ReadNdef)->Apply(Args)->UseRealTime();
+BENCHMARK(BM_WriteNdef)->Apply(Args)->UseRealTime();
+BENCHMARK(BM_RoundTrip)->Apply(Args)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,550 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <phNxpExtns.h>
+
+#include "SimulatedMifareClassic.h"
+
+namespace {
+
+typedef SimulatedMifareClassic Card;
+
+// keys NativeNfcTag formats with, one after the other
+const uint8_t kFormatKey1[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+const uint8_t kFormatKey2[6] = {0xD3, 0xF7, 0xD3, 0xF7, 0xD3, 0xF7};
+
+// NDEF area of the cards once the MAD sectors are left out
+const size_t k1kArea = 15 * 3 * 16;
+const size_t k4kArea = (30 * 3 + 8 * 15) * 16;
+
+std::vector<uint8_t> message(size_t len, uint8_t seed) {
+  std::vector<uint8_t> msg(len);
+  for (size_t i = 0; i < len; i++) msg[i] = (uint8_t)(seed + i * 7);
+  return msg;
+}
+
+// NDEF message TLV followed by the terminator TLV
+std::vector<uint8_t> ndefTlv(const std::vector<uint8_t>& msg) {
+  std::vector<uint8_t> tlv = {0x03};
+  if (msg.size() < 0xFF) {
+    tlv.push_back((uint8_t)msg.size());
+  } else {
+    tlv.push_back(0xFF);
+    tlv.push_back((uint8_t)(msg.size() >> 8));
+    tlv.push_back((uint8_t)msg.size());
+  }
+  tlv.insert(tlv.end(), msg.begin(), msg.end());
+  tlv.push_back(0xFE);
+  return tlv;
+}
+
+class MifareClassicTest : public ::testing::Test {
+ protected:
+  void SetUp() override { card.reset(Card::MIFARE_1K); }
+
+  // A new NFC Forum card holding msg, in the field
+  void presentNdef(Card::Type type, const std::vector<uint8_t>& msg) {
+    card.reset(type);
+    card.layoutNfcForum(ndefTlv(msg));
+    card.present();
+  }
+
+  tNFA_STATUS checkNdef() {
+    return card.run([] { return EXTNS_MfcCheckNDef(); });
+  }
+  tNFA_STATUS readNdef() {
+    return card.run([] { return EXTNS_MfcReadNDef(); });
+  }
+  tNFA_STATUS writeNdef(std::vector<uint8_t> msg) {
+    return card.run(
+        [&msg] { return EXTNS_MfcWriteNDef(msg.data(), msg.size()); });
+  }
+  tNFA_STATUS format(const uint8_t* key) {
+    return card.run([key] {
+      uint8_t copy[6];
+      memcpy(copy, key, sizeof(copy));
+      return EXTNS_MfcFormatTag(copy, sizeof(copy));
+    });
+  }
+  tNFA_STATUS setReadOnly(const uint8_t* key) {
+    return card.run([key] {
+      uint8_t copy[6];
+      memcpy(copy, key, sizeof(copy));
+      return EXTNS_MfcSetReadOnly(copy, sizeof(copy));
+    });
+  }
+
+  // Checks and reads the card, the way a tag is handled once it is found
+  std::vector<uint8_t> readBack() {
+    EXPECT_EQ(NFA_STATUS_OK, checkNdef());
+    if (card.result().ndef_detect.cur_size == 0) return {};
+    EXPECT_EQ(NFA_STATUS_OK, readNdef());
+    return card.ndef();
+  }
+
+  // Writes newMsg over a card laid out with tlvs, holding oldMsg, and has
+  // the card leave the field after each block write in turn.  Whatever was
+  // written by then, the card read again holds the old message, no message
+  // or the new one, never a mix.
+  void expectTornWrites(const std::vector<uint8_t>& tlvs,
+                        const std::vector<uint8_t>& oldMsg,
+                        const std::vector<uint8_t>& newMsg) {
+    card.reset(Card::MIFARE_1K);
+    card.layoutNfcForum(tlvs);
+    card.present();
+    ASSERT_EQ(oldMsg, readBack());
+    card.clearCounters();
+    ASSERT_EQ(NFA_STATUS_OK, writeNdef(newMsg));
+    uint32_t writes = card.writes();
+    ASSERT_NE(0u, writes);
+
+    for (uint32_t n = 1; n <= writes; n++) {
+      SCOPED_TRACE(testing::Message() << "torn after write " << n);
+      card.reset(Card::MIFARE_1K);
+      card.layoutNfcForum(tlvs);
+      card.present();
+      ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+      card.tearAfterWrites(n);
+      writeNdef(newMsg);
+      EXPECT_FALSE(card.stalled());
+
+      card.tearAfterWrites(0);
+      card.present();
+      std::vector<uint8_t> msg = readBack();
+      EXPECT_TRUE(msg == oldMsg || msg.empty() || msg == newMsg)
+          << msg.size() << " bytes read back";
+    }
+  }
+
+  // Lookups answered from the layout cache and read from the card since the
+  // last call
+  void cacheDelta(uint32_t* hits, uint32_t* misses) {
+    uint32_t allHits = 0, allMisses = 0;
+    EXTNS_MfcGetCacheStats(&allHits, &allMisses);
+    *hits = allHits - mHits;
+    *misses = allMisses - mMisses;
+    mHits = allHits;
+    mMisses = allMisses;
+  }
+
+  Card& card = Card::getInstance();
+  uint32_t mHits = 0;
+  uint32_t mMisses = 0;
+};
+
+TEST_F(MifareClassicTest, CheckNdef1k) {
+  presentNdef(Card::MIFARE_1K, message(20, 1));
+
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  EXPECT_EQ(NFA_NDEF_DETECT_EVT, card.event());
+  EXPECT_EQ(20u, card.result().ndef_detect.cur_size);
+  EXPECT_EQ(k1kArea - 4, card.result().ndef_detect.max_size);
+  EXPECT_EQ(0, card.result().ndef_detect.flags & RW_NDEF_FL_READ_ONLY);
+}
+
+TEST_F(MifareClassicTest, CheckNdef4k) {
+  presentNdef(Card::MIFARE_4K, message(300, 2));
+
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  EXPECT_EQ(300u, card.result().ndef_detect.cur_size);
+  EXPECT_EQ(k4kArea - 4, card.result().ndef_detect.max_size);
+}
+
+TEST_F(MifareClassicTest, CheckNdefFailsOnBlankCard) {
+  card.present();
+
+  EXPECT_NE(NFA_STATUS_OK, checkNdef());
+  EXPECT_FALSE(card.stalled());
+  EXPECT_EQ(NFA_NDEF_DETECT_EVT, card.event());
+}
+
+TEST_F(MifareClassicTest, ReadNdef) {
+  for (size_t len : {1u, 40u, 253u, 254u, 700u}) {
+    SCOPED_TRACE(len);
+    std::vector<uint8_t> msg = message(len, 3);
+    presentNdef(Card::MIFARE_1K, msg);
+    EXPECT_EQ(msg, readBack());
+  }
+}
+
+TEST_F(MifareClassicTest, ReadNdef4k) {
+  std::vector<uint8_t> msg = message(3000, 4);
+  presentNdef(Card::MIFARE_4K, msg);
+
+  EXPECT_EQ(msg, readBack());
+}
+
+// A read authenticates once for each sector the NDEF TLV reaches and reads
+// each of its blocks once.
+TEST_F(MifareClassicTest, ReadNdefAuthenticatesOncePerSector) {
+  for (size_t len : {(size_t)10, (size_t)44, (size_t)45, (size_t)300,
+                      k1kArea - 4}) {
+    SCOPED_TRACE(len);
+    std::vector<uint8_t> msg = message(len, 16);
+    size_t blocks = (ndefTlv(msg).size() - 1 + 15) / 16;
+    presentNdef(Card::MIFARE_1K, msg);
+    ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+    card.clearCounters();
+    ASSERT_EQ(NFA_STATUS_OK, readNdef());
+    EXPECT_EQ(msg, card.ndef());
+    EXPECT_EQ(blocks, card.reads());
+    EXPECT_EQ((blocks + 2) / 3, card.auths());
+  }
+}
+
+TEST_F(MifareClassicTest, ReadNdefAuthenticatesOncePerSector4k) {
+  std::vector<uint8_t> msg = message(3000, 17);
+  presentNdef(Card::MIFARE_4K, msg);
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  card.clearCounters();
+  ASSERT_EQ(NFA_STATUS_OK, readNdef());
+  EXPECT_EQ(msg, card.ndef());
+  // 3004 bytes: sectors 1 to 15 and 17 to 31, then 98 of the 15 block ones
+  EXPECT_EQ(188u, card.reads());
+  EXPECT_EQ(15u + 15u + 7u, card.auths());
+}
+
+// NULL TLVs in front move the NDEF TLV header over every block and sector
+// boundary, with both the short and the three byte length.
+TEST_F(MifareClassicTest, ReadNdefHeaderAcrossBlocks) {
+  for (size_t len : {(size_t)20, (size_t)300}) {
+    std::vector<uint8_t> msg = message(len, 18);
+    for (size_t pad = 0; pad < 50; pad++) {
+      SCOPED_TRACE(testing::Message() << len << " after " << pad);
+      std::vector<uint8_t> tlvs(pad, 0x00);
+      std::vector<uint8_t> tlv = ndefTlv(msg);
+      tlvs.insert(tlvs.end(), tlv.begin(), tlv.end());
+      card.reset(Card::MIFARE_1K);
+      card.layoutNfcForum(tlvs);
+      card.present();
+      EXPECT_EQ(msg, readBack());
+    }
+  }
+}
+
+// A sector whose key A no longer matches halts the card half way through
+// the read; the read fails instead of returning a truncated message.
+TEST_F(MifareClassicTest, ReadNdefFailsOnAuthError) {
+  presentNdef(Card::MIFARE_1K, message(400, 19));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  memset(&card.block(Card::trailerOf(4))[0], 0x00, 6);
+  card.clearCounters();
+  EXPECT_NE(NFA_STATUS_OK, readNdef());
+  EXPECT_EQ(NFA_READ_CPLT_EVT, card.event());
+  EXPECT_FALSE(card.stalled());
+  EXPECT_EQ(4u, card.auths());
+  EXPECT_EQ(9u, card.reads());
+}
+
+TEST_F(MifareClassicTest, WriteNdef) {
+  presentNdef(Card::MIFARE_1K, message(30, 5));
+
+  for (size_t len : {(size_t)1, (size_t)13, (size_t)14, (size_t)100,
+                      (size_t)500, k1kArea - 4}) {
+    SCOPED_TRACE(len);
+    std::vector<uint8_t> msg = message(len, (uint8_t)len);
+    ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+    ASSERT_EQ(NFA_STATUS_OK, writeNdef(msg));
+    EXPECT_EQ(NFA_WRITE_CPLT_EVT, card.event());
+    EXPECT_EQ(msg, readBack());
+  }
+}
+
+TEST_F(MifareClassicTest, WriteNdef4k) {
+  presentNdef(Card::MIFARE_4K, {});
+
+  for (size_t len : {(size_t)200, (size_t)2000, k4kArea - 4}) {
+    SCOPED_TRACE(len);
+    std::vector<uint8_t> msg = message(len, (uint8_t)len);
+    ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+    ASSERT_EQ(NFA_STATUS_OK, writeNdef(msg));
+    EXPECT_EQ(msg, readBack());
+  }
+}
+
+TEST_F(MifareClassicTest, WriteNdefTooLong) {
+  presentNdef(Card::MIFARE_1K, message(10, 6));
+
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  EXPECT_NE(NFA_STATUS_OK, writeNdef(message(k1kArea, 7)));
+  EXPECT_EQ(message(10, 6), readBack());
+}
+
+TEST_F(MifareClassicTest, WriteNdefNeedsCheckNdef) {
+  card.present();
+
+  EXPECT_NE(NFA_STATUS_OK, checkNdef());
+  EXPECT_NE(NFA_STATUS_OK, writeNdef(message(10, 8)));
+  EXPECT_EQ(0u, card.writes());
+}
+
+TEST_F(MifareClassicTest, Format) {
+  card.present();
+
+  ASSERT_EQ(NFA_STATUS_OK, format(kFormatKey1));
+  EXPECT_EQ(NFA_FORMAT_CPLT_EVT, card.event());
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  EXPECT_EQ(0u, card.result().ndef_detect.cur_size);
+  EXPECT_EQ(k1kArea - 4, card.result().ndef_detect.max_size);
+
+  std::vector<uint8_t> msg = message(120, 9);
+  ASSERT_EQ(NFA_STATUS_OK, writeNdef(msg));
+  EXPECT_EQ(msg, readBack());
+}
+
+TEST_F(MifareClassicTest, Format4k) {
+  card.reset(Card::MIFARE_4K);
+  card.present();
+
+  ASSERT_EQ(NFA_STATUS_OK, format(kFormatKey1));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  EXPECT_EQ(k4kArea - 4, card.result().ndef_detect.max_size);
+
+  std::vector<uint8_t> msg = message(1500, 10);
+  ASSERT_EQ(NFA_STATUS_OK, writeNdef(msg));
+  EXPECT_EQ(msg, readBack());
+}
+
+// The sector trailers are protected by a key B nobody knows: the format
+// halts the card on every sector and reports the failure.
+TEST_F(MifareClassicTest, FormatFailsWithUnknownKeys) {
+  const uint8_t unknown[6] = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC};
+  for (uint8_t sector = 0; sector < 16; sector++) {
+    std::vector<uint8_t>& trailer = card.block(Card::trailerOf(sector));
+    memcpy(&trailer[0], unknown, 6);
+    memcpy(&trailer[10], unknown, 6);
+  }
+  card.present();
+
+  EXPECT_NE(NFA_STATUS_OK, format(kFormatKey1));
+  EXPECT_FALSE(card.stalled());
+  EXPECT_EQ(NFA_FORMAT_CPLT_EVT, card.event());
+  EXPECT_EQ(0u, card.writes());
+}
+
+TEST_F(MifareClassicTest, SetReadOnly) {
+  std::vector<uint8_t> msg = message(100, 11);
+  presentNdef(Card::MIFARE_1K, msg);
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  ASSERT_EQ(NFA_STATUS_OK, setReadOnly(kFormatKey1));
+  EXPECT_EQ(NFA_SET_TAG_RO_EVT, card.event());
+
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  EXPECT_NE(0, card.result().ndef_detect.flags & RW_NDEF_FL_READ_ONLY);
+  EXPECT_NE(NFA_STATUS_OK, writeNdef(message(10, 12)));
+  EXPECT_EQ(msg, readBack());
+  // The data blocks can no longer be written with either key
+  for (uint8_t sector = 1; sector < 16; sector++) {
+    const std::vector<uint8_t>& trailer = card.block(Card::trailerOf(sector));
+    EXPECT_EQ(0x0F, trailer[6]);
+    EXPECT_EQ(0x07, trailer[7]);
+    EXPECT_EQ(0x8F, trailer[8]);
+  }
+}
+
+TEST_F(MifareClassicTest, SetReadOnlyWithWrongKeyB) {
+  std::vector<uint8_t> msg = message(100, 13);
+  presentNdef(Card::MIFARE_1K, msg);
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  EXPECT_NE(NFA_STATUS_OK, setReadOnly(kFormatKey2));
+  EXPECT_FALSE(card.stalled());
+
+  card.present();
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  EXPECT_EQ(0, card.result().ndef_detect.flags & RW_NDEF_FL_READ_ONLY);
+  EXPECT_EQ(msg, readBack());
+}
+
+TEST_F(MifareClassicTest, ReadNdefFailsOnFrameError) {
+  presentNdef(Card::MIFARE_1K, message(400, 14));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  card.failFrame(3, 0x03);
+  EXPECT_NE(NFA_STATUS_OK, readNdef());
+  EXPECT_EQ(NFA_READ_CPLT_EVT, card.event());
+  EXPECT_FALSE(card.stalled());
+}
+
+TEST_F(MifareClassicTest, CardRemovedDuringRead) {
+  presentNdef(Card::MIFARE_1K, message(400, 15));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  card.failFrame(5, Card::kRfTimeout);
+  EXPECT_NE(NFA_STATUS_OK, readNdef());
+  EXPECT_FALSE(card.stalled());
+
+  card.present();
+  EXPECT_EQ(message(400, 15), readBack());
+}
+
+// A first half of a write the card refused ends the write; the answer to the
+// next frame is not taken for its acknowledgement.
+TEST_F(MifareClassicTest, RawWriteRefusedEndsWrite) {
+  presentNdef(Card::MIFARE_1K, message(20, 16));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  std::vector<uint8_t> block4 = card.block(4);
+
+  std::vector<uint8_t> write = {0xA0, 4};
+  write.resize(2 + 16, 0x00);
+  card.failFrame(1, 0x03);
+  card.run([&write] {
+    return EXTNS_MfcTransceive(write.data(), write.size());
+  });
+
+  card.present();
+  EXPECT_EQ(message(20, 16), readBack());
+  EXPECT_EQ(block4, card.block(4));
+}
+
+TEST_F(MifareClassicTest, WriteNdefTorn) {
+  std::vector<uint8_t> oldMsg = message(100, 17);
+  expectTornWrites(ndefTlv(oldMsg), oldMsg, message(300, 18));
+  expectTornWrites(ndefTlv(oldMsg), oldMsg, message(40, 19));
+}
+
+// The four byte header of a long message split between blocks 4 and 5, and
+// between the sectors 1 and 2.
+TEST_F(MifareClassicTest, WriteNdefTornHeaderAcrossBlocks) {
+  std::vector<uint8_t> oldMsg = message(280, 20);
+  for (size_t pad : {(size_t)13, (size_t)14, (size_t)15, (size_t)46}) {
+    SCOPED_TRACE(testing::Message() << "header after " << pad);
+    std::vector<uint8_t> tlvs(pad, 0x00);
+    std::vector<uint8_t> tlv = ndefTlv(oldMsg);
+    tlvs.insert(tlvs.end(), tlv.begin(), tlv.end());
+    expectTornWrites(tlvs, oldMsg, message(500, 21));
+  }
+}
+
+// The same card tapped again is checked from the cached MAD and sector
+// trailers: no miss, and only the frames that find the NDEF TLV.
+TEST_F(MifareClassicTest, CheckNdefAgainUsesCache) {
+  uint32_t hits, misses;
+  presentNdef(Card::MIFARE_1K, message(20, 20));
+  cacheDelta(&hits, &misses);
+
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  cacheDelta(&hits, &misses);
+  EXPECT_EQ(0u, hits);
+  EXPECT_NE(0u, misses);
+  uint32_t frames = card.frames();
+
+  card.present();
+  card.clearCounters();
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  cacheDelta(&hits, &misses);
+  EXPECT_NE(0u, hits);
+  EXPECT_EQ(0u, misses);
+  EXPECT_LT(card.frames(), frames);
+  EXPECT_EQ(20u, card.result().ndef_detect.cur_size);
+  EXPECT_EQ(k1kArea - 4, card.result().ndef_detect.max_size);
+}
+
+TEST_F(MifareClassicTest, CheckNdefCacheIsPerCard) {
+  uint32_t hits, misses;
+  presentNdef(Card::MIFARE_1K, message(20, 21));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  presentNdef(Card::MIFARE_4K, message(30, 22));
+  cacheDelta(&hits, &misses);
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  cacheDelta(&hits, &misses);
+  EXPECT_EQ(0u, hits);
+  EXPECT_NE(0u, misses);
+  EXPECT_EQ(k4kArea - 4, card.result().ndef_detect.max_size);
+}
+
+TEST_F(MifareClassicTest, WriteNdefInvalidatesCache) {
+  uint32_t hits, misses;
+  presentNdef(Card::MIFARE_1K, message(20, 23));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  ASSERT_EQ(NFA_STATUS_OK, writeNdef(message(60, 24)));
+
+  cacheDelta(&hits, &misses);
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  cacheDelta(&hits, &misses);
+  EXPECT_EQ(0u, hits);
+  EXPECT_NE(0u, misses);
+  EXPECT_EQ(60u, card.result().ndef_detect.cur_size);
+}
+
+TEST_F(MifareClassicTest, FormatInvalidatesCache) {
+  uint32_t hits, misses;
+  card.present();
+  ASSERT_EQ(NFA_STATUS_OK, format(kFormatKey1));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  ASSERT_EQ(NFA_STATUS_OK, writeNdef(message(50, 25)));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  ASSERT_EQ(NFA_STATUS_OK, format(kFormatKey1));
+  cacheDelta(&hits, &misses);
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  cacheDelta(&hits, &misses);
+  EXPECT_EQ(0u, hits);
+  EXPECT_NE(0u, misses);
+  EXPECT_EQ(0u, card.result().ndef_detect.cur_size);
+}
+
+// Without the invalidation the second check would still find the card
+// writable in the cached sector trailers.
+TEST_F(MifareClassicTest, SetReadOnlyInvalidatesCache) {
+  uint32_t hits, misses;
+  presentNdef(Card::MIFARE_1K, message(20, 26));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  ASSERT_EQ(NFA_STATUS_OK, setReadOnly(kFormatKey1));
+
+  cacheDelta(&hits, &misses);
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  cacheDelta(&hits, &misses);
+  EXPECT_EQ(0u, hits);
+  EXPECT_NE(0u, misses);
+  EXPECT_NE(0, card.result().ndef_detect.flags & RW_NDEF_FL_READ_ONLY);
+}
+
+// An application writing raw blocks may rewrite the MAD or a sector
+// trailer, so the cache cannot be trusted afterwards.
+TEST_F(MifareClassicTest, RawWriteInvalidatesCache) {
+  uint32_t hits, misses;
+  presentNdef(Card::MIFARE_1K, message(20, 27));
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+
+  // check NDEF left sector 1 authenticated
+  std::vector<uint8_t> write = {0xA0, 4, 0x03, 0x03, 0xD1, 0x00, 0x00, 0xFE};
+  write.resize(2 + 16, 0x00);
+  ASSERT_EQ(NFA_STATUS_OK, card.run([&write] {
+    return EXTNS_MfcTransceive(write.data(), write.size());
+  }));
+  EXPECT_EQ(std::vector<uint8_t>(write.begin() + 2, write.end()),
+            card.block(4));
+
+  card.present();
+  cacheDelta(&hits, &misses);
+  ASSERT_EQ(NFA_STATUS_OK, checkNdef());
+  cacheDelta(&hits, &misses);
+  EXPECT_EQ(0u, hits);
+  EXPECT_NE(0u, misses);
+  EXPECT_EQ(3u, card.result().ndef_detect.cur_size);
+}
+
+}  // namespace
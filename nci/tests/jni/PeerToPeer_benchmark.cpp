@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "SimulatedLlcp.h"
+
+namespace {
+
+// LLCP MIU the framework's SNEP and handover clients ask for
+const uint16_t kMiu = 248;
+
+// Opens a client data link; the simulated peer echoes miu and rw back as its
+// own in NFA_P2P_CONNECTED_EVT.  Returns 0 on failure.
+PeerToPeer::tJNI_HANDLE connect(uint8_t rw) {
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+  PeerToPeer::tJNI_HANDLE jni = p2p.getNewJniHandle();
+  if (!p2p.createClient(jni, kMiu, rw)) return 0;
+  if (!p2p.connectConnOriented(jni, "urn:nfc:sn:bench")) {
+    PeerToPeerPeer::removeConn(jni);
+    return 0;
+  }
+  return jni;
+}
+
+// Args: payload length, peer receive window, air time of one PDU in us.
+// The stack holds a window's worth of PDUs before it reports congestion.
+void setUp(benchmark::State& state, PeerToPeer::tJNI_HANDLE& jni) {
+  SimulatedLlcp::getInstance().setLink(
+      state.range(1), std::chrono::microseconds(state.range(2)));
+  jni = connect(state.range(1));
+  if (jni == 0) state.SkipWithError("cannot connect");
+}
+
+// One send() per MIU, the way a caller without sendQueued() splits a
+// message; each call returns once the stack took the PDU.
+void BM_Send(benchmark::State& state) {
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+  std::vector<uint8_t> payload(state.range(0), 0x5A);
+  PeerToPeer::tJNI_HANDLE jni = 0;
+  setUp(state, jni);
+  for (auto _ : state) {
+    for (size_t offset = 0; offset < payload.size(); offset += kMiu) {
+      size_t len = std::min<size_t>(kMiu, payload.size() - offset);
+      if (!p2p.send(jni, payload.data() + offset, len)) {
+        state.SkipWithError("send failed");
+        break;
+      }
+    }
+    SimulatedLlcp::getInstance().waitIdle();
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+  if (jni != 0) PeerToPeerPeer::removeConn(jni);
+}
+
+// The whole message in one sendQueued(); flush() waits for the sender
+// thread to hand the last chunk over.
+void BM_SendQueuedFlush(benchmark::State& state) {
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+  std::vector<uint8_t> payload(state.range(0), 0x5A);
+  PeerToPeer::tJNI_HANDLE jni = 0;
+  setUp(state, jni);
+  for (auto _ : state) {
+    if (!p2p.sendQueued(jni, payload.data(), payload.size(), 0) ||
+        !p2p.flush(jni)) {
+      state.SkipWithError("sendQueued failed");
+      break;
+    }
+    SimulatedLlcp::getInstance().waitIdle();
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+  if (jni != 0) PeerToPeerPeer::removeConn(jni);
+}
+
+void linkArgs(benchmark::internal::Benchmark* b) {
+  for (int len : {1024, 16384, 65536})
+    for (int rw : {1, 4})
+      for (int pduTime : {0, 100}) b->Args({len, rw, pduTime});
+}
+
+BENCHMARK(BM_Send)->Apply(linkArgs)->UseRealTime();
+BENCHMARK(BM_SendQueuedFlush)->Apply(linkArgs)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/stringprintf.h>
+
+#include "SimulatedLlcp.h"
+
+using android::base::StringPrintf;
+using android::sp;
+
+namespace {
+
+typedef PeerToPeerPeer Peer;
+
+SimulatedLlcp& llcp() { return SimulatedLlcp::getInstance(); }
+
+const int kThreads = 8;
+const int kRounds = 64;
+
+// NFA_P2P_REG_CLIENT_EVT goes to the oldest waiting client, and the stack
+// answers registrations in order; keep client creation in that order.
+std::mutex sCreateClientLock;
+
+// Accepts one incoming connection on a listening server; returns its NFA
+// handle.  accept() waits without looking at the handle first, so a
+// CONN_REQ that lands before it starts waiting is followed by plain
+// wake-ups until it returns.
+tNFA_HANDLE acceptOne(PeerToPeer::tJNI_HANDLE serverJni,
+                      PeerToPeer::tJNI_HANDLE connJni, bool& accepted) {
+  sp<P2pServer> server = Peer::findServer(serverJni);
+  std::atomic<bool> done(false);
+  std::thread acceptor([&] {
+    accepted = PeerToPeer::getInstance().accept(serverJni, connJni, 128, 1);
+    done = true;
+  });
+  while (Peer::findConnection(connJni) == NULL) std::this_thread::yield();
+  tNFA_HANDLE conn = llcp().connRequest(server->mNfaP2pServerHandle);
+  while (!done.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    SyncEventGuard guard(server->mConnRequestEvent);
+    server->mConnRequestEvent.notifyOne();
+  }
+  acceptor.join();
+  return conn;
+}
+
+// One server with an accepted connection and one connected client, checked
+// by every key and torn down again.
+void runLinks(int thread, int round) {
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+  std::string name = StringPrintf("urn:nfc:sn:stress-%d-%d", thread, round);
+
+  PeerToPeer::tJNI_HANDLE serverJni = p2p.getNewJniHandle();
+  ASSERT_TRUE(p2p.registerServer(serverJni, name.c_str()));
+  sp<P2pServer> server = Peer::findServer(serverJni);
+  ASSERT_TRUE(server != NULL);
+  tNFA_HANDLE serverNfa = server->mNfaP2pServerHandle;
+  EXPECT_EQ(server, Peer::findServer(name.c_str()));
+  EXPECT_EQ(server, Peer::findServer(serverNfa));
+
+  PeerToPeer::tJNI_HANDLE acceptJni = p2p.getNewJniHandle();
+  bool accepted = false;
+  tNFA_HANDLE acceptNfa = acceptOne(serverJni, acceptJni, accepted);
+  EXPECT_TRUE(accepted);
+  sp<NfaConn> inConn = Peer::findConnection(acceptJni);
+  ASSERT_TRUE(inConn != NULL);
+  EXPECT_EQ(inConn, Peer::findConnection(acceptNfa));
+
+  PeerToPeer::tJNI_HANDLE clientJni = p2p.getNewJniHandle();
+  {
+    std::lock_guard<std::mutex> lock(sCreateClientLock);
+    ASSERT_TRUE(p2p.createClient(clientJni, 128, 1));
+  }
+  ASSERT_TRUE(p2p.connectConnOriented(clientJni, name.c_str()));
+  sp<P2pClient> client = Peer::findClient(clientJni);
+  ASSERT_TRUE(client != NULL);
+  tNFA_HANDLE clientNfa = client->mNfaP2pClientHandle;
+  tNFA_HANDLE outNfa = client->mClientConn->mNfaConnHandle;
+  EXPECT_EQ(client, Peer::findClient(clientNfa));
+  EXPECT_EQ(client->mClientConn, Peer::findConnection(clientJni));
+  EXPECT_EQ(client->mClientConn, Peer::findConnection(outNfa));
+
+  // disconnecting drops only the NFA keys
+  llcp().disconnect(llcp().serverCallback, acceptNfa);
+  llcp().disconnect(llcp().clientCallback, outNfa);
+  EXPECT_TRUE(Peer::findConnection(acceptNfa) == NULL);
+  EXPECT_TRUE(Peer::findConnection(outNfa) == NULL);
+  EXPECT_EQ(inConn, Peer::findConnection(acceptJni));
+  EXPECT_EQ(client->mClientConn, Peer::findConnection(clientJni));
+
+  Peer::removeConn(acceptJni);
+  Peer::removeConn(clientJni);
+  EXPECT_TRUE(Peer::findConnection(acceptJni) == NULL);
+  EXPECT_TRUE(Peer::findConnection(clientJni) == NULL);
+  EXPECT_TRUE(Peer::findClient(clientJni) == NULL);
+  EXPECT_TRUE(Peer::findClient(clientNfa) == NULL);
+
+  Peer::removeServer(serverJni);
+  EXPECT_TRUE(Peer::findServer(serverJni) == NULL);
+  EXPECT_TRUE(Peer::findServer(serverNfa) == NULL);
+  EXPECT_TRUE(Peer::findServer(name.c_str()) == NULL);
+}
+
+class PeerToPeerIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override { PeerToPeer::getInstance().handleNfcOnOff(true); }
+  void TearDown() override { PeerToPeer::getInstance().handleNfcOnOff(true); }
+};
+
+TEST_F(PeerToPeerIndexTest, ManyConcurrentLinksStayIndexed) {
+  std::atomic<bool> done(false);
+  std::thread reader([&] {
+    // lookups never take the PeerToPeer mutex; keep them racing the updates
+    uint32_t i = 0;
+    while (!done.load()) {
+      Peer::findServer((PeerToPeer::tJNI_HANDLE)(i % 1024));
+      Peer::findServer((tNFA_HANDLE)(0x0100 + i % 1024));
+      Peer::findClient((tNFA_HANDLE)(0x0100 + i % 1024));
+      Peer::findConnection((tNFA_HANDLE)(0x0100 + i % 1024));
+      Peer::findConnection((PeerToPeer::tJNI_HANDLE)(i % 1024));
+      i++;
+    }
+  });
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < kThreads; t++) {
+    workers.emplace_back([t] {
+      for (int r = 0; r < kRounds; r++) runLinks(t, r);
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+  done = true;
+  reader.join();
+}
+
+TEST_F(PeerToPeerIndexTest, ManyIdleLinksDoNotSlowLookups) {
+  // keep a few hundred links open while others come and go
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+  std::vector<PeerToPeer::tJNI_HANDLE> servers;
+  for (int i = 0; i < 256; i++) {
+    PeerToPeer::tJNI_HANDLE jni = p2p.getNewJniHandle();
+    std::string name = StringPrintf("urn:nfc:sn:idle-%d", i);
+    ASSERT_TRUE(p2p.registerServer(jni, name.c_str()));
+    servers.push_back(jni);
+  }
+  for (int r = 0; r < kRounds; r++) runLinks(kThreads, r);
+  for (PeerToPeer::tJNI_HANDLE jni : servers) {
+    sp<P2pServer> server = Peer::findServer(jni);
+    ASSERT_TRUE(server != NULL);
+    EXPECT_EQ(server, Peer::findServer(server->mNfaP2pServerHandle));
+    EXPECT_EQ(server, Peer::findServer(server->mServiceName.c_str()));
+  }
+}
+
+TEST_F(PeerToPeerIndexTest, ReRegisteringMovesTheJniHandle) {
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+  PeerToPeer::tJNI_HANDLE first = p2p.getNewJniHandle();
+  PeerToPeer::tJNI_HANDLE second = p2p.getNewJniHandle();
+  ASSERT_TRUE(p2p.registerServer(first, "urn:nfc:sn:again"));
+  sp<P2pServer> server = Peer::findServer(first);
+  ASSERT_TRUE(p2p.registerServer(second, "urn:nfc:sn:again"));
+  EXPECT_TRUE(Peer::findServer(first) == NULL);
+  EXPECT_EQ(server, Peer::findServer(second));
+  EXPECT_EQ(server, Peer::findServer("urn:nfc:sn:again"));
+}
+
+TEST_F(PeerToPeerIndexTest, LateEventDoesNotBringBackARemovedServer) {
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+  PeerToPeer::tJNI_HANDLE jni = p2p.getNewJniHandle();
+  ASSERT_TRUE(p2p.registerServer(jni, "urn:nfc:sn:late"));
+  sp<P2pServer> server = Peer::findServer(jni);
+  Peer::removeServer(jni);
+  tNFA_HANDLE late = llcp().newHandle();
+  Peer::setNfaHandle(server, late);
+  EXPECT_TRUE(Peer::findServer(late) == NULL);
+  EXPECT_TRUE(Peer::findServer(jni) == NULL);
+}
+
+TEST_F(PeerToPeerIndexTest, NfcOffDropsOnlyConnectionHandles) {
+  PeerToPeer& p2p = PeerToPeer::getInstance();
+  PeerToPeer::tJNI_HANDLE serverJni = p2p.getNewJniHandle();
+  ASSERT_TRUE(p2p.registerServer(serverJni, "urn:nfc:sn:off"));
+  sp<P2pServer> server = Peer::findServer(serverJni);
+  PeerToPeer::tJNI_HANDLE acceptJni = p2p.getNewJniHandle();
+  bool accepted = false;
+  tNFA_HANDLE acceptNfa = acceptOne(serverJni, acceptJni, accepted);
+  ASSERT_TRUE(accepted);
+
+  p2p.handleNfcOnOff(false);
+  EXPECT_TRUE(Peer::findConnection(acceptNfa) == NULL);
+  EXPECT_TRUE(Peer::findConnection(acceptJni) != NULL);
+  EXPECT_EQ(server, Peer::findServer(server->mNfaP2pServerHandle));
+}
+
+}  // namespace
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SimulatedLlcp.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+SimulatedLlcp& SimulatedLlcp::getInstance() {
+  static SimulatedLlcp* sLlcp = new SimulatedLlcp();
+  return *sLlcp;
+}
+
+SimulatedLlcp::SimulatedLlcp()
+    : mNextHandle(0),
+      mLinkCapacity(0),
+      mPduTime(0),
+      mBytesSent(0) {
+  std::thread(&SimulatedLlcp::run, this).detach();
+  std::thread(&SimulatedLlcp::runLink, this).detach();
+}
+
+tNFA_HANDLE SimulatedLlcp::newHandle() {
+  return (tNFA_HANDLE)(0x0100 + (mNextHandle.fetch_add(1) % 0xFE00));
+}
+
+void SimulatedLlcp::post(std::function<void()> event) {
+  std::lock_guard<std::mutex> lock(mLock);
+  mEvents.push_back(event);
+  mCond.notify_one();
+}
+
+void SimulatedLlcp::postAndWait(std::function<void()> event) {
+  std::mutex done;
+  std::condition_variable cond;
+  bool finished = false;
+  post([&] {
+    event();
+    std::lock_guard<std::mutex> lock(done);
+    finished = true;
+    cond.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(done);
+  cond.wait(lock, [&] { return finished; });
+}
+
+tNFA_HANDLE SimulatedLlcp::connRequest(tNFA_HANDLE serverHandle) {
+  tNFA_HANDLE conn = newHandle();
+  addConn(conn, serverCallback);
+  postAndWait([=] {
+    tNFA_P2P_EVT_DATA data = {};
+    data.conn_req.server_handle = serverHandle;
+    data.conn_req.conn_handle = conn;
+    data.conn_req.remote_miu = 128;
+    data.conn_req.remote_rw = 1;
+    serverCallback(NFA_P2P_CONN_REQ_EVT, &data);
+  });
+  return conn;
+}
+
+void SimulatedLlcp::disconnect(tNFA_P2P_CBACK* cback, tNFA_HANDLE conn) {
+  {
+    std::lock_guard<std::mutex> lock(mLinkLock);
+    mConnCallbacks.erase(conn);
+    mCongested.erase(conn);
+  }
+  postAndWait([=] {
+    tNFA_P2P_EVT_DATA data = {};
+    data.disc.handle = conn;
+    cback(NFA_P2P_DISC_EVT, &data);
+  });
+}
+
+void SimulatedLlcp::setLink(size_t capacity,
+                            std::chrono::microseconds pduTime) {
+  std::lock_guard<std::mutex> lock(mLinkLock);
+  mLinkCapacity = capacity;
+  mPduTime = pduTime;
+}
+
+tNFA_STATUS SimulatedLlcp::sendData(tNFA_HANDLE conn, uint16_t len) {
+  std::lock_guard<std::mutex> lock(mLinkLock);
+  if (mConnCallbacks.count(conn) == 0) return NFA_STATUS_FAILED;
+  if ((mLinkCapacity != 0) && (mLink.size() >= mLinkCapacity)) {
+    mCongested.insert(conn);
+    return NFA_STATUS_CONGESTED;
+  }
+  mLink.push_back({conn, len});
+  mLinkCond.notify_all();
+  return NFA_STATUS_OK;
+}
+
+uint64_t SimulatedLlcp::waitIdle() {
+  std::unique_lock<std::mutex> lock(mLinkLock);
+  mLinkCond.wait(lock, [this] { return mLink.empty(); });
+  return mBytesSent;
+}
+
+void SimulatedLlcp::addConn(tNFA_HANDLE conn, tNFA_P2P_CBACK* cback) {
+  std::lock_guard<std::mutex> lock(mLinkLock);
+  mConnCallbacks[conn] = cback;
+}
+
+void SimulatedLlcp::run() {
+  for (;;) {
+    std::function<void()> event;
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+      mCond.wait(lock, [this] { return !mEvents.empty(); });
+      event = mEvents.front();
+      mEvents.pop_front();
+    }
+    event();
+  }
+}
+
+void SimulatedLlcp::runLink() {
+  std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+  for (;;) {
+    std::chrono::microseconds pduTime;
+    {
+      std::unique_lock<std::mutex> lock(mLinkLock);
+      mLinkCond.wait(lock, [this] { return !mLink.empty(); });
+      pduTime = mPduTime;
+    }
+    // the PDU at the front is on the air until its slot ends
+    next = std::max(next, std::chrono::steady_clock::now()) + pduTime;
+    std::this_thread::sleep_until(next);
+
+    std::vector<std::pair<tNFA_HANDLE, tNFA_P2P_CBACK*>> uncongested;
+    {
+      std::lock_guard<std::mutex> lock(mLinkLock);
+      mBytesSent += mLink.front().len;
+      mLink.pop_front();
+      for (tNFA_HANDLE conn : mCongested) {
+        auto it = mConnCallbacks.find(conn);
+        if (it != mConnCallbacks.end())
+          uncongested.emplace_back(conn, it->second);
+      }
+      mCongested.clear();
+      mLinkCond.notify_all();
+    }
+    for (auto& conn : uncongested) {
+      post([conn] {
+        tNFA_P2P_EVT_DATA data = {};
+        data.congest.handle = conn.first;
+        data.congest.is_congested = false;
+        conn.second(NFA_P2P_CONGEST_EVT, &data);
+      });
+    }
+  }
+}
+
+// Interpose on the NFA library so no controller is needed.
+tNFA_STATUS NFA_P2pSetLLCPConfig(uint16_t link_miu, uint8_t opt, uint8_t wt,
+                                 uint16_t link_timeout,
+                                 uint16_t inact_timeout_init,
+                                 uint16_t inact_timeout_target,
+                                 uint16_t symm_delay,
+                                 uint16_t data_link_timeout,
+                                 uint16_t delay_first_pdu_timeout) {
+  return NFA_STATUS_OK;
+}
+
+tNFA_STATUS NFA_P2pRegisterServer(uint8_t server_sap,
+                                  tNFA_P2P_LINK_TYPE link_type,
+                                  char* p_service_name,
+                                  tNFA_P2P_CBACK* p_cback) {
+  SimulatedLlcp& llcp = SimulatedLlcp::getInstance();
+  tNFA_HANDLE handle = llcp.newHandle();
+  std::string name(p_service_name);
+  llcp.post([=] {
+    tNFA_P2P_EVT_DATA data = {};
+    data.reg_server.server_handle = handle;
+    data.reg_server.server_sap = server_sap;
+    snprintf(data.reg_server.service_name,
+             sizeof(data.reg_server.service_name), "%s", name.c_str());
+    p_cback(NFA_P2P_REG_SERVER_EVT, &data);
+  });
+  return NFA_STATUS_OK;
+}
+
+tNFA_STATUS NFA_P2pRegisterClient(tNFA_P2P_LINK_TYPE link_type,
+                                  tNFA_P2P_CBACK* p_cback) {
+  SimulatedLlcp& llcp = SimulatedLlcp::getInstance();
+  tNFA_HANDLE handle = llcp.newHandle();
+  llcp.post([=] {
+    tNFA_P2P_EVT_DATA data = {};
+    data.reg_client.client_handle = handle;
+    p_cback(NFA_P2P_REG_CLIENT_EVT, &data);
+  });
+  return NFA_STATUS_OK;
+}
+
+tNFA_STATUS NFA_P2pConnectByName(tNFA_HANDLE client_handle,
+                                 char* p_service_name, uint16_t miu,
+                                 uint8_t rw) {
+  SimulatedLlcp& llcp = SimulatedLlcp::getInstance();
+  tNFA_HANDLE conn = llcp.newHandle();
+  llcp.addConn(conn, llcp.clientCallback);
+  llcp.post([=, &llcp] {
+    tNFA_P2P_EVT_DATA data = {};
+    data.connected.client_handle = client_handle;
+    data.connected.conn_handle = conn;
+    data.connected.remote_miu = miu;
+    data.connected.remote_rw = rw;
+    llcp.clientCallback(NFA_P2P_CONNECTED_EVT, &data);
+  });
+  return NFA_STATUS_OK;
+}
+
+tNFA_STATUS NFA_P2pAcceptConn(tNFA_HANDLE conn_handle, uint16_t miu,
+                              uint8_t rw) {
+  return NFA_STATUS_OK;
+}
+
+tNFA_STATUS NFA_P2pSendData(tNFA_HANDLE handle, uint16_t length,
+                            uint8_t* p_data) {
+  return SimulatedLlcp::getInstance().sendData(handle, length);
+}
+
+tNFA_STATUS NFA_P2pDeregister(tNFA_HANDLE handle) { return NFA_STATUS_OK; }
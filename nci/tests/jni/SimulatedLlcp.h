@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "PeerToPeer.h"
+
+class PeerToPeerPeer {
+ public:
+  static android::sp<P2pServer> findServer(tNFA_HANDLE nfaHandle) {
+    return p2p().findServer(nfaHandle);
+  }
+  static android::sp<P2pServer> findServer(PeerToPeer::tJNI_HANDLE jni) {
+    return p2p().findServer(jni);
+  }
+  static android::sp<P2pServer> findServer(const char* serviceName) {
+    return p2p().findServer(serviceName);
+  }
+  static android::sp<P2pClient> findClient(tNFA_HANDLE nfaHandle) {
+    return p2p().findClient(nfaHandle);
+  }
+  static android::sp<P2pClient> findClient(PeerToPeer::tJNI_HANDLE jni) {
+    return p2p().findClient(jni);
+  }
+  static android::sp<NfaConn> findConnection(tNFA_HANDLE nfaHandle) {
+    return p2p().findConnection(nfaHandle);
+  }
+  static android::sp<NfaConn> findConnection(PeerToPeer::tJNI_HANDLE jni) {
+    return p2p().findConnection(jni);
+  }
+  static void removeServer(PeerToPeer::tJNI_HANDLE jniHandle) {
+    p2p().removeServer(jniHandle);
+  }
+  static void removeConn(PeerToPeer::tJNI_HANDLE jniHandle) {
+    p2p().removeConn(jniHandle);
+  }
+  static void setNfaHandle(const android::sp<P2pServer>& server,
+                           tNFA_HANDLE value) {
+    p2p().setNfaHandle(server, value);
+  }
+
+ private:
+  static PeerToPeer& p2p() { return PeerToPeer::getInstance(); }
+};
+
+// Stands in for the NFA task.  SimulatedLlcp.cpp interposes on the NFA_P2p*
+// calls PeerToPeer makes: handles come from here and P2P events are
+// delivered one at a time from the simulator's own thread, like the stack
+// does.  Data handed to NFA_P2pSendData goes onto a simulated link.
+class SimulatedLlcp {
+ public:
+  static SimulatedLlcp& getInstance();
+
+  tNFA_HANDLE newHandle();
+  void post(std::function<void()> event);
+  void postAndWait(std::function<void()> event);
+
+  // remote device connects to a listening server; returns the conn handle
+  tNFA_HANDLE connRequest(tNFA_HANDLE serverHandle);
+  // remote device drops a data link connection
+  void disconnect(tNFA_P2P_CBACK* cback, tNFA_HANDLE conn);
+
+  // At most capacity PDUs wait in the stack, 0 for no limit; one leaves
+  // every pduTime.  A send that finds the link full is answered with
+  // NFA_STATUS_CONGESTED and followed by NFA_P2P_CONGEST_EVT once a PDU
+  // went out.
+  void setLink(size_t capacity, std::chrono::microseconds pduTime);
+  tNFA_STATUS sendData(tNFA_HANDLE conn, uint16_t len);
+  // wait until every accepted PDU went out; returns the bytes sent so far
+  uint64_t waitIdle();
+
+  void addConn(tNFA_HANDLE conn, tNFA_P2P_CBACK* cback);
+
+  tNFA_P2P_CBACK* serverCallback = PeerToPeer::nfaServerCallback;
+  tNFA_P2P_CBACK* clientCallback = PeerToPeer::nfaClientCallback;
+
+ private:
+  struct Pdu {
+    tNFA_HANDLE conn;
+    uint16_t len;
+  };
+
+  SimulatedLlcp();
+  void run();
+  void runLink();
+
+  std::atomic<uint32_t> mNextHandle;
+  std::mutex mLock;
+  std::condition_variable mCond;
+  std::deque<std::function<void()>> mEvents;
+
+  std::mutex mLinkLock;
+  std::condition_variable mLinkCond;
+  std::deque<Pdu> mLink;
+  size_t mLinkCapacity;
+  std::chrono::microseconds mPduTime;
+  std::set<tNFA_HANDLE> mCongested;
+  std::map<tNFA_HANDLE, tNFA_P2P_CBACK*> mConnCallbacks;
+  uint64_t mBytesSent;
+};
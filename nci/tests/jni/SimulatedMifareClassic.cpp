@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SimulatedMifareClassic.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <phNxpConfig.h>
+#include <phNxpExtns.h>
+#include <phNxpExtns_MifareStd.h>
+#include <phNxpLog.h>
+
+// The extension is built into the test without the NFC stack and the NXP
+// configuration below it; these stand in for the few calls it makes there.
+bool nfc_debug_enabled = false;
+nci_log_level_t gLog_level;
+
+void phNxpLog_InitializeLogLevel(void) {
+  memset(&gLog_level, 0, sizeof(gLog_level));
+}
+void resetNxpConfig(void) {}
+uint8_t NFC_GetNCIVersion() { return NCI_VERSION_1_0; }
+// Every frame goes through the transport, so these are never reached.
+tNFA_STATUS NFA_SendRawFrame(uint8_t* p_raw_data, uint16_t data_len,
+                             uint16_t presence_check_start_delay) {
+  return NFA_STATUS_FAILED;
+}
+tNFA_STATUS NFA_Deactivate(bool sleep_mode) { return NFA_STATUS_FAILED; }
+tNFA_STATUS NFA_Select(uint8_t rf_disc_id, tNFA_NFC_PROTOCOL protocol,
+                       tNFA_INTF_TYPE rf_interface) {
+  return NFA_STATUS_FAILED;
+}
+
+namespace {
+
+// extension ids of the answers, see phNciNfc_ExtnRespId_t
+const uint8_t kXchgData = 0x10;
+const uint8_t kAuth = 0x40;
+const uint8_t kRead = 0x30;
+const uint8_t kWrite = 0xA0;
+const uint8_t kOk = 0x00;
+const uint8_t kNak = 0x03;
+const uint8_t kAck = 0x0A;
+const uint8_t kKeyB = 0x80;
+const uint8_t kEmbeddedKey = 0x10;
+const uint8_t kBlockSize = 16;
+
+// keys the NFCC has preloaded, see NXP_MFC_KEYS
+const uint8_t kPreloadedKeys[][6] = {
+    {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5},
+    {0xD3, 0xF7, 0xD3, 0xF7, 0xD3, 0xF7},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00}};
+
+// Who may do what with a data block, for each C1 C2 C3; bit 0 is key A and
+// bit 1 key B.
+const uint8_t A = 0x01;
+const uint8_t B = 0x02;
+const uint8_t AB = A | B;
+const uint8_t kDataRead[8] = {AB, AB, AB, B, AB, B, AB, 0};
+const uint8_t kDataWrite[8] = {AB, 0, 0, B, B, 0, B, 0};
+// The same for the parts of a sector trailer
+const uint8_t kKeyAWrite[8] = {A, A, 0, B, B, 0, 0, 0};
+const uint8_t kAccessRead[8] = {A, A, A, AB, AB, AB, AB, AB};
+const uint8_t kAccessWrite[8] = {0, A, 0, B, 0, B, 0, 0};
+const uint8_t kKeyBRead[8] = {A, A, A, 0, 0, 0, 0, 0};
+const uint8_t kKeyBWrite[8] = {A, A, 0, B, B, 0, 0, 0};
+
+// Trailers: key A, access bits and GPB, key B left to the caller
+const uint8_t kTransportAccess[4] = {0xFF, 0x07, 0x80, 0x69};
+const uint8_t kMadAccess[4] = {0x78, 0x77, 0x88, 0xC1};
+const uint8_t kMad2Access[4] = {0x78, 0x77, 0x88, 0xC2};
+const uint8_t kNfcAccess[4] = {0x7F, 0x07, 0x88, 0x40};
+
+}  // namespace
+
+const uint8_t SimulatedMifareClassic::kMadKeyA[6] = {0xA0, 0xA1, 0xA2,
+                                                     0xA3, 0xA4, 0xA5};
+const uint8_t SimulatedMifareClassic::kNfcKeyA[6] = {0xD3, 0xF7, 0xD3,
+                                                     0xF7, 0xD3, 0xF7};
+const uint8_t SimulatedMifareClassic::kDefaultKey[6] = {0xFF, 0xFF, 0xFF,
+                                                        0xFF, 0xFF, 0xFF};
+
+SimulatedMifareClassic& SimulatedMifareClassic::getInstance() {
+  static SimulatedMifareClassic* sCard = new SimulatedMifareClassic();
+  return *sCard;
+}
+
+SimulatedMifareClassic::SimulatedMifareClassic()
+    : mType(MIFARE_1K),
+      mNextUid(0),
+      mAuthSector(-1),
+      mAuthKeyB(false),
+      mHalted(false),
+      mRemoved(false),
+      mPendingWrite(-1),
+      mLatency(0),
+      mFailAt(0),
+      mFailStatus(kOk),
+      mTearAfter(0),
+      mDone(false),
+      mStalled(false),
+      mEvent(0),
+      mFrames(0),
+      mAuths(0),
+      mReads(0),
+      mWrites(0),
+      mReconnects(0) {
+  static const phNxpExtns_MfcTransport_t sTransport = {sendRaw, reconnect};
+
+  memset(&mResult, 0, sizeof(mResult));
+  EXTNS_Init(dmCallback, connCallback);
+  EXTNS_MfcRegisterNDefTypeHandler(ndefCallback);
+  Mfc_SetTransport(&sTransport);
+  reset(MIFARE_1K);
+}
+
+uint8_t SimulatedMifareClassic::sectorOf(uint8_t blockNo) {
+  return (blockNo < 128) ? (blockNo / 4) : (32 + (blockNo - 128) / 16);
+}
+
+uint8_t SimulatedMifareClassic::trailerOf(uint8_t sector) {
+  return (sector < 32) ? (sector * 4 + 3) : (128 + (sector - 32) * 16 + 15);
+}
+
+void SimulatedMifareClassic::reset(Type type) {
+  uint16_t blocks = (type == MIFARE_1K) ? 64 : 256;
+  uint8_t sectors = (type == MIFARE_1K) ? 16 : 40;
+
+  mType = type;
+  mBlocks.assign(blocks, std::vector<uint8_t>(kBlockSize, 0x00));
+  mUid = {0x04, 0x5A, 0x3C, 0x11, 0x22, 0x33, ++mNextUid};
+  memcpy(mBlocks[0].data(), mUid.data(), mUid.size());
+  mBlocks[0][7] = (type == MIFARE_1K) ? 0x08 : 0x18;
+  for (uint8_t sector = 0; sector < sectors; sector++) {
+    std::vector<uint8_t>& trailer = mBlocks[trailerOf(sector)];
+    memcpy(&trailer[0], kDefaultKey, 6);
+    memcpy(&trailer[6], kTransportAccess, 4);
+    memcpy(&trailer[10], kDefaultKey, 6);
+  }
+  mTearAfter = 0;
+  mFailAt = 0;
+  mLatency = std::chrono::microseconds(0);
+  mOnWrite = nullptr;
+  clearCounters();
+}
+
+void SimulatedMifareClassic::layoutNfcForum(const std::vector<uint8_t>& tlvs,
+                                            const uint8_t keyB[6]) {
+  uint8_t sectors = (mType == MIFARE_1K) ? 16 : 40;
+  std::vector<uint8_t> mad(32 * 2, 0x00);
+  size_t offset = 0;
+
+  for (uint8_t sector = 0; sector < sectors; sector++) {
+    std::vector<uint8_t>& trailer = mBlocks[trailerOf(sector)];
+    if (sector == 0 || sector == 16) {
+      memcpy(&trailer[0], kMadKeyA, 6);
+      memcpy(&trailer[6], (mType == MIFARE_1K) ? kMadAccess : kMad2Access, 4);
+      memcpy(&trailer[10], kDefaultKey, 6);
+      continue;
+    }
+    memcpy(&trailer[0], kNfcKeyA, 6);
+    memcpy(&trailer[6], kNfcAccess, 4);
+    memcpy(&trailer[10], keyB, 6);
+    if (sector < 32) {
+      // AID 0x03E1, in the byte order the NDEF map looks for
+      mad[sector * 2] = 0x03;
+      mad[sector * 2 + 1] = 0xE1;
+    }
+  }
+  // Blocks 1 and 2 hold sectors 0 to 15 after the CRC and info byte, blocks
+  // 64 to 66 the sectors from 16 on the same way.
+  mad[0] = 0x0F;
+  mad[1] = 0x00;
+  memcpy(mBlocks[1].data(), &mad[0], kBlockSize);
+  memcpy(mBlocks[2].data(), &mad[16], kBlockSize);
+  if (mType == MIFARE_4K) {
+    mad[32] = 0x0F;
+    mad[33] = 0x00;
+    memcpy(mBlocks[64].data(), &mad[32], kBlockSize);
+    memcpy(mBlocks[65].data(), &mad[48], kBlockSize);
+    for (uint8_t sector = 32; sector < sectors; sector++) {
+      mBlocks[66][(sector - 32) * 2] = 0x03;
+      mBlocks[66][(sector - 32) * 2 + 1] = 0xE1;
+    }
+  }
+
+  for (uint16_t blockNo = 4; blockNo < mBlocks.size(); blockNo++) {
+    if ((blockNo == trailerOf(sectorOf(blockNo))) || (sectorOf(blockNo) == 16))
+      continue;
+    std::vector<uint8_t>& data = mBlocks[blockNo];
+    std::fill(data.begin(), data.end(), 0x00);
+    if (offset < tlvs.size()) {
+      size_t n = std::min(tlvs.size() - offset, (size_t)kBlockSize);
+      memcpy(data.data(), &tlvs[offset], n);
+      offset += n;
+    }
+  }
+}
+
+void SimulatedMifareClassic::present() {
+  tNFA_ACTIVATED activated;
+
+  mRemoved = false;
+  mHalted = false;
+  mAuthSector = -1;
+  mPendingWrite = -1;
+  mAnswers.clear();
+
+  memset(&activated, 0, sizeof(activated));
+  tNFC_RF_PA_PARAMS& pa = activated.activate_ntf.rf_tech_param.param.pa;
+  pa.sens_res[0] = (mType == MIFARE_1K) ? 0x44 : 0x42;
+  pa.nfcid1_len = mUid.size();
+  memcpy(pa.nfcid1, mUid.data(), mUid.size());
+  pa.sel_rsp = (mType == MIFARE_1K) ? 0x08 : 0x18;
+  EXTNS_MfcInit(activated);
+}
+
+tNFA_STATUS SimulatedMifareClassic::run(
+    const std::function<NFCSTATUS()>& request) {
+  mDone = false;
+  mStalled = false;
+  mEvent = 0;
+  memset(&mResult, 0, sizeof(mResult));
+
+  if (request() != NFCSTATUS_SUCCESS) return NFA_STATUS_FAILED;
+  while (!mDone && !mAnswers.empty()) {
+    Answer next = mAnswers.front();
+    mAnswers.pop_front();
+    if (mLatency.count() > 0) std::this_thread::sleep_for(mLatency);
+    if (next.activated) {
+      EXTNS_MfcActivated();
+    } else if (!EXTNS_GetCallBackFlag()) {
+      EXTNS_MfcCallBack(next.data.data(), next.data.size());
+    } else {
+      // The extension hands the answer to a raw transceive back to the JNI
+      // transceive, which is done once it has it
+      mRawAnswer = next.data;
+      mResult.status = NFA_STATUS_OK;
+      mDone = true;
+    }
+  }
+  if (!mDone) {
+    mStalled = true;
+    return NFA_STATUS_FAILED;
+  }
+  return mResult.status;
+}
+
+std::vector<uint8_t> SimulatedMifareClassic::dataArea() const {
+  std::vector<uint8_t> area;
+  for (uint16_t blockNo = 4; blockNo < mBlocks.size(); blockNo++) {
+    if ((blockNo == trailerOf(sectorOf(blockNo))) || (sectorOf(blockNo) == 16))
+      continue;
+    area.insert(area.end(), mBlocks[blockNo].begin(), mBlocks[blockNo].end());
+  }
+  return area;
+}
+
+void SimulatedMifareClassic::failFrame(uint32_t n, uint8_t status) {
+  mFailAt = mFrames + n;
+  mFailStatus = status;
+}
+
+void SimulatedMifareClassic::clearCounters() {
+  mFrames = 0;
+  mAuths = 0;
+  mReads = 0;
+  mWrites = 0;
+  mReconnects = 0;
+}
+
+NFCSTATUS SimulatedMifareClassic::sendRaw(uint8_t* buff, uint16_t buffSz) {
+  SimulatedMifareClassic& card = getInstance();
+  card.mAnswers.push_back({false, card.answer(buff, buffSz)});
+  return NFCSTATUS_PENDING;
+}
+
+NFCSTATUS SimulatedMifareClassic::reconnect(void) {
+  SimulatedMifareClassic& card = getInstance();
+  card.mReconnects++;
+  if (card.mRemoved) return NFCSTATUS_FAILED;
+  card.mHalted = false;
+  card.mAuthSector = -1;
+  card.mPendingWrite = -1;
+  card.mAnswers.push_back({true, {}});
+  return NFCSTATUS_PENDING;
+}
+
+void SimulatedMifareClassic::connCallback(uint8_t event,
+                                          tNFA_CONN_EVT_DATA* data) {
+  SimulatedMifareClassic& card = getInstance();
+  card.mEvent = event;
+  card.mResult = *data;
+  card.mDone = true;
+}
+
+void SimulatedMifareClassic::ndefCallback(uint8_t event,
+                                          tNFA_NDEF_EVT_DATA* data) {
+  if (event != NFA_NDEF_DATA_EVT) return;
+  getInstance().mNdef.assign(data->ndef_data.p_data,
+                             data->ndef_data.p_data + data->ndef_data.len);
+}
+
+void SimulatedMifareClassic::dmCallback(uint8_t event,
+                                        tNFA_DM_CBACK_DATA* data) {}
+
+std::vector<uint8_t> SimulatedMifareClassic::answer(const uint8_t* frame,
+                                                    uint16_t len) {
+  mFrames++;
+  if (len == 0) return status(kXchgData, kNak);
+  if (mRemoved) return status(frame[0], kRfTimeout);
+  if (mFrames == mFailAt) {
+    mPendingWrite = -1;
+    return status(frame[0], mFailStatus);
+  }
+  if (mHalted) return status(frame[0], kRfTimeout);
+  if (frame[0] == kAuth) return authenticate(frame, len);
+  if (frame[0] == kXchgData) return exchange(frame, len);
+  return status(frame[0], kNak);
+}
+
+std::vector<uint8_t> SimulatedMifareClassic::authenticate(const uint8_t* frame,
+                                                          uint16_t len) {
+  uint8_t sectors = (mType == MIFARE_1K) ? 16 : 40;
+  const uint8_t* key = NULL;
+
+  mAuths++;
+  mAuthSector = -1;
+  if (len < 3 || frame[1] >= sectors) return status(kAuth, kNak);
+  bool keyB = (frame[2] & kKeyB) != 0;
+  if (frame[2] & kEmbeddedKey) {
+    if (len < 9) return status(kAuth, kNak);
+    key = &frame[3];
+  } else if ((frame[2] & 0x0F) < 4) {
+    key = kPreloadedKeys[frame[2] & 0x0F];
+  } else {
+    return status(kAuth, kNak);
+  }
+
+  uint8_t trailer = trailerOf(frame[1]);
+  const std::vector<uint8_t>& stored = mBlocks[trailer];
+  // A key B that can be read is data and does not authenticate
+  bool keyBReadable = (kKeyBRead[accessBits(trailer)] & A) != 0;
+  if (memcmp(key, &stored[keyB ? 10 : 0], 6) != 0 || (keyB && keyBReadable)) {
+    mHalted = true;
+    return status(kAuth, kNak);
+  }
+  mAuthSector = frame[1];
+  mAuthKeyB = keyB;
+  return status(kAuth, kOk);
+}
+
+std::vector<uint8_t> SimulatedMifareClassic::exchange(const uint8_t* frame,
+                                                      uint16_t len) {
+  if (mPendingWrite >= 0) {
+    uint8_t blockNo = (uint8_t)mPendingWrite;
+    mPendingWrite = -1;
+    if (len != 1 + kBlockSize) {
+      mHalted = true;
+      return status(kXchgData, kNak);
+    }
+    writeBlock(blockNo, &frame[1]);
+    if (mRemoved) return status(kXchgData, kRfTimeout);
+    return {kXchgData, kAck, kOk};
+  }
+
+  if (len != 3 || frame[2] >= mBlocks.size()) return status(kXchgData, kNak);
+  uint8_t blockNo = frame[2];
+  if (frame[1] == kRead && mayRead(blockNo)) {
+    std::vector<uint8_t> rsp = readBlock(blockNo);
+    mReads++;
+    rsp.insert(rsp.begin(), kXchgData);
+    rsp.push_back(kOk);
+    return rsp;
+  }
+  if (frame[1] == kWrite && mayWrite(blockNo)) {
+    mPendingWrite = blockNo;
+    return {kXchgData, kAck, kOk};
+  }
+  mHalted = true;
+  return status(kXchgData, kNak);
+}
+
+uint8_t SimulatedMifareClassic::accessBits(uint8_t blockNo) const {
+  const std::vector<uint8_t>& trailer = mBlocks[trailerOf(sectorOf(blockNo))];
+  uint8_t group;
+
+  if (blockNo == trailerOf(sectorOf(blockNo))) {
+    group = 3;
+  } else if (blockNo < 128) {
+    group = blockNo % 4;
+  } else {
+    group = ((blockNo - 128) % 16) / 5;
+  }
+  // Access bits that do not match their inverted copy block the sector
+  if (((trailer[6] & 0x0F) != (~(trailer[7] >> 4) & 0x0F)) ||
+      ((trailer[6] >> 4) != (~trailer[8] & 0x0F)) ||
+      ((trailer[7] & 0x0F) != (~(trailer[8] >> 4) & 0x0F))) {
+    return 7;
+  }
+  uint8_t c1 = (trailer[7] >> (4 + group)) & 1;
+  uint8_t c2 = (trailer[8] >> group) & 1;
+  uint8_t c3 = (trailer[8] >> (4 + group)) & 1;
+  return (c1 << 2) | (c2 << 1) | c3;
+}
+
+bool SimulatedMifareClassic::mayRead(uint8_t blockNo) const {
+  uint8_t key = mAuthKeyB ? B : A;
+  if (mAuthSector != sectorOf(blockNo)) return false;
+  if (blockNo == trailerOf(sectorOf(blockNo))) return true;
+  return (kDataRead[accessBits(blockNo)] & key) != 0;
+}
+
+bool SimulatedMifareClassic::mayWrite(uint8_t blockNo) const {
+  uint8_t key = mAuthKeyB ? B : A;
+  uint8_t bits = accessBits(blockNo);
+  if (mAuthSector != sectorOf(blockNo) || blockNo == 0) return false;
+  if (blockNo == trailerOf(sectorOf(blockNo))) {
+    return ((kKeyAWrite[bits] | kAccessWrite[bits] | kKeyBWrite[bits]) &
+            key) != 0;
+  }
+  return (kDataWrite[bits] & key) != 0;
+}
+
+std::vector<uint8_t> SimulatedMifareClassic::readBlock(uint8_t blockNo) const {
+  std::vector<uint8_t> data = mBlocks[blockNo];
+  uint8_t key = mAuthKeyB ? B : A;
+  uint8_t bits = accessBits(blockNo);
+
+  if (blockNo != trailerOf(sectorOf(blockNo))) return data;
+  // Key A never reads back, the rest only as far as the access bits allow
+  std::fill(data.begin(), data.begin() + 6, 0x00);
+  if ((kAccessRead[bits] & key) == 0)
+    std::fill(data.begin() + 6, data.begin() + 10, 0x00);
+  if ((kKeyBRead[bits] & key) == 0)
+    std::fill(data.begin() + 10, data.end(), 0x00);
+  return data;
+}
+
+void SimulatedMifareClassic::writeBlock(uint8_t blockNo, const uint8_t* data) {
+  std::vector<uint8_t>& stored = mBlocks[blockNo];
+  uint8_t key = mAuthKeyB ? B : A;
+  uint8_t bits = accessBits(blockNo);
+
+  if (blockNo != trailerOf(sectorOf(blockNo))) {
+    memcpy(stored.data(), data, kBlockSize);
+  } else {
+    // Only the parts the access bits let this key change are taken over
+    if (kKeyAWrite[bits] & key) memcpy(&stored[0], &data[0], 6);
+    if (kAccessWrite[bits] & key) memcpy(&stored[6], &data[6], 4);
+    if (kKeyBWrite[bits] & key) memcpy(&stored[10], &data[10], 6);
+  }
+  mWrites++;
+  if (mOnWrite) mOnWrite(blockNo);
+  if (mTearAfter > 0 && --mTearAfter == 0) mRemoved = true;
+}
+
+std::vector<uint8_t> SimulatedMifareClassic::status(uint8_t id,
+                                                    uint8_t value) const {
+  return {id, value};
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <nfa_api.h>
+#include <phNfcStatus.h>
+
+// Stands in for a MIFARE Classic 1K or 4K card behind the NFCC's proprietary
+// MIFARE interface.  It is plugged into the MIFARE Classic extension with
+// Mfc_SetTransport: every frame the extension sends is answered from the
+// card memory, honouring keys A and B, the access bits of the sector
+// trailers and the halt that follows a failed authentication.  Answers are
+// queued and run() hands them back through EXTNS_MfcCallBack and
+// EXTNS_MfcActivated on the caller's thread, one at a time, the way the NFA
+// callbacks would.  There is no thread, so a request that stops sending
+// frames before it completes shows up as a stall instead of a hang.
+class SimulatedMifareClassic {
+ public:
+  enum Type { MIFARE_1K, MIFARE_4K };
+
+  static const uint8_t kMadKeyA[6];
+  static const uint8_t kNfcKeyA[6];
+  static const uint8_t kDefaultKey[6];
+  // status of every frame sent to a card that left the field
+  static const uint8_t kRfTimeout = 0xB2;
+
+  static SimulatedMifareClassic& getInstance();
+
+  // Puts a new card in transport configuration in front of the reader: all
+  // keys FF, every block readable and writable with key A.  Every card gets
+  // a UID of its own, so nothing learnt about the previous one applies.
+  void reset(Type type);
+  // Lays the card out the way an NFC Forum formatted card is, with the MAD
+  // in sector 0 (and 16 on a 4K card), every other sector an NDEF sector
+  // with key B keyB, and tlvs written from block 4 onwards.
+  void layoutNfcForum(const std::vector<uint8_t>& tlvs,
+                      const uint8_t keyB[6] = kDefaultKey);
+  // Activates the card: calls EXTNS_MfcInit with its UID, SAK and ATQA.
+  void present();
+
+  // Runs one EXTNS_Mfc* request and delivers the card's answers until the
+  // request completes.  Returns the status of the completion event, or
+  // NFA_STATUS_FAILED if the request was refused or stalled.
+  tNFA_STATUS run(const std::function<NFCSTATUS()>& request);
+  // completion event of the last run(), the data of the last read and the
+  // last answer to a raw transceive
+  uint8_t event() const { return mEvent; }
+  const tNFA_CONN_EVT_DATA& result() const { return mResult; }
+  const std::vector<uint8_t>& ndef() const { return mNdef; }
+  const std::vector<uint8_t>& rawAnswer() const { return mRawAnswer; }
+  bool stalled() const { return mStalled; }
+
+  // The bytes of the data blocks from block 4 onwards, trailers and the
+  // second MAD sector left out, which is the area the NDEF TLV lives in.
+  std::vector<uint8_t> dataArea() const;
+  std::vector<uint8_t>& block(uint8_t blockNo) { return mBlocks[blockNo]; }
+  uint16_t blockCount() const { return (uint16_t)mBlocks.size(); }
+  static uint8_t sectorOf(uint8_t blockNo);
+  static uint8_t trailerOf(uint8_t sector);
+
+  // Every frame waits this long before its answer is delivered.
+  void setLatency(std::chrono::microseconds latency) { mLatency = latency; }
+  // The n-th frame from now, counting from 1, is answered with status.
+  void failFrame(uint32_t n, uint8_t status);
+  // The card leaves the field once n more blocks were written, 0 to never.
+  // It answers kRfTimeout until present() is called again.
+  void tearAfterWrites(uint32_t n) { mTearAfter = n; }
+  // Called after every block written, with the block number.
+  void onWrite(std::function<void(uint8_t)> listener) { mOnWrite = listener; }
+
+  uint32_t frames() const { return mFrames; }
+  uint32_t auths() const { return mAuths; }
+  uint32_t reads() const { return mReads; }
+  uint32_t writes() const { return mWrites; }
+  uint32_t reconnects() const { return mReconnects; }
+  void clearCounters();
+
+ private:
+  struct Answer {
+    bool activated;
+    std::vector<uint8_t> data;
+  };
+
+  SimulatedMifareClassic();
+  static NFCSTATUS sendRaw(uint8_t* buff, uint16_t buffSz);
+  static NFCSTATUS reconnect(void);
+  static void connCallback(uint8_t event, tNFA_CONN_EVT_DATA* data);
+  static void ndefCallback(uint8_t event, tNFA_NDEF_EVT_DATA* data);
+  static void dmCallback(uint8_t event, tNFA_DM_CBACK_DATA* data);
+
+  std::vector<uint8_t> answer(const uint8_t* frame, uint16_t len);
+  std::vector<uint8_t> authenticate(const uint8_t* frame, uint16_t len);
+  std::vector<uint8_t> exchange(const uint8_t* frame, uint16_t len);
+  // C1 C2 C3 of the group the block belongs to, as a 3 bit number
+  uint8_t accessBits(uint8_t blockNo) const;
+  bool mayRead(uint8_t blockNo) const;
+  bool mayWrite(uint8_t blockNo) const;
+  std::vector<uint8_t> readBlock(uint8_t blockNo) const;
+  void writeBlock(uint8_t blockNo, const uint8_t* data);
+  std::vector<uint8_t> status(uint8_t id, uint8_t value) const;
+
+  Type mType;
+  std::vector<std::vector<uint8_t>> mBlocks;
+  std::vector<uint8_t> mUid;
+  uint8_t mNextUid;
+  // sector authenticated, -1 for none, and with which key
+  int mAuthSector;
+  bool mAuthKeyB;
+  // a failed authentication or access halts the card until reactivation
+  bool mHalted;
+  bool mRemoved;
+  // block waiting for the second half of a write, -1 for none
+  int mPendingWrite;
+
+  std::deque<Answer> mAnswers;
+  std::chrono::microseconds mLatency;
+  uint32_t mFailAt;
+  uint8_t mFailStatus;
+  uint32_t mTearAfter;
+  std::function<void(uint8_t)> mOnWrite;
+
+  bool mDone;
+  bool mStalled;
+  uint8_t mEvent;
+  tNFA_CONN_EVT_DATA mResult;
+  std::vector<uint8_t> mNdef;
+  std::vector<uint8_t> mRawAnswer;
+
+  uint32_t mFrames;
+  uint32_t mAuths;
+  uint32_t mReads;
+  uint32_t mWrites;
+  uint32_t mReconnects;
+};
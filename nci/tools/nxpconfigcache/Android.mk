@@ -0,0 +1,18 @@
+LOCAL_PATH := $(call my-dir)
+NXP_CONFIG_UTILS := ../../jni/extns/pn54x/src/utils
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    nxpconfigcache.cpp \
+    $(NXP_CONFIG_UTILS)/phNxpConfigCache.cpp \
+    $(NXP_CONFIG_UTILS)/sparse_crc32.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(NXP_CONFIG_UTILS)
+LOCAL_CFLAGS += -Wall -Wextra -Wno-unused-parameter
+
+LOCAL_MODULE := nxpconfigcache
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_OWNER := nxp
+
+include $(BUILD_EXECUTABLE)
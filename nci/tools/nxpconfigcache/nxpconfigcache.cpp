@@ -0,0 +1,123 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2018 NXP Semiconductors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Command line tool to inspect the binary NXP config cache. It is built for
+ * the device, where the config files the cache records can be checked.
+ *
+ *   nxpconfigcache dump   [cache file]  print sources and settings
+ *   nxpconfigcache verify [cache file]  exit 0 only if every source file
+ *                                       still matches its recorded CRC32
+ *
+ * The default cache file is the one of libsn100nfc_nci_jni; the cache of
+ * libnqnfc_nci_jni is /data/vendor/nfc/libnfc-nxpConfigCache.bin.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "phNxpConfigCache.h"
+#include "sparse_crc32.h"
+
+namespace {
+
+const char kDefaultCachePath[] = "/data/nfc/libnfc-nxpConfigCache.bin";
+
+/* Returns true if |path| is a readable non-empty file and sets |crc32|. */
+bool fileCrc32(const char* path, uint32_t& crc32) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat file_stat;
+  bool ok = fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) &&
+            file_stat.st_size > 0;
+  if (ok) {
+    std::vector<uint8_t> data(file_stat.st_size);
+    ok = read(fd, data.data(), data.size()) == (ssize_t)data.size();
+    if (ok) crc32 = sparse_crc32_fast(0, data.data(), data.size());
+  }
+  close(fd);
+  return ok;
+}
+
+/* Returns the number of sources that no longer match the cache. */
+int checkSources(const phNxpConfigCacheImage& image, bool verbose) {
+  int stale = 0;
+  for (const phNxpConfigCacheSource& src : image.sources) {
+    uint32_t crc32 = 0;
+    bool present = fileCrc32(src.path.c_str(), crc32);
+    bool match = present == src.present && (!present || crc32 == src.crc32);
+    if (!match) ++stale;
+    if (verbose) {
+      if (src.present)
+        printf("  %-48s crc32=%08x %s\n", src.path.c_str(), src.crc32,
+               match ? "ok" : "STALE");
+      else
+        printf("  %-48s absent %s\n", src.path.c_str(),
+               match ? "ok" : "STALE");
+    }
+  }
+  return stale;
+}
+
+void dumpEntries(const phNxpConfigCacheImage& image) {
+  for (const phNxpConfigCacheEntry& entry : image.entries) {
+    if (!entry.isString) {
+      printf("  %s=0x%llX\n", entry.name.c_str(),
+             (unsigned long long)entry.numValue);
+      continue;
+    }
+    printf("  %s={", entry.name.c_str());
+    for (size_t n = 0; n < entry.strValue.size(); ++n)
+      printf("%s%02X", n ? ", " : "", (uint8_t)entry.strValue[n]);
+    printf("}\n");
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3 ||
+      (strcmp(argv[1], "dump") != 0 && strcmp(argv[1], "verify") != 0)) {
+    fprintf(stderr, "usage: %s dump|verify [cache file]\n", argv[0]);
+    return 2;
+  }
+  const char* path = argc == 3 ? argv[2] : kDefaultCachePath;
+
+  phNxpConfigCacheImage image;
+  if (!phNxpConfigCache_Read(path, image)) {
+    fprintf(stderr, "%s: missing or corrupt cache\n", path);
+    return 1;
+  }
+
+  if (strcmp(argv[1], "verify") == 0) {
+    int stale = checkSources(image, false);
+    printf("%s: %s\n", path, stale ? "stale" : "valid");
+    return stale ? 1 : 0;
+  }
+
+  printf("config crc32=%08x rf=%08x transit=%08x\n", image.config_crc32,
+         image.config_crc32_rf, image.config_crc32_tr);
+  printf("sources (%zu):\n", image.sources.size());
+  checkSources(image, true);
+  printf("settings (%zu):\n", image.entries.size());
+  dumpEntries(image);
+  return 0;
+}
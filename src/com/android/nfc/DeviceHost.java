@@ -46,6 +46,11 @@ public interface DeviceHost {
 
         public void onHostCardEmulationActivated(int technology);
         public void onHostCardEmulationData(int technology, byte[] data);
+        /**
+         * Notifies of a SELECT the stack already answered from its response
+         * cache; it is passed on, but the answer to it must not be sent
+         */
+        public void onHostCardEmulationReplay(int technology, byte[] data);
         public void onHostCardEmulationDeactivated(int technology);
         /**
          * Notifies that the SE has been activated in listen mode
@@ -172,8 +177,30 @@ public interface DeviceHost {
 
         public void send(byte[] data) throws IOException;
 
+        /**
+         * Queues data to be sent in I-PDUs of at most maxChunk bytes (0 for
+         * the remote MIU) and returns without waiting for the link. Blocks
+         * only while a remote receive window worth of I-PDUs is queued.
+         */
+        public void sendQueued(byte[] data, int maxChunk) throws IOException;
+
+        /**
+         * Waits until everything queued by {@link #sendQueued} was sent.
+         */
+        public void flush() throws IOException;
+
         public int receive(byte[] recvBuff) throws IOException;
 
+        /**
+         * Receives every SDU already queued for this socket, blocking only
+         * until the first one arrives. SDUs are stored back to back in
+         * recvBuff and the length of each is written to sduLengths.
+         *
+         * @return the number of SDUs received
+         * @throws IllegalArgumentException if sduLengths is empty
+         */
+        public int receiveBatch(byte[] recvBuff, int[] sduLengths) throws IOException;
+
         public int getRemoteMiu();
 
         public int getRemoteRw();
@@ -227,8 +254,29 @@ public interface DeviceHost {
     public int[] doGetActiveSecureElementList();
     public boolean sendRawFrame(byte[] data);
 
+    /**
+     * Registers a fixed response the controller stack sends for an HCE
+     * command on the given AID without calling up to Java. Only the bits
+     * set in mask are compared; command and mask have the same length.
+     */
+    public boolean setHceStaticResponse(int owner, byte[] aid, byte[] command, byte[] mask,
+            byte[] response);
+
+    /**
+     * Drops the fixed HCE responses of owner, or of every owner if it is
+     * negative.
+     */
+    public void clearHceStaticResponses(int owner);
+
     public boolean routeAid(byte[] aid, int route, int aidInfo, int powerState);
 
+    /**
+     * Routes a set of AIDs in one call. Each entry of aidTable is
+     * aidLength | aid | route | powerState | aidInfo, one byte each except
+     * the AID itself.
+     */
+    public boolean routeAids(byte[] aidTable, int count);
+
     public boolean unrouteAid(byte[] aid);
 
     public int getAidTableSize();
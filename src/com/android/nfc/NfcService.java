@@ -192,6 +192,7 @@ public class NfcService implements DeviceHostListener {
     static final int MSG_CLEAR_ROUTING = 62;
     static final int MSG_INIT_WIREDSE = 63;
     static final int MSG_COMPUTE_ROUTING_PARAMS = 64;
+    static final int MSG_ROUTE_AID_TABLE = 65;
     // Update stats every 4 hours
     static final long STATS_UPDATE_INTERVAL_MS = 4 * 60 * 60 * 1000;
     static final long MAX_POLLING_PAUSE_TIMEOUT = 40000;
@@ -461,6 +462,13 @@ public class NfcService implements DeviceHostListener {
         }
     }
 
+    @Override
+    public void onHostCardEmulationReplay(int technology, byte[] data) {
+        if (mCardEmulationManager != null) {
+            mCardEmulationManager.onHostCardEmulationReplay(technology, data);
+        }
+    }
+
     @Override
     public void onHostCardEmulationDeactivated(int technology) {
         if (mCardEmulationManager != null) {
@@ -829,6 +837,15 @@ public class NfcService implements DeviceHostListener {
         return mSecureElement.doTransceive(handle, cmd);
     }
 
+    byte[] doTransceiveScript(int handle, byte[] script) {
+        mEeWakeLock.acquire();
+        try {
+            return mSecureElement.doTransceiveScript(handle, script);
+        } finally {
+            mEeWakeLock.release();
+        }
+    }
+
     /**
      * Manages tasks that involve turning on/off the NFC controller.
      * <p/>
@@ -1502,6 +1519,11 @@ public class NfcService implements DeviceHostListener {
         public IBinder getNfcAdapterVendorInterface(String vendor) {
             if(vendor.equalsIgnoreCase("nxp")) {
                 return (IBinder) mNxpNfcAdapter;
+            } else if (vendor.equalsIgnoreCase("hce_static_responses")) {
+                if (mIsHceCapable && mCardEmulationManager != null) {
+                    return mCardEmulationManager.getStaticResponseInterface().asBinder();
+                }
+                return null;
             } else {
                 return null;
             }
@@ -2389,7 +2411,7 @@ public class NfcService implements DeviceHostListener {
         }
     }
 
-    static byte[] hexStringToBytes(String s) {
+    public static byte[] hexStringToBytes(String s) {
         if (s == null || s.length() == 0) return null;
         int len = s.length();
         if (len % 2 != 0) {
@@ -2687,6 +2709,18 @@ public class NfcService implements DeviceHostListener {
         mHandler.sendMessage(msg);
     }
 
+    /**
+     * Routes a packed table of count AIDs in one request. Each entry is
+     * aidLength | aid | route | powerState | aidInfo.
+     */
+    public void routeAidTable(byte[] table, int count) {
+        Message msg = mHandler.obtainMessage();
+        msg.what = MSG_ROUTE_AID_TABLE;
+        msg.arg1 = count;
+        msg.obj = table;
+        mHandler.sendMessage(msg);
+    }
+
     public int getAidRoutingTableSize ()
     {
         //return 18;
@@ -2863,6 +2897,15 @@ public class NfcService implements DeviceHostListener {
         return mDeviceHost.sendRawFrame(data);
     }
 
+    public boolean setHceStaticResponse(int owner, byte[] aid, byte[] command, byte[] mask,
+            byte[] response) {
+        return mDeviceHost.setHceStaticResponse(owner, aid, command, mask, response);
+    }
+
+    public void clearHceStaticResponses(int owner) {
+        mDeviceHost.clearHceStaticResponses(owner);
+    }
+
     void sendMessage(int what, Object obj) {
         Message msg = mHandler.obtainMessage();
         msg.what = what;
@@ -2974,6 +3017,11 @@ public class NfcService implements DeviceHostListener {
                     // Restart polling config
                     break;
                 }
+                case MSG_ROUTE_AID_TABLE: {
+                    byte[] table = (byte[]) msg.obj;
+                    mDeviceHost.routeAids(table, msg.arg1);
+                    break;
+                }
                 case MSG_UNROUTE_AID: {
                     String aid = (String) msg.obj;
                     mDeviceHost.unrouteAid(hexStringToBytes(aid));
@@ -42,6 +42,7 @@ import android.app.ActivityManager;
 import android.app.ActivityManager.RunningTaskInfo;
 import com.android.nfc.NfcService;
 import android.util.SparseArray;
+import java.io.ByteArrayOutputStream;
 import java.io.FileDescriptor;
 import java.io.PrintWriter;
 import java.util.Collections;
@@ -106,12 +107,15 @@ public class AidRoutingManager {
     private native int doGetDefaultRouteDestination();
     private native int doGetDefaultOffHostRouteDestination();
     private native int doGetAidMatchingMode();
+    private native int[] doPlanAidRouting(byte[] table, int[] priorities, int capacity,
+            int maxAids);
     final ActivityManager mActivityManager;
     final class AidEntry {
         boolean isOnHost;
         int aidInfo;
         int powerstate;
         int route;
+        int priority; // higher is dropped last when the table overflows
     }
 
     public AidRoutingManager() {
@@ -192,6 +196,7 @@ public class AidRoutingManager {
         HashMap<String, Integer> infoForAid = new HashMap<String, Integer>(aidMap.size());
         HashMap<String, Integer> powerForAid = new HashMap<String, Integer>(aidMap.size());
         Hashtable<String, AidEntry> routeCache = new Hashtable<String, AidEntry>(50);
+        Hashtable<String, AidEntry> preferredRouteCache = null;
         mDefaultRoute = NfcService.getInstance().GetDefaultRouteLoc();
         mAidRoutingTableSize = NfcService.getInstance().getAidRoutingTableSize();
         mDefaultAidRoute =   NfcService.getInstance().GetDefaultRouteEntry() >> 0x08;
@@ -333,6 +338,16 @@ public class AidRoutingManager {
                       }
                     }
                 }
+                // Fold entries already covered by a prefix or subset entry
+                Hashtable<String, AidEntry> foldedCache =
+                        planRouteCache(routeCache, Integer.MAX_VALUE, 0);
+                if (foldedCache != null) {
+                    routeCache.clear();
+                    routeCache.putAll(foldedCache);
+                }
+                if (preferredRouteCache == null) {
+                    preferredRouteCache = new Hashtable<String, AidEntry>(routeCache);
+                }
                 defaultRouteCache.updateDefaultAidRouteCache(routeCache , mDefaultRoute);
                 if(defaultRouteCache.mAidRouteResolvedStatus)
                     break;
@@ -355,6 +370,9 @@ public class AidRoutingManager {
             } else {
                 if (DBG) Log.d(TAG, "Routing size calculation resolved routing table full ");
                 NfcService.getInstance().notifyRoutingTableFull();
+                // Route what fits on the preferred route instead of nothing
+                routeCache = planRouteCache(preferredRouteCache, mAidRoutingTableSize,
+                        DefaultAidRouteResolveCache.MAX_AID_ENTRIES);
             }
         }
         // And finally commit the routing and update the status of commit for each service
@@ -366,6 +384,7 @@ public class AidRoutingManager {
         }
         else{
             if (DBG) Log.d(TAG, "Routing size calculation resolved commit false ");
+            commit(routeCache);
             NfcService.getInstance().updateStatusOfServices(false);
             mLastCommitStatus = false;
         }
@@ -382,16 +401,66 @@ public class AidRoutingManager {
        //List<AidEntry> list = Collections.list(routeCache.elements());
             //Collections.sort(list);
             //NfcService.getInstance().clearRouting();
+        // Pack the whole cache so the stack can program it in one pass
+        ByteArrayOutputStream table = new ByteArrayOutputStream();
+        int count = packRouteCache(routeCache, table, null);
+        if (count > 0) {
+            NfcService.getInstance().routeAidTable(table.toByteArray(), count);
+        }
+    }
+
+    /**
+     * Packs routeCache as aidLength | aid | route | powerState | aidInfo
+     * entries. Returns the number of entries written; their AIDs are
+     * added to aids in the same order if it is not null.
+     */
+    private int packRouteCache(Hashtable<String, AidEntry> routeCache,
+            ByteArrayOutputStream table, List<String> aids) {
+        int count = 0;
         for (Map.Entry<String, AidEntry> aidEntry : routeCache.entrySet())  {
             AidEntry element = aidEntry.getValue();
             if (DBG) Log.d (TAG, element.toString());
-            NfcService.getInstance().routeAids(
-                 aidEntry.getKey(),
-                 element.route,
-                 element.aidInfo,
-                 element.powerstate);
+            byte[] aid = NfcService.hexStringToBytes(aidEntry.getKey());
+            if (aid == null || aid.length > 0xFF) continue;
+            table.write(aid.length);
+            table.write(aid, 0, aid.length);
+            table.write(element.route);
+            table.write(element.powerstate);
+            table.write(element.aidInfo);
+            if (aids != null) aids.add(aidEntry.getKey());
+            count++;
         }
+        return count;
     }
+
+    /**
+     * Asks the native planner which entries of routeCache to route so the
+     * table stays within capacity bytes and maxAids entries (0 for no
+     * limit). Covered entries are folded into their prefix or subset entry
+     * and the lowest priority entries are dropped. Returns null if the
+     * cache could not be planned.
+     */
+    private Hashtable<String, AidEntry> planRouteCache(Hashtable<String, AidEntry> routeCache,
+            int capacity, int maxAids) {
+        if (routeCache == null) return null;
+        ByteArrayOutputStream table = new ByteArrayOutputStream();
+        List<String> aids = new ArrayList<String>(routeCache.size());
+        int count = packRouteCache(routeCache, table, aids);
+        int[] priorities = new int[count];
+        for (int i = 0; i < count; i++) {
+            priorities[i] = routeCache.get(aids.get(i)).priority;
+        }
+        int[] kept = doPlanAidRouting(table.toByteArray(), priorities, capacity, maxAids);
+        if (kept == null) return null;
+        Hashtable<String, AidEntry> planned = new Hashtable<String, AidEntry>(kept.length);
+        for (int index : kept) {
+            String aid = aids.get(index);
+            planned.put(aid, routeCache.get(aid));
+        }
+        if (DBG) Log.d(TAG, "Planned " + planned.size() + " of " + routeCache.size() + " AIDs");
+        return planned;
+    }
+
     /**
      * This notifies that the AID routing table in the controller
      * has been cleared (usually due to NFC being turned off).
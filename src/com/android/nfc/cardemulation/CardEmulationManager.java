@@ -88,6 +88,7 @@ public class CardEmulationManager implements RegisteredServicesCache.Callback,
     final Context mContext;
     final CardEmulationInterface mCardEmulationInterface;
     final NfcFCardEmulationInterface mNfcFCardEmulationInterface;
+    final StaticResponseInterface mStaticResponseInterface;
     final PowerManager mPowerManager;
     final RegisteredNfcServicesCache mRegisteredNfcServicesCache;
 
@@ -95,6 +96,7 @@ public class CardEmulationManager implements RegisteredServicesCache.Callback,
         mContext = context;
         mCardEmulationInterface = new CardEmulationInterface();
         mNfcFCardEmulationInterface = new NfcFCardEmulationInterface();
+        mStaticResponseInterface = new StaticResponseInterface();
         mAidCache = new RegisteredAidCache(context);
         mT3tIdentifiersCache = new RegisteredT3tIdentifiersCache(context);
         mHostEmulationManager = new HostEmulationManager(context, mAidCache);
@@ -117,6 +119,10 @@ public class CardEmulationManager implements RegisteredServicesCache.Callback,
     public INfcFCardEmulation getNfcFCardEmulationInterface() {
         return mNfcFCardEmulationInterface;
     }
+
+    public INfcHceStaticResponses getStaticResponseInterface() {
+        return mStaticResponseInterface;
+    }
         // To get Object of RegisteredAidCache to get the Default Offhost service.
     public RegisteredAidCache getRegisteredAidCache() {
         return mAidCache;
@@ -151,6 +157,12 @@ public class CardEmulationManager implements RegisteredServicesCache.Callback,
         }
     }
 
+    public void onHostCardEmulationReplay(int technology, byte[] data) {
+        if (technology == NFC_HCE_APDU) {
+            mHostEmulationManager.onHostEmulationReplay(data);
+        }
+    }
+
     public void onHostCardEmulationDeactivated(int technology) {
         if (technology == NFC_HCE_APDU) {
             mHostEmulationManager.onHostEmulationDeactivated();
@@ -214,6 +226,8 @@ public class CardEmulationManager implements RegisteredServicesCache.Callback,
         mAidCache.onServicesUpdated(userId, services);
         // Update the preferred services list
         mPreferredServices.onServicesUpdated();
+        // Cached responses may belong to services that no longer own their AID
+        mHostEmulationManager.onServicesUpdated();
     }
 
     @Override
@@ -309,6 +323,22 @@ public class CardEmulationManager implements RegisteredServicesCache.Callback,
         return mServiceCache.hasService(userId, service);
     }
 
+    /**
+     * Returns whether service is registered for userId and belongs to the
+     * calling app.
+     */
+    boolean isCallingServiceOwner(int userId, ComponentName service) {
+        if (!isServiceRegistered(userId, service)) {
+            return false;
+        }
+        NfcApduServiceInfo serviceInfo = mServiceCache.getService(userId, service);
+        if (serviceInfo == null || serviceInfo.getUid() != Binder.getCallingUid()) {
+            Log.e(TAG, "UID mismatch for " + service);
+            return false;
+        }
+        return true;
+    }
+
     boolean isNfcFServiceInstalled(int userId, ComponentName service) {
         boolean serviceFound = mNfcFServicesCache.hasService(userId, service);
         if (!serviceFound) {
@@ -459,6 +489,36 @@ public class CardEmulationManager implements RegisteredServicesCache.Callback,
         }
     }
 
+    /**
+     * This class implements the application-facing static response APIs and
+     * is called from binder. INfcCardEmulation is owned by the framework, so
+     * it is reached through the vendor interface of NfcAdapter instead. All
+     * calls must be permission-checked.
+     */
+    final class StaticResponseInterface extends INfcHceStaticResponses.Stub {
+        @Override
+        public boolean registerStaticResponse(int userId, ComponentName service, String aid,
+                byte[] command, byte[] mask, byte[] response) {
+            NfcPermissions.validateUserId(userId);
+            NfcPermissions.enforceUserPermissions(mContext);
+            if (userId != ActivityManager.getCurrentUser()
+                    || !isCallingServiceOwner(userId, service)) {
+                return false;
+            }
+            return mHostEmulationManager.registerStaticResponse(service, aid, command, mask,
+                    response);
+        }
+
+        @Override
+        public void clearStaticResponses(int userId, ComponentName service) {
+            NfcPermissions.validateUserId(userId);
+            NfcPermissions.enforceUserPermissions(mContext);
+            if (isCallingServiceOwner(userId, service)) {
+                mHostEmulationManager.clearStaticResponses(service);
+            }
+        }
+    }
+
     /**
      * This class implements the application-facing APIs and are called
      * from binder. All calls must be permission-checked.
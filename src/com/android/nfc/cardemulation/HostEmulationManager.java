@@ -44,6 +44,7 @@ import com.android.nfc.cardemulation.RegisteredAidCache.AidResolveInfo;
 import java.io.FileDescriptor;
 import java.io.PrintWriter;
 import java.util.ArrayList;
+import java.util.HashMap;
 
 public class HostEmulationManager {
     static final String TAG = "HostEmulationManager";
@@ -101,6 +102,17 @@ public class HostEmulationManager {
     String mLastSelectedAid;
     int mState;
     byte[] mSelectApdu;
+    // Set if the stack already answered mSelectApdu from its response
+    // cache; the APDUs the reader sent since then wait in mPendingApdus
+    // until the service is bound
+    boolean mSelectApduReplayed;
+    final ArrayList<byte[]> mPendingApdus = new ArrayList<byte[]>();
+    // Answers of the active service to replayed SELECTs still to be dropped
+    int mReplayResponsesToDrop;
+    // Services with responses cached in the stack, by owner id
+    final HashMap<ComponentName, Integer> mStaticResponseOwners =
+            new HashMap<ComponentName, Integer>();
+    int mNextStaticResponseOwner;
 
     public HostEmulationManager(Context context, RegisteredAidCache aidCache) {
         mContext = context;
@@ -112,6 +124,7 @@ public class HostEmulationManager {
 
     public void onPreferredPaymentServiceChanged(ComponentName service) {
         synchronized (mLock) {
+            clearStaticResponsesLocked();
             if (service != null) {
                 bindPaymentServiceLocked(ActivityManager.getCurrentUser(), service);
             } else {
@@ -122,6 +135,7 @@ public class HostEmulationManager {
 
      public void onPreferredForegroundServiceChanged(ComponentName service) {
          synchronized (mLock) {
+            clearStaticResponsesLocked();
             if (service != null) {
                bindServiceIfNeededLocked(service);
             } else {
@@ -130,6 +144,60 @@ public class HostEmulationManager {
          }
      }
 
+    public void onServicesUpdated() {
+        synchronized (mLock) {
+            clearStaticResponsesLocked();
+        }
+    }
+
+    /**
+     * Lets the stack answer command on aid with response without binding
+     * to service. Only the bits set in mask are compared. service must be
+     * the default on-host service for aid and must not require unlock;
+     * the entry is dropped as soon as services or preferences change.
+     */
+    boolean registerStaticResponse(ComponentName service, String aid, byte[] command,
+            byte[] mask, byte[] response) {
+        if (service == null || aid == null || command == null || mask == null
+                || response == null || command.length != mask.length
+                || aid.length() % 2 != 0 || aid.endsWith("*") || aid.endsWith("#")) {
+            return false;
+        }
+        synchronized (mLock) {
+            AidResolveInfo resolveInfo = mAidCache.resolveAid(aid);
+            NfcApduServiceInfo defaultService =
+                    (resolveInfo != null) ? resolveInfo.defaultService : null;
+            if (defaultService == null || !defaultService.isOnHost()
+                    || defaultService.requiresUnlock()
+                    || !service.equals(defaultService.getComponent())) {
+                Log.e(TAG, "Not caching responses of " + service + " for AID " + aid);
+                return false;
+            }
+            Integer owner = mStaticResponseOwners.get(service);
+            if (owner == null) {
+                owner = mNextStaticResponseOwner++;
+                mStaticResponseOwners.put(service, owner);
+            }
+            return NfcService.getInstance().setHceStaticResponse(owner,
+                    NfcService.hexStringToBytes(aid), command, mask, response);
+        }
+    }
+
+    void clearStaticResponses(ComponentName service) {
+        synchronized (mLock) {
+            Integer owner = mStaticResponseOwners.remove(service);
+            if (owner != null) {
+                NfcService.getInstance().clearHceStaticResponses(owner);
+            }
+        }
+    }
+
+    void clearStaticResponsesLocked() {
+        if (mStaticResponseOwners.isEmpty()) return;
+        mStaticResponseOwners.clear();
+        NfcService.getInstance().clearHceStaticResponses(-1);
+    }
+
     public void onHostEmulationActivated() {
         Log.d(TAG, "notifyHostEmulationActivated");
         synchronized (mLock) {
@@ -147,6 +215,20 @@ public class HostEmulationManager {
 
     public void onHostEmulationData(byte[] data) {
         Log.d(TAG, "notifyHostEmulationData");
+        handleHostEmulationData(data, false);
+    }
+
+    /**
+     * Handles a SELECT the stack answered from its response cache. It is
+     * passed to the service like any other, but the service's answer is
+     * dropped since the reader already has it.
+     */
+    public void onHostEmulationReplay(byte[] data) {
+        Log.d(TAG, "notifyHostEmulationReplay");
+        handleHostEmulationData(data, true);
+    }
+
+    void handleHostEmulationData(byte[] data, boolean replay) {
         String selectAid = findSelectAid(data);
         ComponentName resolvedService = null;
         synchronized (mLock) {
@@ -159,13 +241,13 @@ public class HostEmulationManager {
             }
             if (selectAid != null) {
                 if (selectAid.equals(ANDROID_HCE_AID)) {
-                    NfcService.getInstance().sendData(ANDROID_HCE_RESPONSE);
+                    sendDataLocked(ANDROID_HCE_RESPONSE, replay);
                     return;
                 }
                 AidResolveInfo resolveInfo = mAidCache.resolveAid(selectAid);
                 if (resolveInfo == null || resolveInfo.services.size() == 0) {
                     // Tell the remote we don't handle this AID
-                    NfcService.getInstance().sendData(AID_NOT_FOUND);
+                    sendDataLocked(AID_NOT_FOUND, replay);
                     return;
                 }
                 mLastSelectedAid = selectAid;
@@ -185,7 +267,7 @@ public class HostEmulationManager {
                     if (!defaultServiceInfo.isOnHost()) {
                         Log.e(TAG, "AID that was meant to go off-host was routed to host." +
                                 " Check routing table configuration.");
-                        NfcService.getInstance().sendData(AID_NOT_FOUND);
+                        sendDataLocked(AID_NOT_FOUND, replay);
                         return;
                     }
                     resolvedService = defaultServiceInfo.getComponent();
@@ -214,12 +296,12 @@ public class HostEmulationManager {
                     if (existingService != null) {
                         Log.d(TAG, "Binding to existing service");
                         mState = STATE_XFER;
-                        sendDataToServiceLocked(existingService, data);
+                        sendDataToServiceLocked(existingService, data, replay);
                     } else {
                         // Waiting for service to be bound
                         Log.d(TAG, "Waiting for new service.");
                         // Queue SELECT APDU to be used
-                        mSelectApdu = data;
+                        queueSelectApduLocked(data, replay);
                         mState = STATE_W4_SERVICE;
                     }
                 } else {
@@ -228,22 +310,27 @@ public class HostEmulationManager {
                 }
                 break;
             case STATE_W4_SERVICE:
-                Log.d(TAG, "Unexpected APDU in STATE_W4_SERVICE");
+                if (mSelectApduReplayed && selectAid == null) {
+                    // The reader has its SELECT answer and went on
+                    mPendingApdus.add(data);
+                } else {
+                    Log.d(TAG, "Unexpected APDU in STATE_W4_SERVICE");
+                }
                 break;
             case STATE_XFER:
                 if (selectAid != null) {
                     Messenger existingService = bindServiceIfNeededLocked(resolvedService);
                     if (existingService != null) {
-                        sendDataToServiceLocked(existingService, data);
+                        sendDataToServiceLocked(existingService, data, replay);
                         mState = STATE_XFER;
                     } else {
                         // Waiting for service to be bound
-                        mSelectApdu = data;
+                        queueSelectApduLocked(data, replay);
                         mState = STATE_W4_SERVICE;
                     }
                 } else if (mActiveService != null) {
                     // Regular APDU data
-                    sendDataToServiceLocked(mActiveService, data);
+                    sendDataToServiceLocked(mActiveService, data, false);
                 } else {
                     // No SELECT AID and no active service.
                     Log.d(TAG, "Service no longer bound, dropping APDU");
@@ -262,6 +349,8 @@ public class HostEmulationManager {
             sendDeactivateToActiveServiceLocked(HostApduService.DEACTIVATION_LINK_LOSS);
             mActiveService = null;
             mActiveServiceName = null;
+            mPendingApdus.clear();
+            mReplayResponsesToDrop = 0;
             unbindServiceIfNeededLocked();
             mState = STATE_IDLE;
         }
@@ -277,6 +366,8 @@ public class HostEmulationManager {
             }
             mActiveService = null;
             mActiveServiceName = null;
+            mPendingApdus.clear();
+            mReplayResponsesToDrop = 0;
             unbindServiceIfNeededLocked();
             mState = STATE_W4_SELECT;
 
@@ -309,10 +400,25 @@ public class HostEmulationManager {
         }
     }
 
-    void sendDataToServiceLocked(Messenger service, byte[] data) {
+    void sendDataLocked(byte[] data, boolean replay) {
+        // The reader already got the answer to a replayed SELECT
+        if (!replay) {
+            NfcService.getInstance().sendData(data);
+        }
+    }
+
+    void queueSelectApduLocked(byte[] data, boolean replay) {
+        mSelectApdu = data;
+        mSelectApduReplayed = replay;
+        mPendingApdus.clear();
+    }
+
+    void sendDataToServiceLocked(Messenger service, byte[] data, boolean replay) {
         if (service != mActiveService) {
             sendDeactivateToActiveServiceLocked(HostApduService.DEACTIVATION_DESELECTED);
             mActiveService = service;
+            // Answers of the previous service are no longer accepted
+            mReplayResponsesToDrop = 0;
             if (service.equals(mPaymentService)) {
                 mActiveServiceName = mPaymentServiceName;
             } else {
@@ -326,6 +432,9 @@ public class HostEmulationManager {
         msg.replyTo = mMessenger;
         try {
             mActiveService.send(msg);
+            if (replay) {
+                mReplayResponsesToDrop++;
+            }
         } catch (RemoteException e) {
             Log.e(TAG, "Remote service has died, dropping APDU");
         }
@@ -456,8 +565,12 @@ public class HostEmulationManager {
                 mState = STATE_XFER;
                 // Send pending select APDU
                 if (mSelectApdu != null) {
-                    sendDataToServiceLocked(mService, mSelectApdu);
+                    sendDataToServiceLocked(mService, mSelectApdu, mSelectApduReplayed);
                     mSelectApdu = null;
+                    for (byte[] apdu : mPendingApdus) {
+                        sendDataToServiceLocked(mService, apdu, false);
+                    }
+                    mPendingApdus.clear();
                 }
             }
         }
@@ -495,10 +608,17 @@ public class HostEmulationManager {
                     return;
                 }
                 int state;
+                boolean replayAnswer = false;
                 synchronized(mLock) {
                     state = mState;
+                    if (state == STATE_XFER && mReplayResponsesToDrop > 0) {
+                        mReplayResponsesToDrop--;
+                        replayAnswer = true;
+                    }
                 }
-                if (state == STATE_XFER) {
+                if (replayAnswer) {
+                    Log.d(TAG, "Dropping answer to replayed SELECT");
+                } else if (state == STATE_XFER) {
                     Log.d(TAG, "Sending data");
                     NfcService.getInstance().sendData(data);
                 } else {
@@ -506,6 +626,10 @@ public class HostEmulationManager {
                 }
             } else if (msg.what == HostApduService.MSG_UNHANDLED) {
                 synchronized (mLock) {
+                    // No answer will come for the replayed SELECT
+                    if (mReplayResponsesToDrop > 0) {
+                        mReplayResponsesToDrop--;
+                    }
                     AidResolveInfo resolveInfo = mAidCache.resolveAid(mLastSelectedAid);
                     boolean isPayment = false;
                     if (resolveInfo.services.size() > 0) {
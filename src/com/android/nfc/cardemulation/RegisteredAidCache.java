@@ -889,6 +889,9 @@ public class RegisteredAidCache {
                Log.d(TAG," AID power state"+ aid  + powerstate  +"route"+route);
                aidType.route = route;
                aidType.powerstate = powerstate;
+               // Keep the default payment AIDs longest if the table overflows
+               aidType.priority = CardEmulation.CATEGORY_PAYMENT.equals(resolveInfo.category)
+                       ? 2 : 1;
                routingEntries.put(aid, aidType);
             } else if (resolveInfo.services.size() == 1) {
                 // Only one service, but not the default, must route to host
@@ -53,6 +53,8 @@ public class SnepMessenger {
     private static final String TAG = "SnepMessenger";
     private static final boolean DBG = true;
     private static final int HEADER_LENGTH = 6;
+    // Continuation fragments drained per receive call
+    private static final int RECEIVE_BATCH_FRAGMENTS = 8;
     final LlcpSocket mSocket;
     final int mFragmentLength;
     final boolean mIsClient;
@@ -123,7 +125,15 @@ public class SnepMessenger {
             }
         }
 
-        // Send remaining fragments.
+        // Send remaining fragments. Outside DTA mode nothing is read between
+        // them, so hand them all to the native sender and wait once.
+        if (!NfcService.sIsDtaMode && offset < buffer.length) {
+            if (DBG) Log.d(TAG, "about to queue " + (buffer.length - offset) + " bytes");
+            mSocket.sendQueued(Arrays.copyOfRange(buffer, offset, buffer.length),
+                    mFragmentLength);
+            mSocket.flush();
+            offset = buffer.length;
+        }
         while (offset < buffer.length) {
             length = Math.min(buffer.length - offset, mFragmentLength);
             tmpBuffer = Arrays.copyOfRange(buffer, offset, offset + length);
@@ -257,12 +267,18 @@ public class SnepMessenger {
             doneReading = true;
         }
 
-        // Remaining fragments
+        // Remaining fragments, drained in batches of whatever is already queued
+        byte[] batch = doneReading ? null : new byte[mFragmentLength * RECEIVE_BATCH_FRAGMENTS];
+        int[] fragmentLengths = doneReading ? null : new int[RECEIVE_BATCH_FRAGMENTS];
         while (!doneReading) {
             try {
-                size = mSocket.receive(partial);
-                if (DBG) Log.d(TAG, "read " + size + " bytes");
-                if (size < 0) {
+                int fragments = mSocket.receiveBatch(batch, fragmentLengths);
+                size = 0;
+                for (int i = 0; i < fragments; i++) {
+                    size += fragmentLengths[i];
+                }
+                if (DBG) Log.d(TAG, "read " + size + " bytes in " + fragments + " fragments");
+                if (fragments <= 0) {
                     try {
                         mSocket.send(SnepMessage.getMessage(fieldReject).toByteArray());
                     } catch (IOException e) {
@@ -271,7 +287,7 @@ public class SnepMessenger {
                     throw new IOException();
                 } else {
                     readSize += size;
-                    buffer.write(partial, 0, size);
+                    buffer.write(batch, 0, size);
                     if (readSize == requestSize) {
                         doneReading = true;
                     }
@@ -19,6 +19,7 @@ package com.android.nfc;
 import android.util.Log;
 
 import java.io.IOException;
+import java.util.Arrays;
 import java.util.LinkedList;
 import java.util.List;
 
@@ -51,6 +52,21 @@ public class MockLlcpSocket implements DeviceHost.LlcpSocket {
         }
     }
 
+    @Override
+    public void sendQueued(byte[] data, int maxChunk) throws IOException {
+        int chunk = maxChunk > 0 ? maxChunk : data.length;
+        for (int offset = 0; offset < data.length; offset += chunk) {
+            send(Arrays.copyOfRange(data, offset, Math.min(data.length, offset + chunk)));
+        }
+    }
+
+    @Override
+    public void flush() throws IOException {
+        if (mClosed || mPairedSocket == null) {
+            throw new IOException("Socket not connected");
+        }
+    }
+
     @Override
     public int receive(byte[] receiveBuffer) throws IOException {
         synchronized (mReceivedPackets) {
@@ -68,6 +84,30 @@ public class MockLlcpSocket implements DeviceHost.LlcpSocket {
         }
     }
 
+    @Override
+    public int receiveBatch(byte[] receiveBuffer, int[] sduLengths) throws IOException {
+        synchronized (mReceivedPackets) {
+            while (!mClosed && mReceivedPackets.size() == 0) {
+                try {
+                    mReceivedPackets.wait(1000);
+                } catch (InterruptedException e) {}
+            }
+            if (mClosed) {
+                throw new IOException("Socket closed.");
+            }
+            int count = 0;
+            int offset = 0;
+            while (count < sduLengths.length && mReceivedPackets.size() > 0 && (count == 0
+                    || mReceivedPackets.get(0).length <= receiveBuffer.length - offset)) {
+                byte[] arr = mReceivedPackets.remove(0);
+                System.arraycopy(arr, 0, receiveBuffer, offset, arr.length);
+                sduLengths[count++] = arr.length;
+                offset += arr.length;
+            }
+            return count;
+        }
+    }
+
     public static void bind(MockLlcpSocket client, MockLlcpSocket server) {
         client.mPairedSocket = server;
         server.mPairedSocket = client;